@@ -47,6 +47,9 @@
 #include "xrow_io.h"
 #include "error.h"
 #include "session.h"
+#include "txn.h"
+#include "space.h"
+#include "schema.h"
 
 double applier_timeout = 1;
 
@@ -349,6 +352,196 @@ finish:
 	applier_set_state(applier, APPLIER_READY);
 }
 
+/**
+ * Decode the next row from the input buffer if it has already
+ * been read up completely. Never reads from the socket.
+ *
+ * @retval true if a row was decoded
+ * @retval false if the buffer has no complete row
+ */
+static bool
+applier_read_ahead(struct ibuf *in, struct xrow_header *row)
+{
+	const char *pos = in->rpos;
+	/* Malformed input is reported by coio_read_xrow(). */
+	if (pos == in->wpos || mp_typeof(*pos) != MP_UINT ||
+	    mp_check_uint(pos, in->wpos) > 0)
+		return false;
+	uint32_t len = mp_decode_uint(&pos);
+	if ((size_t) (in->wpos - pos) < len)
+		return false;
+	xrow_header_decode_xc(row, &pos, pos + len);
+	in->rpos = (char *) pos;
+	return true;
+}
+
+/**
+ * Raise an error if the master sent an error or a row
+ * which can not be applied.
+ */
+static void
+applier_check_row(struct xrow_header *row)
+{
+	if (iproto_type_is_error(row->type))
+		xrow_decode_error_xc(row);  /* error */
+	/* Replication request. */
+	if (row->replica_id == REPLICA_ID_NIL ||
+	    row->replica_id >= VCLOCK_MAX) {
+		/*
+		 * A safety net, this can only occur
+		 * if we're fed a strangely broken xlog.
+		 */
+		tnt_raise(ClientError, ER_UNKNOWN_REPLICA,
+			  int2str(row->replica_id),
+			  tt_uuid_str(&REPLICASET_UUID));
+	}
+}
+
+/**
+ * Apply a single row received from the master unless
+ * it has already been applied.
+ */
+static void
+applier_apply_row(struct applier *applier, struct xrow_header *row)
+{
+	if (vclock_get(&replicaset_vclock, row->replica_id) >= row->lsn)
+		return;
+	/**
+	 * Promote the replica set vclock before
+	 * applying the row. If there is an
+	 * exception (conflict) applying the row,
+	 * the row is skipped when the replication
+	 * is resumed.
+	 */
+	vclock_follow(&replicaset_vclock, row->replica_id, row->lsn);
+	xstream_write_xc(applier->subscribe_stream, row);
+}
+
+/**
+ * Return the space the row modifies if the row can be applied
+ * in a transaction along with other rows, NULL otherwise.
+ * Changes of system spaces are not allowed in multi-statement
+ * transactions, and on_replace triggers may yield, so such
+ * rows are applied one by one.
+ */
+static struct space *
+applier_batch_space(struct xrow_header *row)
+{
+	if (!iproto_type_is_dml(row->type) ||
+	    row->replica_id == REPLICA_ID_NIL ||
+	    row->replica_id >= VCLOCK_MAX)
+		return NULL;
+	struct request request;
+	if (xrow_decode_dml(row, &request,
+			    dml_request_key_map(row->type)) != 0) {
+		/* Will be reported when the row is applied. */
+		diag_clear(&fiber()->diag);
+		return NULL;
+	}
+	struct space *space = space_by_id(request.space_id);
+	if (space == NULL || space_is_system(space) ||
+	    !rlist_empty(&space->on_replace))
+		return NULL;
+	return space;
+}
+
+/**
+ * Undo the promotion of the replica set vclock by a row which
+ * has not been applied, unless the vclock has moved on since.
+ */
+static void
+applier_unpromote_row(struct xrow_header *row, int64_t prev_lsn)
+{
+	if (vclock_get(&replicaset_vclock, row->replica_id) == row->lsn)
+		vclock_reset(&replicaset_vclock, row->replica_id, prev_lsn);
+}
+
+/**
+ * Apply rows in a single transaction, so that they are
+ * written to WAL at once rather than waiting for a WAL
+ * write per row. If the transaction fails, fall back on
+ * applying the rows one by one, so that an error is raised
+ * for the offending row, exactly as without batching. The rows
+ * following the offending one are not counted in the replica
+ * set vclock then, so that they are applied on resubscribe.
+ */
+static void
+applier_apply_tx(struct applier *applier, struct xrow_header *rows,
+		 int count)
+{
+	assert(count <= APPLIER_BATCH_MAX);
+	bool is_promoted[APPLIER_BATCH_MAX];
+	int64_t prev_lsn[APPLIER_BATCH_MAX];
+	memset(is_promoted, 0, sizeof(is_promoted));
+
+	struct txn *txn = txn_begin(false);
+	if (txn == NULL)
+		diag_raise();
+	int i;
+	for (i = 0; i < count; i++) {
+		struct xrow_header *row = &rows[i];
+		if (vclock_get(&replicaset_vclock, row->replica_id) >= row->lsn)
+			continue;
+		prev_lsn[i] = vclock_follow(&replicaset_vclock,
+					    row->replica_id, row->lsn);
+		is_promoted[i] = true;
+		if (xstream_write(applier->subscribe_stream, row) != 0 ||
+		    in_txn() != txn)
+			break;
+	}
+	if (i == count) {
+		/* txn_commit() rolls back the transaction on failure. */
+		if (txn_commit(txn) == 0)
+			return;
+	} else if (in_txn() == txn) {
+		txn_rollback();
+	}
+	diag_clear(&fiber()->diag);
+
+	for (i = 0; i < count; i++) {
+		if (!is_promoted[i]) {
+			applier_apply_row(applier, &rows[i]);
+			continue;
+		}
+		if (xstream_write(applier->subscribe_stream, &rows[i]) != 0) {
+			for (int j = count - 1; j > i; j--) {
+				if (is_promoted[j])
+					applier_unpromote_row(&rows[j],
+							      prev_lsn[j]);
+			}
+			diag_raise();
+		}
+	}
+}
+
+/**
+ * Apply rows received from the master. Consecutive rows
+ * modifying user spaces of the same engine are grouped into
+ * transactions.
+ */
+static void
+applier_apply_rows(struct applier *applier, struct xrow_header *rows,
+		   int count)
+{
+	int i = 0;
+	while (i < count) {
+		applier_check_row(&rows[i]);
+		struct space *space = applier_batch_space(&rows[i]);
+		int end = i + 1;
+		while (space != NULL && end < count) {
+			struct space *next = applier_batch_space(&rows[end]);
+			if (next == NULL || next->engine != space->engine)
+				break;
+			end++;
+		}
+		if (end - i > 1)
+			applier_apply_tx(applier, rows + i, end - i);
+		else
+			applier_apply_row(applier, &rows[i]);
+		i = end;
+	}
+}
+
 /**
  * Execute and process SUBSCRIBE request (follow updates from a master).
  */
@@ -400,36 +593,23 @@ applier_subscribe(struct applier *applier)
 	/*
 	 * Process a stream of rows from the binary log.
 	 */
+	struct xrow_header *batch = applier->batch;
 	while (true) {
-		coio_read_xrow(coio, &iobuf->in, &row);
-		applier->lag = ev_now(loop()) - row.tm;
+		int count = 0;
+		coio_read_xrow(coio, &iobuf->in, &batch[count++]);
+		/*
+		 * Decode ahead the rows which have already been
+		 * read up, to apply them with a single WAL write.
+		 * The rows refer to the input buffer, so it must
+		 * not be touched until they are applied.
+		 */
+		while (count < APPLIER_BATCH_MAX &&
+		       applier_read_ahead(&iobuf->in, &batch[count]))
+			count++;
+		applier->lag = ev_now(loop()) - batch[count - 1].tm;
 		applier->last_row_time = ev_monotonic_now(loop());
 
-		if (iproto_type_is_error(row.type))
-			xrow_decode_error_xc(&row);  /* error */
-		/* Replication request. */
-		if (row.replica_id == REPLICA_ID_NIL ||
-		    row.replica_id >= VCLOCK_MAX) {
-			/*
-			 * A safety net, this can only occur
-			 * if we're fed a strangely broken xlog.
-			 */
-			tnt_raise(ClientError, ER_UNKNOWN_REPLICA,
-				  int2str(row.replica_id),
-				  tt_uuid_str(&REPLICASET_UUID));
-		}
-		if (vclock_get(&replicaset_vclock, row.replica_id) < row.lsn) {
-			/**
-			 * Promote the replica set vclock before
-			 * applying the row. If there is an
-			 * exception (conflict) applying the row,
-			 * the row is skipped when the replication
-			 * is resumed.
-			 */
-			vclock_follow(&replicaset_vclock, row.replica_id,
-				      row.lsn);
-			xstream_write_xc(applier->subscribe_stream, &row);
-		}
+		applier_apply_rows(applier, batch, count);
 		fiber_cond_signal(&applier->writer_cond);
 		iobuf_reset(iobuf);
 		fiber_gc();
@@ -43,6 +43,7 @@
 #include "uri.h"
 
 #include "vclock.h"
+#include "xrow.h"
 
 /** Network timeout */
 extern double applier_timeout;
@@ -51,6 +52,12 @@ struct xstream;
 
 enum { APPLIER_SOURCE_MAXLEN = 1024 }; /* enough to fit URI with passwords */
 
+/**
+ * The max number of rows read ahead from the master and
+ * applied in a single transaction by SUBSCRIBE.
+ */
+enum { APPLIER_BATCH_MAX = 64 };
+
 #define applier_STATE(_)                                             \
 	_(APPLIER_OFF, 0)                                            \
 	_(APPLIER_CONNECT, 1)                                        \
@@ -113,6 +120,8 @@ struct applier {
 	struct xstream *join_stream;
 	/** xstream to process rows during final JOIN and SUBSCRIBE */
 	struct xstream *subscribe_stream;
+	/** Rows read ahead from the master, see applier_subscribe() */
+	struct xrow_header batch[APPLIER_BATCH_MAX];
 };
 
 /**
@@ -158,6 +158,39 @@ box_check_memtx_min_tuple_size(ssize_t memtx_min_tuple_size)
 		  "specified value is out of bounds");
 }
 
+static int
+box_check_memtx_checkpoint_deltas(int memtx_checkpoint_deltas)
+{
+	if (memtx_checkpoint_deltas < 0) {
+		tnt_raise(ClientError, ER_CFG, "memtx_checkpoint_deltas",
+			  "the value must be greater than or equal to 0");
+	}
+	return memtx_checkpoint_deltas;
+}
+
+static int
+box_check_memtx_checkpoint_threads(int memtx_checkpoint_threads)
+{
+	if (memtx_checkpoint_threads < 1 ||
+	    memtx_checkpoint_threads > MEMTX_CHECKPOINT_THREADS_MAX) {
+		tnt_raise(ClientError, ER_CFG, "memtx_checkpoint_threads",
+			  tt_sprintf("the value must be between 1 and %d",
+				     MEMTX_CHECKPOINT_THREADS_MAX));
+	}
+	return memtx_checkpoint_threads;
+}
+
+static int64_t
+box_check_vinyl_dict_size(int64_t vinyl_dict_size)
+{
+	if (vinyl_dict_size < 0 || vinyl_dict_size > VINYL_DICT_SIZE_MAX) {
+		tnt_raise(ClientError, ER_CFG, "vinyl_dict_size",
+			  tt_sprintf("the value must be between 0 and %d",
+				     VINYL_DICT_SIZE_MAX));
+	}
+	return vinyl_dict_size;
+}
+
 static int
 process_rw(struct request *request, struct space *space, struct tuple **result)
 {
@@ -414,6 +447,17 @@ box_check_readahead(int readahead)
 	}
 }
 
+static int
+box_check_iproto_threads(int iproto_threads)
+{
+	enum { IPROTO_THREADS_MAX = 1000 };
+	if (iproto_threads < 1 || iproto_threads > IPROTO_THREADS_MAX) {
+		tnt_raise(ClientError, ER_CFG, "iproto_threads",
+			  "the value must be between 1 and 1000");
+	}
+	return iproto_threads;
+}
+
 static void
 box_check_checkpoint_count(int checkpoint_count)
 {
@@ -445,6 +489,36 @@ box_check_wal_max_size(int64_t wal_max_size)
 	return wal_max_size;
 }
 
+static int64_t
+box_check_wal_tail_size(int64_t wal_tail_size)
+{
+	if (wal_tail_size < 0) {
+		tnt_raise(ClientError, ER_CFG, "wal_tail_size",
+			  "the value must be greater than or equal to 0");
+	}
+	return wal_tail_size;
+}
+
+static double
+box_check_wal_commit_delay(double wal_commit_delay)
+{
+	if (wal_commit_delay < 0) {
+		tnt_raise(ClientError, ER_CFG, "wal_commit_delay",
+			  "the value must be greater than or equal to 0");
+	}
+	return wal_commit_delay;
+}
+
+static int
+box_check_wal_commit_siblings(int wal_commit_siblings)
+{
+	if (wal_commit_siblings < 0) {
+		tnt_raise(ClientError, ER_CFG, "wal_commit_siblings",
+			  "the value must be greater than or equal to 0");
+	}
+	return wal_commit_siblings;
+}
+
 void
 box_check_config()
 {
@@ -454,11 +528,18 @@ box_check_config()
 	box_check_replication();
 	box_check_replication_timeout();
 	box_check_readahead(cfg_geti("readahead"));
+	box_check_iproto_threads(cfg_geti("iproto_threads"));
 	box_check_checkpoint_count(cfg_geti("checkpoint_count"));
 	box_check_wal_max_rows(cfg_geti64("rows_per_wal"));
 	box_check_wal_max_size(cfg_geti64("wal_max_size"));
+	box_check_wal_tail_size(cfg_geti64("wal_tail_size"));
+	box_check_wal_commit_delay(cfg_getd("wal_commit_delay"));
+	box_check_wal_commit_siblings(cfg_geti("wal_commit_siblings"));
 	box_check_wal_mode(cfg_gets("wal_mode"));
 	box_check_memtx_min_tuple_size(cfg_geti64("memtx_min_tuple_size"));
+	box_check_memtx_checkpoint_deltas(cfg_geti("memtx_checkpoint_deltas"));
+	box_check_memtx_checkpoint_threads(cfg_geti("memtx_checkpoint_threads"));
+	box_check_vinyl_dict_size(cfg_geti64("vinyl_dict_size"));
 	if (cfg_geti64("vinyl_page_size") > cfg_geti64("vinyl_range_size"))
 		tnt_raise(ClientError, ER_CFG, "vinyl_page_size",
 			  "can't be greater than vinyl_range_size");
@@ -556,6 +637,20 @@ box_set_replication_timeout(void)
 	replication_cfg_timeout = relay_timeout = applier_timeout = timeout;
 }
 
+void
+box_set_wal_commit_delay(void)
+{
+	wal_set_commit_delay(box_check_wal_commit_delay(
+				cfg_getd("wal_commit_delay")));
+}
+
+void
+box_set_wal_commit_siblings(void)
+{
+	wal_set_commit_siblings(box_check_wal_commit_siblings(
+				cfg_geti("wal_commit_siblings")));
+}
+
 void
 box_bind(void)
 {
@@ -609,6 +704,28 @@ box_set_memtx_max_tuple_size(void)
 			cfg_geti("memtx_max_tuple_size"));
 }
 
+void
+box_set_memtx_checkpoint_deltas(void)
+{
+	struct memtx_engine *memtx;
+	memtx = (struct memtx_engine *)engine_by_name("memtx");
+	assert(memtx != NULL);
+	memtx_engine_set_checkpoint_deltas(memtx,
+		box_check_memtx_checkpoint_deltas(
+			cfg_geti("memtx_checkpoint_deltas")));
+}
+
+void
+box_set_memtx_checkpoint_threads(void)
+{
+	struct memtx_engine *memtx;
+	memtx = (struct memtx_engine *)engine_by_name("memtx");
+	assert(memtx != NULL);
+	memtx_engine_set_checkpoint_threads(memtx,
+		box_check_memtx_checkpoint_threads(
+			cfg_geti("memtx_checkpoint_threads")));
+}
+
 void
 box_set_too_long_threshold(void)
 {
@@ -650,6 +767,25 @@ box_set_vinyl_timeout(void)
 	vinyl_engine_set_timeout(vinyl,	cfg_getd("vinyl_timeout"));
 }
 
+void
+box_set_vinyl_page_cache(void)
+{
+	struct vinyl_engine *vinyl;
+	vinyl = (struct vinyl_engine *)engine_by_name("vinyl");
+	assert(vinyl != NULL);
+	vinyl_engine_set_page_cache(vinyl, cfg_geti64("vinyl_page_cache"));
+}
+
+void
+box_set_vinyl_dict_size(void)
+{
+	struct vinyl_engine *vinyl;
+	vinyl = (struct vinyl_engine *)engine_by_name("vinyl");
+	assert(vinyl != NULL);
+	vinyl_engine_set_dict_size(vinyl,
+		box_check_vinyl_dict_size(cfg_geti64("vinyl_dict_size")));
+}
+
 /* }}} configuration bindings */
 
 /**
@@ -793,6 +929,16 @@ int
 box_select(struct port *port, uint32_t space_id, uint32_t index_id,
 	   int iterator, uint32_t offset, uint32_t limit,
 	   const char *key, const char *key_end)
+{
+	return box_select_chunked(port, space_id, index_id, iterator,
+				  offset, limit, key, key_end, 0, NULL, NULL);
+}
+
+int
+box_select_chunked(struct port *port, uint32_t space_id, uint32_t index_id,
+		   int iterator, uint32_t offset, uint32_t limit,
+		   const char *key, const char *key_end, uint32_t chunk_size,
+		   box_select_chunk_f on_chunk, void *arg)
 {
 	(void)key_end;
 
@@ -828,8 +974,8 @@ box_select(struct port *port, uint32_t space_id, uint32_t index_id,
 	if (txn_begin_ro_stmt(space, &txn) != 0)
 		return -1;
 
-	struct iterator *it = index_create_iterator(index, type,
-						    key, part_count);
+	struct iterator *it = index_create_iterator_with_offset(index, type,
+						key, part_count, offset);
 	if (it == NULL) {
 		txn_rollback_stmt();
 		return -1;
@@ -842,14 +988,15 @@ box_select(struct port *port, uint32_t space_id, uint32_t index_id,
 		rc = iterator_next(it, &tuple);
 		if (rc != 0 || tuple == NULL)
 			break;
-		if (offset > 0) {
-			offset--;
-			continue;
-		}
 		rc = port_add_tuple(port, tuple);
 		if (rc != 0)
 			break;
 		found++;
+		if (port->size == chunk_size) {
+			rc = on_chunk(port, arg);
+			if (rc != 0)
+				break;
+		}
 	}
 	iterator_delete(it);
 
@@ -1423,6 +1570,8 @@ engine_init()
 				    cfg_getd("slab_alloc_factor"));
 	engine_register((struct engine *)memtx);
 	box_set_memtx_max_tuple_size();
+	box_set_memtx_checkpoint_deltas();
+	box_set_memtx_checkpoint_threads();
 
 	struct sysview_engine *sysview = sysview_engine_new_xc();
 	engine_register((struct engine *)sysview);
@@ -1436,6 +1585,8 @@ engine_init()
 				    cfg_getd("vinyl_timeout"));
 	engine_register((struct engine *)vinyl);
 	box_set_vinyl_max_tuple_size();
+	box_set_vinyl_page_cache();
+	box_set_vinyl_dict_size();
 }
 
 /**
@@ -1601,7 +1752,7 @@ box_cfg_xc(void)
 	schema_init();
 	replication_init();
 	port_init();
-	iproto_init();
+	iproto_init(box_check_iproto_threads(cfg_geti("iproto_threads")));
 	wal_thread_start();
 
 	title("loading");
@@ -1745,9 +1896,12 @@ box_cfg_xc(void)
 	/* Start WAL writer */
 	int64_t wal_max_rows = box_check_wal_max_rows(cfg_geti64("rows_per_wal"));
 	int64_t wal_max_size = box_check_wal_max_size(cfg_geti64("wal_max_size"));
+	int64_t wal_tail_size = box_check_wal_tail_size(
+					cfg_geti64("wal_tail_size"));
 	enum wal_mode wal_mode = box_check_wal_mode(cfg_gets("wal_mode"));
 	wal_init(wal_mode, cfg_gets("wal_dir"), &INSTANCE_UUID,
-		 &replicaset_vclock, wal_max_rows, wal_max_size);
+		 &replicaset_vclock, wal_max_rows, wal_max_size,
+		 wal_tail_size, cfg_geti("wal_prealloc"));
 
 	rmean_cleanup(rmean_box);
 
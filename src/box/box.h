@@ -152,9 +152,15 @@ void box_set_too_long_threshold(void);
 void box_set_readahead(void);
 void box_set_checkpoint_count(void);
 void box_set_memtx_max_tuple_size(void);
+void box_set_memtx_checkpoint_deltas(void);
+void box_set_memtx_checkpoint_threads(void);
 void box_set_vinyl_max_tuple_size(void);
 void box_set_vinyl_timeout(void);
+void box_set_vinyl_page_cache(void);
+void box_set_vinyl_dict_size(void);
 void box_set_replication_timeout(void);
+void box_set_wal_commit_delay(void);
+void box_set_wal_commit_siblings(void);
 
 extern "C" {
 #endif /* defined(__cplusplus) */
@@ -167,6 +173,24 @@ box_select(struct port *port, uint32_t space_id, uint32_t index_id,
 	   int iterator, uint32_t offset, uint32_t limit,
 	   const char *key, const char *key_end);
 
+/**
+ * Called by box_select_chunked() each time the port collects
+ * a chunk of tuples. It must consume the tuples and empty the
+ * port. It may yield, the iterator survives that.
+ */
+typedef int (*box_select_chunk_f)(struct port *port, void *arg);
+
+/**
+ * Same as box_select(), but hand the found tuples over to
+ * @a on_chunk in chunks of @a chunk_size as they are found,
+ * leaving only the rest in the port.
+ */
+int
+box_select_chunked(struct port *port, uint32_t space_id, uint32_t index_id,
+		   int iterator, uint32_t offset, uint32_t limit,
+		   const char *key, const char *key_end, uint32_t chunk_size,
+		   box_select_chunk_f on_chunk, void *arg);
+
 /** \cond public */
 
 /*
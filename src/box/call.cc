@@ -35,6 +35,7 @@
 #include "session.h"
 #include "func.h"
 #include "port.h"
+#include "tuple_convert.h"
 #include "scoped_guard.h"
 #include "box.h"
 #include "txn.h"
@@ -68,8 +69,43 @@ access_check_func(const char *name, uint32_t name_len)
 	return func;
 }
 
+/**
+ * Stream the tuples returned by a C function in chunks, the
+ * last chunk goes as the reply itself.
+ */
+static int
+box_c_call_stream(struct port *port, struct call_request *request,
+		  struct obuf *out, struct call_stream *stream)
+{
+	struct port_entry *pe = port->first;
+	uint32_t left = port->size;
+	while (true) {
+		uint32_t n = MIN(left, stream->chunk_size);
+		struct obuf_svp svp;
+		if (iproto_prepare_select(out, &svp) != 0)
+			return -1;
+		for (uint32_t i = 0; i < n; i++, pe = pe->next) {
+			if (tuple_to_obuf(pe->tuple, out) != 0) {
+				obuf_rollback_to_svp(out, &svp);
+				return -1;
+			}
+		}
+		left -= n;
+		if (left == 0) {
+			iproto_reply_select(out, &svp, request->header->sync,
+					    ::schema_version, n);
+			return 0;
+		}
+		iproto_reply_chunk(out, &svp, request->header->sync,
+				   ::schema_version, n);
+		if (stream->flush(stream) != 0)
+			return -1;
+	}
+}
+
 static int
-box_c_call(struct func *func, struct call_request *request, struct obuf *out)
+box_c_call(struct func *func, struct call_request *request, struct obuf *out,
+	   struct call_stream *stream)
 {
 	assert(func != NULL && func->def->language == FUNC_LANGUAGE_C);
 
@@ -94,6 +130,12 @@ box_c_call(struct func *func, struct call_request *request, struct obuf *out)
 		goto error;
 	}
 
+	if (stream != NULL && request->header->type == IPROTO_CALL) {
+		if (box_c_call_stream(&port, request, out, stream) != 0)
+			goto error;
+		return 0;
+	}
+
 	/* Push results to obuf */
 	struct obuf_svp svp;
 	if (iproto_prepare_select(out, &svp) != 0)
@@ -142,7 +184,8 @@ box_func_reload(const char *name)
 }
 
 void
-box_process_call(struct call_request *request, struct obuf *out)
+box_process_call(struct call_request *request, struct obuf *out,
+		 struct call_stream *stream)
 {
 	rmean_collect(rmean_box, IPROTO_CALL, 1);
 	/**
@@ -183,9 +226,9 @@ box_process_call(struct call_request *request, struct obuf *out)
 
 	int rc;
 	if (func && func->def->language == FUNC_LANGUAGE_C) {
-		rc = box_c_call(func, request, out);
+		rc = box_c_call(func, request, out, stream);
 	} else {
-		rc = box_lua_call(request, out);
+		rc = box_lua_call(request, out, stream);
 	}
 	/* Restore the original user */
 	if (orig_credentials)
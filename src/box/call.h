@@ -49,8 +49,28 @@ struct box_function_ctx {
 	struct port *port;
 };
 
+/**
+ * Sink of a CALL reply streamed in chunks, see IPROTO_CHUNK.
+ * Only the values, or the members of the only table returned,
+ * are streamed, each as an element of a chunk.
+ */
+struct call_stream {
+	/** Max number of values in a chunk. */
+	uint32_t chunk_size;
+	/**
+	 * Called each time a chunk is written to the output
+	 * buffer. May yield to throttle the function.
+	 */
+	int (*flush)(struct call_stream *stream);
+};
+
+/**
+ * Execute a CALL request and write the reply to @a out,
+ * in chunks if @a stream is not NULL.
+ */
 void
-box_process_call(struct call_request *request, struct obuf *out);
+box_process_call(struct call_request *request, struct obuf *out,
+		 struct call_stream *stream);
 
 void
 box_process_eval(struct call_request *request, struct obuf *out);
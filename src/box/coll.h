@@ -49,6 +49,10 @@ typedef uint32_t (*coll_hash_f)(const char *s, size_t s_len,
 				uint32_t *ph, uint32_t *pcarry,
 				struct coll *coll);
 
+typedef size_t (*coll_hint_f)(const char *s, size_t s_len,
+			      char *buf, size_t buf_len,
+			      struct coll *coll);
+
 /**
  * ICU collation specific data.
  */
@@ -73,6 +77,11 @@ struct coll {
 	/** String comparator. */
 	coll_cmp_f cmp;
 	coll_hash_f hash;
+	/**
+	 * Sort key prefix: the first bytes of a byte string
+	 * whose memcmp() order matches the order of cmp.
+	 */
+	coll_hint_f hint;
 	/** Collation name. */
 	size_t name_len;
 	char name[0];
@@ -212,6 +212,7 @@ struct errcode_record {
 	/*157 */_(ER_SQL_EXECUTE,               "Failed to execute SQL statement: %s") \
 	/*158 */_(ER_SQL,			"SQL error: %s") \
 	/*159 */_(ER_SQL_BIND_NOT_FOUND,	"Parameter %s was not found in the statement") \
+	/*160 */_(ER_OVERLOAD,			"Too many requests on the connection, retry in %u ms") \
 
 /*
  * !IMPORTANT! Please follow instructions at start of the file
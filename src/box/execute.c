@@ -42,6 +42,8 @@
 #include "schema.h"
 #include "port.h"
 #include "memtx_tuple.h"
+#include "assoc.h"
+#include "small/rlist.h"
 
 const char *sql_type_strs[] = {
 	NULL,
@@ -241,6 +243,237 @@ sql_bind_list_decode(struct sql_request *request, const char *data,
 	return 0;
 }
 
+/**
+ * A compiled statement stored in the prepared statement cache.
+ *
+ * Compiling an SQL statement (parsing, name resolution and
+ * query planning) costs much more than executing a typical
+ * OLTP query, so compiled VDBE programs are cached and reused
+ * by subsequent requests with the same SQL text. A statement
+ * is identified by a hash of its text, which is also the id
+ * returned to clients in reply to PREPARE. A statement that
+ * was compiled against an older schema is recompiled on next
+ * use. The cache is only accessed from the tx thread.
+ */
+struct sql_stmt_entry {
+	/** Statement id, a hash of the SQL text. */
+	uint32_t id;
+	/** Schema version the statement was compiled against. */
+	uint32_t schema_version;
+	/**
+	 * Set while the statement is being executed. Since
+	 * execution may yield, a concurrent request for the
+	 * same statement compiles a private copy instead.
+	 */
+	bool is_busy;
+	/** Compiled statement. */
+	struct sqlite3_stmt *stmt;
+	/** Link in sql_stmt_cache_lru. */
+	struct rlist in_lru;
+	/** Length of the SQL text. */
+	uint32_t sql_len;
+	/** SQL text, not null-terminated. */
+	char sql[0];
+};
+
+enum {
+	/** Max number of statements in the cache. */
+	SQL_STMT_CACHE_SIZE = 1024,
+};
+
+/** Statement id -> struct sql_stmt_entry. */
+static struct mh_i32ptr_t *sql_stmt_cache;
+/** Statement text -> struct sql_stmt_entry. */
+static struct mh_strnptr_t *sql_stmt_cache_by_text;
+/** Id to try for the next cached statement. */
+static uint32_t sql_stmt_next_id = 1;
+/** Cached statements, most recently used first. */
+static RLIST_HEAD(sql_stmt_cache_lru);
+/** Number of statements in the cache. */
+static uint32_t sql_stmt_cache_size;
+
+/**
+ * Allocate an id for a new cached statement. Ids come from a
+ * counter rather than from the text hash, so that two texts
+ * never share an id.
+ */
+static uint32_t
+sql_stmt_new_id(void)
+{
+	uint32_t id;
+	do {
+		id = sql_stmt_next_id++;
+	} while (id == 0 || mh_i32ptr_find(sql_stmt_cache, id,
+					   NULL) != mh_end(sql_stmt_cache));
+	return id;
+}
+
+static void
+sql_stmt_entry_delete(struct sql_stmt_entry *entry)
+{
+	assert(!entry->is_busy);
+	sqlite3_finalize(entry->stmt);
+	free(entry);
+}
+
+/** Remove a statement from the cache and free it. */
+static void
+sql_stmt_cache_delete(struct sql_stmt_entry *entry)
+{
+	mh_int_t k = mh_i32ptr_find(sql_stmt_cache, entry->id, NULL);
+	assert(k != mh_end(sql_stmt_cache));
+	mh_i32ptr_del(sql_stmt_cache, k, NULL);
+	k = mh_strnptr_find_inp(sql_stmt_cache_by_text, entry->sql,
+				entry->sql_len);
+	assert(k != mh_end(sql_stmt_cache_by_text));
+	mh_strnptr_del(sql_stmt_cache_by_text, k, NULL);
+	rlist_del_entry(entry, in_lru);
+	sql_stmt_cache_size--;
+	sql_stmt_entry_delete(entry);
+}
+
+/**
+ * Find a statement in the cache by id.
+ * @retval NULL if the statement isn't cached.
+ */
+static struct sql_stmt_entry *
+sql_stmt_cache_find(uint32_t id)
+{
+	if (sql_stmt_cache == NULL)
+		return NULL;
+	mh_int_t k = mh_i32ptr_find(sql_stmt_cache, id, NULL);
+	if (k == mh_end(sql_stmt_cache))
+		return NULL;
+	struct sql_stmt_entry *entry = (struct sql_stmt_entry *)
+		mh_i32ptr_node(sql_stmt_cache, k)->val;
+	rlist_move_entry(&sql_stmt_cache_lru, entry, in_lru);
+	return entry;
+}
+
+/**
+ * Compile an SQL statement.
+ * @retval  0 Success.
+ * @retval -1 SQL error.
+ */
+static int
+sql_stmt_compile(sqlite3 *db, const char *sql, uint32_t len,
+		 struct sqlite3_stmt **stmt)
+{
+	if (sqlite3_prepare_v2(db, sql, len, stmt, NULL) != SQLITE_OK) {
+		diag_set(ClientError, ER_SQL_EXECUTE, sqlite3_errmsg(db));
+		return -1;
+	}
+	assert(*stmt != NULL);
+	return 0;
+}
+
+/**
+ * Recompile a cached statement if the schema has changed
+ * since it was compiled.
+ * @retval  0 Success.
+ * @retval -1 SQL error.
+ */
+static int
+sql_stmt_entry_check_schema(sqlite3 *db, struct sql_stmt_entry *entry)
+{
+	if (entry->schema_version == schema_version)
+		return 0;
+	assert(!entry->is_busy);
+	struct sqlite3_stmt *stmt;
+	if (sql_stmt_compile(db, entry->sql, entry->sql_len, &stmt) != 0)
+		return -1;
+	sqlite3_finalize(entry->stmt);
+	entry->stmt = stmt;
+	entry->schema_version = schema_version;
+	return 0;
+}
+
+/**
+ * Find a statement in the cache by text or compile it and add
+ * it to the cache.
+ * @retval not NULL Cached statement.
+ * @retval NULL Client or memory error.
+ */
+static struct sql_stmt_entry *
+sql_stmt_cache_prepare(sqlite3 *db, const char *sql, uint32_t len)
+{
+	struct sql_stmt_entry *entry;
+	if (sql_stmt_cache == NULL) {
+		sql_stmt_cache = mh_i32ptr_new();
+		sql_stmt_cache_by_text = mh_strnptr_new();
+		if (sql_stmt_cache == NULL || sql_stmt_cache_by_text == NULL) {
+			if (sql_stmt_cache != NULL)
+				mh_i32ptr_delete(sql_stmt_cache);
+			if (sql_stmt_cache_by_text != NULL)
+				mh_strnptr_delete(sql_stmt_cache_by_text);
+			sql_stmt_cache = NULL;
+			sql_stmt_cache_by_text = NULL;
+			diag_set(OutOfMemory, sizeof(*sql_stmt_cache),
+				 "mh_i32ptr_new", "sql_stmt_cache");
+			return NULL;
+		}
+	}
+	mh_int_t k = mh_strnptr_find_inp(sql_stmt_cache_by_text, sql, len);
+	if (k != mh_end(sql_stmt_cache_by_text)) {
+		entry = (struct sql_stmt_entry *)
+			mh_strnptr_node(sql_stmt_cache_by_text, k)->val;
+		rlist_move_entry(&sql_stmt_cache_lru, entry, in_lru);
+		return entry;
+	}
+	size_t size = sizeof(*entry) + len;
+	entry = (struct sql_stmt_entry *) malloc(size);
+	if (entry == NULL) {
+		diag_set(OutOfMemory, size, "malloc", "struct sql_stmt_entry");
+		return NULL;
+	}
+	if (sql_stmt_compile(db, sql, len, &entry->stmt) != 0) {
+		free(entry);
+		return NULL;
+	}
+	entry->id = sql_stmt_new_id();
+	entry->schema_version = schema_version;
+	entry->is_busy = false;
+	entry->sql_len = len;
+	memcpy(entry->sql, sql, len);
+	struct mh_i32ptr_node_t node = { entry->id, entry };
+	if (mh_i32ptr_put(sql_stmt_cache, &node, NULL,
+			  NULL) == mh_end(sql_stmt_cache)) {
+		diag_set(OutOfMemory, sizeof(node), "mh_i32ptr_put",
+			 "sql_stmt_cache");
+		sql_stmt_entry_delete(entry);
+		return NULL;
+	}
+	/* The key refers to the text copy owned by the entry. */
+	struct mh_strnptr_node_t text_node = {
+		entry->sql, len, mh_strn_hash(entry->sql, len), entry
+	};
+	if (mh_strnptr_put(sql_stmt_cache_by_text, &text_node, NULL,
+			   NULL) == mh_end(sql_stmt_cache_by_text)) {
+		diag_set(OutOfMemory, sizeof(text_node), "mh_strnptr_put",
+			 "sql_stmt_cache_by_text");
+		mh_i32ptr_del(sql_stmt_cache,
+			      mh_i32ptr_find(sql_stmt_cache, entry->id, NULL),
+			      NULL);
+		sql_stmt_entry_delete(entry);
+		return NULL;
+	}
+	rlist_add_entry(&sql_stmt_cache_lru, entry, in_lru);
+	sql_stmt_cache_size++;
+	/*
+	 * Evict least recently used statements. A statement that
+	 * is being executed can't be evicted, so the cache may
+	 * temporarily exceed its size limit.
+	 */
+	while (sql_stmt_cache_size > SQL_STMT_CACHE_SIZE) {
+		struct sql_stmt_entry *victim = rlist_last_entry(
+			&sql_stmt_cache_lru, struct sql_stmt_entry, in_lru);
+		if (victim->is_busy)
+			break;
+		sql_stmt_cache_delete(victim);
+	}
+	return entry;
+}
+
 int
 xrow_decode_sql(const struct xrow_header *row, struct sql_request *request,
 		struct region *region)
@@ -262,11 +495,24 @@ error:
 
 	uint32_t map_size = mp_decode_map(&data);
 	request->sql_text = NULL;
+	request->stmt_id = 0;
 	request->bind = NULL;
 	request->bind_count = 0;
 	request->sync = row->sync;
+	bool has_stmt_id = false;
 	for (uint32_t i = 0; i < map_size; ++i) {
 		uint8_t key = *data;
+		if (key == IPROTO_STMT_ID) {
+			data++;                 /* skip the key */
+			if (mp_typeof(*data) != MP_UINT)
+				goto error;
+			uint64_t id = mp_decode_uint(&data);
+			if (id > UINT32_MAX)
+				goto error;
+			request->stmt_id = id;
+			has_stmt_id = true;
+			continue;
+		}
 		if (key != IPROTO_SQL_BIND && key != IPROTO_SQL_TEXT) {
 			mp_check(&data, end);   /* skip the key */
 			mp_check(&data, end);   /* skip the value */
@@ -282,7 +528,7 @@ error:
 			request->sql_text = value;
 		}
 	}
-	if (request->sql_text == NULL) {
+	if (request->sql_text == NULL && !has_stmt_id) {
 		diag_set(ClientError, ER_MISSING_REQUEST_FIELD,
 			 iproto_key_name(IPROTO_SQL_TEXT));
 		return -1;
@@ -639,32 +885,115 @@ err_execute:
 	return -1;
 }
 
+/**
+ * Bind parameters, execute the statement and encode the result.
+ * @retval  0 Success.
+ * @retval -1 Client or memory error.
+ */
+static int
+sql_bind_and_execute(sqlite3 *db, struct sqlite3_stmt *stmt,
+		     const struct sql_request *request, struct obuf *out,
+		     struct region *region)
+{
+	if (sql_bind(request, stmt) != 0)
+		return -1;
+	return sql_execute_and_encode(db, stmt, out, request->sync, region);
+}
+
 int
 sql_prepare_and_execute(const struct sql_request *request, struct obuf *out,
 			struct region *region)
 {
-	const char *sql = request->sql_text;
-	uint32_t len;
-	sql = mp_decode_str(&sql, &len);
-	struct sqlite3_stmt *stmt;
 	sqlite3 *db = sql_get();
 	if (db == NULL) {
 		diag_set(ClientError, ER_LOADING);
 		return -1;
 	}
-	if (sqlite3_prepare_v2(db, sql, len, &stmt, NULL) != SQLITE_OK) {
-		diag_set(ClientError, ER_SQL_EXECUTE, sqlite3_errmsg(db));
+	struct sql_stmt_entry *entry;
+	if (request->sql_text != NULL) {
+		const char *sql = request->sql_text;
+		uint32_t len;
+		sql = mp_decode_str(&sql, &len);
+		entry = sql_stmt_cache_prepare(db, sql, len);
+	} else {
+		entry = sql_stmt_cache_find(request->stmt_id);
+		if (entry == NULL) {
+			diag_set(ClientError, ER_SQL_EXECUTE,
+				 tt_sprintf("prepared statement %u does not "
+					    "exist", request->stmt_id));
+		}
+	}
+	if (entry == NULL)
 		return -1;
+	int rc;
+	if (entry->is_busy) {
+		/*
+		 * The cached statement is being executed by
+		 * another fiber. Use a private copy.
+		 */
+		struct sqlite3_stmt *stmt;
+		if (sql_stmt_compile(db, entry->sql, entry->sql_len,
+				     &stmt) != 0)
+			return -1;
+		rc = sql_bind_and_execute(db, stmt, request, out, region);
+		sqlite3_finalize(stmt);
+		return rc;
 	}
-	assert(stmt != NULL);
-	if (sql_bind(request, stmt) != 0)
-		goto err_stmt;
-	if (sql_execute_and_encode(db, stmt, out, request->sync,
-				   region) != 0)
-		goto err_stmt;
-	sqlite3_finalize(stmt);
+	if (sql_stmt_entry_check_schema(db, entry) != 0)
+		return -1;
+	entry->is_busy = true;
+	rc = sql_bind_and_execute(db, entry->stmt, request, out, region);
+	sqlite3_reset(entry->stmt);
+	sqlite3_clear_bindings(entry->stmt);
+	entry->is_busy = false;
+	return rc;
+}
+
+int
+sql_prepare(const struct sql_request *request, struct obuf *out)
+{
+	sqlite3 *db = sql_get();
+	if (db == NULL) {
+		diag_set(ClientError, ER_LOADING);
+		return -1;
+	}
+	if (request->sql_text == NULL) {
+		diag_set(ClientError, ER_MISSING_REQUEST_FIELD,
+			 iproto_key_name(IPROTO_SQL_TEXT));
+		return -1;
+	}
+	const char *sql = request->sql_text;
+	uint32_t len;
+	sql = mp_decode_str(&sql, &len);
+	struct sql_stmt_entry *entry = sql_stmt_cache_prepare(db, sql, len);
+	if (entry == NULL)
+		return -1;
+	if (!entry->is_busy && sql_stmt_entry_check_schema(db, entry) != 0)
+		return -1;
+
+	struct obuf_svp header_svp;
+	if (iproto_prepare_header(out, &header_svp, IPROTO_SQL_HEADER_LEN) != 0)
+		return -1;
+	int keys = 1;
+	size_t size = mp_sizeof_uint(IPROTO_STMT_ID) +
+		      mp_sizeof_uint(entry->id);
+	char *buf = obuf_alloc(out, size);
+	if (buf == NULL) {
+		diag_set(OutOfMemory, size, "obuf_alloc", "buf");
+		goto err;
+	}
+	buf = mp_encode_uint(buf, IPROTO_STMT_ID);
+	buf = mp_encode_uint(buf, entry->id);
+	int column_count = sqlite3_column_count(entry->stmt);
+	if (column_count > 0) {
+		if (sql_get_description(entry->stmt, out, column_count) != 0)
+			goto err;
+		keys = 2;
+	}
+	iproto_reply_sql(out, &header_svp, request->sync, schema_version,
+			 keys);
 	return 0;
-err_stmt:
-	sqlite3_finalize(stmt);
+err:
+	obuf_rollback_to_svp(out, &header_svp);
 	return -1;
 }
@@ -46,8 +46,10 @@ struct xrow_header;
 /** EXECUTE request. */
 struct sql_request {
 	uint64_t sync;
-	/** SQL statement text. */
+	/** SQL statement text. NULL if @stmt_id is set. */
 	const char *sql_text;
+	/** Id of a prepared statement to execute. */
+	uint32_t stmt_id;
 	/** Array of parameters. */
 	struct sql_bind *bind;
 	/** Length of the @bind. */
@@ -95,6 +97,10 @@ xrow_decode_sql(const struct xrow_header *row, struct sql_request *request,
  * | }                                            |
  * +----------------------------------------------+
  *
+ * Compiled statements are cached and reused by subsequent
+ * requests with the same SQL text. A request may refer to a
+ * statement compiled by PREPARE by id rather than by text.
+ *
  * @param request IProto request.
  * @param out Out buffer of the iproto message.
  * @param region Runtime allocator for temporary objects
@@ -107,6 +113,32 @@ int
 sql_prepare_and_execute(const struct sql_request *request, struct obuf *out,
 			struct region *region);
 
+/**
+ * Compile an SQL statement, store it in the prepared statement
+ * cache and encode the statement id in an iproto message.
+ * Response structure:
+ * +----------------------------------------------+
+ * | IPROTO_OK, sync, schema_version   ...        | iproto_header
+ * +----------------------------------------------+---------------
+ * | Body - a map with one or two keys.           |
+ * |                                              |
+ * | IPROTO_BODY: {                               |
+ * |     IPROTO_STMT_ID: number,                  | iproto_body
+ * |     IPROTO_METADATA: [ ... ]                 |
+ * | }                                            |
+ * +----------------------------------------------+
+ * IPROTO_METADATA is present only if the statement returns
+ * rows.
+ *
+ * @param request IProto request.
+ * @param out Out buffer of the iproto message.
+ *
+ * @retval  0 Success.
+ * @retval -1 Client or memory error.
+ */
+int
+sql_prepare(const struct sql_request *request, struct obuf *out);
+
 #if defined(__cplusplus)
 } /* extern "C" { */
 #include "diag.h"
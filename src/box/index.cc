@@ -497,6 +497,15 @@ index_delete(struct index *index)
 
 int
 index_build(struct index *index, struct index *pk)
+{
+	if (index_build_fill(index, pk) != 0)
+		return -1;
+	index_end_build(index);
+	return 0;
+}
+
+int
+index_build_fill(struct index *index, struct index *pk)
 {
 	ssize_t n_tuples = index_size(pk);
 	if (n_tuples < 0)
@@ -530,11 +539,7 @@ index_build(struct index *index, struct index *pk)
 			break;
 	}
 	iterator_delete(it);
-	if (rc != 0)
-		return -1;
-
-	index_end_build(index);
-	return 0;
+	return rc != 0 ? -1 : 0;
 }
 
 /* }}} */
@@ -636,6 +641,28 @@ generic_index_replace(struct index *index, struct tuple *old_tuple,
 	return -1;
 }
 
+struct iterator *
+generic_index_create_iterator_with_offset(struct index *index,
+					  enum iterator_type type,
+					  const char *key, uint32_t part_count,
+					  uint32_t offset)
+{
+	struct iterator *it = index_create_iterator(index, type,
+						    key, part_count);
+	if (it == NULL)
+		return NULL;
+	struct tuple *tuple;
+	for (; offset > 0; offset--) {
+		if (iterator_next(it, &tuple) != 0) {
+			iterator_delete(it);
+			return NULL;
+		}
+		if (tuple == NULL)
+			break;
+	}
+	return it;
+}
+
 struct snapshot_iterator *
 generic_index_create_snapshot_iterator(struct index *index)
 {
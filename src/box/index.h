@@ -271,14 +271,25 @@ iterator_delete(struct iterator *it);
 struct snapshot_iterator {
 	/**
 	 * Iterate to the next tuple in the snapshot.
-	 * Returns a pointer to the tuple data and its
-	 * size or NULL if EOF.
+	 * Sets a pointer to the tuple data and its size,
+	 * or NULL if EOF. Returns -1 on error, e.g. if
+	 * a compressed tuple fails to decompress.
 	 */
-	const char *(*next)(struct snapshot_iterator *, uint32_t *size);
+	int (*next)(struct snapshot_iterator *, const char **data,
+		    uint32_t *size);
 	/**
 	 * Destroy the iterator.
 	 */
 	void (*free)(struct snapshot_iterator *);
+	/**
+	 * Optional filter set by the caller: next() skips
+	 * tuples for which it returns false. Called from the
+	 * thread iterating over the snapshot. Iterators over
+	 * data not stored as tuples ignore it.
+	 */
+	bool (*filter)(struct tuple *tuple, void *arg);
+	/** Argument passed to the filter. */
+	void *filter_arg;
 };
 
 /**
@@ -366,6 +377,13 @@ struct index_vtab {
 	struct iterator *(*create_iterator)(struct index *index,
 			enum iterator_type type,
 			const char *key, uint32_t part_count);
+	/**
+	 * Create an index iterator that skips the first
+	 * @offset tuples it would return.
+	 */
+	struct iterator *(*create_iterator_with_offset)(struct index *index,
+			enum iterator_type type, const char *key,
+			uint32_t part_count, uint32_t offset);
 	/**
 	 * Create an ALL iterator with personal read view so further
 	 * index modifications will not affect the iteration results.
@@ -447,6 +465,14 @@ index_delete(struct index *index);
 int
 index_build(struct index *index, struct index *pk);
 
+/**
+ * Begin building this index and feed it with the contents of
+ * another index, but do not finish the build: the caller is
+ * supposed to call index_end_build() when it is done.
+ */
+int
+index_build_fill(struct index *index, struct index *pk);
+
 static inline void
 index_commit_create(struct index *index, int64_t signature)
 {
@@ -520,6 +546,15 @@ index_create_iterator(struct index *index, enum iterator_type type,
 	return index->vtab->create_iterator(index, type, key, part_count);
 }
 
+static inline struct iterator *
+index_create_iterator_with_offset(struct index *index, enum iterator_type type,
+				  const char *key, uint32_t part_count,
+				  uint32_t offset)
+{
+	return index->vtab->create_iterator_with_offset(index, type, key,
+							part_count, offset);
+}
+
 static inline struct snapshot_iterator *
 index_create_snapshot_iterator(struct index *index)
 {
@@ -570,6 +605,9 @@ ssize_t generic_index_count(struct index *, enum iterator_type,
 int generic_index_get(struct index *, const char *, uint32_t, struct tuple **);
 int generic_index_replace(struct index *, struct tuple *, struct tuple *,
 			  enum dup_replace_mode, struct tuple **);
+struct iterator *
+generic_index_create_iterator_with_offset(struct index *, enum iterator_type,
+					  const char *, uint32_t, uint32_t);
 struct snapshot_iterator *generic_index_create_snapshot_iterator(struct index *);
 void generic_index_info(struct index *, struct info_handler *);
 void generic_index_begin_build(struct index *);
@@ -91,6 +91,11 @@ struct index_opts {
 	double run_size_ratio;
 	/* Bloom filter false positive rate. */
 	double bloom_fpr;
+	/**
+	 * Build bloom filters on key prefixes, too, so that
+	 * lookups by a partial key can skip runs.
+	 */
+	bool bloom_prefix;
 	/**
 	 * LSN from the time of index creation.
 	 */
@@ -143,6 +148,8 @@ index_opts_cmp(const struct index_opts *o1, const struct index_opts *o2)
 		return o1->run_size_ratio < o2->run_size_ratio ? -1 : 1;
 	if (o1->bloom_fpr != o2->bloom_fpr)
 		return o1->bloom_fpr < o2->bloom_fpr ? -1 : 1;
+	if (o1->bloom_prefix != o2->bloom_prefix)
+		return o1->bloom_prefix < o2->bloom_prefix ? -1 : 1;
 	return 0;
 }
 
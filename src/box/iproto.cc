@@ -38,6 +38,7 @@
 
 #include "version.h"
 #include "fiber.h"
+#include "fiber_cond.h"
 #include "cbus.h"
 #include "say.h"
 #include "sio.h"
@@ -47,6 +48,7 @@
 #include "memory.h"
 
 #include "port.h"
+#include "tuple.h"
 #include "iobuf.h"
 #include "box.h"
 #include "call.h"
@@ -57,11 +59,53 @@
 #include "replication.h" /* instance_uuid */
 #include "iproto_constants.h"
 #include "rmean.h"
+#include "histogram.h"
 #include "execute.h"
+#include "errinj.h"
 
-/* The number of iproto messages in flight */
+/* The number of iproto messages in flight, per iproto thread. */
 enum { IPROTO_MSG_MAX = 768 };
 
+enum {
+	/**
+	 * Tuples at least this large are sent from the tuple
+	 * memory rather than copied to the output buffer.
+	 */
+	IPROTO_TUPLE_REF_MIN = 1024,
+	/** Max number of pieces written by one writev(). */
+	IPROTO_IOV_MAX = 256,
+	/** The number of requests of a connection in flight. */
+	IPROTO_CONNECTION_MSG_MAX = IPROTO_MSG_MAX / 4,
+	/**
+	 * The number of requests of a connection waiting for
+	 * their turn to be processed, more are rejected.
+	 */
+	IPROTO_CONNECTION_QUEUE_MAX = IPROTO_MSG_MAX,
+	/**
+	 * The number of rejected requests in flight, per iproto
+	 * thread. Rejects bypass the scheduler, so the input of
+	 * connections getting rejects is suspended beyond this.
+	 */
+	IPROTO_REJECT_MAX = IPROTO_MSG_MAX / 4,
+	/** The number of rejected requests of a connection in flight. */
+	IPROTO_CONNECTION_REJECT_MAX = IPROTO_REJECT_MAX / 4,
+	/**
+	 * Weight of the last request in the moving average of
+	 * request processing time, 1 / N.
+	 */
+	IPROTO_REQUEST_TIME_WEIGHT = 16,
+	/**
+	 * How far a streamed reply may get ahead of the
+	 * client, in bytes of the output buffer.
+	 */
+	IPROTO_STREAM_WATERMARK = 1024 * 1024,
+	/**
+	 * How many chunks of a streamed reply may be sent
+	 * ahead of the client's acknowledgements.
+	 */
+	IPROTO_STREAM_WINDOW = 16,
+};
+
 void
 iproto_reset_input(struct ibuf *ibuf)
 {
@@ -82,9 +126,41 @@ iproto_reset_input(struct ibuf *ibuf)
 /* {{{ iproto_msg - declaration */
 
 /**
- * A single msg from io thread. All requests
- * from all connections are queued into a single queue
- * and processed in FIFO order.
+ * Data of a tuple sent as a part of a reply without copying
+ * it to the output buffer. The data is written to the socket
+ * right after the first @a offset bytes of the buffer. The
+ * tuple is referenced and the object is allocated in tx, it
+ * is returned there once the data is sent.
+ */
+struct iproto_tuple_ref {
+	/** Link in a message, output or release list. */
+	struct stailq_entry in_list;
+	/** The referenced tuple. */
+	struct tuple *tuple;
+	/** Output buffer offset the data is sent at. */
+	size_t offset;
+	/** The tuple MessagePack. */
+	const char *data;
+	/** Size of the tuple MessagePack. */
+	size_t size;
+};
+
+/**
+ * A message returning sent tuple references of an iproto
+ * thread to tx. Each thread has one and only one of them
+ * is in flight at a time.
+ */
+struct iproto_tuple_release {
+	struct cmsg base;
+	/** References to release. */
+	struct stailq refs;
+};
+
+/**
+ * A single msg from io thread. Requests of a connection wait
+ * in the connection queue, and the io thread hands them over
+ * to tx taking connections in turn, see
+ * iproto_thread_schedule().
  */
 struct iproto_msg: public cmsg
 {
@@ -100,7 +176,7 @@ struct iproto_msg: public cmsg
 		struct call_request call_request;
 		/* Authentication request. */
 		struct auth_request auth_request;
-		/* SQL request, if this is the EXECUTE request. */
+		/* SQL request, if this is EXECUTE or PREPARE. */
 		struct sql_request sql_request;
 	};
 	/** Output buffer to write response and flush. */
@@ -116,67 +192,240 @@ struct iproto_msg: public cmsg
 	size_t len;
 	/** End of write position in the output buffer */
 	struct obuf_svp write_end;
+	/**
+	 * Tuple data referenced by the reply, struct
+	 * iproto_tuple_ref, in the output buffer order.
+	 */
+	struct stailq tuple_refs;
 	/**
 	 * Used in "connect" msgs, true if connect trigger failed
 	 * and the connection must be closed.
 	 */
 	bool close_connection;
+	/**
+	 * Monotonic time the request was read at, the time tx
+	 * started and finished processing it, and how long it
+	 * waited for WAL, for latency statistics.
+	 */
+	ev_tstamp read_time;
+	ev_tstamp tx_start_time;
+	ev_tstamp tx_end_time;
+	ev_tstamp wal_wait;
+	/** Link in iproto_connection::queue. */
+	struct stailq_entry in_queue;
+	/**
+	 * True if the request is handed over to tx by the
+	 * scheduler and counts against the in-flight limits.
+	 */
+	bool is_scheduled;
+	/** True if the request is rejected due to the overload. */
+	bool is_rejected;
+	/** Monotonic time the request was handed over to tx. */
+	ev_tstamp schedule_time;
+	/** Retry hint of a rejected request, in milliseconds. */
+	uint32_t retry_delay;
 };
 
-static struct mempool iproto_msg_pool;
-
-static struct iproto_msg *
-iproto_msg_new(struct iproto_connection *con)
-{
-	struct iproto_msg *msg =
-		(struct iproto_msg *) mempool_alloc_xc(&iproto_msg_pool);
-	msg->connection = con;
-	return msg;
-}
-
 /**
- * Resume stopped connections, if any.
+ * A reply streamed in chunks, see IPROTO_CHUNK. Lives on the
+ * stack of the tx fiber processing the request. The fiber hands
+ * the chunks it writes over to net and waits for them to be sent
+ * once it gets too far ahead of the client: either the unsent
+ * data exceeds IPROTO_STREAM_WATERMARK, or IPROTO_STREAM_WINDOW
+ * chunks are not acknowledged by the client, see
+ * IPROTO_CHUNK_ACK. Net holds the message until both are fine.
  */
-static void
-iproto_resume();
+struct iproto_stream {
+	/**
+	 * Message carrying the end of the written chunks to
+	 * net and back to tx once they are sent.
+	 */
+	struct cmsg base;
+	/** Sink of a streamed CALL reply. */
+	struct call_stream call;
+	/** The request being replied to. */
+	struct iproto_msg *msg;
+	/** End of the chunks handed over to net. */
+	struct obuf_svp write_end;
+	/** How much of the output buffer is known to be sent. */
+	size_t sent;
+	/** Number of chunks written, used in tx. */
+	uint64_t chunk_count;
+	/** Number of chunks handed over to net. */
+	uint64_t pushed_count;
+	/** Number of chunks acknowledged by the client, used in net. */
+	uint64_t acked_count;
+	/**
+	 * The number of chunks the stream may write before
+	 * waiting for acknowledgements, set in net when the
+	 * message is returned to tx.
+	 */
+	uint64_t window_end;
+	/** True while the message is away from tx. */
+	bool in_progress;
+	/** True if the stream is known to net, used in tx. */
+	bool is_registered;
+	/** True while net holds the message, used in net. */
+	bool is_parked;
+	/**
+	 * Set in net if the client's acknowledgements can't be
+	 * read, so the window is not enforced any more.
+	 */
+	bool is_unbounded;
+	/** Set in net if the connection is closed. */
+	bool is_closed;
+	/** Signaled when the message gets back to tx. */
+	struct fiber_cond cond;
+	/** Link in iproto_connection::streams, used in net. */
+	struct rlist in_connection;
+};
 
+/* }}} */
 
-static inline void
-iproto_msg_delete(struct cmsg *msg)
+/* {{{ iproto connection and requests */
+
+enum rmean_net_name {
+	IPROTO_SENT,
+	IPROTO_RECEIVED,
+	IPROTO_REJECTED,
+	IPROTO_LAST,
+};
+
+const char *rmean_net_strings[IPROTO_LAST] = {
+	"SENT", "RECEIVED", "REJECTED"
+};
+
+const char *iproto_latency_stage_strs[] = {
+	"total", "net", "tx", "wal", "reply",
+};
+
+enum {
+	USEC_PER_SEC = 1000000,
+	/** Latency histograms cover 1 us .. 10 s. */
+	IPROTO_LATENCY_BUCKETS = 9 * 7 + 1,
+};
+
+/** Upper bounds of latency histogram buckets, in microseconds. */
+static int64_t iproto_latency_buckets[IPROTO_LATENCY_BUCKETS];
+
+/**
+ * Return the index of the latency statistics of a request
+ * type or -1 if the type is not accounted.
+ */
+static inline int
+iproto_latency_type(uint32_t type)
 {
-	mempool_free(&iproto_msg_pool, msg);
-	iproto_resume();
+	if (type == IPROTO_CALL_16)
+		return IPROTO_CALL;
+	if (type < IPROTO_TYPE_STAT_MAX && iproto_type_strs[type] != NULL)
+		return type;
+	return -1;
 }
 
-/* }}} */
-
-/* {{{ iproto connection and requests */
+/* A pointer to the transaction processor cord. */
+struct cord *tx_cord;
 
 /**
- * A single global queue for all requests in all connections. All
- * requests from all connections are processed concurrently.
- * Is also used as a queue for just established connections and to
- * execute disconnect triggers. A few notes about these triggers:
+ * A network io thread. Client connections are spread over
+ * iproto threads by the acceptor (the first thread), and each
+ * connection is served by its thread till it is closed.
+ *
+ * Each thread has its own queue to tx for all requests in all
+ * connections of the thread. All requests from all connections
+ * are processed concurrently. The queue is also used for just
+ * established connections and to execute disconnect triggers.
+ * A few notes about these triggers:
  * - they need to be run in a fiber
  * - unlike an ordinary request failure, on_connect trigger
  *   failure must lead to connection close.
  * - on_connect trigger must be processed before any other
  *   request on this connection.
  */
-static struct cpipe tx_pipe;
-static struct cpipe net_pipe;
-/* A pointer to the transaction processor cord. */
-struct cord *tx_cord;
-
-struct rmean *rmean_net;
-
-enum rmean_net_name {
-	IPROTO_SENT,
-	IPROTO_RECEIVED,
-	IPROTO_LAST,
+struct iproto_thread {
+	/** Ordinal number of the thread, 0 is the acceptor. */
+	int id;
+	/** The thread cord. */
+	struct cord net_cord;
+	/** Name of the cbus endpoint of the thread. */
+	char endpoint_name[FIBER_NAME_MAX];
+	/** A pipe from the thread to tx, used in the thread. */
+	struct cpipe tx_pipe;
+	/** A pipe from tx to the thread, used in tx. */
+	struct cpipe net_pipe;
+	/**
+	 * A pipe from the acceptor thread to this thread,
+	 * used in the acceptor thread to hand over accepted
+	 * sockets. Unused for the acceptor itself.
+	 */
+	struct cpipe accept_pipe;
+	/** Pool of iproto_msg objects of the thread. */
+	struct mempool iproto_msg_pool;
+	/** Pool of iproto_connection objects of the thread. */
+	struct mempool iproto_connection_pool;
+	/**
+	 * Pool of iproto_tuple_ref objects of the thread's
+	 * replies, used in tx.
+	 */
+	struct mempool tuple_ref_pool;
+	/** Sent tuple references to return to tx. */
+	struct stailq tuple_garbage;
+	/** The message returning tuple references to tx. */
+	struct iproto_tuple_release tuple_release;
+	/** True if tuple_release is in flight. */
+	bool tuple_release_in_progress;
+	/**
+	 * Connections with requests waiting to be handed over
+	 * to tx and room for them in tx, served in turn.
+	 */
+	struct rlist ready_connections;
+	/** Requests handed over to tx and not completed yet. */
+	size_t requests_in_progress;
+	/** Requests waiting in connection queues. */
+	size_t requests_queued;
+	/** Rejected requests handed over to tx, not replied yet. */
+	size_t rejects_in_progress;
+	/**
+	 * Connections with input suspended until their rejected
+	 * requests are replied.
+	 */
+	struct rlist throttled_connections;
+	/**
+	 * The number of connections by the number of their
+	 * waiting requests, for statistics.
+	 */
+	size_t queue_depth[IPROTO_CONNECTION_QUEUE_MAX + 1];
+	/** Moving average of request processing time. */
+	double request_time;
+	/** Network statistics of the thread. */
+	struct rmean *rmean;
+	/**
+	 * Request latency histograms of the thread, by request
+	 * type and processing stage, in microseconds.
+	 */
+	struct histogram *latency[IPROTO_TYPE_STAT_MAX]
+				 [iproto_latency_stage_MAX];
+	/** iproto binary listener, only used by the acceptor. */
+	struct evio_service binary;
+	/** Message routes, bound to the thread's net_pipe. */
+	struct cmsg_hop disconnect_route[2];
+	struct cmsg_hop misc_route[2];
+	struct cmsg_hop select_route[2];
+	struct cmsg_hop process1_route[2];
+	struct cmsg_hop sql_route[2];
+	struct cmsg_hop sync_route[2];
+	struct cmsg_hop connect_route[2];
+	struct cmsg_hop accept_route[1];
+	struct cmsg_hop tuple_release_route[2];
+	struct cmsg_hop stream_route[1];
+	struct cmsg_hop stream_return_route[1];
+	struct cmsg_hop stream_close_route[2];
+	struct cmsg_hop reject_route[2];
+	const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX];
 };
 
-const char *rmean_net_strings[IPROTO_LAST] = { "SENT", "RECEIVED" };
+/** All iproto threads, iproto_threads[0] is the acceptor. */
+static struct iproto_thread *iproto_threads;
+static int iproto_threads_count;
 
 /**
  * Context of a single client connection.
@@ -248,47 +497,226 @@ struct iproto_connection
 	ev_loop *loop;
 	/* Pre-allocated disconnect msg. */
 	struct iproto_msg *disconnect;
-	struct rlist in_stop_list;
+	/**
+	 * Parsed requests waiting for their turn to be handed
+	 * over to tx, struct iproto_msg.
+	 */
+	struct stailq queue;
+	/** Length of the queue. */
+	size_t queue_len;
+	/** Requests of the connection handed over to tx. */
+	size_t requests_in_progress;
+	/** Link in iproto_thread::ready_connections. */
+	struct rlist in_ready_list;
+	/** Rejected requests of the connection handed over to tx. */
+	size_t rejects_in_progress;
+	/** Link in iproto_thread::throttled_connections. */
+	struct rlist in_throttled_list;
+	/** The iproto thread serving the connection. */
+	struct iproto_thread *iproto_thread;
+	/**
+	 * Tuple data to send along with obuf[0] and obuf[1],
+	 * struct iproto_tuple_ref, in the buffer order.
+	 */
+	struct stailq tuple_refs[2];
+	/**
+	 * How much of the first tuple data of the buffer being
+	 * written is sent.
+	 */
+	size_t tuple_ref_sent;
+	/**
+	 * Replies being streamed which have handed chunks over
+	 * to net, struct iproto_stream.
+	 */
+	struct rlist streams;
 };
 
-static struct mempool iproto_connection_pool;
-static RLIST_HEAD(stopped_connections);
+static struct iproto_msg *
+iproto_msg_new(struct iproto_connection *con)
+{
+	struct iproto_msg *msg = (struct iproto_msg *)
+		mempool_alloc_xc(&con->iproto_thread->iproto_msg_pool);
+	msg->connection = con;
+	msg->is_scheduled = false;
+	msg->is_rejected = false;
+	stailq_create(&msg->tuple_refs);
+	return msg;
+}
+
+/** Account a change of the request queue length of a connection. */
+static inline void
+iproto_connection_set_queue_len(struct iproto_connection *con, size_t len)
+{
+	struct iproto_thread *iproto_thread = con->iproto_thread;
+	assert(len <= IPROTO_CONNECTION_QUEUE_MAX);
+	if (con->queue_len > 0)
+		iproto_thread->queue_depth[con->queue_len]--;
+	if (len > 0)
+		iproto_thread->queue_depth[len]++;
+	iproto_thread->requests_queued -= con->queue_len;
+	iproto_thread->requests_queued += len;
+	con->queue_len = len;
+}
 
 /**
- * Return true if we have not enough spare messages
- * in the message pool. Disconnect messages are
- * discounted: they are mostly reserved and idle.
+ * Put a connection to the end of the ready list if it has
+ * waiting requests and room for them in tx.
+ */
+static inline void
+iproto_connection_check_ready(struct iproto_connection *con)
+{
+	if (con->queue_len > 0 &&
+	    con->requests_in_progress < IPROTO_CONNECTION_MSG_MAX &&
+	    rlist_empty(&con->in_ready_list)) {
+		rlist_add_tail_entry(&con->iproto_thread->ready_connections,
+				     con, in_ready_list);
+	}
+}
+
+/**
+ * Hand waiting requests over to tx as long as there is room
+ * for them. Ready connections are served in turn, a request
+ * at a time, so a connection flooding the instance with
+ * requests doesn't delay the others, and the fiber pool in tx
+ * is not depleted by the flood. The pushed messages must be
+ * flushed by the caller.
+ */
+static void
+iproto_thread_schedule(struct iproto_thread *iproto_thread)
+{
+	struct rlist *ready = &iproto_thread->ready_connections;
+	ev_tstamp now = ev_monotonic_time();
+	while (iproto_thread->requests_in_progress < IPROTO_MSG_MAX &&
+	       ! rlist_empty(ready)) {
+		struct iproto_connection *con =
+			rlist_first_entry(ready, struct iproto_connection,
+					  in_ready_list);
+		rlist_del_entry(con, in_ready_list);
+		struct iproto_msg *msg = stailq_shift_entry(&con->queue,
+					struct iproto_msg, in_queue);
+		iproto_connection_set_queue_len(con, con->queue_len - 1);
+		msg->is_scheduled = true;
+		msg->schedule_time = now;
+		con->requests_in_progress++;
+		iproto_thread->requests_in_progress++;
+		iproto_connection_check_ready(con);
+		cpipe_push_input(&iproto_thread->tx_pipe, msg);
+	}
+}
+
+static void
+iproto_thread_resume_input(struct iproto_thread *iproto_thread);
+
+static inline void
+iproto_msg_delete(struct iproto_msg *msg)
+{
+	struct iproto_connection *con = msg->connection;
+	struct iproto_thread *iproto_thread = con->iproto_thread;
+	bool is_scheduled = msg->is_scheduled;
+	bool is_rejected = msg->is_rejected;
+	if (is_rejected) {
+		assert(con->rejects_in_progress > 0);
+		con->rejects_in_progress--;
+		iproto_thread->rejects_in_progress--;
+	}
+	if (is_scheduled) {
+		ev_tstamp time = ev_monotonic_time() - msg->schedule_time;
+		iproto_thread->request_time +=
+			(time - iproto_thread->request_time) /
+			IPROTO_REQUEST_TIME_WEIGHT;
+		assert(con->requests_in_progress > 0);
+		con->requests_in_progress--;
+		iproto_thread->requests_in_progress--;
+	}
+	mempool_free(&iproto_thread->iproto_msg_pool, msg);
+	if (is_scheduled) {
+		/* Let the next request in. */
+		iproto_connection_check_ready(con);
+		iproto_thread_schedule(iproto_thread);
+		cpipe_flush_input(&iproto_thread->tx_pipe);
+	}
+	if (is_rejected)
+		iproto_thread_resume_input(iproto_thread);
+}
+
+/**
+ * Drop the requests of a closed connection which haven't been
+ * handed over to tx yet: nobody is going to read the replies.
+ */
+static void
+iproto_connection_drop_queue(struct iproto_connection *con)
+{
+	while (!stailq_empty(&con->queue)) {
+		struct iproto_msg *msg = stailq_shift_entry(&con->queue,
+					struct iproto_msg, in_queue);
+		assert(!msg->is_scheduled);
+		/* Discard request (see iproto_enqueue_batch()) */
+		msg->p_ibuf->rpos += msg->len;
+		iproto_msg_delete(msg);
+	}
+	iproto_connection_set_queue_len(con, 0);
+	if (!rlist_empty(&con->in_ready_list))
+		rlist_del_entry(con, in_ready_list);
+}
+
+/**
+ * Estimate in how many milliseconds a connection will have
+ * room for a new request: the time its queue takes to drain
+ * at the recent request processing time.
+ */
+static inline uint32_t
+iproto_connection_retry_delay(struct iproto_connection *con)
+{
+	double delay = con->iproto_thread->request_time * 1000 *
+		       con->queue_len / IPROTO_CONNECTION_MSG_MAX;
+	return (uint32_t) delay + 1;
+}
+
+/**
+ * Check if the next request of a connection would be rejected
+ * while there are too many rejects in flight already, either
+ * of the connection or of its thread. Such a connection stops
+ * reading input until the rejects are replied, otherwise a
+ * client ignoring the overload errors would keep tx busy
+ * replying them.
  */
 static inline bool
-iproto_must_stop_input()
+iproto_connection_is_throttled(struct iproto_connection *con)
 {
-	size_t connection_count = mempool_count(&iproto_connection_pool);
-	size_t request_count = mempool_count(&iproto_msg_pool);
-	return request_count > connection_count + IPROTO_MSG_MAX;
+	return con->queue_len >= IPROTO_CONNECTION_QUEUE_MAX &&
+	       (con->rejects_in_progress >= IPROTO_CONNECTION_REJECT_MAX ||
+		con->iproto_thread->rejects_in_progress >= IPROTO_REJECT_MAX);
 }
 
 /**
- * Throttle the queue to the tx thread and ensure the fiber pool
- * in tx thread is not depleted by a flood of incoming requests:
- * resume a stopped connection only if there is a spare message
- * object in the message pool.
+ * Queue a parsed request to be handed over to tx in its turn
+ * or, if the connection has too many requests waiting, reject
+ * it with an overload error rather than stop reading input.
+ * The error is replied in tx, which owns the output buffer.
+ * Input is only stopped when the rejects pile up, see
+ * iproto_connection_is_throttled().
  */
 static void
-iproto_resume()
+iproto_connection_push(struct iproto_connection *con,
+		       struct iproto_msg *msg, bool *stop_input)
 {
-	/*
-	 * Most of the time we have nothing to do here: throttling
-	 * is not active.
-	 */
-	if (rlist_empty(&stopped_connections))
-		return;
-	if (iproto_must_stop_input())
+	struct iproto_thread *iproto_thread = con->iproto_thread;
+	if (con->queue_len >= IPROTO_CONNECTION_QUEUE_MAX) {
+		msg->retry_delay = iproto_connection_retry_delay(con);
+		cmsg_init(msg, iproto_thread->reject_route);
+		msg->is_rejected = true;
+		con->rejects_in_progress++;
+		iproto_thread->rejects_in_progress++;
+		cpipe_push_input(&iproto_thread->tx_pipe, msg);
+		rmean_collect(iproto_thread->rmean, IPROTO_REJECTED, 1);
+		/* A rejected JOIN or SUBSCRIBE doesn't stop input. */
+		*stop_input = false;
 		return;
-
-	struct iproto_connection *con;
-	con = rlist_first_entry(&stopped_connections, struct iproto_connection,
-				in_stop_list);
-	ev_feed_event(con->loop, &con->input, EV_READ);
+	}
+	stailq_add_tail_entry(&con->queue, msg, in_queue);
+	iproto_connection_set_queue_len(con, con->queue_len + 1);
+	iproto_connection_check_ready(con);
+	iproto_thread_schedule(iproto_thread);
 }
 
 /**
@@ -313,12 +741,25 @@ iproto_connection_is_idle(struct iproto_connection *con)
 	       ibuf_used(&con->ibuf[1]) == 0;
 }
 
-static inline void
-iproto_connection_stop(struct iproto_connection *con)
+/** Tuple data sent along with an output buffer. */
+static inline struct stailq *
+iproto_connection_tuple_refs(struct iproto_connection *con,
+			     struct obuf *obuf)
+{
+	return &con->tuple_refs[obuf == &con->obuf[1]];
+}
+
+/**
+ * Return true if there is nothing to send from an output
+ * buffer. Note, the buffer itself may be sent while tuple
+ * data referenced at its end is not.
+ */
+static inline bool
+iproto_connection_output_is_empty(struct iproto_connection *con,
+				  struct obuf *obuf)
 {
-	assert(rlist_empty(&con->in_stop_list));
-	ev_io_stop(con->loop, &con->input);
-	rlist_add_tail(&stopped_connections, &con->in_stop_list);
+	return obuf_used(obuf) == 0 &&
+	       stailq_empty(iproto_connection_tuple_refs(con, obuf));
 }
 
 /**
@@ -367,9 +808,15 @@ iproto_connection_delete(struct iproto_connection *con)
 	       con->obuf[0].iov[0].iov_base == NULL);
 	assert(con->obuf[1].pos == 0 &&
 	       con->obuf[1].iov[0].iov_base == NULL);
+	assert(stailq_empty(&con->tuple_refs[0]) &&
+	       stailq_empty(&con->tuple_refs[1]));
+	assert(rlist_empty(&con->streams));
+	assert(stailq_empty(&con->queue));
+	assert(rlist_empty(&con->in_ready_list));
+	assert(rlist_empty(&con->in_throttled_list));
 	if (con->disconnect)
 		iproto_msg_delete(con->disconnect);
-	mempool_free(&iproto_connection_pool, con);
+	mempool_free(&con->iproto_thread->iproto_connection_pool, con);
 }
 
 static void
@@ -383,11 +830,35 @@ tx_process_sql(struct cmsg *m);
 static void
 net_send_msg(struct cmsg *msg);
 
+static void
+tx_process_reject(struct cmsg *msg);
+
 static void
 tx_process_join_subscribe(struct cmsg *msg);
 static void
 net_end_join_subscribe(struct cmsg *msg);
 
+/** Account the latency of a processed request. */
+static void
+iproto_msg_collect_latency(struct iproto_msg *msg)
+{
+	int type = iproto_latency_type(msg->header.type);
+	if (type < 0)
+		return;
+	struct histogram **latency = msg->connection->iproto_thread->
+				     latency[type];
+	ev_tstamp now = ev_monotonic_time();
+	ev_tstamp tx = msg->tx_end_time - msg->tx_start_time - msg->wal_wait;
+	ev_tstamp stages[iproto_latency_stage_MAX];
+	stages[IPROTO_LATENCY_TOTAL] = now - msg->read_time;
+	stages[IPROTO_LATENCY_NET] = msg->tx_start_time - msg->read_time;
+	stages[IPROTO_LATENCY_TX] = MAX(tx, 0);
+	stages[IPROTO_LATENCY_WAL] = msg->wal_wait;
+	stages[IPROTO_LATENCY_REPLY] = now - msg->tx_end_time;
+	for (int i = 0; i < iproto_latency_stage_MAX; i++)
+		histogram_collect(latency[i], stages[i] * USEC_PER_SEC);
+}
+
 static void
 tx_fiber_init(struct session *session, uint64_t sync)
 {
@@ -406,6 +877,277 @@ tx_fiber_init(struct session *session, uint64_t sync)
 	fiber_set_user(fiber(), &session->credentials);
 }
 
+/** Start processing a request in tx. */
+static inline void
+tx_begin_msg(struct iproto_msg *msg)
+{
+	msg->tx_start_time = ev_monotonic_time();
+	msg->wal_wait = 0;
+	fiber_set_key(fiber(), FIBER_KEY_WAL_WAIT, &msg->wal_wait);
+	tx_fiber_init(msg->connection->session, msg->header.sync);
+}
+
+/**
+ * Finish processing a request in tx: remember where its
+ * reply ends and stop accounting WAL waits to it.
+ */
+static inline void
+tx_end_msg(struct iproto_msg *msg)
+{
+	msg->write_end = obuf_create_svp(msg->p_obuf);
+	msg->tx_end_time = ev_monotonic_time();
+	fiber_set_key(fiber(), FIBER_KEY_WAL_WAIT, NULL);
+}
+
+/** Unreference tuples of sent replies and free the references. */
+static void
+tx_release_tuple_refs(struct iproto_thread *iproto_thread,
+		      struct stailq *refs)
+{
+	struct iproto_tuple_ref *ref, *next;
+	stailq_foreach_entry_safe(ref, next, refs, in_list) {
+		tuple_unref(ref->tuple);
+		mempool_free(&iproto_thread->tuple_ref_pool, ref);
+	}
+	stailq_create(refs);
+}
+
+static void
+tx_release_tuples(struct cmsg *m)
+{
+	struct iproto_tuple_release *msg = (struct iproto_tuple_release *) m;
+	struct iproto_thread *iproto_thread = container_of(msg,
+		struct iproto_thread, tuple_release);
+	tx_release_tuple_refs(iproto_thread, &msg->refs);
+}
+
+/**
+ * Return references to sent tuple data to tx unless a previous
+ * batch is still on its way.
+ */
+static void
+iproto_thread_release_tuples(struct iproto_thread *iproto_thread)
+{
+	if (iproto_thread->tuple_release_in_progress ||
+	    stailq_empty(&iproto_thread->tuple_garbage))
+		return;
+	struct iproto_tuple_release *msg = &iproto_thread->tuple_release;
+	stailq_create(&msg->refs);
+	stailq_concat(&msg->refs, &iproto_thread->tuple_garbage);
+	cmsg_init(&msg->base, iproto_thread->tuple_release_route);
+	iproto_thread->tuple_release_in_progress = true;
+	cpipe_push(&iproto_thread->tx_pipe, &msg->base);
+}
+
+static void
+net_end_release_tuples(struct cmsg *m)
+{
+	struct iproto_tuple_release *msg = (struct iproto_tuple_release *) m;
+	struct iproto_thread *iproto_thread = container_of(msg,
+		struct iproto_thread, tuple_release);
+	iproto_thread->tuple_release_in_progress = false;
+	iproto_thread_release_tuples(iproto_thread);
+}
+
+static int
+tx_stream_call_flush(struct call_stream *call);
+
+static void
+iproto_stream_create(struct iproto_stream *stream, struct iproto_msg *msg,
+		     uint32_t chunk_size)
+{
+	stream->call.chunk_size = chunk_size;
+	stream->call.flush = tx_stream_call_flush;
+	stream->msg = msg;
+	stream->write_end = obuf_create_svp(msg->p_obuf);
+	stream->sent = stream->write_end.used;
+	stream->chunk_count = 0;
+	stream->pushed_count = 0;
+	stream->acked_count = 0;
+	stream->window_end = IPROTO_STREAM_WINDOW;
+	stream->in_progress = false;
+	stream->is_registered = false;
+	stream->is_parked = false;
+	stream->is_unbounded = false;
+	stream->is_closed = false;
+	fiber_cond_create(&stream->cond);
+	rlist_create(&stream->in_connection);
+}
+
+/**
+ * Wait for the stream message to return, remove the stream
+ * from the connection in net and free it.
+ */
+static void
+iproto_stream_destroy(struct iproto_stream *stream)
+{
+	while (stream->in_progress)
+		fiber_cond_wait(&stream->cond);
+	if (stream->is_registered) {
+		struct iproto_thread *iproto_thread =
+			stream->msg->connection->iproto_thread;
+		stream->in_progress = true;
+		cmsg_init(&stream->base, iproto_thread->stream_close_route);
+		cpipe_push(&iproto_thread->net_pipe, &stream->base);
+		while (stream->in_progress)
+			fiber_cond_wait(&stream->cond);
+	}
+	fiber_cond_destroy(&stream->cond);
+}
+
+/** Hand the chunks written so far over to net. */
+static void
+tx_stream_push(struct iproto_stream *stream)
+{
+	struct iproto_thread *iproto_thread =
+		stream->msg->connection->iproto_thread;
+	stream->write_end = obuf_create_svp(stream->msg->p_obuf);
+	stream->pushed_count = stream->chunk_count;
+	stream->in_progress = true;
+	stream->is_registered = true;
+	cmsg_init(&stream->base, iproto_thread->stream_route);
+	cpipe_push(&iproto_thread->net_pipe, &stream->base);
+}
+
+/**
+ * Called after a chunk is written. Hand it over to net unless
+ * the previous chunks are still on their way, and wait for the
+ * client if the reply has got too far ahead of it.
+ */
+static int
+tx_stream_flush(struct iproto_stream *stream)
+{
+	struct obuf *out = stream->msg->p_obuf;
+	stream->chunk_count++;
+	while (true) {
+		if (! stream->in_progress) {
+			if (stream->is_closed) {
+				diag_set(ClientError, ER_NO_CONNECTION);
+				return -1;
+			}
+			/*
+			 * Out of the window, the message waits in
+			 * net for acknowledgements even if there
+			 * is nothing new to send.
+			 */
+			if (stream->write_end.used < obuf_size(out) ||
+			    stream->chunk_count >= stream->window_end)
+				tx_stream_push(stream);
+		}
+		if (obuf_size(out) - stream->sent <= IPROTO_STREAM_WATERMARK &&
+		    stream->chunk_count < stream->window_end)
+			return 0;
+		fiber_cond_wait(&stream->cond);
+	}
+}
+
+static int
+tx_stream_call_flush(struct call_stream *call)
+{
+	return tx_stream_flush(container_of(call, struct iproto_stream,
+					    call));
+}
+
+static void
+tx_end_stream_chunk(struct cmsg *m)
+{
+	struct iproto_stream *stream = (struct iproto_stream *) m;
+	stream->in_progress = false;
+	stream->sent = stream->write_end.used;
+	fiber_cond_signal(&stream->cond);
+}
+
+/**
+ * Return the messages of the streamed replies whose chunks are
+ * sent and which have room in their window, or of all of them
+ * if the connection is closed, to tx.
+ */
+static void
+iproto_connection_release_streams(struct iproto_connection *con)
+{
+	struct iproto_thread *iproto_thread = con->iproto_thread;
+	bool is_closed = ! evio_has_fd(&con->output);
+	struct iproto_stream *stream;
+	rlist_foreach_entry(stream, &con->streams, in_connection) {
+		if (! stream->is_parked)
+			continue;
+		struct obuf *obuf = stream->msg->p_obuf;
+		if (! is_closed && obuf->wpos.used < stream->write_end.used)
+			continue;
+		if (! is_closed && ! stream->is_unbounded &&
+		    stream->acked_count + IPROTO_STREAM_WINDOW <=
+		    stream->pushed_count)
+			continue;
+		stream->is_parked = false;
+		stream->is_closed = is_closed;
+		stream->window_end = is_closed || stream->is_unbounded ?
+				     UINT64_MAX :
+				     stream->acked_count + IPROTO_STREAM_WINDOW;
+		cmsg_init(&stream->base, iproto_thread->stream_return_route);
+		cpipe_push(&iproto_thread->tx_pipe, &stream->base);
+	}
+}
+
+/** Account a chunk acknowledged by the client. */
+static void
+iproto_connection_ack_chunk(struct iproto_connection *con, uint64_t sync)
+{
+	struct iproto_stream *stream;
+	rlist_foreach_entry(stream, &con->streams, in_connection) {
+		if (stream->msg->header.sync == sync) {
+			stream->acked_count++;
+			iproto_connection_release_streams(con);
+			return;
+		}
+	}
+	/* The stream is over, ignore. */
+}
+
+/**
+ * Stop enforcing the windows of the streamed replies of a
+ * connection which input is stopped: their acknowledgements
+ * may never be read, while the requests being streamed hold
+ * the input buffers.
+ */
+static void
+iproto_connection_stall_streams(struct iproto_connection *con)
+{
+	struct iproto_stream *stream;
+	rlist_foreach_entry(stream, &con->streams, in_connection)
+		stream->is_unbounded = true;
+	iproto_connection_release_streams(con);
+}
+
+/** Let the chunks of a streamed reply be sent. */
+static void
+net_send_stream_chunk(struct cmsg *m)
+{
+	struct iproto_stream *stream = (struct iproto_stream *) m;
+	struct iproto_msg *msg = stream->msg;
+	struct iproto_connection *con = msg->connection;
+	/* Nothing new is sent if the stream is out of the window. */
+	if (msg->p_obuf->wend.used < stream->write_end.used)
+		msg->p_obuf->wend = stream->write_end;
+	if (rlist_empty(&stream->in_connection))
+		rlist_add_tail_entry(&con->streams, stream, in_connection);
+	stream->is_parked = true;
+	if (evio_has_fd(&con->output)) {
+		if (! ev_is_active(&con->output))
+			ev_feed_event(con->loop, &con->output, EV_WRITE);
+	} else {
+		iproto_connection_release_streams(con);
+	}
+}
+
+/** Forget a stream which is over. */
+static void
+net_close_stream(struct cmsg *m)
+{
+	struct iproto_stream *stream = (struct iproto_stream *) m;
+	assert(! stream->is_parked);
+	rlist_del_entry(stream, in_connection);
+}
+
 /**
  * Fire on_disconnect triggers in the tx
  * thread and destroy the session object,
@@ -429,6 +1171,9 @@ tx_process_disconnect(struct cmsg *m)
 	 */
 	obuf_destroy(&con->obuf[0]);
 	obuf_destroy(&con->obuf[1]);
+	/* Release tuple data that won't be sent. */
+	tx_release_tuple_refs(con->iproto_thread, &con->tuple_refs[0]);
+	tx_release_tuple_refs(con->iproto_thread, &con->tuple_refs[1]);
 }
 
 /**
@@ -439,62 +1184,71 @@ static void
 net_finish_disconnect(struct cmsg *m)
 {
 	struct iproto_msg *msg = (struct iproto_msg *) m;
-	/* Runs the trigger, which may yield. */
-	iproto_connection_delete(msg->connection);
+	struct iproto_connection *con = msg->connection;
+	/* The message refers to the connection, free it first. */
 	iproto_msg_delete(msg);
+	iproto_connection_delete(con);
 }
 
-static const struct cmsg_hop disconnect_route[] = {
-	{ tx_process_disconnect, &net_pipe },
-	{ net_finish_disconnect, NULL },
-};
-
-static const struct cmsg_hop misc_route[] = {
-	{ tx_process_misc, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop select_route[] = {
-	{ tx_process_select, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop process1_route[] = {
-	{ tx_process1, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop sql_route[] = {
-	{ tx_process_sql, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX] = {
-	NULL,                                   /* IPROTO_OK */
-	select_route,                           /* IPROTO_SELECT */
-	process1_route,                         /* IPROTO_INSERT */
-	process1_route,                         /* IPROTO_REPLACE */
-	process1_route,                         /* IPROTO_UPDATE */
-	process1_route,                         /* IPROTO_DELETE */
-	misc_route,                             /* IPROTO_CALL_16 */
-	misc_route,                             /* IPROTO_AUTH */
-	misc_route,                             /* IPROTO_EVAL */
-	process1_route,                         /* IPROTO_UPSERT */
-	misc_route,                             /* IPROTO_CALL */
-	sql_route,                              /* IPROTO_EXECUTE */
-};
+static void
+tx_process_connect(struct cmsg *m);
+static void
+net_send_greeting(struct cmsg *m);
+static void
+net_accept_connection(struct cmsg *m);
 
-static const struct cmsg_hop sync_route[] = {
-	{ tx_process_join_subscribe, &net_pipe },
-	{ net_end_join_subscribe, NULL },
-};
+/** Bind message routes of an iproto thread to its pipe to net. */
+static void
+iproto_thread_init_routes(struct iproto_thread *iproto_thread)
+{
+	struct cpipe *net_pipe = &iproto_thread->net_pipe;
+	iproto_thread->disconnect_route[0] = { tx_process_disconnect, net_pipe };
+	iproto_thread->disconnect_route[1] = { net_finish_disconnect, NULL };
+	iproto_thread->misc_route[0] = { tx_process_misc, net_pipe };
+	iproto_thread->misc_route[1] = { net_send_msg, NULL };
+	iproto_thread->select_route[0] = { tx_process_select, net_pipe };
+	iproto_thread->select_route[1] = { net_send_msg, NULL };
+	iproto_thread->process1_route[0] = { tx_process1, net_pipe };
+	iproto_thread->process1_route[1] = { net_send_msg, NULL };
+	iproto_thread->sql_route[0] = { tx_process_sql, net_pipe };
+	iproto_thread->sql_route[1] = { net_send_msg, NULL };
+	iproto_thread->sync_route[0] = { tx_process_join_subscribe, net_pipe };
+	iproto_thread->sync_route[1] = { net_end_join_subscribe, NULL };
+	iproto_thread->connect_route[0] = { tx_process_connect, net_pipe };
+	iproto_thread->connect_route[1] = { net_send_greeting, NULL };
+	iproto_thread->accept_route[0] = { net_accept_connection, NULL };
+	iproto_thread->tuple_release_route[0] = { tx_release_tuples, net_pipe };
+	iproto_thread->tuple_release_route[1] = { net_end_release_tuples, NULL };
+	iproto_thread->stream_route[0] = { net_send_stream_chunk, NULL };
+	iproto_thread->stream_return_route[0] = { tx_end_stream_chunk, NULL };
+	iproto_thread->stream_close_route[0] =
+		{ net_close_stream, &iproto_thread->tx_pipe };
+	iproto_thread->stream_close_route[1] = { tx_end_stream_chunk, NULL };
+	iproto_thread->reject_route[0] = { tx_process_reject, net_pipe };
+	iproto_thread->reject_route[1] = { net_send_msg, NULL };
+
+	const struct cmsg_hop **dml_route = iproto_thread->dml_route;
+	dml_route[IPROTO_OK] = NULL;
+	dml_route[IPROTO_SELECT] = iproto_thread->select_route;
+	dml_route[IPROTO_INSERT] = iproto_thread->process1_route;
+	dml_route[IPROTO_REPLACE] = iproto_thread->process1_route;
+	dml_route[IPROTO_UPDATE] = iproto_thread->process1_route;
+	dml_route[IPROTO_DELETE] = iproto_thread->process1_route;
+	dml_route[IPROTO_CALL_16] = iproto_thread->misc_route;
+	dml_route[IPROTO_AUTH] = iproto_thread->misc_route;
+	dml_route[IPROTO_EVAL] = iproto_thread->misc_route;
+	dml_route[IPROTO_UPSERT] = iproto_thread->process1_route;
+	dml_route[IPROTO_CALL] = iproto_thread->misc_route;
+	dml_route[IPROTO_EXECUTE] = iproto_thread->sql_route;
+	dml_route[IPROTO_PREPARE] = iproto_thread->sql_route;
+}
 
 static struct iproto_connection *
-iproto_connection_new(const char *name, int fd)
+iproto_connection_new(struct iproto_thread *iproto_thread, int fd)
 {
-	(void) name;
 	struct iproto_connection *con = (struct iproto_connection *)
-		mempool_alloc_xc(&iproto_connection_pool);
+		mempool_alloc_xc(&iproto_thread->iproto_connection_pool);
+	con->iproto_thread = iproto_thread;
 	con->input.data = con->output.data = con;
 	con->loop = loop();
 	ev_io_init(&con->input, iproto_connection_on_input, fd, EV_READ);
@@ -506,10 +1260,19 @@ iproto_connection_new(const char *name, int fd)
 	con->p_ibuf = &con->ibuf[0];
 	con->parse_size = 0;
 	con->session = NULL;
-	rlist_create(&con->in_stop_list);
+	stailq_create(&con->queue);
+	con->queue_len = 0;
+	con->requests_in_progress = 0;
+	rlist_create(&con->in_ready_list);
+	con->rejects_in_progress = 0;
+	rlist_create(&con->in_throttled_list);
+	stailq_create(&con->tuple_refs[0]);
+	stailq_create(&con->tuple_refs[1]);
+	con->tuple_ref_sent = 0;
+	rlist_create(&con->streams);
 	/* It may be very awkward to allocate at close. */
 	con->disconnect = iproto_msg_new(con);
-	cmsg_init(con->disconnect, disconnect_route);
+	cmsg_init(con->disconnect, iproto_thread->disconnect_route);
 	return con;
 }
 
@@ -537,6 +1300,11 @@ iproto_connection_close(struct iproto_connection *con)
 		 * is done only once.
 		 */
 		con->p_ibuf->wpos -= con->parse_size;
+		if (!rlist_empty(&con->in_throttled_list))
+			rlist_del_entry(con, in_throttled_list);
+		/* Stop the replies being streamed. */
+		iproto_connection_release_streams(con);
+		iproto_connection_drop_queue(con);
 	}
 	/*
 	 * If the connection has no outstanding requests in the
@@ -554,9 +1322,8 @@ iproto_connection_close(struct iproto_connection *con)
 		assert(con->disconnect != NULL);
 		struct iproto_msg *msg = con->disconnect;
 		con->disconnect = NULL;
-		cpipe_push(&tx_pipe, msg);
+		cpipe_push(&con->iproto_thread->tx_pipe, msg);
 	}
-	rlist_del(&con->in_stop_list);
 }
 
 static inline struct ibuf *
@@ -640,7 +1407,8 @@ iproto_connection_input_buffer(struct iproto_connection *con)
 
 	struct ibuf *new_ibuf = iproto_connection_next_input(con);
 	struct obuf *new_obuf = iproto_connection_output_by_input(con, new_ibuf);
-	if (ibuf_used(new_ibuf) != 0 || obuf_used(new_obuf) != 0) {
+	if (ibuf_used(new_ibuf) != 0 ||
+	    !iproto_connection_output_is_empty(con, new_obuf)) {
 		/*
 		 * Wait until the second buffer is flushed
 		 * and becomes available for reuse.
@@ -663,7 +1431,8 @@ iproto_connection_input_buffer(struct iproto_connection *con)
 		 * makes the both ibuf and obuf idle, time to trim
 		 * them.
 		 */
-		if (ibuf_used(old_ibuf) == 0 && obuf_used(old_obuf) == 0) {
+		if (ibuf_used(old_ibuf) == 0 &&
+		    iproto_connection_output_is_empty(con, old_obuf)) {
 			obuf_reset(old_obuf);
 			iproto_reset_input(old_ibuf);
 		}
@@ -676,13 +1445,19 @@ iproto_connection_input_buffer(struct iproto_connection *con)
 	return new_ibuf;
 }
 
-static void
+/**
+ * Decode a request and set its route.
+ * @retval true the request is to be handed over to tx.
+ * @retval false the request is handled in net.
+ */
+static bool
 iproto_decode_msg(struct iproto_msg *msg, const char **pos, const char *reqend,
 		  bool *stop_input)
 {
 	xrow_header_decode_xc(&msg->header, pos, reqend);
 	assert(*pos == reqend);
 	uint8_t type = msg->header.type;
+	struct iproto_thread *iproto_thread = msg->connection->iproto_thread;
 
 	/*
 	 * Parse request before putting it into the queue
@@ -698,38 +1473,44 @@ iproto_decode_msg(struct iproto_msg *msg, const char **pos, const char *reqend,
 	case IPROTO_UPSERT:
 		xrow_decode_dml_xc(&msg->header, &msg->dml_request,
 				   dml_request_key_map(type));
-		assert(type < sizeof(dml_route)/sizeof(*dml_route));
-		cmsg_init(msg, dml_route[type]);
+		assert(type < lengthof(iproto_thread->dml_route));
+		cmsg_init(msg, iproto_thread->dml_route[type]);
 		break;
 	case IPROTO_CALL_16:
 	case IPROTO_CALL:
 	case IPROTO_EVAL:
 		xrow_decode_call_xc(&msg->header, &msg->call_request);
-		cmsg_init(msg, misc_route);
+		cmsg_init(msg, iproto_thread->misc_route);
 		break;
 	case IPROTO_PING:
-		cmsg_init(msg, misc_route);
+		cmsg_init(msg, iproto_thread->misc_route);
 		break;
 	case IPROTO_JOIN:
 	case IPROTO_SUBSCRIBE:
-		cmsg_init(msg, sync_route);
+		cmsg_init(msg, iproto_thread->sync_route);
 		*stop_input = true;
 		break;
 	case IPROTO_EXECUTE:
+	case IPROTO_PREPARE:
 		xrow_decode_sql_xc(&msg->header, &msg->sql_request,
 				   &fiber()->gc);
-		cmsg_init(msg, sql_route);
+		cmsg_init(msg, iproto_thread->sql_route);
 		break;
 	case IPROTO_AUTH:
 		xrow_decode_auth_xc(&msg->header, &msg->auth_request);
-		cmsg_init(msg, misc_route);
+		cmsg_init(msg, iproto_thread->misc_route);
 		break;
+	case IPROTO_CHUNK_ACK:
+		/* Not replied, so doesn't need tx. */
+		iproto_connection_ack_chunk(msg->connection,
+					    msg->header.sync);
+		return false;
 	default:
 		tnt_raise(ClientError, ER_UNKNOWN_REQUEST_TYPE,
 			  (uint32_t) type);
 		break;
 	}
-	return;
+	return true;
 }
 
 /** Enqueue all requests which were read up. */
@@ -739,7 +1520,13 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 	struct obuf *p_obuf = iproto_connection_output_by_input(con, con->p_ibuf);
 	int n_requests = 0;
 	bool stop_input = false;
+	ev_tstamp read_time = ev_monotonic_time();
+	bool is_throttled = false;
 	while (con->parse_size && stop_input == false) {
+		if (iproto_connection_is_throttled(con)) {
+			is_throttled = true;
+			break;
+		}
 		const char *reqstart = in->wpos - con->parse_size;
 		const char *pos = reqstart;
 		/* Read request length. */
@@ -759,16 +1546,22 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 		auto guard = make_scoped_guard([=] { iproto_msg_delete(msg); });
 
 		msg->len = reqend - reqstart; /* total request length */
+		msg->read_time = read_time;
 
 		try {
-			iproto_decode_msg(msg, &pos, reqend, &stop_input);
-			/*
-			 * This can't throw, but should not be
-			 * done in case of exception.
-			 */
-			cpipe_push_input(&tx_pipe, msg);
-			guard.is_active = false;
-			n_requests++;
+			if (iproto_decode_msg(msg, &pos, reqend,
+					      &stop_input)) {
+				/*
+				 * This can't throw, but should not
+				 * be done in case of exception.
+				 */
+				iproto_connection_push(con, msg, &stop_input);
+				guard.is_active = false;
+				n_requests++;
+			} else {
+				/* Handled, discard right away. */
+				in->rpos += msg->len;
+			}
 		} catch (Exception *e) {
 			/*
 			 * Do not close connection if we failed to
@@ -811,8 +1604,19 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 		 */
 		ev_io_stop(con->loop, &con->output);
 		ev_io_stop(con->loop, &con->input);
+	} else if (is_throttled) {
+		/*
+		 * Leave the rest of the input in the buffer
+		 * and the socket until the rejects are replied,
+		 * see iproto_thread_resume_input().
+		 */
+		if (rlist_empty(&con->in_throttled_list)) {
+			rlist_add_tail_entry(
+				&con->iproto_thread->throttled_connections,
+				con, in_throttled_list);
+		}
+		ev_io_stop(con->loop, &con->input);
 	} else if (n_requests != 1 || con->parse_size != 0) {
-		assert(rlist_empty(&con->in_stop_list));
 		/*
 		 * Keep reading input, as long as the socket
 		 * supplies data, but don't waste CPU on an extra
@@ -832,7 +1636,7 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 		 */
 		ev_feed_event(con->loop, &con->input, EV_READ);
 	}
-	cpipe_flush_input(&tx_pipe);
+	cpipe_flush_input(&con->iproto_thread->tx_pipe);
 }
 
 static void
@@ -843,32 +1647,16 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 		(struct iproto_connection *) watcher->data;
 	int fd = con->input.fd;
 	assert(fd >= 0);
-	if (! rlist_empty(&con->in_stop_list)) {
-		/* Resumed stopped connection. */
-		rlist_del(&con->in_stop_list);
-		/*
-		 * This connection may have no input, so
-		 * resume one more connection which might have
-		 * input.
-		 */
-		iproto_resume();
-	}
-	/*
-	 * Throttle if there are too many pending requests,
-	 * otherwise we might deplete the fiber pool and
-	 * deadlock (e.g. WAL writer needs a fiber to wake
-	 * another fiber waiting for write to complete).
-	 * Ignore iproto_connection->disconnect messages.
-	 */
-	if (iproto_must_stop_input()) {
-		iproto_connection_stop(con);
+	if (!rlist_empty(&con->in_throttled_list)) {
+		/* Fed by output, wait for the rejects instead. */
+		ev_io_stop(loop, &con->input);
 		return;
 	}
-
 	try {
 		/* Ensure we have sufficient space for the next round.  */
 		struct ibuf *in = iproto_connection_input_buffer(con);
 		if (in == NULL) {
+			iproto_connection_stall_streams(con);
 			ev_io_stop(loop, &con->input);
 			return;
 		}
@@ -883,7 +1671,7 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 			return;
 		}
 		/* Count statistics */
-		rmean_collect(rmean_net, IPROTO_RECEIVED, nrd);
+		rmean_collect(con->iproto_thread->rmean, IPROTO_RECEIVED, nrd);
 
 		/* Update the read position and connection state. */
 		in->wpos += nrd;
@@ -898,6 +1686,122 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 	}
 }
 
+/**
+ * Resume input of the throttled connections which are not
+ * going to get over the reject limits anymore: parse the
+ * requests left in the input buffer, which also starts
+ * reading the socket again.
+ */
+static void
+iproto_thread_resume_input(struct iproto_thread *iproto_thread)
+{
+	struct iproto_connection *con, *tmp;
+	rlist_foreach_entry_safe(con, &iproto_thread->throttled_connections,
+				 in_throttled_list, tmp) {
+		if (iproto_connection_is_throttled(con))
+			continue;
+		rlist_del_entry(con, in_throttled_list);
+		assert(evio_has_fd(&con->input));
+		try {
+			iproto_enqueue_batch(con, con->p_ibuf);
+		} catch (Exception *e) {
+			iproto_write_error_blocking(con->input.fd, e, 0);
+			e->log();
+			iproto_connection_close(con);
+		}
+	}
+}
+
+/**
+ * Build a chain of the unsent pieces of an output buffer, given
+ * in @a iov and starting at buffer offset @a used, with the
+ * referenced tuple data inserted at its offsets. The first
+ * tuple data may be partially sent already. The chain is cut
+ * short when it runs out of slots.
+ * @retval the chain size in bytes.
+ */
+static size_t
+iproto_chain_tuple_refs(struct iproto_connection *con, struct stailq *refs,
+			size_t used, const struct iovec *iov, int iovcnt,
+			struct iovec *chain, int *chaincnt)
+{
+	struct stailq_entry *next = stailq_first(refs);
+	size_t sent = con->tuple_ref_sent;
+	size_t size = 0;
+	int cnt = 0;
+	for (int i = 0; i < iovcnt; i++) {
+		char *base = (char *) iov[i].iov_base;
+		size_t len = iov[i].iov_len;
+		while (next != NULL) {
+			struct iproto_tuple_ref *ref = stailq_entry(next,
+				struct iproto_tuple_ref, in_list);
+			assert(ref->offset >= used);
+			if (ref->offset > used + len)
+				break;
+			if (cnt + 2 > IPROTO_IOV_MAX)
+				goto out;
+			size_t head = ref->offset - used;
+			if (head > 0) {
+				chain[cnt].iov_base = base;
+				chain[cnt++].iov_len = head;
+				base += head;
+				len -= head;
+				used += head;
+				size += head;
+			}
+			chain[cnt].iov_base = (char *) ref->data + sent;
+			chain[cnt++].iov_len = ref->size - sent;
+			size += ref->size - sent;
+			sent = 0;
+			next = stailq_next(next);
+		}
+		if (len > 0) {
+			if (cnt == IPROTO_IOV_MAX)
+				goto out;
+			chain[cnt].iov_base = base;
+			chain[cnt++].iov_len = len;
+			used += len;
+			size += len;
+		}
+	}
+out:
+	*chaincnt = cnt;
+	return size;
+}
+
+/**
+ * Account @a nwr bytes written from a chain built by
+ * iproto_chain_tuple_refs() and move the tuple references
+ * which are fully sent to the thread garbage.
+ * @retval how many of the bytes come from the output buffer.
+ */
+static size_t
+iproto_advance_tuple_refs(struct iproto_connection *con, struct stailq *refs,
+			  size_t used, size_t nwr)
+{
+	size_t obuf_nwr = 0;
+	while (! stailq_empty(refs)) {
+		struct iproto_tuple_ref *ref = stailq_first_entry(refs,
+			struct iproto_tuple_ref, in_list);
+		size_t gap = ref->offset - used - obuf_nwr;
+		if (nwr <= gap)
+			break;
+		obuf_nwr += gap;
+		nwr -= gap;
+		size_t unsent = ref->size - con->tuple_ref_sent;
+		if (nwr < unsent) {
+			con->tuple_ref_sent += nwr;
+			return obuf_nwr;
+		}
+		nwr -= unsent;
+		con->tuple_ref_sent = 0;
+		stailq_shift(refs);
+		stailq_add_tail(&con->iproto_thread->tuple_garbage,
+				&ref->in_list);
+	}
+	return obuf_nwr + nwr;
+}
+
 /** writev() to the socket and handle the result. */
 
 static int
@@ -905,7 +1809,7 @@ iproto_flush(struct iproto_connection *con)
 {
 	struct ibuf *ibuf = iproto_connection_prev_input(con);
 	struct obuf *obuf = iproto_connection_output_by_input(con, ibuf);
-	if (obuf_used(obuf) == 0) {
+	if (iproto_connection_output_is_empty(con, obuf)) {
 		obuf = iproto_connection_output_by_input(con, con->p_ibuf);
 		/*
 		 * Don't try to write from a newer buffer if an
@@ -914,7 +1818,8 @@ iproto_flush(struct iproto_connection *con)
 		 * salad of different pieces of replies from both
 		 * buffers.
 		 */
-		if (ibuf_used(ibuf) > 0 || obuf_used(obuf) == 0)
+		if (ibuf_used(ibuf) > 0 ||
+		    iproto_connection_output_is_empty(con, obuf))
 			return 1;
 		ibuf = con->p_ibuf;
 	}
@@ -922,7 +1827,8 @@ iproto_flush(struct iproto_connection *con)
 	int fd = con->output.fd;
 	struct obuf_svp *begin = &obuf->wpos;
 	struct obuf_svp *end = &obuf->wend;
-	assert(begin->used < end->used);
+	struct stailq *refs = iproto_connection_tuple_refs(con, obuf);
+	assert(begin->used < end->used || ! stailq_empty(refs));
 	struct iovec iov[SMALL_OBUF_IOV_MAX+1];
 	struct iovec *src = obuf->iov;
 	int iovcnt = end->pos - begin->pos + 1;
@@ -935,12 +1841,34 @@ iproto_flush(struct iproto_connection *con)
 	/* *Overwrite* iov_len of the last pos as it may be garbage. */
 	iov[iovcnt-1].iov_len = end->iov_len - begin->iov_len * (iovcnt == 1);
 
-	ssize_t nwr = sio_writev(fd, iov, iovcnt);
+	ssize_t nwr;
+	size_t obuf_nwr;
+	size_t chain_size = 0;
+	if (stailq_empty(refs)) {
+		nwr = sio_writev(fd, iov, iovcnt);
+		obuf_nwr = nwr;
+	} else {
+		/*
+		 * Send tuple data referenced by the replies
+		 * in between the buffer pieces.
+		 */
+		struct iovec chain[IPROTO_IOV_MAX];
+		int chaincnt;
+		chain_size = iproto_chain_tuple_refs(con, refs, begin->used,
+						     iov, iovcnt, chain,
+						     &chaincnt);
+		nwr = sio_writev(fd, chain, chaincnt);
+		obuf_nwr = nwr > 0 ?
+			   iproto_advance_tuple_refs(con, refs, begin->used,
+						     nwr) : 0;
+		iproto_thread_release_tuples(con->iproto_thread);
+	}
 
 	/* Count statistics */
-	rmean_collect(rmean_net, IPROTO_SENT, nwr);
+	rmean_collect(con->iproto_thread->rmean, IPROTO_SENT, nwr);
 	if (nwr > 0) {
-		if (begin->used + nwr == end->used) {
+		if (begin->used + obuf_nwr == end->used &&
+		    stailq_empty(refs)) {
 			if (ibuf_used(ibuf) == 0) {
 				/* Quickly recycle the buffer if it's idle. */
 				assert(end->used == obuf_size(obuf));
@@ -953,13 +1881,23 @@ iproto_flush(struct iproto_connection *con)
 			}
 			return 0;
 		}
-		size_t offset = 0;
-		int advance = 0;
-		advance = sio_move_iov(iov, nwr, &offset);
-		begin->used += nwr;             /* advance write position */
-		begin->iov_len = advance == 0 ? begin->iov_len + offset: offset;
-		begin->pos += advance;
-		assert(begin->pos <= end->pos);
+		if (begin->used + obuf_nwr == end->used) {
+			/* Only tuple data at the end is left. */
+			*begin = *end;
+		} else if (obuf_nwr > 0) {
+			size_t offset = 0;
+			int advance = 0;
+			advance = sio_move_iov(iov, obuf_nwr, &offset);
+			/* advance write position */
+			begin->used += obuf_nwr;
+			begin->iov_len = advance == 0 ?
+					 begin->iov_len + offset: offset;
+			begin->pos += advance;
+			assert(begin->pos <= end->pos);
+		}
+		/* The chain was cut short, write the rest. */
+		if ((size_t) nwr == chain_size)
+			return 0;
 	}
 	return -1;
 }
@@ -974,16 +1912,16 @@ iproto_connection_on_output(ev_loop *loop, struct ev_io *watcher,
 		int rc;
 		while ((rc = iproto_flush(con)) <= 0) {
 			if (rc != 0) {
+				iproto_connection_release_streams(con);
 				ev_io_start(loop, &con->output);
 				return;
 			}
-			if (! ev_is_active(&con->input) &&
-			    rlist_empty(&con->in_stop_list)) {
+			if (! ev_is_active(&con->input))
 				ev_feed_event(loop, &con->input, EV_READ);
-			}
 		}
 		if (ev_is_active(&con->output))
 			ev_io_stop(con->loop, &con->output);
+		iproto_connection_release_streams(con);
 	} catch (Exception *e) {
 		e->log();
 		iproto_connection_close(con);
@@ -1007,7 +1945,7 @@ tx_process1(struct cmsg *m)
 	struct iproto_msg *msg = (struct iproto_msg *) m;
 	struct obuf *out = msg->p_obuf;
 
-	tx_fiber_init(msg->connection->session, msg->header.sync);
+	tx_begin_msg(msg);
 	if (tx_check_schema(msg->header.schema_version))
 		goto error;
 
@@ -1020,12 +1958,80 @@ tx_process1(struct cmsg *m)
 		goto error;
 	iproto_reply_select(out, &svp, msg->header.sync, ::schema_version,
 			    tuple != 0);
-	msg->write_end = obuf_create_svp(out);
+	tx_end_msg(msg);
 	return;
 error:
 	iproto_reply_error(out, diag_last_error(&fiber()->diag),
 			   msg->header.sync, ::schema_version);
-	msg->write_end = obuf_create_svp(out);
+	tx_end_msg(msg);
+}
+
+/**
+ * Dump selected tuples to the reply. Large tuples aren't copied
+ * to the output buffer: the message references them and their
+ * data is sent from the tuple memory.
+ * @param[out] ref_size size of the referenced tuple data.
+ */
+static int
+tx_dump_select(struct iproto_msg *msg, struct port *port, size_t *ref_size)
+{
+	struct iproto_thread *iproto_thread = msg->connection->iproto_thread;
+	struct obuf *out = msg->p_obuf;
+	*ref_size = 0;
+	for (struct port_entry *pe = port->first; pe != NULL; pe = pe->next) {
+		struct tuple *tuple = pe->tuple;
+		ERROR_INJECT(ERRINJ_PORT_DUMP, {
+			diag_set(OutOfMemory, tuple_size(tuple), "obuf_dup",
+				 "data");
+			return -1;
+		});
+		/* Compressed tuples are sent decompressed. */
+		if (tuple->bsize < IPROTO_TUPLE_REF_MIN ||
+		    tuple->is_compressed) {
+			if (tuple_to_obuf(tuple, out) != 0)
+				return -1;
+			continue;
+		}
+		struct iproto_tuple_ref *ref = (struct iproto_tuple_ref *)
+			mempool_alloc(&iproto_thread->tuple_ref_pool);
+		if (ref == NULL) {
+			diag_set(OutOfMemory, sizeof(*ref), "mempool_alloc",
+				 "ref");
+			return -1;
+		}
+		if (tuple_ref(tuple) != 0) {
+			mempool_free(&iproto_thread->tuple_ref_pool, ref);
+			return -1;
+		}
+		ref->tuple = tuple;
+		ref->offset = obuf_size(out);
+		ref->data = tuple_data_raw(tuple);
+		ref->size = tuple->bsize;
+		stailq_add_tail(&msg->tuple_refs, &ref->in_list);
+		*ref_size += ref->size;
+	}
+	return 0;
+}
+
+/** Send a chunk of a streamed SELECT reply. */
+static int
+tx_stream_select_chunk(struct port *port, void *arg)
+{
+	struct iproto_stream *stream = (struct iproto_stream *) arg;
+	struct iproto_msg *msg = stream->msg;
+	struct obuf *out = msg->p_obuf;
+	struct obuf_svp svp;
+	if (iproto_prepare_select(out, &svp) != 0)
+		return -1;
+	if (port_dump(port, out) != 0) {
+		obuf_rollback_to_svp(out, &svp);
+		return -1;
+	}
+	iproto_reply_chunk(out, &svp, msg->header.sync, ::schema_version,
+			   port->size);
+	port_destroy(port);
+	port_create(port);
+	return tx_stream_flush(stream);
 }
 
 static void
@@ -1035,36 +2041,62 @@ tx_process_select(struct cmsg *m)
 	struct obuf *out = msg->p_obuf;
 	struct obuf_svp svp;
 	struct port port;
+	size_t ref_size;
 	int rc;
 	struct request *req = &msg->dml_request;
 
-	tx_fiber_init(msg->connection->session, msg->header.sync);
+	tx_begin_msg(msg);
 
 	port_create(&port);
 	auto port_guard = make_scoped_guard([&](){ port_destroy(&port); });
+	struct iproto_stream stream;
+	iproto_stream_create(&stream, msg, req->chunk_size);
+	auto stream_guard = make_scoped_guard([&](){
+		iproto_stream_destroy(&stream);
+	});
 
 	if (tx_check_schema(msg->header.schema_version))
 		goto error;
 
-	rc = box_select(&port,
-			req->space_id, req->index_id,
-			req->iterator, req->offset, req->limit,
-			req->key, req->key_end);
+	rc = box_select_chunked(&port,
+				req->space_id, req->index_id,
+				req->iterator, req->offset, req->limit,
+				req->key, req->key_end, req->chunk_size,
+				tx_stream_select_chunk, &stream);
 	if (rc < 0 || iproto_prepare_select(out, &svp) != 0)
 		goto error;
-	if (port_dump(&port, out) != 0) {
+	if (tx_dump_select(msg, &port, &ref_size) != 0) {
 		/* Discard the prepared select. */
 		obuf_rollback_to_svp(out, &svp);
+		tx_release_tuple_refs(msg->connection->iproto_thread,
+				      &msg->tuple_refs);
 		goto error;
 	}
-	iproto_reply_select(out, &svp, msg->header.sync, ::schema_version,
-			    port.size);
-	msg->write_end = obuf_create_svp(out);
+	iproto_reply_select_ext(out, &svp, msg->header.sync, ::schema_version,
+				port.size, ref_size);
+	tx_end_msg(msg);
 	return;
 error:
 	iproto_reply_error(out, diag_last_error(&fiber()->diag),
 			   msg->header.sync, ::schema_version);
-	msg->write_end = obuf_create_svp(out);
+	tx_end_msg(msg);
+}
+
+/** Execute a CALL, streaming the reply if requested. */
+static void
+tx_process_call(struct iproto_msg *msg)
+{
+	struct call_request *req = &msg->call_request;
+	if (req->chunk_size == 0) {
+		box_process_call(req, msg->p_obuf, NULL);
+		return;
+	}
+	struct iproto_stream stream;
+	iproto_stream_create(&stream, msg, req->chunk_size);
+	auto stream_guard = make_scoped_guard([&](){
+		iproto_stream_destroy(&stream);
+	});
+	box_process_call(req, msg->p_obuf, &stream.call);
 }
 
 static void
@@ -1073,7 +2105,7 @@ tx_process_misc(struct cmsg *m)
 	struct iproto_msg *msg = (struct iproto_msg *) m;
 	struct obuf *out = msg->p_obuf;
 
-	tx_fiber_init(msg->connection->session, msg->header.sync);
+	tx_begin_msg(msg);
 
 	if (tx_check_schema(msg->header.schema_version))
 		goto error;
@@ -1082,7 +2114,7 @@ tx_process_misc(struct cmsg *m)
 		switch (msg->header.type) {
 		case IPROTO_CALL:
 		case IPROTO_CALL_16:
-			box_process_call(&msg->call_request, out);
+			tx_process_call(msg);
 			break;
 		case IPROTO_EVAL:
 			box_process_eval(&msg->call_request, out);
@@ -1101,12 +2133,12 @@ tx_process_misc(struct cmsg *m)
 		iproto_reply_error(out, diag_last_error(&fiber()->diag),
 				   msg->header.sync, ::schema_version);
 	}
-	msg->write_end = obuf_create_svp(out);
+	tx_end_msg(msg);
 	return;
 error:
 	iproto_reply_error(out, diag_last_error(&fiber()->diag),
 			   msg->header.sync, ::schema_version);
-	msg->write_end = obuf_create_svp(out);
+	tx_end_msg(msg);
 }
 
 static void
@@ -1116,20 +2148,38 @@ tx_process_sql(struct cmsg *m)
 	struct obuf *out = msg->p_obuf;
 	uint64_t sync = msg->header.sync;
 
-	tx_fiber_init(msg->connection->session, sync);
+	tx_begin_msg(msg);
 
 	if (tx_check_schema(msg->header.schema_version))
 		goto error;
-	assert(msg->header.type == IPROTO_EXECUTE);
-	if (sql_prepare_and_execute(&msg->sql_request, out,
-				    &fiber()->gc) == 0) {
-		msg->write_end = obuf_create_svp(out);
+	int rc;
+	if (msg->header.type == IPROTO_PREPARE) {
+		rc = sql_prepare(&msg->sql_request, out);
+	} else {
+		assert(msg->header.type == IPROTO_EXECUTE);
+		rc = sql_prepare_and_execute(&msg->sql_request, out,
+					     &fiber()->gc);
+	}
+	if (rc == 0) {
+		tx_end_msg(msg);
 		return;
 	}
 error:
 	iproto_reply_error(out, diag_last_error(&fiber()->diag), sync,
 			   ::schema_version);
-	msg->write_end = obuf_create_svp(out);
+	tx_end_msg(msg);
+}
+
+/** Reply to a request rejected due to the connection overload. */
+static void
+tx_process_reject(struct cmsg *m)
+{
+	struct iproto_msg *msg = (struct iproto_msg *) m;
+	tx_begin_msg(msg);
+	diag_set(ClientError, ER_OVERLOAD, msg->retry_delay);
+	iproto_reply_error(msg->p_obuf, diag_last_error(&fiber()->diag),
+			   msg->header.sync, ::schema_version);
+	tx_end_msg(msg);
 }
 
 static void
@@ -1177,6 +2227,11 @@ net_send_msg(struct cmsg *m)
 	/* Discard request (see iproto_enqueue_batch()) */
 	msg->p_ibuf->rpos += msg->len;
 	msg->p_obuf->wend = msg->write_end;
+	stailq_concat(iproto_connection_tuple_refs(con, msg->p_obuf),
+		      &msg->tuple_refs);
+	/* Rejected requests would skew the latency. */
+	if (msg->is_scheduled)
+		iproto_msg_collect_latency(msg);
 
 	if (evio_has_fd(&con->output)) {
 		if (! ev_is_active(&con->output))
@@ -1254,7 +2309,8 @@ net_send_greeting(struct cmsg *m)
 						 obuf_iovcnt(out));
 
 			/* Count statistics */
-			rmean_collect(rmean_net, IPROTO_SENT, nwr);
+			rmean_collect(con->iproto_thread->rmean, IPROTO_SENT,
+				      nwr);
 		} catch (Exception *e) {
 			e->log();
 		}
@@ -1275,103 +2331,327 @@ net_send_greeting(struct cmsg *m)
 	iproto_msg_delete(msg);
 }
 
-static const struct cmsg_hop connect_route[] = {
-	{ tx_process_connect, &net_pipe },
-	{ net_send_greeting, NULL },
-};
-
 /** }}} */
 
 /**
- * Create a connection and start input.
+ * Create a connection in the current iproto thread
+ * and start the handshake.
  */
 static void
-iproto_on_accept(struct evio_service * /* service */, int fd,
-		 struct sockaddr *addr, socklen_t addrlen)
+iproto_connection_accept(struct iproto_thread *iproto_thread, int fd)
 {
-	char name[SERVICE_NAME_MAXLEN];
-	snprintf(name, sizeof(name), "%s/%s", "iobuf",
-		sio_strfaddr(addr, addrlen));
-
 	struct iproto_connection *con;
 
-	con = iproto_connection_new(name, fd);
+	con = iproto_connection_new(iproto_thread, fd);
 	/*
 	 * Ignore msg allocation failure - the queue size is
 	 * fixed so there is a limited number of msgs in
 	 * use, all stored in just a few blocks of the memory pool.
 	 */
 	struct iproto_msg *msg = iproto_msg_new(con);
-	cmsg_init(msg, connect_route);
+	cmsg_init(msg, iproto_thread->connect_route);
 	msg->p_ibuf = con->p_ibuf;
 	msg->p_obuf = iproto_connection_output_by_input(con, con->p_ibuf);
 	msg->close_connection = false;
-	cpipe_push(&tx_pipe, msg);
+	cpipe_push(&iproto_thread->tx_pipe, msg);
+}
+
+/**
+ * A message handing over an accepted socket from the
+ * acceptor to another iproto thread.
+ */
+struct iproto_accept_msg {
+	struct cmsg base;
+	/** The thread to serve the connection. */
+	struct iproto_thread *iproto_thread;
+	/** The accepted socket. */
+	int fd;
+};
+
+static void
+net_accept_connection(struct cmsg *m)
+{
+	struct iproto_accept_msg *msg = (struct iproto_accept_msg *) m;
+	struct iproto_thread *iproto_thread = msg->iproto_thread;
+	int fd = msg->fd;
+	free(msg);
+	try {
+		iproto_connection_accept(iproto_thread, fd);
+	} catch (Exception *e) {
+		close(fd);
+		e->log();
+	}
 }
 
-static struct evio_service binary; /* iproto binary listener */
+/**
+ * Create a connection and start input. Connections
+ * are spread over iproto threads in a round-robin manner.
+ */
+static void
+iproto_on_accept(struct evio_service *service, int fd,
+		 struct sockaddr * /* addr */, socklen_t /* addrlen */)
+{
+	struct iproto_thread *acceptor =
+		(struct iproto_thread *) service->on_accept_param;
+	/* Only accessed in the acceptor thread. */
+	static int next_thread_id = 0;
+	struct iproto_thread *iproto_thread = &iproto_threads[next_thread_id];
+	next_thread_id = (next_thread_id + 1) % iproto_threads_count;
+
+	if (iproto_thread == acceptor) {
+		iproto_connection_accept(iproto_thread, fd);
+		return;
+	}
+
+	struct iproto_accept_msg *msg = (struct iproto_accept_msg *)
+		malloc(sizeof(*msg));
+	if (msg == NULL) {
+		tnt_raise(OutOfMemory, sizeof(*msg),
+			  "malloc", "struct iproto_accept_msg");
+	}
+	cmsg_init(&msg->base, iproto_thread->accept_route);
+	msg->iproto_thread = iproto_thread;
+	msg->fd = fd;
+	cpipe_push(&iproto_thread->accept_pipe, &msg->base);
+}
 
 /**
  * The network io thread main function:
  * begin serving the message bus.
  */
 static int
-net_cord_f(va_list /* ap */)
+net_cord_f(va_list ap)
 {
+	struct iproto_thread *iproto_thread = va_arg(ap, struct iproto_thread *);
+
 	/* Got to be called in every thread using iobuf */
 	iobuf_init();
-	mempool_create(&iproto_msg_pool, &cord()->slabc,
+	mempool_create(&iproto_thread->iproto_msg_pool, &cord()->slabc,
 		       sizeof(struct iproto_msg));
-	mempool_create(&iproto_connection_pool, &cord()->slabc,
+	mempool_create(&iproto_thread->iproto_connection_pool, &cord()->slabc,
 		       sizeof(struct iproto_connection));
 
-	evio_service_init(loop(), &binary, "binary",
-			  iproto_on_accept, NULL);
+	evio_service_init(loop(), &iproto_thread->binary, "binary",
+			  iproto_on_accept, iproto_thread);
 
 
 	/* Init statistics counter */
-	rmean_net = rmean_new(rmean_net_strings, IPROTO_LAST);
+	iproto_thread->rmean = rmean_new(rmean_net_strings, IPROTO_LAST);
 
-	if (rmean_net == NULL) {
+	if (iproto_thread->rmean == NULL) {
 		tnt_raise(OutOfMemory, sizeof(struct rmean),
 			  "rmean", "struct rmean");
 	}
+	for (int type = 0; type < IPROTO_TYPE_STAT_MAX; type++) {
+		if (iproto_latency_type(type) != type)
+			continue;
+		for (int i = 0; i < iproto_latency_stage_MAX; i++) {
+			struct histogram *hist =
+				histogram_new(iproto_latency_buckets,
+					      IPROTO_LATENCY_BUCKETS);
+			if (hist == NULL) {
+				tnt_raise(OutOfMemory, sizeof(*hist),
+					  "histogram_new", "struct histogram");
+			}
+			iproto_thread->latency[type][i] = hist;
+		}
+	}
 
 	struct cbus_endpoint endpoint;
 	/* Create "net" endpoint. */
-	cbus_endpoint_create(&endpoint, "net", fiber_schedule_cb, fiber());
+	cbus_endpoint_create(&endpoint, iproto_thread->endpoint_name,
+			     fiber_schedule_cb, fiber());
 	/* Create a pipe to "tx" thread. */
-	cpipe_create(&tx_pipe, "tx");
-	cpipe_set_max_input(&tx_pipe, IPROTO_MSG_MAX/2);
+	cpipe_create(&iproto_thread->tx_pipe, "tx");
+	cpipe_set_max_input(&iproto_thread->tx_pipe, IPROTO_MSG_MAX/2);
+	/*
+	 * The acceptor hands over accepted sockets
+	 * to the other threads.
+	 */
+	if (iproto_thread->id == 0) {
+		for (int i = 1; i < iproto_threads_count; i++) {
+			cpipe_create(&iproto_threads[i].accept_pipe,
+				     iproto_threads[i].endpoint_name);
+		}
+	}
 	/* Process incomming messages. */
 	cbus_loop(&endpoint);
 
-	cpipe_destroy(&tx_pipe);
+	if (iproto_thread->id == 0) {
+		for (int i = 1; i < iproto_threads_count; i++)
+			cpipe_destroy(&iproto_threads[i].accept_pipe);
+	}
+	cpipe_destroy(&iproto_thread->tx_pipe);
 	/*
 	 * Nothing to do in the fiber so far, the service
 	 * will take care of creating events for incoming
 	 * connections.
 	 */
-	if (evio_service_is_active(&binary))
-		evio_service_stop(&binary);
-
-	rmean_delete(rmean_net);
+	if (evio_service_is_active(&iproto_thread->binary))
+		evio_service_stop(&iproto_thread->binary);
+
+	rmean_delete(iproto_thread->rmean);
+	for (int type = 0; type < IPROTO_TYPE_STAT_MAX; type++) {
+		for (int i = 0; i < iproto_latency_stage_MAX; i++) {
+			if (iproto_thread->latency[type][i] != NULL)
+				histogram_delete(iproto_thread->latency[type][i]);
+		}
+	}
 	return 0;
 }
 
-/** Initialize the iproto subsystem and start network io thread */
+/** Initialize the iproto subsystem and start network io threads */
 void
-iproto_init()
+iproto_init(int threads_count)
 {
+	assert(threads_count > 0);
 	tx_cord = cord();
 
-	static struct cord net_cord;
-	if (cord_costart(&net_cord, "iproto", net_cord_f, NULL))
-		panic("failed to initialize iproto thread");
+	int64_t *bucket = iproto_latency_buckets;
+	for (int64_t usec = 1; usec < 10 * USEC_PER_SEC; usec *= 10) {
+		for (int i = 1; i <= 9; i++)
+			*bucket++ = i * usec;
+	}
+	*bucket++ = 10 * USEC_PER_SEC;
+	assert(bucket == iproto_latency_buckets + IPROTO_LATENCY_BUCKETS);
+
+	iproto_threads = (struct iproto_thread *)
+		calloc(threads_count, sizeof(struct iproto_thread));
+	if (iproto_threads == NULL)
+		panic("failed to allocate iproto threads");
+	iproto_threads_count = threads_count;
+
+	for (int i = 0; i < threads_count; i++) {
+		struct iproto_thread *iproto_thread = &iproto_threads[i];
+		char name[FIBER_NAME_MAX];
+		iproto_thread->id = i;
+		if (i == 0) {
+			snprintf(name, sizeof(name), "iproto");
+			snprintf(iproto_thread->endpoint_name,
+				 sizeof(iproto_thread->endpoint_name), "net");
+		} else {
+			snprintf(name, sizeof(name), "iproto%d", i);
+			snprintf(iproto_thread->endpoint_name,
+				 sizeof(iproto_thread->endpoint_name),
+				 "net%d", i);
+		}
+		rlist_create(&iproto_thread->ready_connections);
+		rlist_create(&iproto_thread->throttled_connections);
+		stailq_create(&iproto_thread->tuple_garbage);
+		mempool_create(&iproto_thread->tuple_ref_pool, &cord()->slabc,
+			       sizeof(struct iproto_tuple_ref));
+		iproto_thread_init_routes(iproto_thread);
+
+		if (cord_costart(&iproto_thread->net_cord, name,
+				 net_cord_f, iproto_thread))
+			panic("failed to initialize iproto thread");
+
+		/* Create a pipe to "net" thread. */
+		cpipe_create(&iproto_thread->net_pipe,
+			     iproto_thread->endpoint_name);
+		cpipe_set_max_input(&iproto_thread->net_pipe,
+				    IPROTO_MSG_MAX/2);
+	}
+}
+
+int
+iproto_rmean_foreach(rmean_cb cb, void *cb_ctx)
+{
+	for (size_t name = 0; name < IPROTO_LAST; name++) {
+		int64_t rps = 0;
+		int64_t total = 0;
+		for (int i = 0; i < iproto_threads_count; i++) {
+			struct rmean *rmean = iproto_threads[i].rmean;
+			/* Dirty read from tx thread. */
+			if (rmean == NULL)
+				continue;
+			rps += rmean_mean(rmean, name);
+			total += rmean_total(rmean, name);
+		}
+		int rc = cb(rmean_net_strings[name], (int) rps, total, cb_ctx);
+		if (rc != 0)
+			return rc;
+	}
+	return 0;
+}
+
+/** Return a latency percentile, in seconds. */
+static double
+iproto_latency_percentile(struct histogram *hist, double pct)
+{
+	if (hist->total == 0)
+		return 0;
+	return (double)histogram_percentile(hist, pct) / USEC_PER_SEC;
+}
+
+int
+iproto_latency_foreach(iproto_latency_cb cb, void *cb_ctx)
+{
+	for (int type = 0; type < IPROTO_TYPE_STAT_MAX; type++) {
+		if (iproto_latency_type(type) != type)
+			continue;
+		int64_t count = 0;
+		struct iproto_latency_stat stages[iproto_latency_stage_MAX];
+		for (int i = 0; i < iproto_latency_stage_MAX; i++) {
+			struct histogram *hist =
+				histogram_new(iproto_latency_buckets,
+					      IPROTO_LATENCY_BUCKETS);
+			if (hist == NULL)
+				return -1;
+			for (int t = 0; t < iproto_threads_count; t++) {
+				/* Dirty read from tx thread. */
+				struct histogram *other =
+					iproto_threads[t].latency[type][i];
+				if (other != NULL)
+					histogram_merge(hist, other);
+			}
+			count = hist->total;
+			stages[i].p50 = iproto_latency_percentile(hist, 50);
+			stages[i].p99 = iproto_latency_percentile(hist, 99);
+			stages[i].p999 = iproto_latency_percentile(hist, 99.9);
+			histogram_delete(hist);
+		}
+		int rc = cb(iproto_type_strs[type], count, stages, cb_ctx);
+		if (rc != 0)
+			return rc;
+	}
+	return 0;
+}
+
+/** Return the number of connections with a given queue depth. */
+static int64_t
+iproto_queue_depth_count(int depth)
+{
+	int64_t count = 0;
+	for (int i = 0; i < iproto_threads_count; i++)
+		count += iproto_threads[i].queue_depth[depth];
+	return count;
+}
 
-	/* Create a pipe to "net" thread. */
-	cpipe_create(&net_pipe, "net");
-	cpipe_set_max_input(&net_pipe, IPROTO_MSG_MAX/2);
+void
+iproto_queue_stat(struct iproto_queue_stat *stat)
+{
+	memset(stat, 0, sizeof(*stat));
+	for (int i = 0; i < iproto_threads_count; i++) {
+		/* Dirty read from tx thread. */
+		stat->in_progress += iproto_threads[i].requests_in_progress;
+		stat->queued += iproto_threads[i].requests_queued;
+	}
+	for (int depth = 1; depth <= IPROTO_CONNECTION_QUEUE_MAX; depth++)
+		stat->connections += iproto_queue_depth_count(depth);
+	int64_t count = 0;
+	for (int depth = 1; depth <= IPROTO_CONNECTION_QUEUE_MAX; depth++) {
+		int64_t n = iproto_queue_depth_count(depth);
+		if (n == 0)
+			continue;
+		count += n;
+		int64_t pct = count * 100 / MAX(stat->connections, 1);
+		if (stat->depth_p50 == 0 && pct >= 50)
+			stat->depth_p50 = depth;
+		if (stat->depth_p99 == 0 && pct >= 99)
+			stat->depth_p99 = depth;
+		stat->depth_max = depth;
+	}
 }
 
 /**
@@ -1389,11 +2669,12 @@ static int
 iproto_do_bind(struct cbus_call_msg *m)
 {
 	const char *uri  = ((struct iproto_bind_msg *) m)->uri;
+	struct evio_service *binary = &iproto_threads[0].binary;
 	try {
-		if (evio_service_is_active(&binary))
-			evio_service_stop(&binary);
+		if (evio_service_is_active(binary))
+			evio_service_stop(binary);
 		if (uri != NULL)
-			evio_service_bind(&binary, uri);
+			evio_service_bind(binary, uri);
 	} catch (Exception *e) {
 		return -1;
 	}
@@ -1404,9 +2685,10 @@ static int
 iproto_do_listen(struct cbus_call_msg *m)
 {
 	(void) m;
+	struct evio_service *binary = &iproto_threads[0].binary;
 	try {
-		if (evio_service_is_active(&binary))
-			evio_service_listen(&binary);
+		if (evio_service_is_active(binary))
+			evio_service_listen(binary);
 	} catch (Exception *e) {
 		return -1;
 	}
@@ -1418,8 +2700,10 @@ iproto_bind(const char *uri)
 {
 	static struct iproto_bind_msg m;
 	m.uri = uri;
-	if (cbus_call(&net_pipe, &tx_pipe, &m, iproto_do_bind,
-		      NULL, TIMEOUT_INFINITY))
+	/* Only the acceptor thread listens on the socket. */
+	struct iproto_thread *acceptor = &iproto_threads[0];
+	if (cbus_call(&acceptor->net_pipe, &acceptor->tx_pipe, &m,
+		      iproto_do_bind, NULL, TIMEOUT_INFINITY))
 		diag_raise();
 }
 
@@ -1428,8 +2712,9 @@ iproto_listen()
 {
 	/* Declare static to avoid stack corruption on fiber cancel. */
 	static struct cbus_call_msg m;
-	if (cbus_call(&net_pipe, &tx_pipe, &m, iproto_do_listen,
-		      NULL, TIMEOUT_INFINITY))
+	struct iproto_thread *acceptor = &iproto_threads[0];
+	if (cbus_call(&acceptor->net_pipe, &acceptor->tx_pipe, &m,
+		      iproto_do_listen, NULL, TIMEOUT_INFINITY))
 		diag_raise();
 }
 
@@ -30,8 +30,91 @@
  * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  */
+#include "rmean.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * Invoke a callback for each network statistics counter,
+ * summed up over all iproto threads.
+ */
+int
+iproto_rmean_foreach(rmean_cb cb, void *cb_ctx);
+
+/** Stages of request processing, for latency statistics. */
+enum iproto_latency_stage {
+	/** From reading the request to queueing the reply. */
+	IPROTO_LATENCY_TOTAL,
+	/** Waiting in the queue to the tx thread. */
+	IPROTO_LATENCY_NET,
+	/** Execution in the tx thread, except for WAL writes. */
+	IPROTO_LATENCY_TX,
+	/** Waiting for WAL writes. */
+	IPROTO_LATENCY_WAL,
+	/** Waiting in the queue back to the network thread. */
+	IPROTO_LATENCY_REPLY,
+	iproto_latency_stage_MAX
+};
+
+extern const char *iproto_latency_stage_strs[];
+
+/** Latency percentiles of a request processing stage. */
+struct iproto_latency_stat {
+	/** Median, in seconds. */
+	double p50;
+	/** 99th percentile, in seconds. */
+	double p99;
+	/** 99.9th percentile, in seconds. */
+	double p999;
+};
+
+typedef int
+(*iproto_latency_cb)(const char *name, int64_t count,
+		     const struct iproto_latency_stat *stages, void *cb_ctx);
+
+/**
+ * Invoke a callback for each request type with the number
+ * of processed requests of this type and latency percentiles
+ * of each processing stage, indexed by enum
+ * iproto_latency_stage, summed up over all iproto threads.
+ */
+int
+iproto_latency_foreach(iproto_latency_cb cb, void *cb_ctx);
+
+/** Statistics of requests waiting to be processed. */
+struct iproto_queue_stat {
+	/** Requests being processed in tx. */
+	int64_t in_progress;
+	/** Requests waiting in connection queues. */
+	int64_t queued;
+	/** Connections with waiting requests. */
+	int64_t connections;
+	/** Median of the queue depth of those connections. */
+	int64_t depth_p50;
+	/** 99th percentile of the queue depth. */
+	int64_t depth_p99;
+	/** The deepest connection queue. */
+	int64_t depth_max;
+};
+
+/**
+ * Fill request queue statistics, summed up over all iproto
+ * threads.
+ */
+void
+iproto_queue_stat(struct iproto_queue_stat *stat);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+
+/**
+ * Initialize the iproto subsystem and start
+ * the given number of network io threads.
+ */
 void
-iproto_init();
+iproto_init(int threads_count);
 
 void
 iproto_bind(const char *uri);
@@ -39,4 +122,6 @@ iproto_bind(const char *uri);
 void
 iproto_listen();
 
+#endif /* defined(__cplusplus) */
+
 #endif
@@ -66,6 +66,11 @@ enum iproto_key {
 	IPROTO_OFFSET = 0x13,
 	IPROTO_ITERATOR = 0x14,
 	IPROTO_INDEX_BASE = 0x15,
+	/**
+	 * Max number of tuples in a chunk of a streamed
+	 * SELECT or CALL reply, see IPROTO_CHUNK.
+	 */
+	IPROTO_CHUNK_SIZE = 0x16,
 
 	/* Leave a gap between integer values and other keys */
 	IPROTO_KEY = 0x20,
@@ -112,6 +117,8 @@ enum iproto_key {
 	 */
 	IPROTO_SQL_INFO = 0x43,
 	IPROTO_SQL_ROW_COUNT = 0x44,
+	/** Id of a statement compiled by IPROTO_PREPARE. */
+	IPROTO_STMT_ID = 0x45,
 	IPROTO_KEY_MAX
 };
 
@@ -121,7 +128,8 @@ enum iproto_key {
 			  bit(LSN) | bit(SCHEMA_VERSION))
 #define IPROTO_DML_BODY_BMAP (bit(SPACE_ID) | bit(INDEX_ID) | bit(LIMIT) |\
 			      bit(OFFSET) | bit(ITERATOR) | bit(INDEX_BASE) |\
-			      bit(KEY) | bit(TUPLE) | bit(OPS))
+			      bit(KEY) | bit(TUPLE) | bit(OPS) |\
+			      bit(CHUNK_SIZE))
 
 static inline bool
 xrow_header_has_key(const char *pos, const char *end)
@@ -176,6 +184,8 @@ enum iproto_type {
 	IPROTO_CALL = 10,
 	/** Execute an SQL statement. */
 	IPROTO_EXECUTE = 11,
+	/** Compile an SQL statement and return its id. */
+	IPROTO_PREPARE = 12,
 	/** The maximum typecode used for box.stat() */
 	IPROTO_TYPE_STAT_MAX,
 
@@ -185,6 +195,22 @@ enum iproto_type {
 	IPROTO_JOIN = 65,
 	/** Replication SUBSCRIBE command */
 	IPROTO_SUBSCRIBE = 66,
+	/**
+	 * Acknowledgement of a chunk of a streamed reply, see
+	 * IPROTO_CHUNK, consumed by the client. Has the sync of
+	 * the streamed request and is not replied. The server
+	 * sends a limited number of chunks ahead of them.
+	 */
+	IPROTO_CHUNK_ACK = 67,
+
+	/**
+	 * A part of a streamed reply. A SELECT or CALL request
+	 * with IPROTO_CHUNK_SIZE set is replied with a series
+	 * of chunks, each having IPROTO_DATA with at most that
+	 * many tuples, followed by the usual IPROTO_OK reply
+	 * with the rest of the data, or by an error.
+	 */
+	IPROTO_CHUNK = 128,
 
 	/** Vinyl run info stored in .index file */
 	VY_INDEX_RUN_INFO = 100,
@@ -219,6 +245,10 @@ iproto_type_name(uint32_t type)
 		return "PAGEINFO";
 	case VY_RUN_ROW_INDEX:
 		return "ROWINDEX";
+	case IPROTO_CHUNK:
+		return "CHUNK";
+	case IPROTO_CHUNK_ACK:
+		return "CHUNK_ACK";
 	default:
 		return NULL;
 	}
@@ -320,6 +350,8 @@ enum vy_run_info_key {
 	VY_RUN_INFO_PAGE_COUNT = 5,
 	/** Bloom filter for keys. */
 	VY_RUN_INFO_BLOOM = 6,
+	/** Bloom filters for key prefixes. */
+	VY_RUN_INFO_PREFIX_BLOOM = 7,
 	/** The last key in this enum + 1 */
 	VY_RUN_INFO_KEY_MAX
 };
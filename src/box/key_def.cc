@@ -208,6 +208,14 @@ key_part_check_compatibility(const struct key_part *old_parts,
 			return false;
 		if (old_part->coll != new_part->coll)
 			return false;
+		/*
+		 * A collation is used only for string parts, both
+		 * by comparators and by tree hints.
+		 */
+		if (old_part->coll != NULL &&
+		    (old_part->type == FIELD_TYPE_STRING) !=
+		    (new_part->type == FIELD_TYPE_STRING))
+			return false;
 		if (old_part->is_nullable != new_part->is_nullable)
 			return false;
 	}
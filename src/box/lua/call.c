@@ -250,8 +250,69 @@ struct lua_function_ctx {
 	struct obuf_svp svp;
 	/* true if `out' was changed and `svp' can be used for rollback  */
 	bool out_is_dirty;
+	/** Sink of a streamed CALL reply or NULL. */
+	struct call_stream *stream;
 };
 
+/**
+ * Stream the values returned by a CALL in chunks. The members
+ * of the only array returned are streamed rather than the
+ * array itself, so that a large result doesn't end up in a
+ * single chunk. A map is sent as a single item. The last chunk
+ * goes as the reply itself.
+ */
+static int
+luamp_encode_call_stream(lua_State *L, struct lua_function_ctx *ctx)
+{
+	struct call_request *request = ctx->request;
+	struct call_stream *call_stream = ctx->stream;
+	struct obuf *out = ctx->out;
+	struct obuf_svp *svp = &ctx->svp;
+	struct luaL_serializer *cfg = luaL_msgpack_default;
+	int top = lua_gettop(L);
+	uint32_t count = top;
+	bool is_array = false;
+	if (top == 1 && lua_type(L, 1) == LUA_TTABLE) {
+		struct luaL_field root;
+		luaL_tofield(L, cfg, 1, &root);
+		if (root.type == MP_ARRAY) {
+			is_array = true;
+			count = root.size;
+		}
+	}
+	uint32_t i = 0;
+	while (true) {
+		uint32_t n = MIN(count - i, call_stream->chunk_size);
+		if (iproto_prepare_select(out, svp) != 0)
+			luaT_error(L);
+		ctx->out_is_dirty = true;
+		struct mpstream stream;
+		mpstream_init(&stream, out, obuf_reserve_cb, obuf_alloc_cb,
+			      luamp_error, L);
+		for (uint32_t end = i + n; i < end; i++) {
+			if (is_array) {
+				lua_rawgeti(L, 1, i + 1);
+				luamp_encode(L, cfg, &stream, -1);
+				lua_pop(L, 1);
+			} else {
+				luamp_encode(L, cfg, &stream, i + 1);
+			}
+		}
+		mpstream_flush(&stream);
+		if (i == count) {
+			iproto_reply_select(out, svp, request->header->sync,
+					    schema_version, n);
+			return 0;
+		}
+		iproto_reply_chunk(out, svp, request->header->sync,
+				   schema_version, n);
+		/* The chunk can't be rolled back once flushed. */
+		ctx->out_is_dirty = false;
+		if (call_stream->flush(call_stream) != 0)
+			luaT_error(L);
+	}
+}
+
 /**
  * Invoke a Lua stored procedure from the binary protocol
  * (implementation of 'CALL' command code).
@@ -283,6 +344,9 @@ execute_lua_call(lua_State *L)
 		luamp_decode(L, luaL_msgpack_default, &args);
 	lua_call(L, arg_count + oc - 1, LUA_MULTRET);
 
+	if (ctx->stream != NULL && request->header->type == IPROTO_CALL)
+		return luamp_encode_call_stream(L, ctx);
+
 	/**
 	 * Add all elements from Lua stack to iproto.
 	 *
@@ -377,9 +441,11 @@ execute_lua_eval(lua_State *L)
 }
 
 static inline int
-box_process_lua(struct call_request *request, struct obuf *out, lua_CFunction handler)
+box_process_lua(struct call_request *request, struct obuf *out,
+		struct call_stream *stream, lua_CFunction handler)
 {
-	struct lua_function_ctx ctx = { request, out, {0, 0, 0}, false };
+	struct lua_function_ctx ctx = { request, out, {0, 0, 0}, false,
+					stream };
 
 	lua_State *L = lua_newthread(tarantool_L);
 	int coro_ref = luaL_ref(tarantool_L, LUA_REGISTRYINDEX);
@@ -404,15 +470,16 @@ box_process_lua(struct call_request *request, struct obuf *out, lua_CFunction ha
 }
 
 int
-box_lua_call(struct call_request *request, struct obuf *out)
+box_lua_call(struct call_request *request, struct obuf *out,
+	     struct call_stream *stream)
 {
-	return box_process_lua(request, out, execute_lua_call);
+	return box_process_lua(request, out, stream, execute_lua_call);
 }
 
 int
 box_lua_eval(struct call_request *request, struct obuf *out)
 {
-	return box_process_lua(request, out, execute_lua_eval);
+	return box_process_lua(request, out, NULL, execute_lua_eval);
 }
 
 static int
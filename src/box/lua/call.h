@@ -44,6 +44,7 @@ void
 box_lua_call_init(struct lua_State *L);
 
 struct call_request;
+struct call_stream;
 struct obuf;
 
 /**
@@ -51,7 +52,8 @@ struct obuf;
  * (implementation of 'CALL' command code).
  */
 int
-box_lua_call(struct call_request *request, struct obuf *out);
+box_lua_call(struct call_request *request, struct obuf *out,
+	     struct call_stream *stream);
 
 int
 box_lua_eval(struct call_request *request, struct obuf *out);
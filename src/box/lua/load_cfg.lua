@@ -12,6 +12,8 @@ local default_cfg = {
     memtx_memory        = 256 * 1024 *1024,
     memtx_min_tuple_size = 16,
     memtx_max_tuple_size = 1024 * 1024,
+    memtx_checkpoint_deltas = 0,
+    memtx_checkpoint_threads = 1,
     slab_alloc_factor   = 1.05,
     work_dir            = nil,
     memtx_dir           = ".",
@@ -20,6 +22,8 @@ local default_cfg = {
     vinyl_dir           = '.',
     vinyl_memory        = 128 * 1024 * 1024,
     vinyl_cache         = 128 * 1024 * 1024,
+    vinyl_page_cache    = 128 * 1024 * 1024,
+    vinyl_dict_size     = 0,
     vinyl_max_tuple_size = 1024 * 1024,
     vinyl_read_threads  = 1,
     vinyl_write_threads = 2,
@@ -35,11 +39,16 @@ local default_cfg = {
     log_format          = "plain",
     io_collect_interval = nil,
     readahead           = 16320,
+    iproto_threads      = 1,
     snap_io_rate_limit  = nil, -- no limit
     too_long_threshold  = 0.5,
     wal_mode            = "write",
     rows_per_wal        = 500000,
     wal_max_size        = 256 * 1024 * 1024,
+    wal_tail_size       = 16 * 1024 * 1024,
+    wal_prealloc        = false,
+    wal_commit_delay    = 0,
+    wal_commit_siblings = 5,
     wal_dir_rescan_delay= 2,
     force_recovery      = false,
     replication         = nil,
@@ -63,6 +72,8 @@ local template_cfg = {
     memtx_memory        = 'number',
     memtx_min_tuple_size  = 'number',
     memtx_max_tuple_size  = 'number',
+    memtx_checkpoint_deltas = 'number',
+    memtx_checkpoint_threads = 'number',
     slab_alloc_factor   = 'number',
     work_dir            = 'string',
     memtx_dir            = 'string',
@@ -70,6 +81,8 @@ local template_cfg = {
     vinyl_dir           = 'string',
     vinyl_memory        = 'number',
     vinyl_cache               = 'number',
+    vinyl_page_cache          = 'number',
+    vinyl_dict_size           = 'number',
     vinyl_max_tuple_size      = 'number',
     vinyl_read_threads        = 'number',
     vinyl_write_threads       = 'number',
@@ -86,11 +99,16 @@ local template_cfg = {
     log_format          = 'string',
     io_collect_interval = 'number',
     readahead           = 'number',
+    iproto_threads      = 'number',
     snap_io_rate_limit  = 'number',
     too_long_threshold  = 'number',
     wal_mode            = 'string',
     rows_per_wal        = 'number',
     wal_max_size        = 'number',
+    wal_tail_size       = 'number',
+    wal_prealloc        = 'boolean',
+    wal_commit_delay    = 'number',
+    wal_commit_siblings = 'number',
     wal_dir_rescan_delay= 'number',
     force_recovery      = 'boolean',
     replication         = 'string, number, table',
@@ -159,8 +177,12 @@ local dynamic_cfg = {
     snap_io_rate_limit      = private.cfg_set_snap_io_rate_limit,
     read_only               = private.cfg_set_read_only,
     memtx_max_tuple_size    = private.cfg_set_memtx_max_tuple_size,
+    memtx_checkpoint_deltas = private.cfg_set_memtx_checkpoint_deltas,
+    memtx_checkpoint_threads = private.cfg_set_memtx_checkpoint_threads,
     vinyl_max_tuple_size    = private.cfg_set_vinyl_max_tuple_size,
     vinyl_timeout           = private.cfg_set_vinyl_timeout,
+    vinyl_page_cache        = private.cfg_set_vinyl_page_cache,
+    vinyl_dict_size         = private.cfg_set_vinyl_dict_size,
     checkpoint_count        = private.cfg_set_checkpoint_count,
     checkpoint_interval     = private.checkpoint_daemon.set_checkpoint_interval,
     worker_pool_threads     = private.cfg_set_worker_pool_threads,
@@ -171,6 +193,8 @@ local dynamic_cfg = {
     end,
     force_recovery          = function() end,
     replication_timeout     = private.cfg_set_replication_timeout,
+    wal_commit_delay        = private.cfg_set_wal_commit_delay,
+    wal_commit_siblings     = private.cfg_set_wal_commit_siblings,
 }
 
 local dynamic_cfg_skip_at_load = {
@@ -181,6 +205,8 @@ local dynamic_cfg_skip_at_load = {
     wal_dir_rescan_delay    = true,
     custom_proc_title       = true,
     force_recovery          = true,
+    memtx_checkpoint_deltas = true,
+    memtx_checkpoint_threads = true,
 }
 
 local function convert_gb(size)
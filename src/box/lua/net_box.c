@@ -121,6 +121,19 @@ netbox_encode_ping(lua_State *L)
 	return 0;
 }
 
+static int
+netbox_encode_chunk_ack(lua_State *L)
+{
+	if (lua_gettop(L) < 3)
+		return luaL_error(L, "Usage: netbox.encode_chunk_ack(ibuf, "
+				  "sync, schema_version)");
+
+	struct mpstream stream;
+	size_t svp = netbox_prepare_request(L, &stream, IPROTO_CHUNK_ACK);
+	netbox_encode_request(&stream, svp);
+	return 0;
+}
+
 static int
 netbox_encode_auth(lua_State *L)
 {
@@ -167,7 +180,8 @@ netbox_encode_call_impl(lua_State *L, enum iproto_type type)
 	struct mpstream stream;
 	size_t svp = netbox_prepare_request(L, &stream, type);
 
-	luamp_encode_map(cfg, &stream, 2);
+	uint32_t chunk_size = lua_gettop(L) >= 6 ? lua_tonumber(L, 6) : 0;
+	luamp_encode_map(cfg, &stream, chunk_size != 0 ? 3 : 2);
 
 	/* encode proc name */
 	size_t name_len;
@@ -179,6 +193,12 @@ netbox_encode_call_impl(lua_State *L, enum iproto_type type)
 	luamp_encode_uint(cfg, &stream, IPROTO_TUPLE);
 	luamp_encode_tuple(L, cfg, &stream, 5);
 
+	/* encode chunk size of a streamed reply */
+	if (chunk_size != 0) {
+		luamp_encode_uint(cfg, &stream, IPROTO_CHUNK_SIZE);
+		luamp_encode_uint(cfg, &stream, chunk_size);
+	}
+
 	netbox_encode_request(&stream, svp);
 	return 0;
 }
@@ -227,12 +247,13 @@ netbox_encode_select(lua_State *L)
 	if (lua_gettop(L) < 9)
 		return luaL_error(L, "Usage netbox.encode_select(ibuf, sync, "
 				  "schema_version, space_id, index_id, iterator, "
-				  "offset, limit, key)");
+				  "offset, limit, key[, chunk_size])");
 
 	struct mpstream stream;
 	size_t svp = netbox_prepare_request(L, &stream, IPROTO_SELECT);
 
-	luamp_encode_map(cfg, &stream, 6);
+	uint32_t chunk_size = lua_gettop(L) >= 10 ? lua_tonumber(L, 10) : 0;
+	luamp_encode_map(cfg, &stream, chunk_size != 0 ? 7 : 6);
 
 	uint32_t space_id = lua_tonumber(L, 4);
 	uint32_t index_id = lua_tonumber(L, 5);
@@ -264,6 +285,12 @@ netbox_encode_select(lua_State *L)
 	luamp_encode_uint(cfg, &stream, IPROTO_KEY);
 	luamp_convert_key(L, cfg, &stream, 9);
 
+	/* encode chunk size of a streamed reply */
+	if (chunk_size != 0) {
+		luamp_encode_uint(cfg, &stream, IPROTO_CHUNK_SIZE);
+		luamp_encode_uint(cfg, &stream, chunk_size);
+	}
+
 	netbox_encode_request(&stream, svp);
 	return 0;
 }
@@ -566,10 +593,18 @@ netbox_encode_execute(lua_State *L)
 
 	luamp_encode_map(cfg, &stream, 3);
 
-	size_t len;
-	const char *query = lua_tolstring(L, 4, &len);
-	luamp_encode_uint(cfg, &stream, IPROTO_SQL_TEXT);
-	luamp_encode_str(cfg, &stream, query, len);
+	if (lua_istable(L, 4)) {
+		/* A statement compiled by PREPARE. */
+		lua_getfield(L, 4, "stmt_id");
+		luamp_encode_uint(cfg, &stream, IPROTO_STMT_ID);
+		luamp_encode_uint(cfg, &stream, lua_tointeger(L, -1));
+		lua_pop(L, 1);
+	} else {
+		size_t len;
+		const char *query = lua_tolstring(L, 4, &len);
+		luamp_encode_uint(cfg, &stream, IPROTO_SQL_TEXT);
+		luamp_encode_str(cfg, &stream, query, len);
+	}
 
 	luamp_encode_uint(cfg, &stream, IPROTO_SQL_BIND);
 	luamp_encode_tuple(L, cfg, &stream, 5);
@@ -581,6 +616,26 @@ netbox_encode_execute(lua_State *L)
 	return 0;
 }
 
+static int
+netbox_encode_prepare(lua_State *L)
+{
+	if (lua_gettop(L) < 4)
+		return luaL_error(L, "Usage: netbox.encode_prepare(ibuf, "\
+				  "sync, schema_version, query)");
+	struct mpstream stream;
+	size_t svp = netbox_prepare_request(L, &stream, IPROTO_PREPARE);
+
+	luamp_encode_map(cfg, &stream, 1);
+
+	size_t len;
+	const char *query = lua_tolstring(L, 4, &len);
+	luamp_encode_uint(cfg, &stream, IPROTO_SQL_TEXT);
+	luamp_encode_str(cfg, &stream, query, len);
+
+	netbox_encode_request(&stream, svp);
+	return 0;
+}
+
 int
 luaopen_net_box(struct lua_State *L)
 {
@@ -596,7 +651,9 @@ luaopen_net_box(struct lua_State *L)
 		{ "encode_update",  netbox_encode_update },
 		{ "encode_upsert",  netbox_encode_upsert },
 		{ "encode_execute", netbox_encode_execute},
+		{ "encode_prepare", netbox_encode_prepare},
 		{ "encode_auth",    netbox_encode_auth },
+		{ "encode_chunk_ack", netbox_encode_chunk_ack },
 		{ "decode_greeting",netbox_decode_greeting },
 		{ "communicate",    netbox_communicate },
 		{ NULL, NULL}
@@ -39,10 +39,13 @@ local IPROTO_SCHEMA_VERSION_KEY = 0x05
 local IPROTO_METADATA_KEY = 0x32
 local IPROTO_SQL_INFO_KEY = 0x43
 local IPROTO_SQL_ROW_COUNT_KEY = 0x44
+local IPROTO_STMT_ID_KEY = 0x45
 local IPROTO_FIELD_NAME_KEY = 0x29
 local IPROTO_DATA_KEY      = 0x30
 local IPROTO_ERROR_KEY     = 0x31
 local IPROTO_GREETING_SIZE = 128
+local IPROTO_CHUNK         = 128
+local DEFAULT_CHUNK_SIZE   = 512
 
 -- select errors from box.error
 local E_UNKNOWN              = box.error.UNKNOWN
@@ -65,6 +68,7 @@ local method_codec           = {
     upsert  = internal.encode_upsert,
     select  = internal.encode_select,
     execute = internal.encode_execute,
+    prepare = internal.encode_prepare,
     -- inject raw data into connection, used by console and tests
     inject = function(buf, id, schema_version, bytes)
         local ptr = buf:reserve(#bytes)
@@ -147,6 +151,9 @@ local function create_transport(host, port, user, password, callback)
     -- the client reports E_TIMEOUT.
     local requests         = setmetatable({}, { __mode = 'v' })
     local next_request_id  = 1
+    -- ids of streamed requests which iterators are abandoned,
+    -- their chunks are acknowledged and dropped as they arrive.
+    local aborted_streams  = {}
 
     local worker_fiber
     local connection
@@ -167,6 +174,7 @@ local function create_transport(host, port, user, password, callback)
             if not schema_version or state ~= 'fetch_schema' then
                 schema_version = -1
             end
+            aborted_streams = {}
             local next_id, next_request = next(requests)
             while next_id do
                 local id, request = next_id, next_request
@@ -237,10 +245,10 @@ local function create_transport(host, port, user, password, callback)
         local id = next_request_id
         method_codec[method](send_buf, id, schema_version, ...)
         next_request_id = next_id(id)
-        -- reserve space for 8 keys: client, method,
+        -- reserve space for 9 keys: client, method,
         -- schema_version, buffer, errno, response, metadata,
-        -- sql_info.
-        local request = table_new(0, 8)
+        -- sql_info, stmt_id.
+        local request = table_new(0, 9)
         request.client = fiber_self()
         request.method = method
         request.schema_version = schema_version
@@ -253,7 +261,85 @@ local function create_transport(host, port, user, password, callback)
                 return E_TIMEOUT, 'Timeout exceeded'
             end
         until requests[id] == nil -- i.e. completed (beware spurious wakeups)
-        return request.errno, request.response, request.metadata, request.info
+        return request.errno, request.response, request.metadata,
+               request.info, request.stmt_id
+    end
+
+    -- Send a request which reply is streamed in IPROTO_CHUNK
+    -- packets. Returns the request object to be passed to
+    -- wait_chunk() or nil, errno, error.
+    local function perform_stream_request(method, schema_version, ...)
+        if state ~= 'active' then
+            return nil, last_errno or E_NO_CONNECTION, last_error
+        end
+        if send_buf:size() == 0 then
+            worker_fiber:wakeup()
+        end
+        local id = next_request_id
+        method_codec[method](send_buf, id, schema_version, ...)
+        next_request_id = next_id(id)
+        local request = table_new(0, 7)
+        request.id = id
+        request.client = fiber_self()
+        request.method = method
+        request.schema_version = schema_version
+        request.chunks = {}
+        requests[id] = request
+        return request
+    end
+
+    -- Tell the server a chunk of a streamed reply is consumed,
+    -- so that it may send one more.
+    local function send_chunk_ack(id)
+        if worker_fiber == nil then
+            return
+        end
+        if send_buf:size() == 0 and worker_fiber ~= fiber_self() then
+            worker_fiber:wakeup()
+        end
+        internal.encode_chunk_ack(send_buf, id, nil)
+    end
+
+    -- Forget a streamed request which iterator timed out or was
+    -- abandoned. The server waits for the chunks to be
+    -- acknowledged, so ack the buffered ones and the rest as
+    -- they arrive.
+    local function abort_stream(request)
+        local id = request.id
+        if requests[id] == request then
+            requests[id] = nil
+            aborted_streams[id] = true
+            for _ = 1, #request.chunks do
+                send_chunk_ack(id)
+            end
+        end
+        request.chunks = {}
+    end
+
+    -- Wait for the next chunk of a streamed reply. The final
+    -- response is returned as the last chunk, then nil.
+    local function wait_chunk(request, timeout)
+        local deadline = fiber_clock() + (timeout or TIMEOUT_INFINITY)
+        request.client = fiber_self()
+        while request.chunks[1] == nil and requests[request.id] == request do
+            if not state_cond:wait(max(0, deadline - fiber_clock())) then
+                abort_stream(request)
+                return E_TIMEOUT, 'Timeout exceeded'
+            end
+        end
+        if request.chunks[1] ~= nil then
+            local chunk = table.remove(request.chunks, 1)
+            if requests[request.id] == request then
+                send_chunk_ack(request.id)
+            end
+            return nil, chunk
+        end
+        if request.errno then
+            return request.errno, request.response
+        end
+        local response = request.response
+        request.response = nil
+        return nil, response
     end
 
     local function wakeup_client(client)
@@ -265,13 +351,34 @@ local function create_transport(host, port, user, password, callback)
     local function dispatch_response_iproto(hdr, body_rpos, body_end)
         local id = hdr[IPROTO_SYNC_KEY]
         local request = requests[id]
+        local status = hdr[IPROTO_STATUS_KEY]
         if request == nil then -- nobody is waiting for the response
+            if aborted_streams[id] then
+                if status == IPROTO_CHUNK then
+                    send_chunk_ack(id)
+                else
+                    aborted_streams[id] = nil
+                end
+            end
             return
         end
-        requests[id] = nil
-        local status = hdr[IPROTO_STATUS_KEY]
         local body, body_end_check
 
+        if status == IPROTO_CHUNK then
+            -- A part of a streamed reply, the request stays in
+            -- flight. Chunks are never waited for here: the
+            -- server doesn't send more than a few of them ahead
+            -- of acknowledgements, see wait_chunk().
+            if request.chunks ~= nil then
+                body_end_check, body = ibuf_decode(body_rpos)
+                assert(body_end == body_end_check, "invalid xrow length")
+                table.insert(request.chunks, body[IPROTO_DATA_KEY])
+                wakeup_client(request.client)
+            end
+            return
+        end
+        requests[id] = nil
+
         if status ~= 0 then
             -- Handle errors
             body_end_check, body = ibuf_decode(body_rpos)
@@ -299,6 +406,7 @@ local function create_transport(host, port, user, password, callback)
         request.response = body[IPROTO_DATA_KEY]
         request.metadata = body[IPROTO_METADATA_KEY]
         request.info = body[IPROTO_SQL_INFO_KEY]
+        request.stmt_id = body[IPROTO_STMT_ID_KEY]
         wakeup_client(request.client)
     end
 
@@ -517,7 +625,10 @@ local function create_transport(host, port, user, password, callback)
         close           = close,
         connect         = connect,
         wait_state      = wait_state,
-        perform_request = perform_request
+        perform_request = perform_request,
+        perform_stream_request = perform_stream_request,
+        wait_chunk      = wait_chunk,
+        abort_stream    = abort_stream
     }
 end
 
@@ -753,6 +864,66 @@ function remote_methods:_request(method, opts, ...)
     box.error({code = err, reason = res})
 end
 
+-- Send a request with a streamed reply and return an iterator
+-- over its items: for _, item in remote:_stream(...) do ... end.
+-- Items are fetched from the server in chunks of opts.chunk_size.
+function remote_methods:_stream(method, opts, ...)
+    local transport = self._transport
+    local timeout = self:request_timeout(opts)
+    local deadline = timeout and fiber_clock() + timeout
+    local args, nargs = {...}, select('#', ...)
+    local request
+    local function send()
+        if self.state ~= 'active' then
+            transport.wait_state('active', deadline and
+                                 max(0, deadline - fiber_clock()))
+        end
+        local err, msg
+        request, err, msg = transport.perform_stream_request(method,
+            self.schema_version, unpack(args, 1, nargs))
+        if request == nil then
+            box.error({code = err, reason = msg})
+        end
+    end
+    send()
+    -- Let the worker go on if the iterator is abandoned.
+    local gc_hook = ffi.gc(ffi.new('char[1]'), function()
+        transport.abort_stream(request)
+    end)
+    local wait_chunk = transport.wait_chunk
+    local postproc = method ~= 'call_17'
+    local tnew = box.tuple.new
+    local chunk, pos, count = {}, 0, 0
+    return function()
+        local _ = gc_hook -- the hook lives as long as the iterator
+        while chunk ~= nil and pos == #chunk do
+            local err, res
+            timeout = deadline and max(0, deadline - fiber_clock())
+            err, res = wait_chunk(request, timeout)
+            if err == E_WRONG_SCHEMA_VERSION and count == 0 then
+                -- Nothing was streamed yet, retry with the
+                -- reloaded schema like _request() does.
+                send()
+                res = {}
+            elseif err then
+                chunk = nil
+                box.error({code = err, reason = res})
+            end
+            chunk, pos = res, 0
+        end
+        if chunk == nil then
+            return nil
+        end
+        pos = pos + 1
+        count = count + 1
+        local item = chunk[pos]
+        if postproc then
+            item = tnew(item)
+        end
+        return count, item
+    end
+end
+
 function remote_methods:ping(opts)
     check_remote_arg(self, 'ping')
     local timeout = self:request_timeout(opts)
@@ -784,6 +955,19 @@ function remote_methods:call(func_name, args, opts)
     return unpack(res)
 end
 
+-- Call a function and iterate over its results as the server
+-- streams them: the members of a single returned table or the
+-- returned values otherwise.
+function remote_methods:call_stream(func_name, args, opts)
+    check_remote_arg(self, 'call_stream')
+    check_call_args(args)
+    args = args or {}
+    local chunk_size = tonumber(opts and opts.chunk_size) or
+                       DEFAULT_CHUNK_SIZE
+    return self:_stream('call_17', opts, tostring(func_name), args,
+                        chunk_size)
+end
+
 -- @deprecated since 1.7.4
 function remote_methods:eval_16(code, ...)
     check_remote_arg(self, 'eval')
@@ -834,6 +1018,26 @@ function remote_methods:execute(query, parameters, sql_opts, netbox_opts)
     return {metadata = metadata, rows = res}
 end
 
+function remote_methods:prepare(query, netbox_opts)
+    check_remote_arg(self, "prepare")
+    local timeout = self:request_timeout(netbox_opts)
+    local err, res, metadata, info, stmt_id =
+        self._transport.perform_request(timeout, nil, 'prepare',
+                                        self.schema_version, query)
+    if err then
+        box.error({code = err, reason = res})
+    end
+    local result = {stmt_id = stmt_id}
+    if metadata ~= nil then
+        for i, field_meta in pairs(metadata) do
+            field_meta["name"] = field_meta[IPROTO_FIELD_NAME_KEY]
+            field_meta[IPROTO_FIELD_NAME_KEY] = nil
+        end
+        result.metadata = metadata
+    end
+    return result
+end
+
 function remote_methods:wait_state(state, timeout)
     check_remote_arg(self, 'wait_state')
     if timeout == nil then
@@ -1000,6 +1204,11 @@ space_metatable = function(remote)
         return check_primary_index(self):select(key, opts)
     end
 
+    function methods:pairs(key, opts)
+        check_space_arg(self, 'pairs')
+        return check_primary_index(self):pairs(key, opts)
+    end
+
     function methods:delete(key, opts)
         check_space_arg(self, 'delete')
         return check_primary_index(self):delete(key, opts)
@@ -1046,6 +1255,19 @@ index_metatable = function(remote)
                                iterator, offset, limit, key)
     end
 
+    function methods:pairs(key, opts)
+        check_index_arg(self, 'pairs')
+        local key_is_nil = (key == nil or
+                            (type(key) == 'table' and #key == 0))
+        local iterator = check_iterator_type(opts, key_is_nil)
+        local offset = tonumber(opts and opts.offset) or 0
+        local limit = tonumber(opts and opts.limit) or 0xFFFFFFFF
+        local chunk_size = tonumber(opts and opts.chunk_size) or
+                           DEFAULT_CHUNK_SIZE
+        return remote:_stream('select', opts, self.space.id, self.id,
+                              iterator, offset, limit, key, chunk_size)
+    end
+
     function methods:get(key, opts)
         check_index_arg(self, 'get')
         if opts and opts.buffer then
@@ -359,6 +359,7 @@ box.schema.space.create = function(name, options)
         user = 'string, number',
         format = 'table',
         temporary = 'boolean',
+        compress_threshold = 'number',
     }
     local options_defaults = {
         engine = 'memtx',
@@ -402,6 +403,7 @@ box.schema.space.create = function(name, options)
     -- filter out global parameters from the options array
     local space_options = setmap({
         temporary = options.temporary and true or nil,
+        compress_threshold = options.compress_threshold,
     })
     _space:insert{id, uid, name, options.engine, options.field_count,
         space_options, format}
@@ -607,6 +609,7 @@ local index_options = {
     range_size = 'number',
     page_size = 'number',
     bloom_fpr = 'number',
+    bloom_prefix = 'boolean',
 }
 
 --
@@ -698,6 +701,7 @@ box.schema.index.create = function(space_id, name, options)
             run_count_per_level = options.run_count_per_level,
             run_size_ratio = options.run_size_ratio,
             bloom_fpr = options.bloom_fpr,
+            bloom_prefix = options.bloom_prefix,
     }
     local field_type_aliases = {
         num = 'unsigned'; -- Deprecated since 1.7.2
@@ -1166,6 +1170,12 @@ function box.schema.space.bless(space)
         return internal.count(index.space_id, index.id, itype, key);
     end
 
+    -- number of tuples preceding the key
+    index_mt.rank = function(index, key)
+        check_index_arg(index, 'rank')
+        return index:count(key, {iterator = 'LT'})
+    end
+
     index_mt.get_ffi = function(index, key)
         check_index_arg(index, 'get')
         local key, key_end = tuple_encode(key)
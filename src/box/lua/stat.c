@@ -39,12 +39,12 @@
 #include <lualib.h>
 
 #include "lua/utils.h"
+#include "box/iproto.h"
 
 extern struct rmean *rmean_box;
 extern struct rmean *rmean_error;
-/** network statistics (iproto & cbus) */
-extern struct rmean *rmean_net;
 extern struct rmean *rmean_tx_wal_bus;
+extern struct rmean *rmean_wal;
 
 static void
 fill_stat_item(struct lua_State *L, int rps, int64_t total)
@@ -109,18 +109,181 @@ lbox_stat_call(struct lua_State *L)
 	return 1;
 }
 
+static void
+fill_net_requests(struct lua_State *L, const struct iproto_queue_stat *stat)
+{
+	lua_newtable(L);
+
+	lua_pushstring(L, "in_progress");
+	lua_pushnumber(L, stat->in_progress);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "queued");
+	lua_pushnumber(L, stat->queued);
+	lua_settable(L, -3);
+}
+
+static void
+fill_net_queue(struct lua_State *L, const struct iproto_queue_stat *stat)
+{
+	lua_newtable(L);
+
+	lua_pushstring(L, "connections");
+	lua_pushnumber(L, stat->connections);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "p50");
+	lua_pushnumber(L, stat->depth_p50);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "p99");
+	lua_pushnumber(L, stat->depth_p99);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "max");
+	lua_pushnumber(L, stat->depth_max);
+	lua_settable(L, -3);
+}
+
 static int
 lbox_stat_net_index(struct lua_State *L)
 {
-	luaL_checkstring(L, -1);
-	return rmean_foreach(rmean_net, seek_stat_item, L);
+	const char *name = luaL_checkstring(L, -1);
+	struct iproto_queue_stat stat;
+	if (strcmp(name, "REQUESTS") == 0) {
+		iproto_queue_stat(&stat);
+		fill_net_requests(L, &stat);
+		return 1;
+	}
+	if (strcmp(name, "QUEUE") == 0) {
+		iproto_queue_stat(&stat);
+		fill_net_queue(L, &stat);
+		return 1;
+	}
+	return iproto_rmean_foreach(seek_stat_item, L);
 }
 
 static int
 lbox_stat_net_call(struct lua_State *L)
 {
 	lua_newtable(L);
-	rmean_foreach(rmean_net, set_stat_item, L);
+	iproto_rmean_foreach(set_stat_item, L);
+
+	struct iproto_queue_stat stat;
+	iproto_queue_stat(&stat);
+
+	lua_pushstring(L, "REQUESTS");
+	fill_net_requests(L, &stat);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "QUEUE");
+	fill_net_queue(L, &stat);
+	lua_settable(L, -3);
+	return 1;
+}
+
+static int
+lbox_stat_wal_index(struct lua_State *L)
+{
+	luaL_checkstring(L, -1);
+	if (rmean_wal == NULL)
+		return 0;
+	return rmean_foreach(rmean_wal, seek_stat_item, L);
+}
+
+static int
+lbox_stat_wal_call(struct lua_State *L)
+{
+	lua_newtable(L);
+	if (rmean_wal != NULL)
+		rmean_foreach(rmean_wal, set_stat_item, L);
+	return 1;
+}
+
+static void
+fill_latency_stage(struct lua_State *L, const char *name,
+		   const struct iproto_latency_stat *stat)
+{
+	lua_pushstring(L, name);
+	lua_newtable(L);
+
+	lua_pushstring(L, "p50");
+	lua_pushnumber(L, stat->p50);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "p99");
+	lua_pushnumber(L, stat->p99);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "p999");
+	lua_pushnumber(L, stat->p999);
+	lua_settable(L, -3);
+
+	lua_settable(L, -3);
+}
+
+static void
+fill_latency_item(struct lua_State *L, int64_t count,
+		  const struct iproto_latency_stat *stages)
+{
+	lua_pushstring(L, "count");
+	lua_pushnumber(L, count);
+	lua_settable(L, -3);
+
+	for (int i = 0; i < iproto_latency_stage_MAX; i++)
+		fill_latency_stage(L, iproto_latency_stage_strs[i], &stages[i]);
+}
+
+static int
+set_latency_item(const char *name, int64_t count,
+		 const struct iproto_latency_stat *stages, void *cb_ctx)
+{
+	struct lua_State *L = (struct lua_State *) cb_ctx;
+
+	lua_pushstring(L, name);
+	lua_newtable(L);
+
+	fill_latency_item(L, count, stages);
+
+	lua_settable(L, -3);
+
+	return 0;
+}
+
+/**
+ * An iproto_latency_foreach() callback used to handle access
+ * to e.g. box.stat.latency.SELECT.
+ */
+static int
+seek_latency_item(const char *name, int64_t count,
+		  const struct iproto_latency_stat *stages, void *cb_ctx)
+{
+	struct lua_State *L = (struct lua_State *) cb_ctx;
+	if (strcmp(name, lua_tostring(L, -1)) != 0)
+		return 0;
+
+	lua_newtable(L);
+	fill_latency_item(L, count, stages);
+
+	return 1;
+}
+
+static int
+lbox_stat_latency_index(struct lua_State *L)
+{
+	luaL_checkstring(L, -1);
+	int rc = iproto_latency_foreach(seek_latency_item, L);
+	if (rc < 0)
+		return luaL_error(L, "out of memory");
+	return rc;
+}
+
+static int
+lbox_stat_latency_call(struct lua_State *L)
+{
+	lua_newtable(L);
+	if (iproto_latency_foreach(set_latency_item, L) < 0)
+		return luaL_error(L, "out of memory");
 	return 1;
 }
 
@@ -136,6 +299,18 @@ static const struct luaL_Reg lbox_stat_net_meta [] = {
 	{NULL, NULL}
 };
 
+static const struct luaL_Reg lbox_stat_wal_meta [] = {
+	{"__index", lbox_stat_wal_index},
+	{"__call",  lbox_stat_wal_call},
+	{NULL, NULL}
+};
+
+static const struct luaL_Reg lbox_stat_latency_meta [] = {
+	{"__index", lbox_stat_latency_index},
+	{"__call",  lbox_stat_latency_call},
+	{NULL, NULL}
+};
+
 /** Initialize box.stat package. */
 void
 box_lua_stat_init(struct lua_State *L)
@@ -158,5 +333,20 @@ box_lua_stat_init(struct lua_State *L)
 	luaL_register(L, NULL, lbox_stat_net_meta);
 	lua_setmetatable(L, -2);
 	lua_pop(L, 1); /* stat net module */
+
+	luaL_register_module(L, "box.stat.wal", statlib);
+
+	lua_newtable(L);
+	luaL_register(L, NULL, lbox_stat_wal_meta);
+	lua_setmetatable(L, -2);
+	lua_pop(L, 1); /* stat wal module */
+
+
+	luaL_register_module(L, "box.stat.latency", statlib);
+
+	lua_newtable(L);
+	luaL_register(L, NULL, lbox_stat_latency_meta);
+	lua_setmetatable(L, -2);
+	lua_pop(L, 1); /* stat latency module */
 }
 
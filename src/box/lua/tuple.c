@@ -254,7 +254,10 @@ tuple_to_mpstream(struct tuple *tuple, struct mpstream *stream)
 {
 	size_t bsize = box_tuple_bsize(tuple);
 	char *ptr = mpstream_reserve(stream, bsize);
-	box_tuple_to_buf(tuple, ptr, bsize);
+	if (box_tuple_to_buf(tuple, ptr, bsize) < 0) {
+		stream->error(stream->error_ctx);
+		return;
+	}
 	mpstream_advance(stream, bsize);
 }
 
@@ -107,7 +107,7 @@ local tuple_gc = function(tuple)
 end
 
 local tuple_bless = function(tuple)
-    -- overflow checked by tuple_bless() in C
+    -- overflow checked and compressed data pinned by tuple_bless() in C
     builtin.box_tuple_ref(tuple)
     -- must never fail:
     return ffi.gc(ffi.cast(const_tuple_ref_t, tuple), tuple_gc)
@@ -267,7 +267,9 @@ local function tuple_to_msgpack(buf, tuple)
     assert(ffi.istype(tuple_t, tuple))
     local bsize = builtin.box_tuple_bsize(tuple)
     buf:reserve(bsize)
-    builtin.box_tuple_to_buf(tuple, buf.wpos, bsize)
+    if builtin.box_tuple_to_buf(tuple, buf.wpos, bsize) < 0 then
+        return box.error()
+    end
     buf.wpos = buf.wpos + bsize
 end
 
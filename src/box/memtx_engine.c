@@ -33,6 +33,7 @@
 #include "memtx_tuple.h"
 
 #include <small/mempool.h>
+#include <unistd.h>
 
 #include "coio_file.h"
 #include "tuple.h"
@@ -45,6 +46,9 @@
 #include "replication.h"
 #include "schema.h"
 #include "gc.h"
+#include "cbus.h"
+#include "fiber_cond.h"
+#include "tt_pthread.h"
 
 /** For all memory used by all indexes.
  * If you decide to use memtx_index_arena or
@@ -75,6 +79,31 @@ txn_on_yield_or_stop(struct trigger *trigger, void *event)
 	txn_rollback(); /* doesn't throw */
 }
 
+/**
+ * Key of a tuple deleted since the last checkpoint. Written
+ * to the next delta checkpoint as a DELETE row.
+ */
+struct memtx_deleted_key {
+	/** Link in memtx_engine::deleted_keys. */
+	struct stailq_entry in_list;
+	/** Space the tuple was deleted from. */
+	uint32_t space_id;
+	/** Size of @data. */
+	uint32_t size;
+	/** Primary key of the tuple, MsgPack. */
+	char data[0];
+};
+
+/** Free keys deleted since a checkpoint. */
+static void
+memtx_deleted_keys_free(struct stailq *keys)
+{
+	struct memtx_deleted_key *key, *next;
+	stailq_foreach_entry_safe(key, next, keys, in_list)
+		free(key);
+	stailq_create(keys);
+}
+
 static int
 memtx_end_build_primary_key(struct space *space, void *param)
 {
@@ -88,17 +117,185 @@ memtx_end_build_primary_key(struct space *space, void *param)
 	return 0;
 }
 
+enum {
+	/** Max number of threads sorting secondary keys at recovery. */
+	MEMTX_BUILD_THREADS_MAX = 8,
+};
+
+/**
+ * Secondary tree keys are sorted in background threads, so
+ * that all indexes of all spaces are sorted in parallel.
+ * This structure represents such a thread.
+ */
+struct memtx_build_worker {
+	/** Thread that sorts build arrays. */
+	struct cord cord;
+	/** Pipe from tx to the worker thread. */
+	struct cpipe worker_pipe;
+	/** Pipe from the worker thread to tx. */
+	struct cpipe tx_pipe;
+	/** Task route: sort in the worker thread, complete in tx. */
+	struct cmsg_hop route[2];
+};
+
+/** Pool of threads building secondary keys at recovery. */
+struct memtx_build_pool {
+	/** Engine whose spaces are built. */
+	struct memtx_engine *memtx;
+	/** Worker threads, may be empty on a single core host. */
+	struct memtx_build_worker *workers;
+	/** Number of worker threads. */
+	int worker_count;
+	/** Worker to send the next task to. */
+	int next_worker;
+	/** Number of tasks sent to workers and not completed yet. */
+	int in_flight;
+	/** Signaled when a task is completed. */
+	struct fiber_cond cond;
+};
+
+/** Cbus task sorting the build array of a tree index. */
+struct memtx_build_task {
+	struct cmsg base;
+	struct memtx_build_pool *pool;
+	struct memtx_tree_index *index;
+};
+
+/** Build worker thread function. */
+static int
+memtx_build_worker_f(va_list ap)
+{
+	struct memtx_build_worker *worker =
+		va_arg(ap, struct memtx_build_worker *);
+	struct cbus_endpoint endpoint;
+
+	cpipe_create(&worker->tx_pipe, "tx_prio");
+	cbus_endpoint_create(&endpoint, cord_name(cord()),
+			     fiber_schedule_cb, fiber());
+	cbus_loop(&endpoint);
+	cbus_endpoint_destroy(&endpoint, cbus_process);
+	cpipe_destroy(&worker->tx_pipe);
+	return 0;
+}
+
+/** Sort the build array, called in a worker thread. */
+static void
+memtx_build_task_sort(struct cmsg *base)
+{
+	struct memtx_build_task *task = (struct memtx_build_task *)base;
+	memtx_tree_index_sort_build_array(task->index);
+}
+
+/** Complete a build task, called in tx. */
+static void
+memtx_build_task_complete(struct cmsg *base)
+{
+	struct memtx_build_task *task = (struct memtx_build_task *)base;
+	struct memtx_build_pool *pool = task->pool;
+	assert(pool->in_flight > 0);
+	pool->in_flight--;
+	fiber_cond_signal(&pool->cond);
+	free(task);
+}
+
+/** Start build worker threads, one per core. */
+static void
+memtx_build_pool_start(struct memtx_build_pool *pool,
+		       struct memtx_engine *memtx)
+{
+	memset(pool, 0, sizeof(*pool));
+	pool->memtx = memtx;
+	fiber_cond_create(&pool->cond);
+
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpu <= 1)
+		return;
+	int threads = MIN(ncpu, MEMTX_BUILD_THREADS_MAX);
+	pool->workers = calloc(threads, sizeof(*pool->workers));
+	if (pool->workers == NULL)
+		return; /* fall back on building in tx */
+
+	for (int i = 0; i < threads; i++) {
+		struct memtx_build_worker *worker = &pool->workers[i];
+		char name[FIBER_NAME_MAX];
+
+		snprintf(name, sizeof(name), "memtx.build.%d", i);
+		if (cord_costart(&worker->cord, name,
+				 memtx_build_worker_f, worker) != 0) {
+			/* Make do with the threads started so far. */
+			diag_log();
+			say_warn("failed to start memtx build thread, "
+				 "using %d threads", i);
+			break;
+		}
+		pool->worker_count++;
+		cpipe_create(&worker->worker_pipe, name);
+		worker->route[0].f = memtx_build_task_sort;
+		worker->route[0].pipe = &worker->tx_pipe;
+		worker->route[1].f = memtx_build_task_complete;
+		worker->route[1].pipe = NULL;
+	}
+}
+
+/** Wait for all tasks to complete and join build threads. */
+static void
+memtx_build_pool_stop(struct memtx_build_pool *pool)
+{
+	while (pool->in_flight > 0)
+		fiber_cond_wait(&pool->cond);
+	for (int i = 0; i < pool->worker_count; i++) {
+		struct memtx_build_worker *worker = &pool->workers[i];
+
+		cbus_stop_loop(&worker->worker_pipe);
+		cpipe_destroy(&worker->worker_pipe);
+		if (cord_join(&worker->cord) != 0)
+			panic("failed to join memtx build thread");
+	}
+	free(pool->workers);
+	fiber_cond_destroy(&pool->cond);
+}
+
+/**
+ * Send the build array of a tree index to a worker thread to
+ * sort. Returns false if the index has to be sorted in tx.
+ */
+static bool
+memtx_build_pool_sort(struct memtx_build_pool *pool,
+		      struct memtx_tree_index *index)
+{
+	if (pool->worker_count == 0)
+		return false;
+	struct memtx_build_task *task = malloc(sizeof(*task));
+	if (task == NULL)
+		return false;
+	struct memtx_build_worker *worker;
+	worker = &pool->workers[pool->next_worker++];
+	pool->next_worker %= pool->worker_count;
+
+	task->pool = pool;
+	task->index = index;
+	cmsg_init(&task->base, worker->route);
+	pool->in_flight++;
+	cpipe_push(&worker->worker_pipe, &task->base);
+	return true;
+}
+
 /**
  * Secondary indexes are built in bulk after all data is
- * recovered. This function enables secondary keys on a space.
+ * recovered. This function fills secondary keys of a space
+ * with tuples and sends tree keys to worker threads to sort.
+ * The keys are enabled by memtx_end_build_secondary_keys()
+ * once all worker threads are done.
  * Data dictionary spaces are an exception, they are fully
  * built right from the start.
  */
 static int
 memtx_build_secondary_keys(struct space *space, void *param)
 {
+	struct memtx_build_pool *pool = (struct memtx_build_pool *)param;
 	struct memtx_space *memtx_space = (struct memtx_space *)space;
-	if (space->engine != param || space_index(space, 0) == NULL ||
+	if (space->engine != (struct engine *)pool->memtx ||
+	    space_index(space, 0) == NULL ||
 	    memtx_space->replace == memtx_space_replace_all_keys)
 		return 0;
 
@@ -113,11 +310,42 @@ memtx_build_secondary_keys(struct space *space, void *param)
 		}
 
 		for (uint32_t j = 1; j < space->index_count; j++) {
-			if (index_build(space->index[j], pk) < 0)
+			struct index *index = space->index[j];
+			if (!index_is_memtx_tree(index)) {
+				if (index_build(index, pk) < 0)
+					return -1;
+				continue;
+			}
+			if (index_build_fill(index, pk) < 0)
 				return -1;
+			memtx_build_pool_sort(pool,
+					      (struct memtx_tree_index *)index);
 		}
+	}
+	return 0;
+}
 
-		if (n_tuples > 0) {
+/**
+ * Finish building secondary keys sorted by worker threads
+ * and enable them on a space.
+ */
+static int
+memtx_end_build_secondary_keys(struct space *space, void *param)
+{
+	struct memtx_build_pool *pool = (struct memtx_build_pool *)param;
+	struct memtx_space *memtx_space = (struct memtx_space *)space;
+	if (space->engine != (struct engine *)pool->memtx ||
+	    space_index(space, 0) == NULL ||
+	    memtx_space->replace == memtx_space_replace_all_keys)
+		return 0;
+
+	if (space->index_id_max > 0) {
+		for (uint32_t j = 1; j < space->index_count; j++) {
+			struct index *index = space->index[j];
+			if (index_is_memtx_tree(index))
+				index_end_build(index);
+		}
+		if (index_size(space->index[0]) > 0) {
 			say_info("Space '%s': done", space_name(space));
 		}
 	}
@@ -125,6 +353,21 @@ memtx_build_secondary_keys(struct space *space, void *param)
 	return 0;
 }
 
+/** Build and enable secondary keys in all memtx spaces. */
+static int
+memtx_build_all_secondary_keys(struct memtx_engine *memtx)
+{
+	struct memtx_build_pool pool;
+	memtx_build_pool_start(&pool, memtx);
+	int rc = space_foreach(memtx_build_secondary_keys, &pool);
+	while (pool.in_flight > 0)
+		fiber_cond_wait(&pool.cond);
+	if (rc == 0)
+		rc = space_foreach(memtx_end_build_secondary_keys, &pool);
+	memtx_build_pool_stop(&pool);
+	return rc;
+}
+
 static void
 memtx_engine_shutdown(struct engine *engine)
 {
@@ -138,6 +381,7 @@ memtx_engine_shutdown(struct engine *engine)
 	if (mempool_is_initialized(&memtx->bitset_iterator_pool))
 		mempool_destroy(&memtx->bitset_iterator_pool);
 	xdir_destroy(&memtx->snap_dir);
+	memtx_deleted_keys_free(&memtx->deleted_keys);
 	free(memtx);
 	memtx_tuple_free();
 }
@@ -146,43 +390,452 @@ static int
 memtx_engine_recover_snapshot_row(struct memtx_engine *memtx,
 				  struct xrow_header *row);
 
-int
-memtx_engine_recover_snapshot(struct memtx_engine *memtx,
-			      const struct vclock *vclock)
-{
-	/* Process existing snapshot */
-	say_info("recovery start");
-	int64_t signature = vclock_sum(vclock);
-	const char *filename = xdir_format_filename(&memtx->snap_dir,
-						    signature, NONE);
+static int
+memtx_engine_recover_request(struct memtx_engine *memtx,
+			     struct request *request);
 
-	say_info("recovering from `%s'", filename);
+enum {
+	/** Max number of rows in a batch decoded by the snapshot reader. */
+	MEMTX_SNAP_BATCH_ROWS = 1024,
+	/**
+	 * Number of batches circulating between tx and the snapshot
+	 * reader: while tx inserts rows from one batch, the reader
+	 * decompresses and decodes the next ones.
+	 */
+	MEMTX_SNAP_BATCH_COUNT = 4,
+};
+
+struct memtx_snap_reader;
+
+/**
+ * A batch of snapshot rows decoded by the reader thread.
+ * Row bodies are copied to a buffer owned by the batch so that
+ * they stay valid after the cursor advances to the next tx.
+ */
+struct memtx_snap_batch {
+	/** cbus message: tx -> reader -> tx. */
+	struct cmsg base;
+	/** Link in memtx_snap_reader::ready. */
+	struct stailq_entry in_ready;
+	/** Reader this batch belongs to. */
+	struct memtx_snap_reader *reader;
+	/** Number of decoded rows. */
+	int row_count;
+	/** Row headers, bodies point to @data. */
+	struct xrow_header rows[MEMTX_SNAP_BATCH_ROWS];
+	/** Requests decoded from @rows. */
+	struct request requests[MEMTX_SNAP_BATCH_ROWS];
+	/** Buffer storing row bodies. */
+	char *data;
+	/** Size of @data. */
+	size_t data_size;
+	/** Set if the reader failed, the error is in @diag. */
+	int rc;
+	/** Set if this is the last batch in the snapshot. */
+	bool eof;
+	/** Reader error, moved to tx. */
+	struct diag diag;
+};
+
+/**
+ * Snapshot decompression and xrow decoding are done in a
+ * separate thread so that the tx thread is only busy with
+ * inserting tuples into the primary keys.
+ */
+struct memtx_snap_reader {
+	/** Thread that reads the snapshot. */
+	struct cord cord;
+	/** Pipe from tx to the reader thread. */
+	struct cpipe reader_pipe;
+	/** Pipe from the reader thread to tx. */
+	struct cpipe tx_pipe;
+	/** Batch route: read in the reader thread, apply in tx. */
+	struct cmsg_hop route[2];
+	/** Snapshot cursor, accessed only by the reader thread. */
 	struct xlog_cursor cursor;
-	if (xlog_cursor_open(&cursor, filename) < 0)
+	/** Set if the cursor was opened successfully. */
+	bool cursor_is_open;
+	/** Set once the reader hit EOF or an error. */
+	bool done;
+	/** Name of the snapshot file. */
+	const char *filename;
+	/** LSN assigned to all snapshot rows. */
+	int64_t signature;
+	/** Skip invalid snapshot records if this flag is set. */
+	bool force_recovery;
+	/** All batches. */
+	struct memtx_snap_batch *batches[MEMTX_SNAP_BATCH_COUNT];
+	/** Batches sent to the reader thread and not returned yet. */
+	int in_flight;
+	/** Batches returned by the reader thread, in snapshot order. */
+	struct stailq ready;
+	/** Signaled when a batch is returned by the reader thread. */
+	struct fiber_cond ready_cond;
+};
+
+/** Snapshot reader thread function. */
+static int
+memtx_snap_reader_f(va_list ap)
+{
+	struct memtx_snap_reader *reader =
+		va_arg(ap, struct memtx_snap_reader *);
+	struct cbus_endpoint endpoint;
+
+	cpipe_create(&reader->tx_pipe, "tx_prio");
+	cbus_endpoint_create(&endpoint, cord_name(cord()),
+			     fiber_schedule_cb, fiber());
+	cbus_loop(&endpoint);
+	cbus_endpoint_destroy(&endpoint, cbus_process);
+	cpipe_destroy(&reader->tx_pipe);
+	/*
+	 * The cursor buffers were allocated by this thread
+	 * so they must be released here as well.
+	 */
+	if (reader->cursor_is_open)
+		xlog_cursor_close(&reader->cursor, false);
+	return 0;
+}
+
+/** Cbus call opening the snapshot in the reader thread. */
+struct memtx_snap_open_msg {
+	struct cbus_call_msg base;
+	struct memtx_snap_reader *reader;
+};
+
+static int
+memtx_snap_reader_open_cb(struct cbus_call_msg *base)
+{
+	struct memtx_snap_open_msg *msg = (struct memtx_snap_open_msg *)base;
+	struct memtx_snap_reader *reader = msg->reader;
+	if (xlog_cursor_open(&reader->cursor, reader->filename) < 0)
 		return -1;
-	INSTANCE_UUID = cursor.meta.instance_uuid;
+	reader->cursor_is_open = true;
+	return 0;
+}
 
-	int rc;
+/** Make sure the batch buffer can store @size more bytes. */
+static int
+memtx_snap_batch_reserve(struct memtx_snap_batch *batch, size_t used,
+			 size_t size)
+{
+	if (used + size <= batch->data_size)
+		return 0;
+	size_t new_size = MAX(batch->data_size * 2, used + size);
+	char *data = realloc(batch->data, new_size);
+	if (data == NULL) {
+		diag_set(OutOfMemory, new_size, "realloc", "snapshot batch");
+		return -1;
+	}
+	batch->data = data;
+	batch->data_size = new_size;
+	return 0;
+}
+
+/** Decode a snapshot row, called in the reader thread. */
+static int
+memtx_snap_decode_row(struct xrow_header *row, struct request *request)
+{
+	assert(row->bodycnt == 1); /* always 1 for read */
+	/* Delta snapshots also contain REPLACE and DELETE rows. */
+	if (row->type != IPROTO_INSERT && row->type != IPROTO_REPLACE &&
+	    row->type != IPROTO_DELETE) {
+		diag_set(ClientError, ER_UNKNOWN_REQUEST_TYPE,
+			 (uint32_t) row->type);
+		return -1;
+	}
+	return xrow_decode_dml(row, request, dml_request_key_map(row->type));
+}
+
+/**
+ * Fill a batch with rows read from the snapshot,
+ * called in the reader thread.
+ */
+static void
+memtx_snap_batch_read(struct cmsg *base)
+{
+	struct memtx_snap_batch *batch = (struct memtx_snap_batch *)base;
+	struct memtx_snap_reader *reader = batch->reader;
+	batch->row_count = 0;
+	batch->rc = 0;
+	batch->eof = reader->done;
+	if (reader->done)
+		return;
+	/*
+	 * First copy row bodies to the batch buffer, storing
+	 * offsets instead of pointers, as the buffer may be
+	 * reallocated while it grows.
+	 */
+	size_t used = 0;
+	int row_count = 0;
 	struct xrow_header row;
-	uint64_t row_count = 0;
-	while ((rc = xlog_cursor_next(&cursor, &row,
-				      memtx->force_recovery)) == 0) {
-		row.lsn = signature;
-		rc = memtx_engine_recover_snapshot_row(memtx, &row);
+	while (row_count < MEMTX_SNAP_BATCH_ROWS) {
+		int rc = xlog_cursor_next(&reader->cursor, &row,
+					  reader->force_recovery);
+		if (rc > 0) {
+			batch->eof = true;
+			reader->done = true;
+			break;
+		}
+		if (rc == 0) {
+			assert(row.bodycnt == 1);
+			size_t len = row.body[0].iov_len;
+			rc = memtx_snap_batch_reserve(batch, used, len);
+		}
 		if (rc < 0) {
-			if (!memtx->force_recovery)
-				break;
+			diag_move(diag_get(), &batch->diag);
+			batch->rc = -1;
+			reader->done = true;
+			break;
+		}
+		memcpy(batch->data + used, row.body[0].iov_base,
+		       row.body[0].iov_len);
+		row.body[0].iov_base = (void *)(uintptr_t)used;
+		row.lsn = reader->signature;
+		used += row.body[0].iov_len;
+		batch->rows[row_count++] = row;
+	}
+	/* Now decode the rows, skipping invalid ones if allowed. */
+	for (int i = 0; i < row_count; i++) {
+		struct xrow_header *row = &batch->rows[batch->row_count];
+		*row = batch->rows[i];
+		row->body[0].iov_base = batch->data +
+					(uintptr_t)row->body[0].iov_base;
+		struct request *request = &batch->requests[batch->row_count];
+		if (memtx_snap_decode_row(row, request) == 0) {
+			batch->row_count++;
+			continue;
+		}
+		if (reader->force_recovery) {
 			say_error("can't apply row: ");
 			diag_log();
+			continue;
 		}
-		++row_count;
-		if (row_count % 100000 == 0) {
-			say_info("%.1fM rows processed",
-				 row_count / 1000000.);
-			fiber_yield_timeout(0);
+		/* Rows preceding the broken one are still applied. */
+		diag_move(diag_get(), &batch->diag);
+		batch->rc = -1;
+		batch->eof = false;
+		reader->done = true;
+		break;
+	}
+}
+
+/** Queue a batch returned by the reader thread, called in tx. */
+static void
+memtx_snap_batch_ready(struct cmsg *base)
+{
+	struct memtx_snap_batch *batch = (struct memtx_snap_batch *)base;
+	struct memtx_snap_reader *reader = batch->reader;
+	assert(reader->in_flight > 0);
+	reader->in_flight--;
+	stailq_add_tail_entry(&reader->ready, batch, in_ready);
+	fiber_cond_signal(&reader->ready_cond);
+}
+
+/** Send a batch to the reader thread to fill it with rows. */
+static void
+memtx_snap_reader_push(struct memtx_snap_reader *reader,
+		       struct memtx_snap_batch *batch)
+{
+	cmsg_init(&batch->base, reader->route);
+	reader->in_flight++;
+	cpipe_push(&reader->reader_pipe, &batch->base);
+}
+
+/**
+ * Wait for the next batch returned by the reader thread.
+ * The caller must either push it back or stop the reader.
+ */
+static struct memtx_snap_batch *
+memtx_snap_reader_next(struct memtx_snap_reader *reader)
+{
+	while (stailq_empty(&reader->ready)) {
+		assert(reader->in_flight > 0);
+		fiber_cond_wait(&reader->ready_cond);
+	}
+	return stailq_shift_entry(&reader->ready, struct memtx_snap_batch,
+				  in_ready);
+}
+
+/**
+ * Wait for all batches to return from the reader thread,
+ * stop the thread, and free the batches.
+ */
+static void
+memtx_snap_reader_stop(struct memtx_snap_reader *reader)
+{
+	while (reader->in_flight > 0)
+		fiber_cond_wait(&reader->ready_cond);
+	cbus_stop_loop(&reader->reader_pipe);
+	cpipe_destroy(&reader->reader_pipe);
+	if (cord_join(&reader->cord) != 0)
+		panic("failed to join snapshot reader thread");
+	for (int i = 0; i < MEMTX_SNAP_BATCH_COUNT; i++) {
+		struct memtx_snap_batch *batch = reader->batches[i];
+		if (batch == NULL)
+			continue;
+		diag_destroy(&batch->diag);
+		free(batch->data);
+		free(batch);
+	}
+	fiber_cond_destroy(&reader->ready_cond);
+}
+
+/**
+ * Start the snapshot reader thread, open the snapshot and
+ * send all batches to the reader to fill.
+ */
+static int
+memtx_snap_reader_start(struct memtx_snap_reader *reader,
+			const char *filename, int64_t signature,
+			bool force_recovery)
+{
+	memset(reader, 0, sizeof(*reader));
+	reader->filename = filename;
+	reader->signature = signature;
+	reader->force_recovery = force_recovery;
+	reader->route[0].f = memtx_snap_batch_read;
+	reader->route[0].pipe = &reader->tx_pipe;
+	reader->route[1].f = memtx_snap_batch_ready;
+	reader->route[1].pipe = NULL;
+	stailq_create(&reader->ready);
+	fiber_cond_create(&reader->ready_cond);
+
+	if (cord_costart(&reader->cord, "snapshot.reader",
+			 memtx_snap_reader_f, reader) != 0) {
+		fiber_cond_destroy(&reader->ready_cond);
+		return -1;
+	}
+	cpipe_create(&reader->reader_pipe, "snapshot.reader");
+
+	struct memtx_snap_open_msg msg;
+	msg.reader = reader;
+	if (cbus_call(&reader->reader_pipe, &reader->tx_pipe, &msg.base,
+		      memtx_snap_reader_open_cb, NULL, TIMEOUT_INFINITY) != 0)
+		goto fail;
+
+	for (int i = 0; i < MEMTX_SNAP_BATCH_COUNT; i++) {
+		struct memtx_snap_batch *batch = malloc(sizeof(*batch));
+		if (batch == NULL) {
+			diag_set(OutOfMemory, sizeof(*batch), "malloc",
+				 "struct memtx_snap_batch");
+			goto fail;
 		}
+		batch->reader = reader;
+		batch->data = NULL;
+		batch->data_size = 0;
+		diag_create(&batch->diag);
+		reader->batches[i] = batch;
+		memtx_snap_reader_push(reader, batch);
 	}
-	xlog_cursor_close(&cursor, false);
+	return 0;
+fail:
+	memtx_snap_reader_stop(reader);
+	return -1;
+}
+
+/**
+ * Find the snapshots needed to restore the checkpoint with
+ * the given signature: the full snapshot the checkpoint is
+ * based on followed by delta snapshots, oldest first. The
+ * array of signatures is allocated with malloc() and must be
+ * freed by the caller.
+ *
+ * Returns the number of snapshots or -1 on error.
+ */
+static int
+memtx_engine_snapshot_chain(struct memtx_engine *memtx, int64_t signature,
+			    int64_t **chain)
+{
+	int64_t *buf = NULL;
+	int count = 0, capacity = 0;
+	while (true) {
+		if (count == capacity) {
+			capacity = MAX(capacity * 2, 4);
+			int64_t *new_buf = realloc(buf, capacity *
+						   sizeof(*buf));
+			if (new_buf == NULL) {
+				diag_set(OutOfMemory, capacity * sizeof(*buf),
+					 "realloc", "snapshot chain");
+				goto fail;
+			}
+			buf = new_buf;
+		}
+		buf[count++] = signature;
+		struct xlog_cursor cursor;
+		if (xdir_open_cursor(&memtx->snap_dir, signature,
+				     &cursor) != 0)
+			goto fail;
+		bool is_delta = cursor.meta.has_prev_vclock;
+		int64_t prev = vclock_sum(&cursor.meta.prev_vclock);
+		xlog_cursor_close(&cursor, false);
+		if (!is_delta)
+			break;
+		if (prev >= signature) {
+			diag_set(XlogError, "%s: invalid previous snapshot",
+				 xdir_format_filename(&memtx->snap_dir,
+						      signature, NONE));
+			goto fail;
+		}
+		signature = prev;
+	}
+	/* Reverse the chain so that the full snapshot goes first. */
+	for (int i = 0; i < count / 2; i++) {
+		int64_t tmp = buf[i];
+		buf[i] = buf[count - i - 1];
+		buf[count - i - 1] = tmp;
+	}
+	*chain = buf;
+	return count;
+fail:
+	free(buf);
+	return -1;
+}
+
+/** Load rows of a single snapshot file, full or delta. */
+static int
+memtx_engine_recover_snapshot_file(struct memtx_engine *memtx,
+				   int64_t signature)
+{
+	const char *filename = xdir_format_filename(&memtx->snap_dir,
+						    signature, NONE);
+
+	say_info("recovering from `%s'", filename);
+	struct memtx_snap_reader reader;
+	if (memtx_snap_reader_start(&reader, filename, signature,
+				    memtx->force_recovery) != 0)
+		return -1;
+	INSTANCE_UUID = reader.cursor.meta.instance_uuid;
+
+	int rc = 0;
+	uint64_t row_count = 0;
+	while (true) {
+		struct memtx_snap_batch *batch = memtx_snap_reader_next(&reader);
+		for (int i = 0; i < batch->row_count; i++) {
+			rc = memtx_engine_recover_request(memtx,
+							  &batch->requests[i]);
+			if (rc < 0) {
+				if (!memtx->force_recovery)
+					break;
+				say_error("can't apply row: ");
+				diag_log();
+				rc = 0;
+			}
+			++row_count;
+			if (row_count % 100000 == 0) {
+				say_info("%.1fM rows processed",
+					 row_count / 1000000.);
+				fiber_yield_timeout(0);
+			}
+		}
+		if (rc == 0 && batch->rc != 0) {
+			diag_move(&batch->diag, diag_get());
+			rc = -1;
+		}
+		if (rc < 0 || batch->eof)
+			break;
+		memtx_snap_reader_push(&reader, batch);
+	}
+	memtx_snap_reader_stop(&reader);
 	if (rc < 0)
 		return -1;
 
@@ -191,12 +844,54 @@ memtx_engine_recover_snapshot(struct memtx_engine *memtx,
 	 * marker - such snapshots are very likely corrupted and
 	 * should not be trusted.
 	 */
-	if (!xlog_cursor_is_eof(&cursor))
+	if (!xlog_cursor_is_eof(&reader.cursor))
 		panic("snapshot `%s' has no EOF marker", filename);
 
 	return 0;
 }
 
+int
+memtx_engine_recover_snapshot(struct memtx_engine *memtx,
+			      const struct vclock *vclock)
+{
+	/* Process existing snapshot */
+	say_info("recovery start");
+	int64_t *chain;
+	int chain_len = memtx_engine_snapshot_chain(memtx, vclock_sum(vclock),
+						    &chain);
+	if (chain_len < 0)
+		return -1;
+	int rc = 0;
+	for (int i = 0; i < chain_len && rc == 0; i++) {
+		if (i > 0)
+			memtx_engine_begin_delta_recovery(memtx);
+		rc = memtx_engine_recover_snapshot_file(memtx, chain[i]);
+	}
+	free(chain);
+	if (rc != 0)
+		return -1;
+	/*
+	 * Tuples recovered from the WAL must get a newer version
+	 * than the ones loaded from the snapshot, so that the next
+	 * checkpoint can be a delta. Deletes done while loading
+	 * delta snapshots don't belong to it.
+	 */
+	memtx->checkpoint_version = memtx_tuple_next_version();
+	memtx->checkpoint_delta_count = chain_len - 1;
+	memtx->checkpoint_needs_full = memtx->checkpoint_deltas == 0;
+	memtx_deleted_keys_free(&memtx->deleted_keys);
+	return 0;
+}
+
+void
+memtx_engine_begin_delta_recovery(struct memtx_engine *memtx)
+{
+	if (memtx->state != MEMTX_INITIAL_RECOVERY)
+		return;
+	space_foreach(memtx_end_build_primary_key, memtx);
+	memtx->state = MEMTX_FINAL_RECOVERY;
+}
+
 static int
 memtx_engine_recover_snapshot_row(struct memtx_engine *memtx,
 				  struct xrow_header *row)
@@ -211,6 +906,13 @@ memtx_engine_recover_snapshot_row(struct memtx_engine *memtx,
 	struct request *request = xrow_decode_dml_gc(row);
 	if (request == NULL)
 		return -1;
+	return memtx_engine_recover_request(memtx, request);
+}
+
+static int
+memtx_engine_recover_request(struct memtx_engine *memtx,
+			     struct request *request)
+{
 	struct space *space = space_cache_find(request->space_id);
 	if (space == NULL)
 		return -1;
@@ -259,6 +961,9 @@ memtx_engine_begin_final_recovery(struct engine *engine)
 	struct memtx_engine *memtx = (struct memtx_engine *)engine;
 	if (memtx->state == MEMTX_OK)
 		return 0;
+	/* Primary keys were built to apply a delta snapshot. */
+	if (memtx->state == MEMTX_FINAL_RECOVERY)
+		return 0;
 
 	assert(memtx->state == MEMTX_INITIAL_RECOVERY);
 	/* End of the fast path: loaded the primary key. */
@@ -280,7 +985,7 @@ memtx_engine_begin_final_recovery(struct engine *engine)
 		 * unique keys.
 		 */
 		memtx->state = MEMTX_OK;
-		if (space_foreach(memtx_build_secondary_keys, memtx) != 0)
+		if (memtx_build_all_secondary_keys(memtx) != 0)
 			return -1;
 	}
 	return 0;
@@ -299,7 +1004,7 @@ memtx_engine_end_recovery(struct engine *engine)
 	if (memtx->state != MEMTX_OK) {
 		assert(memtx->state == MEMTX_FINAL_RECOVERY);
 		memtx->state = MEMTX_OK;
-		if (space_foreach(memtx_build_secondary_keys, memtx) != 0)
+		if (memtx_build_all_secondary_keys(memtx) != 0)
 			return -1;
 	}
 	return 0;
@@ -419,12 +1124,66 @@ memtx_engine_rollback(struct engine *engine, struct txn *txn)
 		memtx_engine_rollback_statement(engine, txn, stmt);
 }
 
+/**
+ * Track a committed statement for the next delta checkpoint.
+ * Changed tuples are found by version, but deleted ones are
+ * gone by then so their keys have to be remembered here.
+ */
+static void
+memtx_engine_track_stmt(struct memtx_engine *memtx, struct txn_stmt *stmt)
+{
+	struct space *space = stmt->space;
+	if (space == NULL || space_is_temporary(space))
+		return;
+	if (stmt->old_tuple == NULL && stmt->new_tuple == NULL)
+		return;
+	if (space_is_system(space) && space_id(space) != BOX_SEQUENCE_DATA_ID) {
+		/*
+		 * Rows of a delta are applied in space order
+		 * rather than in the order of changes, which
+		 * is only safe if there was no DDL.
+		 */
+		memtx->checkpoint_needs_full = true;
+		memtx_deleted_keys_free(&memtx->deleted_keys);
+		return;
+	}
+	if (memtx->checkpoint_needs_full ||
+	    stmt->old_tuple == NULL || stmt->new_tuple != NULL)
+		return;
+	/* The tuple isn't in any read view, nothing to delete. */
+	if (memtx_tuple_is_new(stmt->old_tuple))
+		return;
+	struct index *pk = space_index(space, 0);
+	if (pk == NULL)
+		return;
+	uint32_t size;
+	const char *data = tuple_extract_key(stmt->old_tuple,
+					     pk->def->key_def, &size);
+	struct memtx_deleted_key *key = NULL;
+	if (data != NULL)
+		key = malloc(sizeof(*key) + size);
+	if (key == NULL) {
+		/* Commit can't fail, fall back on a full checkpoint. */
+		say_warn("failed to track a deleted key, the next "
+			 "checkpoint will be full");
+		memtx->checkpoint_needs_full = true;
+		memtx_deleted_keys_free(&memtx->deleted_keys);
+		return;
+	}
+	key->space_id = space_id(space);
+	key->size = size;
+	memcpy(key->data, data, size);
+	stailq_add_tail_entry(&memtx->deleted_keys, key, in_list);
+}
+
 static void
 memtx_engine_commit(struct engine *engine, struct txn *txn)
 {
-	(void)engine;
+	struct memtx_engine *memtx = (struct memtx_engine *)engine;
 	struct txn_stmt *stmt;
 	stailq_foreach_entry(stmt, &txn->stmts, next) {
+		if (memtx->checkpoint_deltas > 0)
+			memtx_engine_track_stmt(memtx, stmt);
 		if (stmt->old_tuple)
 			tuple_unref(stmt->old_tuple);
 	}
@@ -488,26 +1247,55 @@ checkpoint_write_row(struct xlog *l, struct xrow_header *row)
 
 }
 
+/** Make a snapshot row storing a tuple, the body refers to @data. */
+static void
+checkpoint_encode_tuple(struct xrow_header *row,
+			struct request_replace_body *body, uint16_t type,
+			uint32_t space_id, const char *data, uint32_t size)
+{
+	body->m_body = 0x82; /* map of two elements. */
+	body->k_space_id = IPROTO_SPACE_ID;
+	body->m_space_id = 0xce; /* uint32 */
+	body->v_space_id = mp_bswap_u32(space_id);
+	body->k_tuple = IPROTO_TUPLE;
+
+	memset(row, 0, sizeof(struct xrow_header));
+	row->type = type;
+
+	row->bodycnt = 2;
+	row->body[0].iov_base = body;
+	row->body[0].iov_len = sizeof(*body);
+	row->body[1].iov_base = (char *)data;
+	row->body[1].iov_len = size;
+}
+
 static int
-checkpoint_write_tuple(struct xlog *l, uint32_t space_id,
+checkpoint_write_tuple(struct xlog *l, uint16_t type, uint32_t space_id,
 		       const char *data, uint32_t size)
 {
 	struct request_replace_body body;
-	body.m_body = 0x82; /* map of two elements. */
-	body.k_space_id = IPROTO_SPACE_ID;
-	body.m_space_id = 0xce; /* uint32 */
-	body.v_space_id = mp_bswap_u32(space_id);
-	body.k_tuple = IPROTO_TUPLE;
+	struct xrow_header row;
+	checkpoint_encode_tuple(&row, &body, type, space_id, data, size);
+	return checkpoint_write_row(l, &row);
+}
+
+static int
+checkpoint_write_delete(struct xlog *l, uint32_t space_id,
+			const char *key, uint32_t size)
+{
+	struct request request;
+	memset(&request, 0, sizeof(request));
+	request.type = IPROTO_DELETE;
+	request.space_id = space_id;
+	request.key = key;
+	request.key_end = key + size;
 
 	struct xrow_header row;
 	memset(&row, 0, sizeof(struct xrow_header));
-	row.type = IPROTO_INSERT;
-
-	row.bodycnt = 2;
-	row.body[0].iov_base = &body;
-	row.body[0].iov_len = sizeof(body);
-	row.body[1].iov_base = (char *)data;
-	row.body[1].iov_len = size;
+	row.type = IPROTO_DELETE;
+	row.bodycnt = xrow_encode_dml(&request, row.body);
+	if (row.bodycnt < 0)
+		return -1;
 	return checkpoint_write_row(l, &row);
 }
 
@@ -534,6 +1322,33 @@ struct checkpoint {
 	 * checkpoint already exists.
 	 */
 	bool touch;
+	/**
+	 * Set if only changes since the previous checkpoint
+	 * are written, see memtx_engine::checkpoint_deltas.
+	 */
+	bool is_delta;
+	/** The vclock of the previous checkpoint, for a delta. */
+	struct vclock prev_vclock;
+	/** Tuples of this or newer versions are written to a delta. */
+	uint32_t dirty_version;
+	/** Snapshot version started by this checkpoint. */
+	uint32_t version;
+	/** Keys to delete in a delta, oldest first. */
+	struct stailq deleted_keys;
+	/**
+	 * Number of threads writing user spaces, see
+	 * memtx_engine::checkpoint_threads.
+	 */
+	int threads;
+	/**
+	 * Serializes writer threads appending to the snapshot
+	 * file and taking spaces from @next_entry.
+	 */
+	pthread_mutex_t mutex;
+	/** The next space to be taken by a writer thread. */
+	struct checkpoint_entry *next_entry;
+	/** Set if a writer thread failed, the others stop. */
+	bool failed;
 };
 
 static int
@@ -544,6 +1359,10 @@ checkpoint_init(struct checkpoint *ckpt, const char *snap_dirname,
 	ckpt->waiting_for_snap_thread = false;
 	xdir_create(&ckpt->dir, snap_dirname, SNAP, &INSTANCE_UUID);
 	ckpt->snap_io_rate_limit = snap_io_rate_limit;
+	ckpt->threads = 1;
+	tt_pthread_mutex_init(&ckpt->mutex, NULL);
+	ckpt->next_entry = NULL;
+	ckpt->failed = false;
 	/* May be used in abortCheckpoint() */
 	ckpt->vclock = malloc(sizeof(*ckpt->vclock));
 	if (ckpt->vclock == NULL) {
@@ -553,6 +1372,8 @@ checkpoint_init(struct checkpoint *ckpt, const char *snap_dirname,
 	}
 	vclock_create(ckpt->vclock);
 	ckpt->touch = false;
+	ckpt->is_delta = false;
+	stailq_create(&ckpt->deleted_keys);
 	return 0;
 }
 
@@ -564,10 +1385,20 @@ checkpoint_destroy(struct checkpoint *ckpt)
 		entry->iterator->free(entry->iterator);
 	}
 	rlist_create(&ckpt->entries);
+	memtx_deleted_keys_free(&ckpt->deleted_keys);
+	tt_pthread_mutex_destroy(&ckpt->mutex);
 	xdir_destroy(&ckpt->dir);
 	free(ckpt->vclock);
 }
 
+/** Snapshot iterator filter selecting tuples for a delta. */
+static bool
+checkpoint_tuple_is_dirty(struct tuple *tuple, void *arg)
+{
+	struct checkpoint *ckpt = (struct checkpoint *)arg;
+	return memtx_tuple_version(tuple) >= ckpt->dirty_version;
+}
+
 
 static int
 checkpoint_add_space(struct space *sp, void *data)
@@ -593,10 +1424,167 @@ checkpoint_add_space(struct space *sp, void *data)
 	entry->iterator = index_create_snapshot_iterator(pk);
 	if (entry->iterator == NULL)
 		return -1;
-
+	if (ckpt->is_delta) {
+		entry->iterator->filter = checkpoint_tuple_is_dirty;
+		entry->iterator->filter_arg = ckpt;
+	}
 	return 0;
 };
 
+/**
+ * A thread writing user spaces to a snapshot in parallel with
+ * other such threads. Each thread takes whole spaces, encodes
+ * and compresses their rows into its own buffer and appends
+ * complete tx blocks to the snapshot file.
+ */
+struct checkpoint_writer {
+	struct cord cord;
+	struct checkpoint *ckpt;
+	/** The snapshot file, shared by all writers. */
+	struct xlog *snap;
+};
+
+/** Take the next space to write, NULL if there's none left. */
+static struct checkpoint_entry *
+checkpoint_next_entry(struct checkpoint *ckpt)
+{
+	tt_pthread_mutex_lock(&ckpt->mutex);
+	struct checkpoint_entry *entry = ckpt->next_entry;
+	if (ckpt->failed) {
+		entry = NULL;
+	} else if (entry != NULL) {
+		if (rlist_next(&entry->link) == &ckpt->entries)
+			ckpt->next_entry = NULL;
+		else
+			ckpt->next_entry = rlist_next_entry(entry, link);
+	}
+	tt_pthread_mutex_unlock(&ckpt->mutex);
+	return entry;
+}
+
+/** Append complete tx blocks of a writer to the snapshot. */
+static int
+checkpoint_writer_flush(struct checkpoint_writer *writer,
+			struct xlog_tx_buf *buf)
+{
+	struct checkpoint *ckpt = writer->ckpt;
+	tt_pthread_mutex_lock(&ckpt->mutex);
+	/*
+	 * Rate limiting sleeps with the mutex locked, which
+	 * throttles the other writers as well.
+	 */
+	int rc = xlog_write_tx_buf(writer->snap, buf) < 0 ? -1 : 0;
+	tt_pthread_mutex_unlock(&ckpt->mutex);
+	return rc;
+}
+
+static int
+checkpoint_writer_run(struct checkpoint_writer *writer)
+{
+	struct checkpoint *ckpt = writer->ckpt;
+	struct xlog_tx_buf buf;
+	if (xlog_tx_buf_create(&buf) != 0)
+		goto fail;
+
+	ev_now_update(loop());
+	double tm = ev_now(loop());
+	uint16_t type = ckpt->is_delta ? IPROTO_REPLACE : IPROTO_INSERT;
+	int64_t rows = 0;
+	struct checkpoint_entry *entry;
+	while ((entry = checkpoint_next_entry(ckpt)) != NULL) {
+		uint32_t size;
+		const char *data;
+		struct snapshot_iterator *it = entry->iterator;
+		while (true) {
+			if (it->next(it, &data, &size) != 0)
+				goto fail_buf;
+			if (data == NULL)
+				break;
+			struct request_replace_body body;
+			struct xrow_header row;
+			checkpoint_encode_tuple(&row, &body, type,
+						space_id(entry->space),
+						data, size);
+			row.tm = tm;
+			/* Rows are numbered per writer. */
+			row.lsn = ++rows;
+			int rc = xlog_tx_buf_add_row(&buf, &row);
+			fiber_gc();
+			if (rc != 0)
+				goto fail_buf;
+			if (xlog_tx_buf_size(&buf) > 0 &&
+			    checkpoint_writer_flush(writer, &buf) != 0)
+				goto fail_buf;
+		}
+	}
+	if (xlog_tx_buf_flush(&buf) != 0 ||
+	    checkpoint_writer_flush(writer, &buf) != 0)
+		goto fail_buf;
+	xlog_tx_buf_destroy(&buf);
+	return 0;
+fail_buf:
+	xlog_tx_buf_destroy(&buf);
+fail:
+	tt_pthread_mutex_lock(&ckpt->mutex);
+	ckpt->failed = true;
+	tt_pthread_mutex_unlock(&ckpt->mutex);
+	return -1;
+}
+
+static int
+checkpoint_writer_f(va_list ap)
+{
+	struct checkpoint_writer *writer =
+		va_arg(ap, struct checkpoint_writer *);
+	return checkpoint_writer_run(writer);
+}
+
+/**
+ * Write spaces starting from @first in parallel, using
+ * the calling thread as one of the writers.
+ */
+static int
+checkpoint_write_parallel(struct checkpoint *ckpt, struct xlog *snap,
+			  struct checkpoint_entry *first)
+{
+	/* Blocks written by the threads go after buffered rows. */
+	if (xlog_flush(snap) < 0)
+		return -1;
+	ckpt->next_entry = first;
+	ckpt->failed = false;
+
+	struct checkpoint_writer *writers = calloc(ckpt->threads,
+						   sizeof(*writers));
+	if (writers == NULL) {
+		diag_set(OutOfMemory, ckpt->threads * sizeof(*writers),
+			 "calloc", "struct checkpoint_writer");
+		return -1;
+	}
+	int started = 1;
+	for (int i = 0; i < ckpt->threads; i++) {
+		writers[i].ckpt = ckpt;
+		writers[i].snap = snap;
+	}
+	for (; started < ckpt->threads; started++) {
+		char name[FIBER_NAME_MAX];
+		snprintf(name, sizeof(name), "snapshot.%d", started);
+		struct checkpoint_writer *writer = &writers[started];
+		if (cord_costart(&writer->cord, name, checkpoint_writer_f,
+				 writer) != 0) {
+			/* Let the started threads write the rest. */
+			diag_log();
+			break;
+		}
+	}
+	int rc = checkpoint_writer_run(&writers[0]);
+	for (int i = 1; i < started; i++) {
+		if (cord_join(&writers[i].cord) != 0)
+			rc = -1;
+	}
+	free(writers);
+	return rc;
+}
+
 static int
 checkpoint_f(va_list ap)
 {
@@ -613,20 +1601,64 @@ checkpoint_f(va_list ap)
 	}
 
 	struct xlog snap;
-	if (xdir_create_xlog(&ckpt->dir, &snap, ckpt->vclock) != 0)
-		return -1;
+	if (ckpt->is_delta) {
+		if (xdir_create_xlog_after(&ckpt->dir, &snap, ckpt->vclock,
+					   &ckpt->prev_vclock) != 0)
+			return -1;
+	} else {
+		if (xdir_create_xlog(&ckpt->dir, &snap, ckpt->vclock) != 0)
+			return -1;
+	}
 
 	snap.rate_limit = ckpt->snap_io_rate_limit;
 
-	say_info("saving snapshot `%s'", snap.filename);
+	say_info("saving %ssnapshot `%s'", ckpt->is_delta ? "delta " : "",
+		 snap.filename);
+	/*
+	 * A delta is applied on top of the previous checkpoint:
+	 * deletes go first, so that a key deleted and inserted
+	 * again ends up with the new tuple.
+	 */
+	struct memtx_deleted_key *key;
+	if (ckpt->is_delta) {
+		stailq_foreach_entry(key, &ckpt->deleted_keys, in_list) {
+			if (checkpoint_write_delete(&snap, key->space_id,
+						    key->data,
+						    key->size) != 0) {
+				xlog_close(&snap, false);
+				return -1;
+			}
+		}
+	}
+	uint16_t type = ckpt->is_delta ? IPROTO_REPLACE : IPROTO_INSERT;
 	struct checkpoint_entry *entry;
 	rlist_foreach_entry(entry, &ckpt->entries, link) {
+		/*
+		 * System spaces must be recovered before user
+		 * spaces and in order, so only user spaces are
+		 * written in parallel. They are visited after
+		 * system spaces, and their blocks may go in any
+		 * order.
+		 */
+		if (ckpt->threads > 1 && !space_is_system(entry->space)) {
+			if (checkpoint_write_parallel(ckpt, &snap,
+						      entry) != 0) {
+				xlog_close(&snap, false);
+				return -1;
+			}
+			break;
+		}
 		uint32_t size;
 		const char *data;
 		struct snapshot_iterator *it = entry->iterator;
-		for (data = it->next(it, &size); data != NULL;
-		     data = it->next(it, &size)) {
-			if (checkpoint_write_tuple(&snap,
+		while (true) {
+			if (it->next(it, &data, &size) != 0) {
+				xlog_close(&snap, false);
+				return -1;
+			}
+			if (data == NULL)
+				break;
+			if (checkpoint_write_tuple(&snap, type,
 					space_id(entry->space),
 					data, size) != 0) {
 				xlog_close(&snap, false);
@@ -653,18 +1685,40 @@ memtx_engine_begin_checkpoint(struct engine *engine)
 		return -1;
 	}
 
-	if (checkpoint_init(memtx->checkpoint, memtx->snap_dir.dirname,
+	struct checkpoint *ckpt = memtx->checkpoint;
+	if (checkpoint_init(ckpt, memtx->snap_dir.dirname,
 			    memtx->snap_io_rate_limit) != 0)
 		return -1;
+	ckpt->threads = memtx->checkpoint_threads;
+
+	/*
+	 * Write only tuples changed since the previous checkpoint
+	 * unless there are too many deltas already or changes
+	 * weren't tracked.
+	 */
+	if (memtx->checkpoint_deltas > 0 && !memtx->checkpoint_needs_full &&
+	    memtx->checkpoint_delta_count < memtx->checkpoint_deltas &&
+	    xdir_last_vclock(&memtx->snap_dir, &ckpt->prev_vclock) >= 0) {
+		ckpt->is_delta = true;
+		ckpt->dirty_version = memtx->checkpoint_version;
+	}
 
-	if (space_foreach(checkpoint_add_space, memtx->checkpoint) != 0) {
-		checkpoint_destroy(memtx->checkpoint);
+	if (space_foreach(checkpoint_add_space, ckpt) != 0) {
+		checkpoint_destroy(ckpt);
 		memtx->checkpoint = NULL;
 		return -1;
 	}
 
+	/*
+	 * Keys deleted from now on belong to the next checkpoint.
+	 * A full checkpoint doesn't need the keys, it just frees
+	 * them when it's done.
+	 */
+	stailq_concat(&ckpt->deleted_keys, &memtx->deleted_keys);
+	memtx->checkpoint_needs_full = memtx->checkpoint_deltas == 0;
+
 	/* increment snapshot version; set tuple deletion to delayed mode */
-	memtx_tuple_begin_snapshot();
+	ckpt->version = memtx_tuple_begin_snapshot();
 	return 0;
 }
 
@@ -712,7 +1766,12 @@ memtx_engine_commit_checkpoint(struct engine *engine, struct vclock *vclock)
 
 	memtx_tuple_end_snapshot();
 
+	struct checkpoint *ckpt = memtx->checkpoint;
+	memtx->checkpoint_version = ckpt->version;
+
 	if (!memtx->checkpoint->touch) {
+		memtx->checkpoint_delta_count = ckpt->is_delta ?
+			memtx->checkpoint_delta_count + 1 : 0;
 		int64_t lsn = vclock_sum(memtx->checkpoint->vclock);
 		struct xdir *dir = &memtx->checkpoint->dir;
 		/* rename snapshot on completion */
@@ -755,6 +1814,17 @@ memtx_engine_abort_checkpoint(struct engine *engine)
 
 	memtx_tuple_end_snapshot();
 
+	struct checkpoint *ckpt = memtx->checkpoint;
+	if (!ckpt->is_delta) {
+		/* Deletes since the previous checkpoint are lost. */
+		memtx->checkpoint_needs_full = true;
+		memtx_deleted_keys_free(&memtx->deleted_keys);
+	} else if (!memtx->checkpoint_needs_full) {
+		/* Give the deleted keys back to the next delta. */
+		stailq_concat(&ckpt->deleted_keys, &memtx->deleted_keys);
+		stailq_concat(&memtx->deleted_keys, &ckpt->deleted_keys);
+	}
+
 	/** Remove garbage .inprogress file. */
 	char *filename =
 		xdir_format_filename(&memtx->checkpoint->dir,
@@ -777,7 +1847,20 @@ memtx_engine_collect_garbage(struct engine *engine, int64_t lsn)
 	 * file would result in a corrupted checkpoint on the list.
 	 * That said, we have to abort garbage collection if we
 	 * fail to delete a snap file.
+	 *
+	 * A delta checkpoint can't be restored without the
+	 * snapshots it is based on, so keep the whole chain.
+	 * If the chain can't be read, keep all snapshots, but
+	 * let the WAL be collected: it isn't needed to restore
+	 * the checkpoint.
 	 */
+	int64_t *chain;
+	if (memtx_engine_snapshot_chain(memtx, lsn, &chain) < 0) {
+		diag_log();
+		return 0;
+	}
+	lsn = chain[0];
+	free(chain);
 	if (xdir_collect_garbage(&memtx->snap_dir, lsn, true) != 0)
 		return -1;
 
@@ -789,38 +1872,37 @@ memtx_engine_backup(struct engine *engine, struct vclock *vclock,
 		    engine_backup_cb cb, void *cb_arg)
 {
 	struct memtx_engine *memtx = (struct memtx_engine *)engine;
-	char *filename = xdir_format_filename(&memtx->snap_dir,
-					      vclock_sum(vclock), NONE);
-	return cb(filename, cb_arg);
+	int64_t *chain;
+	int chain_len = memtx_engine_snapshot_chain(memtx, vclock_sum(vclock),
+						    &chain);
+	if (chain_len < 0)
+		return -1;
+	int rc = 0;
+	for (int i = 0; i < chain_len && rc == 0; i++) {
+		char *filename = xdir_format_filename(&memtx->snap_dir,
+						      chain[i], NONE);
+		rc = cb(filename, cb_arg);
+	}
+	free(chain);
+	return rc;
 }
 
 /** Used to pass arguments to memtx_initial_join_f */
 struct memtx_join_arg {
 	const char *snap_dirname;
-	int64_t checkpoint_lsn;
+	/** Snapshots to send, @sa memtx_engine_snapshot_chain(). */
+	int64_t *chain;
+	int chain_len;
 	struct xstream *stream;
 };
 
-/**
- * Invoked from a thread to feed snapshot rows.
- */
+/** Send all rows of a snapshot file to the joining replica. */
 static int
-memtx_initial_join_f(va_list ap)
+memtx_initial_join_send(struct xdir *dir, int64_t signature,
+			struct xstream *stream)
 {
-	struct memtx_join_arg *arg = va_arg(ap, struct memtx_join_arg *);
-	const char *snap_dirname = arg->snap_dirname;
-	int64_t checkpoint_lsn = arg->checkpoint_lsn;
-	struct xstream *stream = arg->stream;
-
-	struct xdir dir;
-	/*
-	 * snap_dirname and INSTANCE_UUID don't change after start,
-	 * safe to use in another thread.
-	 */
-	xdir_create(&dir, snap_dirname, SNAP, &INSTANCE_UUID);
 	struct xlog_cursor cursor;
-	int rc = xdir_open_cursor(&dir, checkpoint_lsn, &cursor);
-	xdir_destroy(&dir);
+	int rc = xdir_open_cursor(dir, signature, &cursor);
 	if (rc < 0)
 		return -1;
 
@@ -845,25 +1927,62 @@ memtx_initial_join_f(va_list ap)
 	return 0;
 }
 
+/**
+ * Invoked from a thread to feed snapshot rows.
+ */
+static int
+memtx_initial_join_f(va_list ap)
+{
+	struct memtx_join_arg *arg = va_arg(ap, struct memtx_join_arg *);
+	const char *snap_dirname = arg->snap_dirname;
+	struct xstream *stream = arg->stream;
+
+	struct xdir dir;
+	/*
+	 * snap_dirname and INSTANCE_UUID don't change after start,
+	 * safe to use in another thread.
+	 */
+	xdir_create(&dir, snap_dirname, SNAP, &INSTANCE_UUID);
+	/*
+	 * A delta checkpoint is sent as is, after the snapshots
+	 * it is based on: the replica applies REPLACE and DELETE
+	 * rows of deltas the same way as local recovery does.
+	 */
+	int rc = 0;
+	for (int i = 0; i < arg->chain_len && rc == 0; i++)
+		rc = memtx_initial_join_send(&dir, arg->chain[i], stream);
+	xdir_destroy(&dir);
+	return rc;
+}
+
 static int
 memtx_engine_join(struct engine *engine, struct vclock *vclock,
 		  struct xstream *stream)
 {
 	struct memtx_engine *memtx = (struct memtx_engine *)engine;
 
+	int64_t *chain;
+	int chain_len = memtx_engine_snapshot_chain(memtx, vclock_sum(vclock),
+						    &chain);
+	if (chain_len < 0)
+		return -1;
+
 	/*
 	 * cord_costart() passes only void * pointer as an argument.
 	 */
 	struct memtx_join_arg arg = {
 		/* .snap_dirname   = */ memtx->snap_dir.dirname,
-		/* .checkpoint_lsn = */ vclock_sum(vclock),
+		/* .chain          = */ chain,
+		/* .chain_len      = */ chain_len,
 		/* .stream         = */ stream
 	};
 
 	/* Send snapshot using a thread */
 	struct cord cord;
 	cord_costart(&cord, "initial_join", memtx_initial_join_f, &arg);
-	return cord_cojoin(&cord);
+	int rc = cord_cojoin(&cord);
+	free(chain);
+	return rc;
 }
 
 static int
@@ -921,6 +2040,9 @@ memtx_engine_new(const char *snap_dirname, bool force_recovery,
 
 	memtx->state = MEMTX_INITIALIZED;
 	memtx->force_recovery = force_recovery;
+	memtx->checkpoint_needs_full = true;
+	memtx->checkpoint_threads = 1;
+	stailq_create(&memtx->deleted_keys);
 
 	memtx->base.vtab = &memtx_engine_vtab;
 	memtx->base.name = "memtx";
@@ -940,6 +2062,26 @@ memtx_engine_set_max_tuple_size(struct memtx_engine *memtx, size_t max_size)
 	memtx_max_tuple_size = max_size;
 }
 
+void
+memtx_engine_set_checkpoint_deltas(struct memtx_engine *memtx, int deltas)
+{
+	/*
+	 * Deleted keys aren't tracked while deltas are disabled,
+	 * so the first checkpoint after enabling must be full.
+	 */
+	if (memtx->checkpoint_deltas == 0 || deltas == 0) {
+		memtx->checkpoint_needs_full = true;
+		memtx_deleted_keys_free(&memtx->deleted_keys);
+	}
+	memtx->checkpoint_deltas = deltas;
+}
+
+void
+memtx_engine_set_checkpoint_threads(struct memtx_engine *memtx, int threads)
+{
+	memtx->checkpoint_threads = threads;
+}
+
 /**
  * Initialize arena for indexes.
  * The arena is used for memtx_index_extent_alloc
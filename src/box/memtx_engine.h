@@ -34,6 +34,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <small/mempool.h>
+#include "salad/stailq.h"
 
 #include "engine.h"
 #include "xlog.h"
@@ -79,6 +80,11 @@ enum memtx_recovery_state {
 /** Memtx extents pool, available to statistics. */
 extern struct mempool memtx_index_extent_pool;
 
+enum {
+	/** Max number of threads writing a checkpoint. */
+	MEMTX_CHECKPOINT_THREADS_MAX = 32,
+};
+
 struct memtx_engine {
 	struct engine base;
 	/** Engine recovery state. */
@@ -91,6 +97,38 @@ struct memtx_engine {
 	uint64_t snap_io_rate_limit;
 	/** Skip invalid snapshot records if this flag is set. */
 	bool force_recovery;
+	/**
+	 * Max number of delta checkpoints written in a row
+	 * after a full one, box.cfg.memtx_checkpoint_deltas.
+	 * A delta checkpoint only stores tuples changed since
+	 * the previous checkpoint. Zero disables deltas.
+	 */
+	int checkpoint_deltas;
+	/** Number of deltas the last checkpoint is based on. */
+	int checkpoint_delta_count;
+	/**
+	 * Set if the next checkpoint can't be a delta, because
+	 * the changes since the last one aren't fully tracked:
+	 * e.g. there was DDL or deltas were disabled.
+	 */
+	bool checkpoint_needs_full;
+	/**
+	 * Snapshot version of the last checkpoint. Tuples of this
+	 * or a newer version were created after its read view.
+	 */
+	uint32_t checkpoint_version;
+	/**
+	 * Keys of tuples deleted since the last checkpoint
+	 * began, linked by memtx_deleted_key::in_list.
+	 */
+	struct stailq deleted_keys;
+	/**
+	 * Number of threads writing a checkpoint,
+	 * box.cfg.memtx_checkpoint_threads. User spaces
+	 * are distributed among the threads, which encode
+	 * and compress rows in parallel.
+	 */
+	int checkpoint_threads;
 	/** Memory pool for tree index iterator. */
 	struct mempool tree_iterator_pool;
 	/** Memory pool for rtree index iterator. */
@@ -116,6 +154,20 @@ memtx_engine_set_snap_io_rate_limit(struct memtx_engine *memtx, double limit);
 void
 memtx_engine_set_max_tuple_size(struct memtx_engine *memtx, size_t max_size);
 
+void
+memtx_engine_set_checkpoint_deltas(struct memtx_engine *memtx, int deltas);
+
+void
+memtx_engine_set_checkpoint_threads(struct memtx_engine *memtx, int threads);
+
+/**
+ * Finish bulk loading of the primary keys and switch to
+ * REPLACE/DELETE mode, so that rows of a delta snapshot
+ * can be applied on top of the loaded data.
+ */
+void
+memtx_engine_begin_delta_recovery(struct memtx_engine *memtx);
+
 enum {
 	MEMTX_EXTENT_SIZE = 16 * 1024,
 	MEMTX_SLAB_SIZE = 4 * 1024 * 1024
@@ -334,17 +334,25 @@ hash_snapshot_iterator_free(struct snapshot_iterator *iterator)
  * Virtual method of snapshot iterator.
  * @sa index_vtab::create_snapshot_iterator.
  */
-static const char *
-hash_snapshot_iterator_next(struct snapshot_iterator *iterator, uint32_t *size)
+static int
+hash_snapshot_iterator_next(struct snapshot_iterator *iterator,
+			    const char **data, uint32_t *size)
 {
 	assert(iterator->free == hash_snapshot_iterator_free);
 	struct hash_snapshot_iterator *it =
 		(struct hash_snapshot_iterator *) iterator;
-	struct tuple **res = light_index_iterator_get_and_next(it->hash_table,
-							       &it->iterator);
-	if (res == NULL)
-		return NULL;
-	return tuple_data_range(*res, size);
+	struct tuple **res;
+	do {
+		res = light_index_iterator_get_and_next(it->hash_table,
+							&it->iterator);
+		if (res == NULL) {
+			*data = NULL;
+			return 0;
+		}
+	} while (iterator->filter != NULL &&
+		 !iterator->filter(*res, iterator->filter_arg));
+	*data = tuple_data_range(*res, size);
+	return *data != NULL ? 0 : -1;
 }
 
 /**
@@ -385,6 +393,8 @@ static const struct index_vtab memtx_hash_index_vtab = {
 	/* .get = */ memtx_hash_index_get,
 	/* .replace = */ memtx_hash_index_replace,
 	/* .create_iterator = */ memtx_hash_index_create_iterator,
+	/* .create_iterator_with_offset = */
+		generic_index_create_iterator_with_offset,
 	/* .create_snapshot_iterator = */
 		memtx_hash_index_create_snapshot_iterator,
 	/* .info = */ generic_index_info,
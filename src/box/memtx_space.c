@@ -30,6 +30,7 @@
  */
 #include "memtx_space.h"
 #include "space.h"
+#include "memtx_engine.h"
 #include "iproto_constants.h"
 #include "txn.h"
 #include "tuple_compare.h"
@@ -293,7 +294,15 @@ dup_replace_mode(uint32_t op)
 static int
 memtx_space_apply_initial_join_row(struct space *space, struct request *request)
 {
-	if (request->type != IPROTO_INSERT) {
+	/*
+	 * Delta snapshots contain REPLACE and DELETE rows, which
+	 * need the primary key to be built.
+	 */
+	if (request->type == IPROTO_REPLACE ||
+	    request->type == IPROTO_DELETE) {
+		memtx_engine_begin_delta_recovery(
+			(struct memtx_engine *)space->engine);
+	} else if (request->type != IPROTO_INSERT) {
 		diag_set(ClientError, ER_UNKNOWN_REQUEST_TYPE, request->type);
 		return -1;
 	}
@@ -302,7 +311,12 @@ memtx_space_apply_initial_join_row(struct space *space, struct request *request)
 	if (txn == NULL)
 		return -1;
 	struct tuple *unused;
-	if (space_execute_replace(space, txn, request, &unused) != 0) {
+	int rc;
+	if (request->type == IPROTO_DELETE)
+		rc = space_execute_delete(space, txn, request, &unused);
+	else
+		rc = space_execute_replace(space, txn, request, &unused);
+	if (rc != 0) {
 		say_error("rollback: %s", diag_last_error(diag_get())->errmsg);
 		txn_rollback_stmt();
 		return -1;
@@ -377,6 +391,8 @@ memtx_space_execute_update(struct space *space, struct txn *txn,
 	/* Update the tuple; legacy, request ops are in request->tuple */
 	uint32_t new_size = 0, bsize;
 	const char *old_data = tuple_data_range(stmt->old_tuple, &bsize);
+	if (old_data == NULL)
+		return -1;
 	const char *new_data =
 		tuple_update_execute(region_aligned_alloc_cb, &fiber()->gc,
 				     request->tuple, request->tuple_end,
@@ -460,6 +476,8 @@ memtx_space_execute_upsert(struct space *space, struct txn *txn,
 		uint32_t new_size = 0, bsize;
 		const char *old_data = tuple_data_range(stmt->old_tuple,
 							&bsize);
+		if (old_data == NULL)
+			return -1;
 		/*
 		 * Update the tuple.
 		 * tuple_upsert_execute() fails on totally wrong
@@ -796,6 +814,19 @@ memtx_space_build_secondary_key(struct space *old_space,
 		rc = tuple_validate(new_space->format, tuple);
 		if (rc != 0)
 			break;
+		/*
+		 * Index keys are read without decompression,
+		 * see tuple_data_for_key(). A tuple created
+		 * before the index may have the key fields in
+		 * its compressed tail.
+		 */
+		if (!tuple_key_is_uncompressed(tuple,
+					       new_index->def->key_def)) {
+			diag_set(ClientError, ER_UNSUPPORTED, "memtx",
+				 "indexing fields stored compressed");
+			rc = -1;
+			break;
+		}
 		/*
 		 * @todo: better message if there is a duplicate.
 		 */
@@ -940,6 +971,7 @@ memtx_space_new(struct memtx_engine *memtx,
 		return NULL;
 	}
 	format->exact_field_count = def->exact_field_count;
+	format->compress_threshold = def->opts.compress_threshold;
 	tuple_format_ref(format);
 
 	if (space_create((struct space *)memtx_space, (struct engine *)memtx,
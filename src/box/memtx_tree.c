@@ -43,8 +43,18 @@
 static int
 memtx_tree_qcompare(const void* a, const void *b, void *c)
 {
-	return tuple_compare(*(struct tuple **)a,
-		*(struct tuple **)b, (struct key_def *)c);
+	return memtx_tree_compare(*(struct memtx_tree_data *)a,
+		*(struct memtx_tree_data *)b, (struct key_def *)c);
+}
+
+/** Make a tree element of a tuple. */
+static inline struct memtx_tree_data
+memtx_tree_data_new(struct memtx_tree_index *index, struct tuple *tuple)
+{
+	struct memtx_tree_data data;
+	data.tuple = tuple;
+	data.hint = tuple_hint(tuple, index->tree.arg);
+	return data;
 }
 
 /* {{{ MemtxTree Iterators ****************************************/
@@ -55,7 +65,10 @@ struct tree_iterator {
 	struct memtx_tree_iterator tree_iterator;
 	enum iterator_type type;
 	struct memtx_tree_key_data key_data;
-	struct tuple *current_tuple;
+	/** Last returned element. */
+	struct memtx_tree_data current;
+	/** Number of tuples to skip on start. */
+	uint32_t offset;
 	/** Memory pool the iterator was allocated from. */
 	struct mempool *pool;
 };
@@ -74,8 +87,8 @@ static void
 tree_iterator_free(struct iterator *iterator)
 {
 	struct tree_iterator *it = tree_iterator(iterator);
-	if (it->current_tuple != NULL)
-		tuple_unref(it->current_tuple);
+	if (it->current.tuple != NULL)
+		tuple_unref(it->current.tuple);
 	mempool_free(it->pool, it);
 }
 
@@ -90,25 +103,27 @@ tree_iterator_dummie(struct iterator *iterator, struct tuple **ret)
 static int
 tree_iterator_next(struct iterator *iterator, struct tuple **ret)
 {
-	struct tuple **res;
+	struct memtx_tree_data *res;
 	struct tree_iterator *it = tree_iterator(iterator);
-	assert(it->current_tuple != NULL);
-	struct tuple **check = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
-	if (check == NULL || *check != it->current_tuple)
+	assert(it->current.tuple != NULL);
+	struct memtx_tree_data *check =
+		memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
+	if (check == NULL || check->tuple != it->current.tuple)
 		it->tree_iterator =
-			memtx_tree_upper_bound_elem(it->tree, it->current_tuple,
+			memtx_tree_upper_bound_elem(it->tree, it->current,
 						    NULL);
 	else
 		memtx_tree_iterator_next(it->tree, &it->tree_iterator);
-	tuple_unref(it->current_tuple);
-	it->current_tuple = NULL;
+	tuple_unref(it->current.tuple);
+	it->current.tuple = NULL;
 	res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
 	if (res == NULL) {
 		iterator->next = tree_iterator_dummie;
 		*ret = NULL;
 	} else {
-		*ret = it->current_tuple = *res;
-		tuple_ref(it->current_tuple);
+		it->current = *res;
+		*ret = it->current.tuple;
+		tuple_ref(it->current.tuple);
 	}
 	return 0;
 }
@@ -117,22 +132,25 @@ static int
 tree_iterator_prev(struct iterator *iterator, struct tuple **ret)
 {
 	struct tree_iterator *it = tree_iterator(iterator);
-	assert(it->current_tuple != NULL);
-	struct tuple **check = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
-	if (check == NULL || *check != it->current_tuple)
+	assert(it->current.tuple != NULL);
+	struct memtx_tree_data *check =
+		memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
+	if (check == NULL || check->tuple != it->current.tuple)
 		it->tree_iterator =
-			memtx_tree_lower_bound_elem(it->tree, it->current_tuple,
+			memtx_tree_lower_bound_elem(it->tree, it->current,
 						    NULL);
 	memtx_tree_iterator_prev(it->tree, &it->tree_iterator);
-	tuple_unref(it->current_tuple);
-	it->current_tuple = NULL;
-	struct tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
+	tuple_unref(it->current.tuple);
+	it->current.tuple = NULL;
+	struct memtx_tree_data *res =
+		memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
 	if (!res) {
 		iterator->next = tree_iterator_dummie;
 		*ret = NULL;
 	} else {
-		*ret = it->current_tuple = *res;
-		tuple_ref(it->current_tuple);
+		it->current = *res;
+		*ret = it->current.tuple;
+		tuple_ref(it->current.tuple);
 	}
 	return 0;
 }
@@ -141,27 +159,28 @@ static int
 tree_iterator_next_equal(struct iterator *iterator, struct tuple **ret)
 {
 	struct tree_iterator *it = tree_iterator(iterator);
-	assert(it->current_tuple != NULL);
-	struct tuple **check = memtx_tree_iterator_get_elem(it->tree,
-						&it->tree_iterator);
-	if (check == NULL || *check != it->current_tuple)
+	assert(it->current.tuple != NULL);
+	struct memtx_tree_data *check =
+		memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
+	if (check == NULL || check->tuple != it->current.tuple)
 		it->tree_iterator =
-			memtx_tree_upper_bound_elem(it->tree, it->current_tuple,
+			memtx_tree_upper_bound_elem(it->tree, it->current,
 						    NULL);
 	else
 		memtx_tree_iterator_next(it->tree, &it->tree_iterator);
-	tuple_unref(it->current_tuple);
-	it->current_tuple = NULL;
-	struct tuple **res = memtx_tree_iterator_get_elem(it->tree,
-						&it->tree_iterator);
+	tuple_unref(it->current.tuple);
+	it->current.tuple = NULL;
+	struct memtx_tree_data *res =
+		memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
 	/* Use user key def to save a few loops. */
 	if (!res || memtx_tree_compare_key(*res, &it->key_data,
 					   it->index_def->key_def) != 0) {
 		iterator->next = tree_iterator_dummie;
 		*ret = NULL;
 	} else {
-		*ret = it->current_tuple = *res;
-		tuple_ref(it->current_tuple);
+		it->current = *res;
+		*ret = it->current.tuple;
+		tuple_ref(it->current.tuple);
 	}
 	return 0;
 }
@@ -170,26 +189,27 @@ static int
 tree_iterator_prev_equal(struct iterator *iterator, struct tuple **ret)
 {
 	struct tree_iterator *it = tree_iterator(iterator);
-	assert(it->current_tuple != NULL);
-	struct tuple **check = memtx_tree_iterator_get_elem(it->tree,
-						&it->tree_iterator);
-	if (check == NULL || *check != it->current_tuple)
+	assert(it->current.tuple != NULL);
+	struct memtx_tree_data *check =
+		memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
+	if (check == NULL || check->tuple != it->current.tuple)
 		it->tree_iterator =
-			memtx_tree_lower_bound_elem(it->tree, it->current_tuple,
+			memtx_tree_lower_bound_elem(it->tree, it->current,
 						    NULL);
 	memtx_tree_iterator_prev(it->tree, &it->tree_iterator);
-	tuple_unref(it->current_tuple);
-	it->current_tuple = NULL;
-	struct tuple **res = memtx_tree_iterator_get_elem(it->tree,
-						&it->tree_iterator);
+	tuple_unref(it->current.tuple);
+	it->current.tuple = NULL;
+	struct memtx_tree_data *res =
+		memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
 	/* Use user key def to save a few loops. */
 	if (!res || memtx_tree_compare_key(*res, &it->key_data,
 					   it->index_def->key_def) != 0) {
 		iterator->next = tree_iterator_dummie;
 		*ret = NULL;
 	} else {
-		*ret = it->current_tuple = *res;
-		tuple_ref(it->current_tuple);
+		it->current = *res;
+		*ret = it->current.tuple;
+		tuple_ref(it->current.tuple);
 	}
 	return 0;
 }
@@ -197,7 +217,7 @@ tree_iterator_prev_equal(struct iterator *iterator, struct tuple **ret)
 static void
 tree_iterator_set_next_method(struct tree_iterator *it)
 {
-	assert(it->current_tuple != NULL);
+	assert(it->current.tuple != NULL);
 	switch (it->type) {
 	case ITER_EQ:
 		it->base.next = tree_iterator_next_equal;
@@ -231,24 +251,36 @@ tree_iterator_start(struct iterator *iterator, struct tuple **ret)
 	const struct memtx_tree *tree = it->tree;
 	enum iterator_type type = it->type;
 	bool exact = false;
-	assert(it->current_tuple == NULL);
+	/* Number of tuples preceding the found bound. */
+	size_t bound = 0;
+	assert(it->current.tuple == NULL);
 	if (it->key_data.key == 0) {
-		if (iterator_type_is_reverse(it->type))
+		if (iterator_type_is_reverse(it->type)) {
 			it->tree_iterator = memtx_tree_iterator_last(tree);
-		else
+			bound = memtx_tree_size(tree);
+		} else {
 			it->tree_iterator = memtx_tree_iterator_first(tree);
+		}
 	} else {
+		/*
+		 * Calculating the offset of the bound costs a few
+		 * extra block reads, so do it only if we need it.
+		 */
 		if (type == ITER_ALL || type == ITER_EQ ||
 		    type == ITER_GE || type == ITER_LT) {
-			it->tree_iterator =
+			it->tree_iterator = it->offset == 0 ?
 				memtx_tree_lower_bound(tree, &it->key_data,
-						       &exact);
+						       &exact) :
+				memtx_tree_lower_bound_get_offset(tree,
+						&it->key_data, &exact, &bound);
 			if (type == ITER_EQ && !exact)
 				return 0;
 		} else { // ITER_GT, ITER_REQ, ITER_LE
-			it->tree_iterator =
+			it->tree_iterator = it->offset == 0 ?
 				memtx_tree_upper_bound(tree, &it->key_data,
-						       &exact);
+						       &exact) :
+				memtx_tree_upper_bound_get_offset(tree,
+						&it->key_data, &exact, &bound);
 			if (type == ITER_REQ && !exact)
 				return 0;
 		}
@@ -267,13 +299,32 @@ tree_iterator_start(struct iterator *iterator, struct tuple **ret)
 			memtx_tree_iterator_prev(it->tree, &it->tree_iterator);
 		}
 	}
+	if (it->offset > 0) {
+		/*
+		 * Jump over the skipped tuples instead of
+		 * iterating over them.
+		 */
+		if (!iterator_type_is_reverse(type)) {
+			bound += it->offset;
+		} else if (bound > it->offset) {
+			bound -= it->offset + 1;
+		} else {
+			return 0;
+		}
+		it->tree_iterator = memtx_tree_iterator_at(tree, bound);
+	}
 
-	struct tuple **res = memtx_tree_iterator_get_elem(it->tree,
-						&it->tree_iterator);
+	struct memtx_tree_data *res =
+		memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
 	if (!res)
 		return 0;
-	*ret = it->current_tuple = *res;
-	tuple_ref(it->current_tuple);
+	if (it->offset > 0 && (type == ITER_EQ || type == ITER_REQ) &&
+	    memtx_tree_compare_key(*res, &it->key_data,
+				   it->index_def->key_def) != 0)
+		return 0;
+	it->current = *res;
+	*ret = it->current.tuple;
+	tuple_ref(it->current.tuple);
 	tree_iterator_set_next_method(it);
 	return 0;
 }
@@ -309,8 +360,8 @@ static int
 memtx_tree_index_random(struct index *base, uint32_t rnd, struct tuple **result)
 {
 	struct memtx_tree_index *index = (struct memtx_tree_index *)base;
-	struct tuple **res = memtx_tree_random(&index->tree, rnd);
-	*result = res != NULL ? *res : NULL;
+	struct memtx_tree_data *res = memtx_tree_random(&index->tree, rnd);
+	*result = res != NULL ? res->tuple : NULL;
 	return 0;
 }
 
@@ -318,9 +369,41 @@ static ssize_t
 memtx_tree_index_count(struct index *base, enum iterator_type type,
 		       const char *key, uint32_t part_count)
 {
-	if (type == ITER_ALL)
+	struct memtx_tree_index *index = (struct memtx_tree_index *)base;
+	if (type == ITER_ALL || part_count == 0)
 		return memtx_tree_index_size(base); /* optimization */
-	return generic_index_count(base, type, key, part_count);
+	struct memtx_tree_key_data key_data;
+	key_data.key = key;
+	key_data.part_count = part_count;
+	key_data.hint = key_hint(key, part_count, index->tree.arg);
+	size_t lower, upper;
+	switch (type) {
+	case ITER_EQ:
+	case ITER_REQ:
+		memtx_tree_lower_bound_get_offset(&index->tree, &key_data,
+						  NULL, &lower);
+		memtx_tree_upper_bound_get_offset(&index->tree, &key_data,
+						  NULL, &upper);
+		return upper - lower;
+	case ITER_GE:
+		memtx_tree_lower_bound_get_offset(&index->tree, &key_data,
+						  NULL, &lower);
+		return memtx_tree_size(&index->tree) - lower;
+	case ITER_GT:
+		memtx_tree_upper_bound_get_offset(&index->tree, &key_data,
+						  NULL, &upper);
+		return memtx_tree_size(&index->tree) - upper;
+	case ITER_LT:
+		memtx_tree_lower_bound_get_offset(&index->tree, &key_data,
+						  NULL, &lower);
+		return lower;
+	case ITER_LE:
+		memtx_tree_upper_bound_get_offset(&index->tree, &key_data,
+						  NULL, &upper);
+		return upper;
+	default:
+		return generic_index_count(base, type, key, part_count);
+	}
 }
 
 static int
@@ -333,8 +416,9 @@ memtx_tree_index_get(struct index *base, const char *key,
 	struct memtx_tree_key_data key_data;
 	key_data.key = key;
 	key_data.part_count = part_count;
-	struct tuple **res = memtx_tree_find(&index->tree, &key_data);
-	*result = res != NULL ? *res : NULL;
+	key_data.hint = key_hint(key, part_count, index->tree.arg);
+	struct memtx_tree_data *res = memtx_tree_find(&index->tree, &key_data);
+	*result = res != NULL ? res->tuple : NULL;
 	return 0;
 }
 
@@ -345,23 +429,28 @@ memtx_tree_index_replace(struct index *base, struct tuple *old_tuple,
 {
 	struct memtx_tree_index *index = (struct memtx_tree_index *)base;
 	if (new_tuple) {
-		struct tuple *dup_tuple = NULL;
+		struct memtx_tree_data new_data =
+			memtx_tree_data_new(index, new_tuple);
+		struct memtx_tree_data dup_data;
+		dup_data.tuple = NULL;
+		dup_data.hint = HINT_NONE;
 
 		/* Try to optimistically replace the new_tuple. */
 		int tree_res = memtx_tree_insert(&index->tree,
-						 new_tuple, &dup_tuple);
+						 new_data, &dup_data);
 		if (tree_res) {
 			diag_set(OutOfMemory, MEMTX_EXTENT_SIZE,
 				 "memtx_tree_index", "replace");
 			return -1;
 		}
 
+		struct tuple *dup_tuple = dup_data.tuple;
 		uint32_t errcode = replace_check_dup(old_tuple,
 						     dup_tuple, mode);
 		if (errcode) {
-			memtx_tree_delete(&index->tree, new_tuple);
+			memtx_tree_delete(&index->tree, new_data);
 			if (dup_tuple)
-				memtx_tree_insert(&index->tree, dup_tuple, 0);
+				memtx_tree_insert(&index->tree, dup_data, 0);
 			struct space *sp = space_cache_find(base->def->space_id);
 			if (sp != NULL)
 				diag_set(ClientError, errcode, base->def->name,
@@ -374,15 +463,19 @@ memtx_tree_index_replace(struct index *base, struct tuple *old_tuple,
 		}
 	}
 	if (old_tuple) {
-		memtx_tree_delete(&index->tree, old_tuple);
+		memtx_tree_delete(&index->tree,
+				  memtx_tree_data_new(index, old_tuple));
 	}
 	*result = old_tuple;
 	return 0;
 }
 
 static struct iterator *
-memtx_tree_index_create_iterator(struct index *base, enum iterator_type type,
-				 const char *key, uint32_t part_count)
+memtx_tree_index_create_iterator_with_offset(struct index *base,
+					     enum iterator_type type,
+					     const char *key,
+					     uint32_t part_count,
+					     uint32_t offset)
 {
 	struct memtx_tree_index *index = (struct memtx_tree_index *)base;
 	struct memtx_engine *memtx = (struct memtx_engine *)base->engine;
@@ -416,13 +509,23 @@ memtx_tree_index_create_iterator(struct index *base, enum iterator_type type,
 	it->type = type;
 	it->key_data.key = key;
 	it->key_data.part_count = part_count;
+	it->key_data.hint = key_hint(key, part_count, index->tree.arg);
 	it->index_def = base->def;
 	it->tree = &index->tree;
 	it->tree_iterator = memtx_tree_invalid_iterator();
-	it->current_tuple = NULL;
+	it->current.tuple = NULL;
+	it->offset = offset;
 	return (struct iterator *)it;
 }
 
+static struct iterator *
+memtx_tree_index_create_iterator(struct index *base, enum iterator_type type,
+				 const char *key, uint32_t part_count)
+{
+	return memtx_tree_index_create_iterator_with_offset(base, type, key,
+							    part_count, 0);
+}
+
 static void
 memtx_tree_index_begin_build(struct index *base)
 {
@@ -437,8 +540,8 @@ memtx_tree_index_reserve(struct index *base, uint32_t size_hint)
 	struct memtx_tree_index *index = (struct memtx_tree_index *)base;
 	if (size_hint < index->build_array_alloc_size)
 		return 0;
-	struct tuple **tmp = (struct tuple **)realloc(index->build_array,
-						      size_hint * sizeof(*tmp));
+	struct memtx_tree_data *tmp = (struct memtx_tree_data *)
+		realloc(index->build_array, size_hint * sizeof(*tmp));
 	if (tmp == NULL) {
 		diag_set(OutOfMemory, size_hint * sizeof(*tmp),
 			 "memtx_tree_index", "reserve");
@@ -454,20 +557,21 @@ memtx_tree_index_build_next(struct index *base, struct tuple *tuple)
 {
 	struct memtx_tree_index *index = (struct memtx_tree_index *)base;
 	if (index->build_array == NULL) {
-		index->build_array = (struct tuple **)malloc(MEMTX_EXTENT_SIZE);
+		index->build_array =
+			(struct memtx_tree_data *)malloc(MEMTX_EXTENT_SIZE);
 		if (index->build_array == NULL) {
 			diag_set(OutOfMemory, MEMTX_EXTENT_SIZE,
 				 "memtx_tree_index", "build_next");
 			return -1;
 		}
 		index->build_array_alloc_size =
-			MEMTX_EXTENT_SIZE / sizeof(struct tuple*);
+			MEMTX_EXTENT_SIZE / sizeof(struct memtx_tree_data);
 	}
 	assert(index->build_array_size <= index->build_array_alloc_size);
 	if (index->build_array_size == index->build_array_alloc_size) {
 		index->build_array_alloc_size = index->build_array_alloc_size +
 					index->build_array_alloc_size / 2;
-		struct tuple **tmp = (struct tuple **)
+		struct memtx_tree_data *tmp = (struct memtx_tree_data *)
 			realloc(index->build_array,
 				index->build_array_alloc_size * sizeof(*tmp));
 		if (tmp == NULL) {
@@ -477,20 +581,30 @@ memtx_tree_index_build_next(struct index *base, struct tuple *tuple)
 		}
 		index->build_array = tmp;
 	}
-	index->build_array[index->build_array_size++] = tuple;
+	index->build_array[index->build_array_size++] =
+		memtx_tree_data_new(index, tuple);
 	return 0;
 }
 
-static void
-memtx_tree_index_end_build(struct index *base)
+void
+memtx_tree_index_sort_build_array(struct memtx_tree_index *index)
 {
-	struct memtx_tree_index *index = (struct memtx_tree_index *)base;
+	struct index_def *def = index->base.def;
 	/** Use extended key def only for non-unique indexes. */
-	struct key_def *cmp_def = base->def->opts.is_unique ?
-			base->def->key_def : base->def->cmp_def;
+	struct key_def *cmp_def = def->opts.is_unique ?
+			def->key_def : def->cmp_def;
 	qsort_arg(index->build_array, index->build_array_size,
-		  sizeof(struct tuple *),
+		  sizeof(struct memtx_tree_data),
 		  memtx_tree_qcompare, cmp_def);
+	index->build_array_is_sorted = true;
+}
+
+static void
+memtx_tree_index_end_build(struct index *base)
+{
+	struct memtx_tree_index *index = (struct memtx_tree_index *)base;
+	if (!index->build_array_is_sorted)
+		memtx_tree_index_sort_build_array(index);
 	memtx_tree_build(&index->tree, index->build_array,
 			 index->build_array_size);
 
@@ -498,6 +612,7 @@ memtx_tree_index_end_build(struct index *base)
 	index->build_array = NULL;
 	index->build_array_size = 0;
 	index->build_array_alloc_size = 0;
+	index->build_array_is_sorted = false;
 }
 
 struct tree_snapshot_iterator {
@@ -517,18 +632,26 @@ tree_snapshot_iterator_free(struct snapshot_iterator *iterator)
 	free(iterator);
 }
 
-static const char *
-tree_snapshot_iterator_next(struct snapshot_iterator *iterator, uint32_t *size)
+static int
+tree_snapshot_iterator_next(struct snapshot_iterator *iterator,
+			    const char **data, uint32_t *size)
 {
 	assert(iterator->free == tree_snapshot_iterator_free);
 	struct tree_snapshot_iterator *it =
 		(struct tree_snapshot_iterator *)iterator;
-	struct tuple **res = memtx_tree_iterator_get_elem(it->tree,
-						&it->tree_iterator);
-	if (res == NULL)
-		return NULL;
-	memtx_tree_iterator_next(it->tree, &it->tree_iterator);
-	return tuple_data_range(*res, size);
+	struct memtx_tree_data *res;
+	do {
+		res = memtx_tree_iterator_get_elem(it->tree,
+						   &it->tree_iterator);
+		if (res == NULL) {
+			*data = NULL;
+			return 0;
+		}
+		memtx_tree_iterator_next(it->tree, &it->tree_iterator);
+	} while (iterator->filter != NULL &&
+		 !iterator->filter(res->tuple, iterator->filter_arg));
+	*data = tuple_data_range(res->tuple, size);
+	return *data != NULL ? 0 : -1;
 }
 
 /**
@@ -569,6 +692,8 @@ static const struct index_vtab memtx_tree_index_vtab = {
 	/* .get = */ memtx_tree_index_get,
 	/* .replace = */ memtx_tree_index_replace,
 	/* .create_iterator = */ memtx_tree_index_create_iterator,
+	/* .create_iterator_with_offset = */
+		memtx_tree_index_create_iterator_with_offset,
 	/* .create_snapshot_iterator = */
 		memtx_tree_index_create_snapshot_iterator,
 	/* .info = */ generic_index_info,
@@ -618,3 +743,9 @@ memtx_tree_index_new(struct memtx_engine *memtx, struct index_def *def)
 			  memtx_index_extent_free, NULL);
 	return index;
 }
+
+bool
+index_is_memtx_tree(struct index *index)
+{
+	return index->vtab == &memtx_tree_index_vtab;
+}
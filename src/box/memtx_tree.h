@@ -52,12 +52,43 @@ struct memtx_tree_key_data
 	const char *key;
 	/** Number of msgpacked search fields */
 	uint32_t part_count;
+	/** Comparison hint of the key, see key_hint(). */
+	hint_t hint;
 };
 
+/**
+ * Struct that is used as an element in BPS tree definition.
+ * The comparison hint of the tuple is stored next to the
+ * tuple pointer so that most comparisons done on descent
+ * don't have to touch the tuple.
+ */
+struct memtx_tree_data
+{
+	/** Indexed tuple. */
+	struct tuple *tuple;
+	/** Comparison hint of the tuple, see tuple_hint(). */
+	hint_t hint;
+};
+
+/**
+ * BPS tree element comparator.
+ * @param a, b - elements to compare.
+ * @param def - key definition.
+ * @retval 0  if a == b in terms of def.
+ * @retval <0 if a < b in terms of def.
+ * @retval >0 if a > b in terms of def.
+ */
+static inline int
+memtx_tree_compare(struct memtx_tree_data a, struct memtx_tree_data b,
+		   struct key_def *def)
+{
+	return tuple_compare_hinted(a.tuple, a.hint, b.tuple, b.hint, def);
+}
+
 /**
  * BPS tree element vs key comparator.
  * Defined in header in order to allow compiler to inline it.
- * @param tuple - tuple to compare.
+ * @param data - element to compare.
  * @param key_data - key to compare with.
  * @param def - key definition.
  * @retval 0  if tuple == key in terms of def.
@@ -65,22 +96,27 @@ struct memtx_tree_key_data
  * @retval >0 if tuple > key in terms of def.
  */
 static inline int
-memtx_tree_compare_key(const struct tuple *tuple,
+memtx_tree_compare_key(struct memtx_tree_data data,
 		       const struct memtx_tree_key_data *key_data,
 		       struct key_def *def)
 {
-	return tuple_compare_with_key(tuple, key_data->key,
-				      key_data->part_count, def);
+	return tuple_compare_with_key_hinted(data.tuple, data.hint,
+					     key_data->key,
+					     key_data->part_count,
+					     key_data->hint, def);
 }
 
 #define BPS_TREE_NAME memtx_tree
 #define BPS_TREE_BLOCK_SIZE (512)
 #define BPS_TREE_EXTENT_SIZE MEMTX_EXTENT_SIZE
-#define BPS_TREE_COMPARE(a, b, arg) tuple_compare(a, b, arg)
+#define BPS_TREE_COMPARE(a, b, arg) memtx_tree_compare(a, b, arg)
 #define BPS_TREE_COMPARE_KEY(a, b, arg) memtx_tree_compare_key(a, b, arg)
-#define bps_tree_elem_t struct tuple *
+#define BPS_TREE_IDENTICAL(a, b) ((a).tuple == (b).tuple)
+#define bps_tree_elem_t struct memtx_tree_data
 #define bps_tree_key_t struct memtx_tree_key_data *
 #define bps_tree_arg_t struct key_def *
+/* Keep subtree sizes for logarithmic count() and offset. */
+#define BPS_INNER_CARD
 
 #include "salad/bps_tree.h"
 
@@ -89,20 +125,37 @@ memtx_tree_compare_key(const struct tuple *tuple,
 #undef BPS_TREE_EXTENT_SIZE
 #undef BPS_TREE_COMPARE
 #undef BPS_TREE_COMPARE_KEY
+#undef BPS_TREE_IDENTICAL
 #undef bps_tree_elem_t
 #undef bps_tree_key_t
 #undef bps_tree_arg_t
+#undef BPS_INNER_CARD
 
 struct memtx_tree_index {
 	struct index base;
 	struct memtx_tree tree;
-	struct tuple **build_array;
+	struct memtx_tree_data *build_array;
 	size_t build_array_size, build_array_alloc_size;
+	/** Set if build_array has already been sorted. */
+	bool build_array_is_sorted;
 };
 
 struct memtx_tree_index *
 memtx_tree_index_new(struct memtx_engine *memtx, struct index_def *def);
 
+/** Return true if the given index is a memtx tree index. */
+bool
+index_is_memtx_tree(struct index *index);
+
+/**
+ * Sort tuples accumulated by index_build_next() so that
+ * index_end_build() only has to build the tree. Touches
+ * nothing but the build array and the tuples, so it may be
+ * called from a thread other than tx.
+ */
+void
+memtx_tree_index_sort_build_array(struct memtx_tree_index *index);
+
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif /* defined(__cplusplus) */
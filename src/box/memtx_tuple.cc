@@ -31,6 +31,8 @@
 
 #include "memtx_tuple.h"
 
+#include <zstd.h>
+
 #include "small/small.h"
 #include "small/region.h"
 #include "small/quota.h"
@@ -60,11 +62,15 @@ struct small_alloc memtx_alloc; /* used box box.slab.info() */
 /* The maximal allowed tuple size, box.cfg.memtx_max_tuple_size */
 size_t memtx_max_tuple_size = 1 * 1024 * 1024; /* set dynamically */
 uint32_t snapshot_version;
+/** zstd context to compress tuples with, created on demand. */
+static ZSTD_CCtx *memtx_tuple_cctx;
 
 enum {
 	/** Lowest allowed slab_alloc_minimal */
 	OBJSIZE_MIN = 16,
 	SLAB_SIZE = 16 * 1024 * 1024,
+	/** zstd level to compress tuples with. */
+	MEMTX_TUPLE_COMPRESSION_LEVEL = 1,
 };
 
 void
@@ -86,12 +92,63 @@ memtx_tuple_init(uint64_t tuple_arena_max_size, uint32_t objsize_min,
 void
 memtx_tuple_free(void)
 {
+	ZSTD_freeCCtx(memtx_tuple_cctx);
+	memtx_tuple_cctx = NULL;
 }
 
 struct tuple_format_vtab memtx_tuple_format_vtab = {
 	memtx_tuple_delete,
 };
 
+/**
+ * Compress the fields of the tuple data which follow the indexed
+ * ones.
+ * @param format tuple format.
+ * @param data tuple data.
+ * @param end the end of @a data.
+ * @param[out] hdr header of the compressed tuple.
+ * @retval not NULL the compressed tail, allocated on the fiber
+ *         region, hdr->zsize bytes long.
+ * @retval NULL the data is not worth compressing.
+ */
+static const char *
+memtx_tuple_compress(struct tuple_format *format, const char *data,
+		     const char *end, struct tuple_compressed *hdr)
+{
+	const char *pos = data;
+	uint32_t field_count = mp_decode_array(&pos);
+	hdr->head_field_count = MIN(field_count, format->index_field_count);
+	for (uint32_t i = 0; i < hdr->head_field_count; i++)
+		mp_next(&pos);
+	hdr->head_size = pos - data;
+	size_t tail_size = end - pos;
+	if (memtx_tuple_cctx == NULL) {
+		memtx_tuple_cctx = ZSTD_createCCtx();
+		if (memtx_tuple_cctx == NULL)
+			return NULL;
+	}
+	size_t bound = ZSTD_compressBound(tail_size);
+	char *buf = (char *) region_alloc(&fiber()->gc, bound);
+	if (buf == NULL)
+		return NULL;
+	size_t zsize = ZSTD_compressCCtx(memtx_tuple_cctx, buf, bound,
+					 pos, tail_size,
+					 MEMTX_TUPLE_COMPRESSION_LEVEL);
+	if (ZSTD_isError(zsize) ||
+	    zsize + sizeof(struct tuple_compressed) >= tail_size)
+		return NULL;
+	hdr->zsize = zsize;
+	return buf;
+}
+
+/** Size of the memory allocated for a memtx tuple. */
+static inline size_t
+memtx_tuple_alloc_size(const struct tuple *tuple)
+{
+	return sizeof(struct memtx_tuple) - sizeof(struct tuple) +
+	       tuple_size(tuple);
+}
+
 struct tuple *
 memtx_tuple_new(struct tuple_format *format, const char *data, const char *end)
 {
@@ -111,6 +168,23 @@ memtx_tuple_new(struct tuple_format *format, const char *data, const char *end)
 		return NULL;
 	}
 
+	/*
+	 * Store the tuple compressed if the space asks so and
+	 * compression saves memory.
+	 */
+	struct tuple_compressed hdr;
+	const char *zdata = NULL;
+	size_t region_svp = region_used(&fiber()->gc);
+	if (format->compress_threshold != 0 &&
+	    tuple_len >= format->compress_threshold &&
+	    sizeof(struct tuple) + sizeof(hdr) + meta_size <= UINT16_MAX) {
+		zdata = memtx_tuple_compress(format, data, end, &hdr);
+		if (zdata != NULL) {
+			total = sizeof(struct memtx_tuple) + sizeof(hdr) +
+				meta_size + hdr.head_size + hdr.zsize;
+		}
+	}
+
 	struct memtx_tuple *memtx_tuple =
 		(struct memtx_tuple *) smalloc(&memtx_alloc, total);
 	/**
@@ -122,6 +196,7 @@ memtx_tuple_new(struct tuple_format *format, const char *data, const char *end)
 	 * of disaster recovery.
 	 */
 	if (memtx_tuple == NULL) {
+		region_truncate(&fiber()->gc, region_svp);
 		diag_set(OutOfMemory, (unsigned) total,
 				 "slab allocator", "memtx_tuple");
 		return NULL;
@@ -129,7 +204,7 @@ memtx_tuple_new(struct tuple_format *format, const char *data, const char *end)
 	struct tuple *tuple = &memtx_tuple->base;
 	tuple->refs = 0;
 	memtx_tuple->version = snapshot_version;
-	assert(tuple_len <= UINT32_MAX); /* bsize is UINT32_MAX */
+	assert(tuple_len <= INT32_MAX); /* bsize is 31 bits */
 	tuple->bsize = tuple_len;
 	tuple->format_id = tuple_format_id(format);
 	tuple_format_ref(format);
@@ -139,10 +214,27 @@ memtx_tuple_new(struct tuple_format *format, const char *data, const char *end)
 	 * tuple is not the first field of the memtx_tuple.
 	 */
 	tuple->data_offset = sizeof(struct tuple) + meta_size;
+	tuple->is_compressed = false;
+	if (zdata != NULL) {
+		tuple->data_offset += sizeof(hdr);
+		tuple->is_compressed = true;
+		memcpy(tuple + 1, &hdr, sizeof(hdr));
+	}
 	char *raw = (char *) tuple + tuple->data_offset;
 	uint32_t *field_map = (uint32_t *) raw;
-	memcpy(raw, data, tuple_len);
-	if (tuple_init_field_map(format, field_map, raw)) {
+	if (zdata != NULL) {
+		memcpy(raw, data, hdr.head_size);
+		memcpy(raw + hdr.head_size, zdata, hdr.zsize);
+	} else {
+		memcpy(raw, data, tuple_len);
+	}
+	region_truncate(&fiber()->gc, region_svp);
+	/*
+	 * Field map offsets are relative to the beginning of
+	 * the data, so the map can be built from the original
+	 * data for a compressed tuple too.
+	 */
+	if (tuple_init_field_map(format, field_map, data)) {
 		memtx_tuple_delete(format, tuple);
 		return NULL;
 	}
@@ -155,8 +247,9 @@ memtx_tuple_delete(struct tuple_format *format, struct tuple *tuple)
 {
 	say_debug("%s(%p)", __func__, tuple);
 	assert(tuple->refs == 0);
-	size_t total = sizeof(struct memtx_tuple) +
-		       tuple_format_meta_size(format) + tuple->bsize;
+	size_t total = memtx_tuple_alloc_size(tuple);
+	if (tuple->is_compressed)
+		tuple_decompress_forget(tuple);
 	tuple_format_unref(format);
 	struct memtx_tuple *memtx_tuple =
 		container_of(tuple, struct memtx_tuple, base);
@@ -167,11 +260,32 @@ memtx_tuple_delete(struct tuple_format *format, struct tuple *tuple)
 		smfree_delayed(&memtx_alloc, memtx_tuple, total);
 }
 
-void
+uint32_t
+memtx_tuple_version(const struct tuple *tuple)
+{
+	const struct memtx_tuple *memtx_tuple =
+		container_of(tuple, struct memtx_tuple, base);
+	return memtx_tuple->version;
+}
+
+bool
+memtx_tuple_is_new(const struct tuple *tuple)
+{
+	return memtx_tuple_version(tuple) == snapshot_version;
+}
+
+uint32_t
+memtx_tuple_next_version()
+{
+	return ++snapshot_version;
+}
+
+uint32_t
 memtx_tuple_begin_snapshot()
 {
-	snapshot_version++;
+	uint32_t version = memtx_tuple_next_version();
 	small_alloc_setopt(&memtx_alloc, SMALL_DELAYED_FREE_MODE, true);
+	return version;
 }
 
 void
@@ -69,7 +69,31 @@ extern size_t memtx_max_tuple_size;
 /** tuple format vtab for memtx engine. */
 extern struct tuple_format_vtab memtx_tuple_format_vtab;
 
-void
+/** Snapshot version of a memtx tuple, i.e. when it was created. */
+uint32_t
+memtx_tuple_version(const struct tuple *tuple);
+
+/**
+ * Return true if the tuple was created after the current
+ * snapshot version was started, i.e. it can't be in any
+ * snapshot read view.
+ */
+bool
+memtx_tuple_is_new(const struct tuple *tuple);
+
+/**
+ * Start a new tuple generation: tuples created from now on
+ * get a new snapshot version, which is returned.
+ */
+uint32_t
+memtx_tuple_next_version();
+
+/**
+ * Start a new tuple generation and delay freeing of tuples
+ * of older generations until memtx_tuple_end_snapshot().
+ * Returns the new snapshot version.
+ */
+uint32_t
 memtx_tuple_begin_snapshot();
 
 void
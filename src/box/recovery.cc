@@ -151,6 +151,14 @@ recovery_close_log(struct recovery *r)
 	trigger_run_xc(&r->on_close_log, NULL);
 }
 
+void
+recovery_skip_log(struct recovery *r)
+{
+	if (xlog_cursor_is_open(&r->cursor))
+		xlog_cursor_close(&r->cursor, false);
+	trigger_run_xc(&r->on_close_log, NULL);
+}
+
 void
 recovery_delete(struct recovery *r)
 {
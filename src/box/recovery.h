@@ -100,4 +100,15 @@ void
 recover_remaining_wals(struct recovery *r, struct xstream *stream,
 		       struct vclock *stop_vclock, bool scan_dir);
 
+/**
+ * Stop reading the current WAL, because rows following
+ * the recovery position are fetched from elsewhere, and
+ * run on_close_log triggers so that WALs preceding the
+ * recovery position can be collected. Recovery from files
+ * can be resumed with recover_remaining_wals(): it will
+ * reopen the WAL containing the recovery position.
+ */
+void
+recovery_skip_log(struct recovery *r);
+
 #endif /* TARANTOOL_RECOVERY_H_INCLUDED */
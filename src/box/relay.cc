@@ -280,9 +280,36 @@ relay_process_wal_event(struct wal_watcher *watcher, unsigned events)
 		 */
 		return;
 	}
+	struct recovery *r = relay->r;
 	try {
-		recover_remaining_wals(relay->r, &relay->stream, NULL,
-				       (events & WAL_EVENT_ROTATE) != 0);
+		/*
+		 * Try to send recent rows from memory first and
+		 * fall back on reading xlog files if the replica
+		 * is lagging behind the in-memory WAL tail.
+		 */
+		int rc = wal_relay_tail(&r->vclock, &relay->stream);
+		if (rc < 0)
+			diag_raise();
+		if (rc > 0) {
+			/*
+			 * Rescan the WAL directory if no xlog is
+			 * open, since we might have been streaming
+			 * rows from memory for a while.
+			 */
+			bool scan_dir = (events & WAL_EVENT_ROTATE) != 0 ||
+					!xlog_cursor_is_open(&r->cursor);
+			recover_remaining_wals(r, &relay->stream, NULL,
+					       scan_dir);
+		} else if (xlog_cursor_is_open(&r->cursor) ||
+			   (events & WAL_EVENT_ROTATE) != 0) {
+			/*
+			 * Rows are streamed from memory, so
+			 * release the xlog we were reading and
+			 * let the garbage collector know that
+			 * the replica doesn't need old xlogs.
+			 */
+			recovery_skip_log(r);
+		}
 	} catch (Exception *e) {
 		e->log();
 		diag_move(diag_get(), &relay->diag);
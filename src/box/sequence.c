@@ -272,8 +272,9 @@ struct sequence_data_iterator {
 #define SEQUENCE_TUPLE_BUF_SIZE		(mp_sizeof_array(2) + \
 					 2 * mp_sizeof_uint(UINT64_MAX))
 
-static const char *
-sequence_data_iterator_next(struct snapshot_iterator *base, uint32_t *size)
+static int
+sequence_data_iterator_next(struct snapshot_iterator *base,
+			    const char **data_out, uint32_t *size)
 {
 	struct sequence_data_iterator *iter =
 		(struct sequence_data_iterator *)base;
@@ -281,8 +282,10 @@ sequence_data_iterator_next(struct snapshot_iterator *base, uint32_t *size)
 	struct sequence_data *data =
 		light_sequence_iterator_get_and_next(&sequence_data_index,
 						     &iter->iter);
-	if (data == NULL)
-		return NULL;
+	if (data == NULL) {
+		*data_out = NULL;
+		return 0;
+	}
 
 	char *buf_end = iter->tuple;
 	buf_end = mp_encode_array(buf_end, 2);
@@ -292,7 +295,8 @@ sequence_data_iterator_next(struct snapshot_iterator *base, uint32_t *size)
 		   mp_encode_int(buf_end, data->value));
 	assert(buf_end <= iter->tuple + SEQUENCE_TUPLE_BUF_SIZE);
 	*size = buf_end - iter->tuple;
-	return iter->tuple;
+	*data_out = iter->tuple;
+	return 0;
 }
 
 static void
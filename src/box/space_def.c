@@ -34,11 +34,14 @@
 
 const struct space_opts space_opts_default = {
 	/* .temporary = */ false,
+	/* .compress_threshold = */ 0,
 	/* .sql        = */ NULL,
 };
 
 const struct opt_def space_opts_reg[] = {
 	OPT_DEF("temporary", OPT_BOOL, struct space_opts, temporary),
+	OPT_DEF("compress_threshold", OPT_UINT32, struct space_opts,
+		compress_threshold),
 	OPT_DEF("sql", OPT_STRPTR, struct space_opts, sql),
 	OPT_END,
 };
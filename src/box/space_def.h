@@ -49,6 +49,12 @@ struct space_opts {
 	 * - changes are not part of a snapshot
 	 */
 	bool temporary;
+	/**
+	 * If not 0, memtx stores tuples which are at least
+	 * this many bytes long compressed. Indexed fields are
+	 * kept uncompressed.
+	 */
+	uint32_t compress_threshold;
 	/**
 	 * SQL statement that produced this space.
 	 */
@@ -30,10 +30,14 @@
  */
 #include "tuple.h"
 
+#include <zstd.h>
+
 #include "trivia/util.h"
 #include "memory.h"
 #include "fiber.h"
 #include "tt_uuid.h"
+#include "tt_pthread.h"
+#include "assoc.h"
 #include "small/quota.h"
 #include "small/small.h"
 
@@ -50,6 +54,12 @@ enum {
 
 static const double ALLOC_FACTOR = 1.05;
 
+/**
+ * Per-thread zstd context to decompress tuples with. Compressed
+ * tuples are read in tx and in the snapshot thread.
+ */
+static pthread_key_t tuple_dctx_key;
+
 /**
  * Last tuple returned by public C API
  * \sa tuple_bless()
@@ -92,6 +102,7 @@ tuple_new(struct tuple_format *format, const char *data, const char *end)
 	tuple->format_id = tuple_format_id(format);
 	tuple_format_ref(format);
 	tuple->data_offset = sizeof(struct tuple) + meta_size;
+	tuple->is_compressed = false;
 	char *raw = (char *) tuple + tuple->data_offset;
 	uint32_t *field_map = (uint32_t *) raw;
 	memcpy(raw, data, data_len);
@@ -115,6 +126,275 @@ runtime_tuple_delete(struct tuple_format *format, struct tuple *tuple)
 	smfree(&runtime_alloc, tuple, total);
 }
 
+static void
+tuple_dctx_delete(void *dctx)
+{
+	ZSTD_freeDCtx((ZSTD_DCtx *) dctx);
+}
+
+int
+tuple_decompress_to(const struct tuple *tuple, char *buf)
+{
+	const struct tuple_compressed *hdr = tuple_compressed(tuple);
+	const char *head = tuple_data_raw(tuple);
+	memcpy(buf, head, hdr->head_size);
+	ZSTD_DCtx *dctx = (ZSTD_DCtx *) pthread_getspecific(tuple_dctx_key);
+	if (dctx == NULL) {
+		dctx = ZSTD_createDCtx();
+		if (dctx == NULL) {
+			diag_set(OutOfMemory, sizeof(dctx), "malloc",
+				 "zstd context");
+			return -1;
+		}
+		tt_pthread_setspecific(tuple_dctx_key, dctx);
+	}
+	size_t tail_size = tuple->bsize - hdr->head_size;
+	size_t rc = ZSTD_decompressDCtx(dctx, buf + hdr->head_size, tail_size,
+					head + hdr->head_size, hdr->zsize);
+	if (ZSTD_isError(rc)) {
+		diag_set(ClientError, ER_DECOMPRESSION, ZSTD_getErrorName(rc));
+		return -1;
+	}
+	if (rc != tail_size) {
+		diag_set(ClientError, ER_DECOMPRESSION, "tuple size mismatch");
+		return -1;
+	}
+	return 0;
+}
+
+/** Decompressed data of a tuple kept in the tx cache. */
+struct tuple_dcache_entry {
+	/** Compressed tuple, not referenced. */
+	const struct tuple *tuple;
+	/**
+	 * tuple->bsize bytes of MessagePack or NULL if a pinned
+	 * tuple hasn't been decompressed yet.
+	 */
+	char *data;
+	/**
+	 * Number of times the tuple is pinned. A pinned entry is
+	 * not in tuple_dcache_lru and is never evicted.
+	 */
+	uint32_t pins;
+	/** Link in tuple_dcache_lru. */
+	struct rlist in_lru;
+};
+
+enum {
+	/** Memory unpinned entries of the tx cache may take. */
+	TUPLE_DCACHE_SIZE = 4 * 1024 * 1024,
+	/**
+	 * Number of most recently decompressed tuples which are
+	 * never evicted, whatever their size.
+	 */
+	TUPLE_DCACHE_MIN_COUNT = 16,
+};
+
+/** Compressed tuple -> struct tuple_dcache_entry. */
+static struct mh_i64ptr_t *tuple_dcache;
+/** Unpinned entries with data, most recently used first. */
+static struct rlist tuple_dcache_lru;
+/** Total size of decompressed data in tuple_dcache_lru. */
+static size_t tuple_dcache_size;
+/** Number of entries in tuple_dcache_lru. */
+static uint32_t tuple_dcache_count;
+
+static inline bool
+tuple_dcache_entry_in_lru(struct tuple_dcache_entry *entry)
+{
+	return entry->pins == 0 && entry->data != NULL;
+}
+
+static void
+tuple_dcache_lru_add(struct tuple_dcache_entry *entry)
+{
+	rlist_add_entry(&tuple_dcache_lru, entry, in_lru);
+	tuple_dcache_size += entry->tuple->bsize;
+	tuple_dcache_count++;
+}
+
+static void
+tuple_dcache_lru_del(struct tuple_dcache_entry *entry)
+{
+	rlist_del_entry(entry, in_lru);
+	tuple_dcache_size -= entry->tuple->bsize;
+	tuple_dcache_count--;
+}
+
+static void
+tuple_dcache_delete_entry(struct tuple_dcache_entry *entry, mh_int_t k)
+{
+	mh_i64ptr_del(tuple_dcache, k, NULL);
+	if (tuple_dcache_entry_in_lru(entry))
+		tuple_dcache_lru_del(entry);
+	free(entry->data);
+	free(entry);
+}
+
+static void
+tuple_dcache_evict(void)
+{
+	while (tuple_dcache_size > TUPLE_DCACHE_SIZE &&
+	       tuple_dcache_count > TUPLE_DCACHE_MIN_COUNT) {
+		struct tuple_dcache_entry *entry =
+			rlist_last_entry(&tuple_dcache_lru,
+					 struct tuple_dcache_entry, in_lru);
+		mh_int_t k = mh_i64ptr_find(tuple_dcache,
+					    (uint64_t) (uintptr_t) entry->tuple,
+					    NULL);
+		assert(k != mh_end(tuple_dcache));
+		tuple_dcache_delete_entry(entry, k);
+	}
+}
+
+/** Find or create a cache entry of a tuple, without data. */
+static struct tuple_dcache_entry *
+tuple_dcache_entry(const struct tuple *tuple)
+{
+	uint64_t key = (uint64_t) (uintptr_t) tuple;
+	mh_int_t k = mh_i64ptr_find(tuple_dcache, key, NULL);
+	if (k != mh_end(tuple_dcache))
+		return (struct tuple_dcache_entry *)
+			mh_i64ptr_node(tuple_dcache, k)->val;
+	struct tuple_dcache_entry *entry = (struct tuple_dcache_entry *)
+		malloc(sizeof(*entry));
+	if (entry == NULL) {
+		diag_set(OutOfMemory, sizeof(*entry), "malloc",
+			 "tuple_dcache_entry");
+		return NULL;
+	}
+	entry->tuple = tuple;
+	entry->data = NULL;
+	entry->pins = 0;
+	struct mh_i64ptr_node_t node = { key, entry };
+	if (mh_i64ptr_put(tuple_dcache, &node, NULL, NULL) ==
+	    mh_end(tuple_dcache)) {
+		diag_set(OutOfMemory, sizeof(node), "mh_i64ptr_put",
+			 "mh_i64ptr_node_t");
+		free(entry);
+		return NULL;
+	}
+	return entry;
+}
+
+/** Delete an entry which is neither pinned nor has data. */
+static void
+tuple_dcache_entry_drop(struct tuple_dcache_entry *entry)
+{
+	assert(entry->pins == 0 && entry->data == NULL);
+	mh_int_t k = mh_i64ptr_find(tuple_dcache,
+				    (uint64_t) (uintptr_t) entry->tuple, NULL);
+	assert(k != mh_end(tuple_dcache));
+	tuple_dcache_delete_entry(entry, k);
+}
+
+/** Look up or decompress a tuple to the tx cache. */
+static const char *
+tuple_dcache_get(const struct tuple *tuple)
+{
+	struct tuple_dcache_entry *entry = tuple_dcache_entry(tuple);
+	if (entry == NULL)
+		return NULL;
+	if (entry->data != NULL) {
+		if (entry->pins == 0)
+			rlist_move_entry(&tuple_dcache_lru, entry, in_lru);
+		return entry->data;
+	}
+	char *data = (char *) malloc(tuple->bsize);
+	if (data == NULL) {
+		diag_set(OutOfMemory, tuple->bsize, "malloc", "tuple data");
+		goto fail;
+	}
+	if (tuple_decompress_to(tuple, data) != 0) {
+		free(data);
+		goto fail;
+	}
+	entry->data = data;
+	if (entry->pins == 0) {
+		tuple_dcache_lru_add(entry);
+		tuple_dcache_evict();
+	}
+	return data;
+fail:
+	if (entry->pins == 0)
+		tuple_dcache_entry_drop(entry);
+	return NULL;
+}
+
+const char *
+tuple_decompress(const struct tuple *tuple)
+{
+	if (cord_is_main())
+		return tuple_dcache_get(tuple);
+	/*
+	 * Other threads (checkpoint, initial join) read tuples
+	 * one by one and truncate the fiber region after each.
+	 */
+	char *buf = (char *) region_alloc(&fiber()->gc, tuple->bsize);
+	if (buf == NULL) {
+		diag_set(OutOfMemory, tuple->bsize, "region",
+			 "tuple data");
+		return NULL;
+	}
+	if (tuple_decompress_to(tuple, buf) != 0)
+		return NULL;
+	return buf;
+}
+
+int
+tuple_decompress_pin(const struct tuple *tuple)
+{
+	assert(cord_is_main());
+	assert(tuple->is_compressed);
+	/* Decompression is deferred to the first data access. */
+	struct tuple_dcache_entry *entry = tuple_dcache_entry(tuple);
+	if (entry == NULL)
+		return -1;
+	if (tuple_dcache_entry_in_lru(entry))
+		tuple_dcache_lru_del(entry);
+	entry->pins++;
+	return 0;
+}
+
+void
+tuple_decompress_unpin(const struct tuple *tuple)
+{
+	assert(cord_is_main());
+	assert(tuple->is_compressed);
+	if (tuple_dcache == NULL)
+		return; /* tuple_free() was called */
+	mh_int_t k = mh_i64ptr_find(tuple_dcache,
+				    (uint64_t) (uintptr_t) tuple, NULL);
+	assert(k != mh_end(tuple_dcache));
+	struct tuple_dcache_entry *entry = (struct tuple_dcache_entry *)
+		mh_i64ptr_node(tuple_dcache, k)->val;
+	assert(entry->pins > 0);
+	if (--entry->pins > 0)
+		return;
+	if (entry->data == NULL) {
+		tuple_dcache_delete_entry(entry, k);
+		return;
+	}
+	tuple_dcache_lru_add(entry);
+	tuple_dcache_evict();
+}
+
+void
+tuple_decompress_forget(const struct tuple *tuple)
+{
+	assert(cord_is_main());
+	if (tuple_dcache == NULL)
+		return; /* tuple_free() was called */
+	mh_int_t k = mh_i64ptr_find(tuple_dcache,
+				    (uint64_t) (uintptr_t) tuple, NULL);
+	if (k == mh_end(tuple_dcache))
+		return;
+	struct tuple_dcache_entry *entry = (struct tuple_dcache_entry *)
+		mh_i64ptr_node(tuple_dcache, k)->val;
+	assert(entry->pins == 0);
+	tuple_dcache_delete_entry(entry, k);
+}
+
 int
 tuple_validate_raw(struct tuple_format *format, const char *tuple)
 {
@@ -161,7 +441,17 @@ tuple_validate_raw(struct tuple_format *format, const char *tuple)
 const char *
 tuple_seek(struct tuple_iterator *it, uint32_t fieldno)
 {
-	const char *field = tuple_field(it->tuple, fieldno);
+	if (unlikely(it->end == NULL))
+		return NULL; /* tuple_rewind() failed */
+	/*
+	 * Don't use tuple_field(): it returns the head of a
+	 * compressed tuple as stored, not the data the iterator
+	 * walks through.
+	 */
+	const char *data = it->end - it->tuple->bsize;
+	const char *field = tuple_field_raw(tuple_format(it->tuple), data,
+					    tuple_field_map(it->tuple),
+					    fieldno);
 	if (likely(field != NULL)) {
 		it->pos = field;
 		it->fieldno = fieldno;
@@ -233,7 +523,7 @@ tuple_extract_key_sequential(const struct tuple *tuple,
 			     uint32_t *key_size)
 {
 	assert(key_def_is_sequential(key_def));
-	const char *data = tuple_data(tuple);
+	const char *data = tuple_data_for_key(tuple, key_def);
 	return tuple_extract_key_sequential_raw(data, NULL, key_def, key_size);
 }
 
@@ -245,7 +535,7 @@ static char *
 tuple_extract_key_slowpath(const struct tuple *tuple,
 			   const struct key_def *key_def, uint32_t *key_size)
 {
-	const char *data = tuple_data(tuple);
+	const char *data = tuple_data_for_key(tuple, key_def);
 	uint32_t part_count = key_def->part_count;
 	uint32_t bsize = mp_sizeof_array(part_count);
 	const struct tuple_format *format = tuple_format(tuple);
@@ -404,6 +694,15 @@ tuple_init(field_name_hash_f hash)
 
 	box_tuple_last = NULL;
 
+	tt_pthread_key_create(&tuple_dctx_key, tuple_dctx_delete);
+	rlist_create(&tuple_dcache_lru);
+	tuple_dcache = mh_i64ptr_new();
+	if (tuple_dcache == NULL) {
+		diag_set(OutOfMemory, sizeof(*tuple_dcache), "malloc",
+			 "tuple_dcache");
+		return -1;
+	}
+
 	if (coll_cache_init() != 0)
 		return -1;
 
@@ -448,6 +747,8 @@ tuple_free(void)
 {
 	/* Unref last tuple returned by public C API */
 	if (box_tuple_last != NULL) {
+		if (box_tuple_last->is_compressed)
+			tuple_decompress_unpin(box_tuple_last);
 		tuple_unref(box_tuple_last);
 		box_tuple_last = NULL;
 	}
@@ -458,6 +759,22 @@ tuple_free(void)
 	tuple_format_free();
 
 	coll_cache_destroy();
+
+	mh_int_t k;
+	mh_foreach(tuple_dcache, k) {
+		struct tuple_dcache_entry *entry = (struct tuple_dcache_entry *)
+			mh_i64ptr_node(tuple_dcache, k)->val;
+		free(entry->data);
+		free(entry);
+	}
+	rlist_create(&tuple_dcache_lru);
+	tuple_dcache_size = 0;
+	tuple_dcache_count = 0;
+	mh_i64ptr_delete(tuple_dcache);
+	tuple_dcache = NULL;
+
+	tuple_dctx_delete(pthread_getspecific(tuple_dctx_key));
+	tt_pthread_setspecific(tuple_dctx_key, NULL);
 }
 
 box_tuple_format_t *
@@ -481,13 +798,26 @@ int
 box_tuple_ref(box_tuple_t *tuple)
 {
 	assert(tuple != NULL);
-	return tuple_ref(tuple);
+	if (tuple_ref(tuple) != 0)
+		return -1;
+	/*
+	 * Data returned for a referenced tuple must stay valid
+	 * until it is unreferenced.
+	 */
+	if (unlikely(tuple->is_compressed) &&
+	    tuple_decompress_pin(tuple) != 0) {
+		tuple_unref(tuple);
+		return -1;
+	}
+	return 0;
 }
 
 void
 box_tuple_unref(box_tuple_t *tuple)
 {
 	assert(tuple != NULL);
+	if (unlikely(tuple->is_compressed))
+		tuple_decompress_unpin(tuple);
 	return tuple_unref(tuple);
 }
 
@@ -510,6 +840,8 @@ tuple_to_buf(const struct tuple *tuple, char *buf, size_t size)
 {
 	uint32_t bsize;
 	const char *data = tuple_data_range(tuple, &bsize);
+	if (data == NULL)
+		return -1;
 	if (likely(bsize <= size)) {
 		memcpy(buf, data, bsize);
 	}
@@ -550,18 +882,22 @@ box_tuple_iterator(box_tuple_t *tuple)
 			 "mempool", "new slab");
 		return NULL;
 	}
-	if (tuple_ref(tuple) != 0) {
+	if (box_tuple_ref(tuple) != 0) {
+		mempool_free(&tuple_iterator_pool, it);
+		return NULL;
+	}
+	if (tuple_rewind(it, tuple) != 0) {
+		box_tuple_unref(tuple);
 		mempool_free(&tuple_iterator_pool, it);
 		return NULL;
 	}
-	tuple_rewind(it, tuple);
 	return it;
 }
 
 void
 box_tuple_iterator_free(box_tuple_iterator_t *it)
 {
-	tuple_unref(it->tuple);
+	box_tuple_unref(it->tuple);
 	mempool_free(&tuple_iterator_pool, it);
 }
 
@@ -574,7 +910,7 @@ box_tuple_position(box_tuple_iterator_t *it)
 void
 box_tuple_rewind(box_tuple_iterator_t *it)
 {
-	tuple_rewind(it, it->tuple);
+	(void) tuple_rewind(it, it->tuple);
 }
 
 const char *
@@ -597,6 +933,8 @@ box_tuple_update(const box_tuple_t *tuple, const char *expr,
 
 	uint32_t new_size = 0, bsize;
 	const char *old_data = tuple_data_range(tuple, &bsize);
+	if (old_data == NULL)
+		return NULL;
 	struct region *region = &fiber()->gc;
 	size_t used = region_used(region);
 	const char *new_data =
@@ -623,6 +961,8 @@ box_tuple_upsert(const box_tuple_t *tuple, const char *expr,
 
 	uint32_t new_size = 0, bsize;
 	const char *old_data = tuple_data_range(tuple, &bsize);
+	if (old_data == NULL)
+		return NULL;
 	struct region *region = &fiber()->gc;
 	size_t used = region_used(region);
 	const char *new_data =
@@ -659,7 +999,12 @@ tuple_snprint(char *buf, int size, const struct tuple *tuple)
 		SNPRINT(total, snprintf, buf, size, "<NULL>");
 		return total;
 	}
-	SNPRINT(total, mp_snprint, buf, size, tuple_data(tuple));
+	const char *data = tuple_data(tuple);
+	if (data == NULL) {
+		SNPRINT(total, snprintf, buf, size, "<failed to decompress>");
+		return total;
+	}
+	SNPRINT(total, mp_snprint, buf, size, data);
 	return total;
 }
 
@@ -312,6 +312,22 @@ box_tuple_extract_key(const box_tuple_t *tuple, uint32_t space_id,
  *    @sa tuple_format_new()   uint32  ...  uint32
  *
  * Each 'off_i' is the offset to the i-th indexed field.
+ *
+ * A compressed tuple (is_compressed is set) stores its
+ * MessagePack in two parts: the head, which is the original array
+ * header followed by the first head_field_count fields as is, and
+ * the rest of the fields compressed with zstd:
+ *
+ * +-------------------------+------------+------+--------------+
+ * | struct tuple_compressed | tuple_meta | head | zstd(tail)   |
+ * +-------------------------+------------+------+--------------+
+ *                                        ^
+ *                                   data_offset
+ *
+ * Field map offsets are the same as in the uncompressed tuple,
+ * so indexed fields, which are always in the head, are accessed
+ * without decompression. bsize is the size of the uncompressed
+ * MessagePack.
  */
 struct PACKED tuple
 {
@@ -323,7 +339,9 @@ struct PACKED tuple
 	 * Length of the MessagePack data in raw part of the
 	 * tuple.
 	 */
-	uint32_t bsize;
+	uint32_t bsize:31;
+	/** True if the tail of the MessagePack is compressed. */
+	uint32_t is_compressed:1;
 	/**
 	 * Offset to the MessagePack from the begin of the tuple.
 	 */
@@ -335,25 +353,173 @@ struct PACKED tuple
 	 */
 };
 
+/** Header of a compressed tuple, follows struct tuple. */
+struct PACKED tuple_compressed {
+	/** Size of the uncompressed head of the MessagePack. */
+	uint32_t head_size;
+	/** Number of fields stored in the head. */
+	uint32_t head_field_count;
+	/** Size of the compressed tail. */
+	uint32_t zsize;
+};
+
+/** Return the header of a compressed tuple. */
+static inline const struct tuple_compressed *
+tuple_compressed(const struct tuple *tuple)
+{
+	assert(tuple->is_compressed);
+	return (const struct tuple_compressed *) (tuple + 1);
+}
+
 /** Size of the tuple including size of struct tuple. */
 static inline size_t
 tuple_size(const struct tuple *tuple)
 {
 	/* data_offset includes sizeof(struct tuple). */
+	if (tuple->is_compressed) {
+		const struct tuple_compressed *hdr = tuple_compressed(tuple);
+		return tuple->data_offset + hdr->head_size + hdr->zsize;
+	}
 	return tuple->data_offset + tuple->bsize;
 }
 
 /**
- * Get pointer to MessagePack data of the tuple.
+ * Get pointer to the MessagePack data of the tuple as it is
+ * stored. If the tuple is compressed, only the head of the
+ * data can be read.
  * @param tuple tuple.
  * @return MessagePack array.
  */
 static inline const char *
-tuple_data(const struct tuple *tuple)
+tuple_data_raw(const struct tuple *tuple)
 {
 	return (const char *) tuple + tuple->data_offset;
 }
 
+/**
+ * Decompress the MessagePack data of a compressed tuple.
+ * @param tuple compressed tuple.
+ * @param[out] buf buffer of tuple->bsize bytes.
+ * @retval  0 success.
+ * @retval -1 memory or zstd error, diag is set.
+ */
+int
+tuple_decompress_to(const struct tuple *tuple, char *buf);
+
+/**
+ * Decompress the MessagePack data of a compressed tuple.
+ *
+ * In tx the data goes to a cache. It stays valid while the
+ * tuple is pinned, see tuple_decompress_pin(). Data of unpinned
+ * tuples is kept in a bounded LRU list and stays valid at least
+ * until 16 other compressed tuples are decompressed. In other
+ * threads it is allocated on the fiber region, which the
+ * caller truncates.
+ * @param tuple compressed tuple.
+ * @retval MessagePack array.
+ * @retval NULL memory or zstd error, diag is set.
+ */
+const char *
+tuple_decompress(const struct tuple *tuple);
+
+/**
+ * Pin the decompressed data of a compressed tuple in the tx
+ * cache: once decompressed, it is not evicted until the tuple
+ * is unpinned. Done for tuples referenced by the public API,
+ * including Lua, and for box_tuple_last.
+ * @retval  0 success.
+ * @retval -1 out of memory, diag is set.
+ */
+int
+tuple_decompress_pin(const struct tuple *tuple);
+
+/** Undo tuple_decompress_pin(). */
+void
+tuple_decompress_unpin(const struct tuple *tuple);
+
+/**
+ * Drop the decompressed data of a tuple from the tx cache.
+ * Called when a compressed tuple is freed.
+ */
+void
+tuple_decompress_forget(const struct tuple *tuple);
+
+/**
+ * Get pointer to MessagePack data of the tuple. A compressed
+ * tuple is decompressed, see tuple_decompress().
+ * @param tuple tuple.
+ * @retval MessagePack array.
+ * @retval NULL failed to decompress the tuple, diag is set.
+ */
+static inline const char *
+tuple_data(const struct tuple *tuple)
+{
+	if (unlikely(tuple->is_compressed))
+		return tuple_decompress(tuple);
+	return tuple_data_raw(tuple);
+}
+
+/**
+ * Get pointer to MessagePack data of the tuple which is good
+ * for access to the first @a field_count fields. Unlike
+ * tuple_data(), it doesn't decompress a compressed tuple if
+ * the fields are in its head.
+ * @param tuple tuple.
+ * @param field_count number of leading fields to access.
+ * @retval MessagePack array.
+ * @retval NULL failed to decompress the tuple, diag is set.
+ */
+static inline const char *
+tuple_data_prefix(const struct tuple *tuple, uint32_t field_count)
+{
+	if (likely(!tuple->is_compressed) ||
+	    field_count <= tuple_compressed(tuple)->head_field_count)
+		return tuple_data_raw(tuple);
+	return tuple_decompress(tuple);
+}
+
+/**
+ * Check if all parts of @a key_def can be read from the tuple
+ * without decompression.
+ */
+static inline bool
+tuple_key_is_uncompressed(const struct tuple *tuple,
+			  const struct key_def *key_def)
+{
+	if (likely(!tuple->is_compressed))
+		return true;
+	uint32_t head_field_count = tuple_compressed(tuple)->head_field_count;
+	for (uint32_t i = 0; i < key_def->part_count; i++) {
+		if (key_def->parts[i].fieldno >= head_field_count)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Get pointer to MessagePack data of the tuple which is good
+ * for access to all parts of @a key_def.
+ *
+ * Memtx doesn't let index fields stored compressed, so tuples
+ * are never decompressed to compare or hash them in an index.
+ * Only a key definition which is not an index one, e.g. given
+ * to box_tuple_compare(), may need the whole data.
+ * @sa tuple_data_prefix()
+ */
+static inline const char *
+tuple_data_for_key(const struct tuple *tuple, const struct key_def *key_def)
+{
+	if (likely(tuple_key_is_uncompressed(tuple, key_def)))
+		return tuple_data_raw(tuple);
+	const char *data = tuple_decompress(tuple);
+	if (data == NULL) {
+		/* Comparators have no way to report an error. */
+		diag_log();
+		panic("failed to decompress tuple %p", tuple);
+	}
+	return data;
+}
+
 /**
  * Wrapper around tuple_data() which returns NULL if @tuple == NULL.
  */
@@ -367,13 +533,14 @@ tuple_data_or_null(const struct tuple *tuple)
  * Get pointer to MessagePack data of the tuple.
  * @param tuple tuple.
  * @param[out] size Size in bytes of the MessagePack array.
- * @return MessagePack array.
+ * @retval MessagePack array.
+ * @retval NULL failed to decompress the tuple, diag is set.
  */
 static inline const char *
 tuple_data_range(const struct tuple *tuple, uint32_t *p_size)
 {
 	*p_size = tuple->bsize;
-	return (const char *) tuple + tuple->data_offset;
+	return tuple_data(tuple);
 }
 
 /**
@@ -470,7 +637,7 @@ static inline const char *
 tuple_extra(const struct tuple *tuple)
 {
 	struct tuple_format *format = tuple_format(tuple);
-	return tuple_data(tuple) - tuple_format_meta_size(format);
+	return tuple_data_raw(tuple) - tuple_format_meta_size(format);
 }
 
 /**
@@ -524,7 +691,10 @@ tuple_validate_raw(struct tuple_format *format, const char *data);
 static inline int
 tuple_validate(struct tuple_format *format, struct tuple *tuple)
 {
-	return tuple_validate_raw(format, tuple_data(tuple));
+	const char *data = tuple_data(tuple);
+	if (data == NULL)
+		return -1;
+	return tuple_validate_raw(format, data);
 }
 
 /*
@@ -547,7 +717,8 @@ tuple_field_map(const struct tuple *tuple)
 static inline uint32_t
 tuple_field_count(const struct tuple *tuple)
 {
-	const char *data = tuple_data(tuple);
+	/* The array header is never compressed. */
+	const char *data = tuple_data_raw(tuple);
 	return mp_decode_array(&data);
 }
 
@@ -557,12 +728,35 @@ tuple_field_count(const struct tuple *tuple)
  * @param fieldno the index of field to return
  * @param len pointer where the len of the field will be stored
  * @retval pointer to MessagePack data
- * @retval NULL when fieldno is out of range
+ * @retval NULL when fieldno is out of range or the tuple failed
+ *         to decompress
  */
 static inline const char *
 tuple_field(const struct tuple *tuple, uint32_t fieldno)
 {
-	return tuple_field_raw(tuple_format(tuple), tuple_data(tuple),
+	const char *data = tuple_data_prefix(tuple, fieldno + 1);
+	if (unlikely(data == NULL))
+		return NULL;
+	return tuple_field_raw(tuple_format(tuple), data,
+			       tuple_field_map(tuple), fieldno);
+}
+
+/**
+ * Get a field of the tuple which is a part of @a key_def. Unlike
+ * tuple_field(), the returned pointer can be used to go on to
+ * the following parts of the key with mp_next().
+ * @param tuple tuple
+ * @param key_def key definition
+ * @param fieldno the index of field to return
+ * @retval pointer to MessagePack data
+ * @retval NULL when fieldno is out of range
+ */
+static inline const char *
+tuple_field_for_key(const struct tuple *tuple, const struct key_def *key_def,
+		    uint32_t fieldno)
+{
+	return tuple_field_raw(tuple_format(tuple),
+			       tuple_data_for_key(tuple, key_def),
 			       tuple_field_map(tuple), fieldno);
 }
 
@@ -574,13 +768,17 @@ tuple_field(const struct tuple *tuple, uint32_t fieldno)
  * @param name_hash Hash of @a name.
  *
  * @retval not NULL MessagePack field.
- * @retval     NULL No field with @a name.
+ * @retval     NULL No field with @a name or the tuple failed to
+ *                  decompress.
  */
 static inline const char *
 tuple_field_by_name(const struct tuple *tuple, const char *name,
 		    uint32_t name_len, uint32_t name_hash)
 {
-	return tuple_field_raw_by_name(tuple_format(tuple), tuple_data(tuple),
+	const char *data = tuple_data(tuple);
+	if (data == NULL)
+		return NULL;
+	return tuple_field_raw_by_name(tuple_format(tuple), data,
 				       tuple_field_map(tuple), name, name_len,
 				       name_hash);
 }
@@ -617,17 +815,25 @@ struct tuple_iterator {
  *
  * @param[out] it tuple iterator
  * @param[in]  tuple tuple
+ * @retval  0 success
+ * @retval -1 failed to decompress the tuple, the iterator
+ *            yields no fields
  */
-static inline void
+static inline int
 tuple_rewind(struct tuple_iterator *it, struct tuple *tuple)
 {
 	it->tuple = tuple;
+	it->fieldno = 0;
 	uint32_t bsize;
 	const char *data = tuple_data_range(tuple, &bsize);
+	if (data == NULL) {
+		it->pos = it->end = NULL;
+		return -1;
+	}
 	it->pos = data;
 	(void) mp_decode_array(&it->pos); /* Skip array header */
-	it->fieldno = 0;
 	it->end = data + bsize;
+	return 0;
 }
 
 /**
@@ -858,10 +1064,16 @@ tuple_bless(struct tuple *tuple)
 		diag_set(ClientError, ER_TUPLE_REF_OVERFLOW);
 		return NULL;
 	}
+	if (unlikely(tuple->is_compressed) &&
+	    tuple_decompress_pin(tuple) != 0)
+		return NULL;
 	tuple->refs++;
 	/* Remove previous tuple */
-	if (likely(box_tuple_last != NULL))
+	if (likely(box_tuple_last != NULL)) {
+		if (unlikely(box_tuple_last->is_compressed))
+			tuple_decompress_unpin(box_tuple_last);
 		tuple_unref(box_tuple_last); /* do not throw */
+	}
 	/* Remember current tuple */
 	box_tuple_last = tuple;
 	return tuple;
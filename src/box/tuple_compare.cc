@@ -423,8 +423,8 @@ tuple_compare_slowpath(const struct tuple *tuple_a, const struct tuple *tuple_b,
 		       const struct key_def *key_def)
 {
 	const struct key_part *part = key_def->parts;
-	const char *tuple_a_raw = tuple_data(tuple_a);
-	const char *tuple_b_raw = tuple_data(tuple_b);
+	const char *tuple_a_raw = tuple_data_for_key(tuple_a, key_def);
+	const char *tuple_b_raw = tuple_data_for_key(tuple_b, key_def);
 	if (key_def->part_count == 1 && part->fieldno == 0) {
 		mp_decode_array(&tuple_a_raw);
 		mp_decode_array(&tuple_b_raw);
@@ -525,7 +525,7 @@ tuple_compare_with_key_slowpath(const struct tuple *tuple, const char *key,
 	assert(part_count <= key_def->part_count);
 	const struct key_part *part = key_def->parts;
 	const struct tuple_format *format = tuple_format(tuple);
-	const char *tuple_raw = tuple_data(tuple);
+	const char *tuple_raw = tuple_data_for_key(tuple, key_def);
 	const uint32_t *field_map = tuple_field_map(tuple);
 	if (likely(part_count == 1)) {
 		const char *field;
@@ -659,7 +659,7 @@ tuple_compare_with_key_sequential(const struct tuple *tuple,
 	const char *key, uint32_t part_count, const struct key_def *key_def)
 {
 	assert(key_def_is_sequential(key_def));
-	const char *tuple_key = tuple_data(tuple);
+	const char *tuple_key = tuple_data_for_key(tuple, key_def);
 	uint32_t tuple_field_count = mp_decode_array(&tuple_key);
 	assert(tuple_field_count >= key_def->part_count);
 	assert(part_count <= key_def->part_count);
@@ -693,11 +693,11 @@ tuple_compare_sequential(const struct tuple *tuple_a,
 			 const struct key_def *key_def)
 {
 	assert(key_def_is_sequential(key_def));
-	const char *key_a = tuple_data(tuple_a);
+	const char *key_a = tuple_data_for_key(tuple_a, key_def);
 	uint32_t field_count_a = mp_decode_array(&key_a);
 	assert(field_count_a >= key_def->part_count);
 	(void) field_count_a;
-	const char *key_b = tuple_data(tuple_b);
+	const char *key_b = tuple_data_for_key(tuple_b, key_def);
 	uint32_t field_count_b = mp_decode_array(&key_b);
 	assert(field_count_b >= key_def->part_count);
 	(void) field_count_b;
@@ -712,10 +712,10 @@ tuple_compare_sequential_nullable(const struct tuple *tuple_a,
 {
 	assert(key_def->is_nullable);
 	assert(key_def_is_sequential(key_def));
-	const char *key_a = tuple_data(tuple_a);
+	const char *key_a = tuple_data_for_key(tuple_a, key_def);
 	uint32_t field_count = mp_decode_array(&key_a);
 	assert(field_count >= key_def->part_count);
-	const char *key_b = tuple_data(tuple_b);
+	const char *key_b = tuple_data_for_key(tuple_b, key_def);
 	field_count = mp_decode_array(&key_b);
 	assert(field_count >= key_def->part_count);
 	(void) field_count;
@@ -792,6 +792,7 @@ struct FieldCompare<IDX, TYPE, IDX2, TYPE2, MORE_TYPES...>
 {
 	inline static int compare(const struct tuple *tuple_a,
 				  const struct tuple *tuple_b,
+				  const struct key_def *key_def,
 				  const struct tuple_format *format_a,
 				  const struct tuple_format *format_b,
 				  const char *field_a,
@@ -806,15 +807,19 @@ struct FieldCompare<IDX, TYPE, IDX2, TYPE2, MORE_TYPES...>
 		} else {
 			if ((r = field_compare<TYPE>(&field_a, &field_b)) != 0)
 				return r;
-			field_a = tuple_field_raw(format_a, tuple_data(tuple_a),
+			field_a = tuple_field_raw(format_a,
+						  tuple_data_for_key(tuple_a,
+								     key_def),
 						  tuple_field_map(tuple_a),
 						  IDX2);
-			field_b = tuple_field_raw(format_b, tuple_data(tuple_b),
+			field_b = tuple_field_raw(format_b,
+						  tuple_data_for_key(tuple_b,
+								     key_def),
 						  tuple_field_map(tuple_b),
 						  IDX2);
 		}
 		return FieldCompare<IDX2, TYPE2, MORE_TYPES...>::
-			compare(tuple_a, tuple_b, format_a,
+			compare(tuple_a, tuple_b, key_def, format_a,
 				format_b, field_a, field_b);
 	}
 };
@@ -824,6 +829,7 @@ struct FieldCompare<IDX, TYPE>
 {
 	inline static int compare(const struct tuple *,
 				  const struct tuple *,
+				  const struct key_def *,
 				  const struct tuple_format *,
 				  const struct tuple_format *,
 				  const char *field_a,
@@ -841,17 +847,19 @@ struct TupleCompare
 {
 	static int compare(const struct tuple *tuple_a,
 			   const struct tuple *tuple_b,
-			   const struct key_def *)
+			   const struct key_def *key_def)
 	{
 		struct tuple_format *format_a = tuple_format(tuple_a);
 		struct tuple_format *format_b = tuple_format(tuple_b);
 		const char *field_a, *field_b;
-		field_a = tuple_field_raw(format_a, tuple_data(tuple_a),
+		field_a = tuple_field_raw(format_a,
+					  tuple_data_for_key(tuple_a, key_def),
 					  tuple_field_map(tuple_a), IDX);
-		field_b = tuple_field_raw(format_b, tuple_data(tuple_b),
+		field_b = tuple_field_raw(format_b,
+					  tuple_data_for_key(tuple_b, key_def),
 					  tuple_field_map(tuple_b), IDX);
 		return FieldCompare<IDX, TYPE, MORE_TYPES...>::
-			compare(tuple_a, tuple_b, format_a,
+			compare(tuple_a, tuple_b, key_def, format_a,
 				format_b, field_a, field_b);
 	}
 };
@@ -860,16 +868,16 @@ template <int TYPE, int ...MORE_TYPES>
 struct TupleCompare<0, TYPE, MORE_TYPES...> {
 	static int compare(const struct tuple *tuple_a,
 			   const struct tuple *tuple_b,
-			   const struct key_def *)
+			   const struct key_def *key_def)
 	{
 		struct tuple_format *format_a = tuple_format(tuple_a);
 		struct tuple_format *format_b = tuple_format(tuple_b);
-		const char *field_a = tuple_data(tuple_a);
-		const char *field_b = tuple_data(tuple_b);
+		const char *field_a = tuple_data_for_key(tuple_a, key_def);
+		const char *field_b = tuple_data_for_key(tuple_b, key_def);
 		mp_decode_array(&field_a);
 		mp_decode_array(&field_b);
 		return FieldCompare<0, TYPE, MORE_TYPES...>::compare(tuple_a, tuple_b,
-					format_a, format_b, field_a, field_b);
+				key_def, format_a, format_b, field_a, field_b);
 	}
 };
 } /* end of anonymous namespace */
@@ -1015,7 +1023,9 @@ struct FieldCompareWithKey<FLD_ID, IDX, TYPE, IDX2, TYPE2, MORE_TYPES...>
 			r = field_compare_with_key<TYPE>(&field, &key);
 			if (r || part_count == FLD_ID + 1)
 				return r;
-			field = tuple_field_raw(format, tuple_data(tuple),
+			field = tuple_field_raw(format,
+						tuple_data_for_key(tuple,
+								   key_def),
 						tuple_field_map(tuple), IDX2);
 			mp_next(&key);
 		}
@@ -1052,9 +1062,10 @@ struct TupleCompareWithKey
 		if (part_count == 0)
 			return 0;
 		struct tuple_format *format = tuple_format(tuple);
-		const char *field = tuple_field_raw(format, tuple_data(tuple),
-						    tuple_field_map(tuple),
-						    IDX);
+		const char *field =
+			tuple_field_raw(format,
+					tuple_data_for_key(tuple, key_def),
+					tuple_field_map(tuple), IDX);
 		return FieldCompareWithKey<FLD_ID, IDX, TYPE, MORE_TYPES...>::
 				compare(tuple, key, part_count,
 					key_def, format, field);
@@ -1073,7 +1084,7 @@ struct TupleCompareWithKey<0, 0, TYPE, MORE_TYPES...>
 		if (part_count == 0)
 			return 0;
 		struct tuple_format *format = tuple_format(tuple);
-		const char *field = tuple_data(tuple);
+		const char *field = tuple_data_for_key(tuple, key_def);
 		mp_decode_array(&field);
 		return FieldCompareWithKey<0, 0, TYPE, MORE_TYPES...>::
 			compare(tuple, key, part_count,
@@ -1144,6 +1155,133 @@ tuple_compare_with_key_create(const struct key_def *def)
 
 /* }}} tuple_compare_with_key */
 
+/* {{{ tuple_hint */
+
+enum {
+	/** Number of high bits of a hint storing a MsgPack class. */
+	HINT_CLASS_BITS = 4,
+	/** Number of low bits of a hint storing a value prefix. */
+	HINT_VALUE_BITS = sizeof(hint_t) * CHAR_BIT - HINT_CLASS_BITS,
+	/** Number of string bytes stored in a hint. */
+	HINT_STR_LEN = 7,
+};
+
+static inline hint_t
+hint_create(enum mp_class mp_class, uint64_t value)
+{
+	assert((value >> HINT_VALUE_BITS) == 0);
+	return (hint_t)mp_class << HINT_VALUE_BITS | value;
+}
+
+/**
+ * All numbers are hinted as doubles so that integers and
+ * floating point values stored in the same field are
+ * comparable. Integer to double conversion is monotonic, so
+ * the order is preserved, although big integers may get equal
+ * hints.
+ */
+static inline hint_t
+hint_double(double d)
+{
+	/* NaNs are less than any number. */
+	if (isnan(d))
+		return hint_create(MP_CLASS_NUMBER, 0);
+	/* -0.0 == 0.0, make them have the same bits. */
+	if (d == 0)
+		d = 0;
+	uint64_t bits;
+	memcpy(&bits, &d, sizeof(bits));
+	/*
+	 * Make the bits of a double comparable as an unsigned
+	 * integer: flip the sign bit of positive values and all
+	 * bits of negative ones.
+	 */
+	if ((bits & (1ULL << 63)) != 0)
+		bits = ~bits;
+	else
+		bits |= 1ULL << 63;
+	return hint_create(MP_CLASS_NUMBER, bits >> HINT_CLASS_BITS);
+}
+
+/**
+ * Strings and binaries are compared with memcmp() and so are
+ * hinted by their first bytes. A string shorter than a hint
+ * is padded with zeros, which is consistent with the shorter
+ * string being less.
+ */
+static inline hint_t
+hint_bytes(enum mp_class mp_class, const char *s, uint32_t len)
+{
+	uint64_t value = 0;
+	for (uint32_t i = 0; i < HINT_STR_LEN; i++) {
+		value <<= CHAR_BIT;
+		if (i < len)
+			value |= (unsigned char)s[i];
+	}
+	return hint_create(mp_class, value);
+}
+
+static hint_t
+field_hint(const char *field, enum field_type type, struct coll *coll)
+{
+	uint32_t len;
+	const char *s;
+	switch (mp_typeof(*field)) {
+	case MP_NIL:
+		return hint_create(MP_CLASS_NIL, 0);
+	case MP_BOOL:
+		return hint_create(MP_CLASS_BOOL, mp_decode_bool(&field));
+	case MP_UINT:
+		return hint_double(mp_decode_uint(&field));
+	case MP_INT:
+		return hint_double(mp_decode_int(&field));
+	case MP_FLOAT:
+		return hint_double(mp_decode_float(&field));
+	case MP_DOUBLE:
+		return hint_double(mp_decode_double(&field));
+	case MP_STR:
+		s = mp_decode_str(&field, &len);
+		/* Scalar fields ignore collations, see tuple_compare_field. */
+		if (coll != NULL && type == FIELD_TYPE_STRING) {
+			char buf[HINT_STR_LEN];
+			len = coll->hint(s, len, buf, sizeof(buf), coll);
+			return hint_bytes(MP_CLASS_STR, buf, len);
+		}
+		return hint_bytes(MP_CLASS_STR, s, len);
+	case MP_BIN:
+		s = mp_decode_bin(&field, &len);
+		return hint_bytes(MP_CLASS_BIN, s, len);
+	default:
+		return HINT_NONE;
+	}
+}
+
+hint_t
+tuple_hint(const struct tuple *tuple, const struct key_def *key_def)
+{
+	if (key_def->part_count == 0)
+		return HINT_NONE;
+	const struct key_part *part = &key_def->parts[0];
+	const char *field = tuple_field(tuple, part->fieldno);
+	if (field == NULL) {
+		/* A missing nullable field is compared as nil. */
+		assert(part->is_nullable);
+		return hint_create(MP_CLASS_NIL, 0);
+	}
+	return field_hint(field, part->type, part->coll);
+}
+
+hint_t
+key_hint(const char *key, uint32_t part_count, const struct key_def *key_def)
+{
+	if (part_count == 0 || key_def->part_count == 0)
+		return HINT_NONE;
+	const struct key_part *part = &key_def->parts[0];
+	return field_hint(key, part->type, part->coll);
+}
+
+/* }}} tuple_hint */
+
 int
 box_tuple_compare(const box_tuple_t *tuple_a, const box_tuple_t *tuple_b,
 		  const box_key_def_t *key_def)
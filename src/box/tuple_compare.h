@@ -106,6 +106,80 @@ tuple_compare_with_key(const struct tuple *tuple, const char *key,
 	return key_def->tuple_compare_with_key(tuple, key, part_count, key_def);
 }
 
+/**
+ * A comparison hint is an unsigned integer that preserves the
+ * order of the first key part: if hint(a) < hint(b), then
+ * a < b in terms of the key definition. Equal hints tell
+ * nothing. The high bits of a hint store the MsgPack class of
+ * the field, the low bits store a prefix of its value: a
+ * number converted to double, the first bytes of a string or
+ * of its collation sort key.
+ */
+typedef uint64_t hint_t;
+
+/** A hint that tells nothing, e.g. for an empty key. */
+#define HINT_NONE ((hint_t)UINT64_MAX)
+
+/**
+ * Calculate a comparison hint of a tuple.
+ * @param tuple tuple
+ * @param key_def key definition
+ */
+hint_t
+tuple_hint(const struct tuple *tuple, const struct key_def *key_def);
+
+/**
+ * Calculate a comparison hint of a key.
+ * @param key key parts without MessagePack array header
+ * @param part_count the number of parts in @a key
+ * @param key_def key definition
+ */
+hint_t
+key_hint(const char *key, uint32_t part_count, const struct key_def *key_def);
+
+/**
+ * Compare two hints.
+ * @retval 0 if the hints don't decide the order.
+ */
+static inline int
+hint_cmp(hint_t hint_a, hint_t hint_b)
+{
+	if (hint_a == HINT_NONE || hint_b == HINT_NONE)
+		return 0;
+	return hint_a < hint_b ? -1 : hint_a > hint_b;
+}
+
+/**
+ * Compare two tuples using their comparison hints first.
+ * @sa tuple_compare()
+ */
+static inline int
+tuple_compare_hinted(const struct tuple *tuple_a, hint_t hint_a,
+		     const struct tuple *tuple_b, hint_t hint_b,
+		     const struct key_def *key_def)
+{
+	int rc = hint_cmp(hint_a, hint_b);
+	if (rc != 0)
+		return rc;
+	return tuple_compare(tuple_a, tuple_b, key_def);
+}
+
+/**
+ * Compare a tuple with a key using their comparison hints
+ * first.
+ * @sa tuple_compare_with_key()
+ */
+static inline int
+tuple_compare_with_key_hinted(const struct tuple *tuple, hint_t hint_tuple,
+			      const char *key, uint32_t part_count,
+			      hint_t hint_key, const struct key_def *key_def)
+{
+	int rc = hint_cmp(hint_tuple, hint_key);
+	if (rc != 0)
+		return rc;
+	return tuple_compare_with_key(tuple, key, part_count, key_def);
+}
+
 /** \cond public */
 
 /**
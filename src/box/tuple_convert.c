@@ -42,6 +42,8 @@ tuple_to_obuf(const struct tuple *tuple, struct obuf *buf)
 {
 	uint32_t bsize;
 	const char *data = tuple_data_range(tuple, &bsize);
+	if (data == NULL)
+		return -1;
 	if (obuf_dup(buf, data, bsize) != bsize) {
 		diag_set(OutOfMemory, bsize, "tuple_to_obuf", "dup");
 		return -1;
@@ -230,6 +232,8 @@ char *
 tuple_to_yaml(const struct tuple *tuple)
 {
 	const char *data = tuple_data(tuple);
+	if (data == NULL)
+		return NULL;
 	yaml_emitter_t emitter;
 	yaml_event_t ev;
 
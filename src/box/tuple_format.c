@@ -297,6 +297,7 @@ tuple_format_alloc(struct key_def * const *keys, uint16_t key_count,
 	format->field_count = field_count;
 	format->index_field_count = index_field_count;
 	format->exact_field_count = 0;
+	format->compress_threshold = 0;
 	return format;
 
 error_name_hash_reserve:
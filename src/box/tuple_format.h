@@ -132,6 +132,12 @@ struct tuple_format {
 	 * fields. If set, each tuple must have exactly this number of fields.
 	 */
 	uint32_t exact_field_count;
+	/**
+	 * If not 0, the engine may store tuples which are at
+	 * least this many bytes long compressed.
+	 * \sa struct tuple_compressed
+	 */
+	uint32_t compress_threshold;
 	/**
 	 * The longest field array prefix in which the last
 	 * element is used by an index.
@@ -158,7 +158,8 @@ struct TupleHash
 		uint32_t h = HASH_SEED;
 		uint32_t carry = 0;
 		uint32_t total_size = 0;
-		const char *field = tuple_field(tuple, key_def->parts->fieldno);
+		const char *field = tuple_field_for_key(tuple, key_def,
+							key_def->parts->fieldno);
 		TupleFieldHash<TYPE, MORE_TYPES...>::
 			hash(&field, &h, &carry, &total_size);
 		return PMurHash32_Result(h, carry, total_size);
@@ -170,7 +171,8 @@ struct TupleHash<FIELD_TYPE_UNSIGNED> {
 	static uint32_t	hash(const struct tuple *tuple,
 			     const struct key_def *key_def)
 	{
-		const char *field = tuple_field(tuple, key_def->parts->fieldno);
+		const char *field = tuple_field_for_key(tuple, key_def,
+							key_def->parts->fieldno);
 		uint64_t val = mp_decode_uint(&field);
 		if (likely(val <= UINT32_MAX))
 			return val;
@@ -305,7 +307,8 @@ tuple_hash_slowpath(const struct tuple *tuple, const struct key_def *key_def)
 	uint32_t carry = 0;
 	uint32_t total_size = 0;
 	uint32_t prev_fieldno = key_def->parts[0].fieldno;
-	const char* field = tuple_field(tuple, key_def->parts[0].fieldno);
+	const char *field = tuple_field_for_key(tuple, key_def,
+						key_def->parts[0].fieldno);
 	total_size += tuple_hash_field(&h, &carry, &field,
 		key_def->parts[0].type, key_def->parts[0].coll);
 	for (uint32_t part_id = 1; part_id < key_def->part_count; part_id++) {
@@ -314,7 +317,8 @@ tuple_hash_slowpath(const struct tuple *tuple, const struct key_def *key_def)
 		 * need of tuple_field
 		 */
 		if (prev_fieldno + 1 != key_def->parts[part_id].fieldno) {
-			field = tuple_field(tuple, key_def->parts[part_id].fieldno);
+			field = tuple_field_for_key(tuple, key_def,
+					key_def->parts[part_id].fieldno);
 		}
 		total_size += tuple_hash_field(&h, &carry, &field,
 					       key_def->parts[part_id].type,
@@ -340,3 +344,42 @@ key_hash_slowpath(const char *key, const struct key_def *key_def)
 
 	return PMurHash32_Result(h, carry, total_size);
 }
+
+void
+tuple_hash_prefixes(const struct tuple *tuple, const struct key_def *key_def,
+		    uint32_t part_count, uint32_t *hashes)
+{
+	assert(part_count <= key_def->part_count);
+	uint32_t h = HASH_SEED;
+	uint32_t carry = 0;
+	uint32_t total_size = 0;
+	const char *field = NULL;
+	for (uint32_t part_id = 0; part_id < part_count; part_id++) {
+		const struct key_part *part = &key_def->parts[part_id];
+		if (part_id == 0 ||
+		    key_def->parts[part_id - 1].fieldno + 1 != part->fieldno)
+			field = tuple_field_for_key(tuple, key_def,
+						    part->fieldno);
+		total_size += tuple_hash_field(&h, &carry, &field,
+					       part->type, part->coll);
+		hashes[part_id] = PMurHash32_Result(h, carry, total_size);
+	}
+}
+
+uint32_t
+key_hash_prefix(const char *key, const struct key_def *key_def,
+		uint32_t part_count)
+{
+	assert(part_count <= key_def->part_count);
+	uint32_t h = HASH_SEED;
+	uint32_t carry = 0;
+	uint32_t total_size = 0;
+
+	for (const struct key_part *part = key_def->parts;
+	     part < key_def->parts + part_count; part++) {
+		total_size += tuple_hash_field(&h, &carry, &key,
+					       part->type, part->coll);
+	}
+
+	return PMurHash32_Result(h, carry, total_size);
+}
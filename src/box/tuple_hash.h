@@ -68,6 +68,31 @@ key_hash(const char *key, const struct key_def *key_def)
 	return key_def->key_hash(key, key_def);
 }
 
+/**
+ * Calculate hash values of key prefixes of a tuple.
+ * @param tuple - a tuple
+ * @param key_def - key_def for field description
+ * @param part_count - number of prefixes to hash,
+ *  must not exceed the number of key parts
+ * @param[out] hashes - hashes[i] is set to the hash value
+ *  of the first i + 1 key parts, equal to key_hash_prefix()
+ *  of the same key prefix
+ */
+void
+tuple_hash_prefixes(const struct tuple *tuple, const struct key_def *key_def,
+		    uint32_t part_count, uint32_t *hashes);
+
+/**
+ * Calculate a hash value for a key prefix
+ * @param key - key (msgpack fields w/o array marker)
+ * @param key_def - key_def for field description
+ * @param part_count - number of key parts to hash
+ * @return - hash value
+ */
+uint32_t
+key_hash_prefix(const char *key, const struct key_def *key_def,
+		uint32_t part_count);
+
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif /* defined(__cplusplus) */
@@ -243,12 +243,16 @@ txn_write_to_wal(struct txn *txn)
 	}
 	assert(row == req->rows + req->n_rows);
 
-	ev_tstamp start = ev_monotonic_now(loop());
+	ev_tstamp start = ev_monotonic_time();
 	int64_t res = journal_write(req);
 
-	ev_tstamp stop = ev_monotonic_now(loop());
+	ev_tstamp stop = ev_monotonic_time();
 	if (stop - start > too_long_threshold)
 		say_warn("too long WAL write: %.3f sec", stop - start);
+	ev_tstamp *wal_wait = (ev_tstamp *)
+		fiber_get_key(fiber(), FIBER_KEY_WAL_WAIT);
+	if (wal_wait != NULL)
+		*wal_wait += stop - start;
 	if (res < 0) {
 		/* Cascading rollback. */
 		txn_rollback(); /* Perform our part of cascading rollback. */
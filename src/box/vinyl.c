@@ -128,6 +128,11 @@ struct vy_env {
 	int read_threads;
 	/** Max number of threads used for writing. */
 	int write_threads;
+	/**
+	 * Max size of zstd dictionaries trained for new run
+	 * files, 0 if runs are compressed without dictionaries.
+	 */
+	size_t dict_size;
 };
 
 /** Mask passed to vy_gc(). */
@@ -586,7 +591,53 @@ struct vy_task {
 	 * an index:alter() call.
 	 */
 	double bloom_fpr;
+	bool bloom_prefix;
 	int64_t page_size;
+	/**
+	 * Compaction of a large range may be split in parts,
+	 * each of which merges statements falling in its own
+	 * key interval into a separate run and is executed by
+	 * a separate worker thread. The task returned by the
+	 * scheduler (the leader) owns the range and commits
+	 * the result of all parts once they all have been
+	 * processed. For other parts this member points to
+	 * the leader, for the leader it is NULL.
+	 */
+	struct vy_task *leader;
+	/** List of parts other than the leader, linked by @in_parts. */
+	struct stailq parts;
+	/** Link in vy_task->parts of the leader. */
+	struct stailq_entry in_parts;
+	/**
+	 * Number of parts that have not been processed by
+	 * worker threads yet, including the leader itself.
+	 * Only used by the leader.
+	 */
+	int pending_part_count;
+	/**
+	 * Key interval of a compaction part. NULL means
+	 * that the interval is bounded by the range.
+	 */
+	struct tuple *begin, *end;
+	/**
+	 * Slices of compacted runs cut by the part boundaries,
+	 * linked by vy_slice->in_range.
+	 */
+	struct rlist part_slices;
+	/**
+	 * In-memory trees dumped by a dump task, sampled by
+	 * the worker to train a compression dictionary for
+	 * the new run. NULL if dictionaries are disabled.
+	 */
+	struct vy_mem **dump_mems;
+	int dump_mem_count;
+	/** Max size of the dictionary to train. */
+	size_t dict_size;
+	/**
+	 * ID of a compacted run whose dictionary is reused
+	 * for the new run by a compaction task or -1.
+	 */
+	int64_t dict_run_id;
 };
 
 /**
@@ -610,29 +661,140 @@ vy_task_new(struct mempool *pool, struct vy_index *index,
 	task->index = index;
 	vy_index_ref(index);
 	diag_create(&task->diag);
+	stailq_create(&task->parts);
+	task->pending_part_count = 1;
+	rlist_create(&task->part_slices);
+	task->dict_run_id = -1;
 	return task;
 }
 
-/** Free a task allocated with vy_task_new(). */
+/**
+ * Free a task allocated with vy_task_new().
+ * Parts of the task are freed as well.
+ */
 static void
 vy_task_delete(struct mempool *pool, struct vy_task *task)
 {
+	struct vy_task *part, *next_part;
+	stailq_foreach_entry_safe(part, next_part, &task->parts, in_parts)
+		vy_task_delete(pool, part);
+	assert(rlist_empty(&task->part_slices));
+	if (task->begin != NULL)
+		tuple_unref(task->begin);
+	if (task->end != NULL)
+		tuple_unref(task->end);
+	free(task->dump_mems);
 	vy_index_unref(task->index);
 	diag_destroy(&task->diag);
 	TRASH(task);
 	mempool_free(pool, task);
 }
 
+enum {
+	/**
+	 * A dictionary is trained on samples this many times
+	 * bigger than the dictionary.
+	 */
+	VY_DICT_SAMPLE_RATIO = 100,
+	/**
+	 * Don't train a dictionary if there's less data than
+	 * this many times the dictionary size.
+	 */
+	VY_DICT_SAMPLE_RATIO_MIN = 10,
+	/** Max total size of samples to train a dictionary on. */
+	VY_DICT_SAMPLE_SIZE_MAX = 16 * 1024 * 1024,
+};
+
+/**
+ * Train a compression dictionary for the run written by a
+ * dump task on statements sampled at random from the dumped
+ * in-memory trees. Called by a worker thread, which is safe,
+ * because the trees are read-only while they are being dumped.
+ *
+ * Returns NULL if there is too little data to train on or
+ * training fails, in which case the run is compressed without
+ * a dictionary.
+ */
+static void *
+vy_task_dump_train_dict(struct vy_task *task, size_t *dict_size)
+{
+	struct vy_index *index = task->index;
+	int64_t total_rows = 0, total_bytes = 0;
+	for (int i = 0; i < task->dump_mem_count; i++) {
+		total_rows += task->dump_mems[i]->count.rows;
+		total_bytes += task->dump_mems[i]->count.bytes;
+	}
+	if (total_rows == 0 || total_bytes <
+	    (int64_t)task->dict_size * VY_DICT_SAMPLE_RATIO_MIN)
+		return NULL;
+
+	size_t budget = MIN(task->dict_size * VY_DICT_SAMPLE_RATIO,
+			    (size_t)VY_DICT_SAMPLE_SIZE_MAX);
+	budget = MIN(budget, (size_t)total_bytes);
+	unsigned capacity = MIN(total_rows, (int64_t)budget / 8 + 1);
+	char *samples = malloc(budget);
+	size_t *sample_sizes = malloc(capacity * sizeof(*sample_sizes));
+	if (samples == NULL || sample_sizes == NULL) {
+		diag_set(OutOfMemory, budget, "malloc", "samples");
+		goto fail;
+	}
+	size_t used = 0;
+	unsigned count = 0;
+	while (count < capacity) {
+		/* Pick a tree with probability proportional to its size. */
+		int64_t rnd = rand() % total_rows;
+		struct vy_mem *mem = NULL;
+		for (int i = 0; i < task->dump_mem_count; i++) {
+			mem = task->dump_mems[i];
+			if (rnd < mem->count.rows)
+				break;
+			rnd -= mem->count.rows;
+		}
+		const struct tuple **stmt = vy_mem_tree_random(&mem->tree,
+							       rand());
+		if (stmt == NULL)
+			continue;
+		uint32_t size;
+		const char *data = tuple_data_range(*stmt, &size);
+		if (used + size > budget)
+			break;
+		memcpy(samples + used, data, size);
+		sample_sizes[count++] = size;
+		used += size;
+	}
+	void *dict = xlog_dict_train(task->dict_size, samples,
+				     sample_sizes, count, dict_size);
+	if (dict == NULL)
+		goto fail;
+	free(samples);
+	free(sample_sizes);
+	return dict;
+fail:
+	say_warn("%s: failed to train compression dictionary: %s",
+		 vy_index_name(index), diag_last_error(diag_get())->errmsg);
+	diag_clear(diag_get());
+	free(samples);
+	free(sample_sizes);
+	return NULL;
+}
+
 static int
 vy_task_dump_execute(struct vy_task *task)
 {
 	struct vy_index *index = task->index;
-
-	return vy_run_write(task->new_run, index->env->path,
-			    index->space_id, index->id, task->wi,
-			    task->page_size, index->cmp_def,
-			    index->key_def, task->max_output_count,
-			    task->bloom_fpr);
+	void *dict = NULL;
+	size_t dict_size = 0;
+	if (task->dump_mems != NULL)
+		dict = vy_task_dump_train_dict(task, &dict_size);
+
+	int rc = vy_run_write(task->new_run, index->env->path,
+			      index->space_id, index->id, task->wi,
+			      task->page_size, index->cmp_def,
+			      index->key_def, task->max_output_count,
+			      task->bloom_fpr, task->bloom_prefix,
+			      dict, dict_size);
+	free(dict);
+	return rc;
 }
 
 static int
@@ -892,6 +1054,7 @@ vy_task_dump_new(struct vy_scheduler *scheduler, struct vy_index *index,
 	 */
 	int64_t dump_lsn = -1;
 	size_t max_output_count = 0;
+	int mem_count = 0;
 	struct vy_mem *mem, *next_mem;
 	rlist_foreach_entry_safe(mem, &index->sealed, in_sealed, next_mem) {
 		if (mem->generation > scheduler->dump_generation)
@@ -907,6 +1070,7 @@ vy_task_dump_new(struct vy_scheduler *scheduler, struct vy_index *index,
 		}
 		dump_lsn = MAX(dump_lsn, mem->max_lsn);
 		max_output_count += mem->tree.size;
+		mem_count++;
 	}
 
 	if (max_output_count == 0) {
@@ -935,17 +1099,30 @@ vy_task_dump_new(struct vy_scheduler *scheduler, struct vy_index *index,
 				   is_last_level, &xm->read_views);
 	if (wi == NULL)
 		goto err_wi;
+	if (scheduler->env->dict_size > 0) {
+		task->dump_mems = malloc(mem_count * sizeof(*task->dump_mems));
+		if (task->dump_mems == NULL) {
+			diag_set(OutOfMemory, mem_count *
+				 sizeof(*task->dump_mems), "malloc",
+				 "struct vy_mem *");
+			goto err_wi_sub;
+		}
+		task->dict_size = scheduler->env->dict_size;
+	}
 	rlist_foreach_entry(mem, &index->sealed, in_sealed) {
 		if (mem->generation > scheduler->dump_generation)
 			continue;
 		if (vy_write_iterator_new_mem(wi, mem) != 0)
 			goto err_wi_sub;
+		if (task->dump_mems != NULL)
+			task->dump_mems[task->dump_mem_count++] = mem;
 	}
 
 	task->new_run = new_run;
 	task->wi = wi;
 	task->max_output_count = max_output_count;
 	task->bloom_fpr = index->opts.bloom_fpr;
+	task->bloom_prefix = index->opts.bloom_prefix;
 	task->page_size = index->opts.page_size;
 
 	index->is_dumping = true;
@@ -970,7 +1147,7 @@ vy_task_dump_new(struct vy_scheduler *scheduler, struct vy_index *index,
 	return 0;
 
 err_wi_sub:
-	task->wi->iface->close(wi);
+	wi->iface->close(wi);
 err_wi:
 	vy_run_discard(new_run);
 err_run:
@@ -981,21 +1158,280 @@ err:
 	return -1;
 }
 
+/**
+ * Max number of parts compaction of a single range
+ * can be split in, see vy_task_compact_split().
+ */
+#define VY_COMPACT_MAX_PARTS		8
+
 static int
 vy_task_compact_execute(struct vy_task *task)
 {
 	struct vy_index *index = task->index;
+	void *dict = NULL;
+	size_t dict_size = 0;
+	if (task->dict_run_id >= 0) {
+		/* Reuse the dictionary of a compacted run. */
+		char path[PATH_MAX];
+		vy_run_snprint_path(path, sizeof(path), index->env->path,
+				    index->space_id, index->id,
+				    task->dict_run_id, VY_FILE_DICT);
+		dict = xlog_dict_read(path, &dict_size);
+		if (dict == NULL)
+			return -1;
+	}
+
+	int rc = vy_run_write(task->new_run, index->env->path,
+			      index->space_id, index->id, task->wi,
+			      task->page_size, index->cmp_def,
+			      index->key_def, task->max_output_count,
+			      task->bloom_fpr, task->bloom_prefix,
+			      dict, dict_size);
+	free(dict);
+	return rc;
+}
+
+/**
+ * Release resources allocated for a compaction task part:
+ * close the write iterator, delete slices cut by the part
+ * boundaries and, unless the run written by the part has
+ * been committed, discard it.
+ */
+static void
+vy_task_compact_cleanup(struct vy_task *task, bool in_shutdown)
+{
+	if (task->wi != NULL) {
+		task->wi->iface->close(task->wi);
+		task->wi = NULL;
+	}
+	struct vy_slice *slice, *next_slice;
+	rlist_foreach_entry_safe(slice, &task->part_slices,
+				 in_range, next_slice)
+		vy_slice_delete(slice);
+	rlist_create(&task->part_slices);
+	if (task->new_run != NULL) {
+		/* The metadata log is unavailable on shutdown. */
+		if (!in_shutdown)
+			vy_run_discard(task->new_run);
+		else
+			vy_run_unref(task->new_run);
+		task->new_run = NULL;
+	}
+}
 
-	return vy_run_write(task->new_run, index->env->path,
-			    index->space_id, index->id, task->wi,
-			    task->page_size, index->cmp_def,
-			    index->key_def, task->max_output_count,
-			    task->bloom_fpr);
+/**
+ * Build the list of runs that became unused as a result
+ * of compaction of slices [@first_slice, @last_slice].
+ */
+static void
+vy_task_compact_find_unused_runs(struct vy_slice *first_slice,
+				 struct vy_slice *last_slice,
+				 struct rlist *unused_runs)
+{
+	struct vy_slice *slice;
+	struct vy_run *run;
+	for (slice = first_slice; ; slice = rlist_next_entry(slice, in_range)) {
+		slice->run->compacted_slice_count++;
+		if (slice == last_slice)
+			break;
+	}
+	for (slice = first_slice; ; slice = rlist_next_entry(slice, in_range)) {
+		run = slice->run;
+		if (run->compacted_slice_count == run->refs)
+			rlist_add_entry(unused_runs, run, in_unused);
+		slice->run->compacted_slice_count = 0;
+		if (slice == last_slice)
+			break;
+	}
+}
+
+/**
+ * Complete compaction that was split in parts.
+ *
+ * The compacted range is replaced with new ranges, one per
+ * each part. A new range consists of the slice of the run
+ * written by the part and slices of the runs that were not
+ * compacted, cut by the part boundaries.
+ */
+static int
+vy_task_compact_complete_parts(struct vy_scheduler *scheduler,
+			       struct vy_task *task)
+{
+	struct vy_index *index = task->index;
+	struct vy_range *range = task->range;
+	struct vy_slice *first_slice = task->first_slice;
+	struct vy_slice *last_slice = task->last_slice;
+	struct vy_slice *slice, *next_slice, *new_slice;
+	struct vy_run *run;
+
+	struct vy_task *part, *parts[VY_COMPACT_MAX_PARTS];
+	struct vy_range *new_ranges[VY_COMPACT_MAX_PARTS] = {NULL, };
+	int n_parts = 0;
+	parts[n_parts++] = task;
+	stailq_foreach_entry(part, &task->parts, in_parts)
+		parts[n_parts++] = part;
+
+	/*
+	 * Slices cut by the part boundaries hold references
+	 * to the compacted runs, which we need to drop before
+	 * looking for unused runs.
+	 */
+	for (int i = 0; i < n_parts; i++) {
+		part = parts[i];
+		part->wi->iface->close(part->wi);
+		part->wi = NULL;
+		rlist_foreach_entry_safe(slice, &part->part_slices,
+					 in_range, next_slice)
+			vy_slice_delete(slice);
+		rlist_create(&part->part_slices);
+	}
+
+	RLIST_HEAD(unused_runs);
+	vy_task_compact_find_unused_runs(first_slice, last_slice,
+					 &unused_runs);
+
+	/*
+	 * Allocate new ranges. Since vy_range_add_slice() adds
+	 * a slice to the list head, we have to iterate over
+	 * the slices of the compacted range backward in order
+	 * to preserve their order.
+	 */
+	for (int i = 0; i < n_parts; i++) {
+		part = parts[i];
+		struct vy_range *new_range;
+		new_range = vy_range_new(vy_log_next_id(),
+				part->begin != NULL ? part->begin : range->begin,
+				part->end != NULL ? part->end : range->end,
+				index->cmp_def);
+		if (new_range == NULL)
+			goto fail;
+		new_ranges[i] = new_range;
+		bool is_compacted = false;
+		rlist_foreach_entry_reverse(slice, &range->slices, in_range) {
+			if (slice == last_slice) {
+				is_compacted = true;
+				if (!vy_run_is_empty(part->new_run)) {
+					new_slice = vy_slice_new(vy_log_next_id(),
+							part->new_run, NULL, NULL,
+							index->cmp_def);
+					if (new_slice == NULL)
+						goto fail;
+					vy_range_add_slice(new_range, new_slice);
+				}
+			}
+			if (!is_compacted) {
+				if (vy_slice_cut(slice, vy_log_next_id(),
+						 new_range->begin, new_range->end,
+						 index->cmp_def, &new_slice) != 0)
+					goto fail;
+				if (new_slice != NULL)
+					vy_range_add_slice(new_range, new_slice);
+			}
+			if (slice == first_slice)
+				is_compacted = false;
+		}
+		new_range->n_compactions = range->n_compactions + 1;
+		vy_range_update_compact_priority(new_range, &index->opts);
+	}
+
+	/*
+	 * Log change in metadata.
+	 */
+	vy_log_tx_begin();
+	rlist_foreach_entry(slice, &range->slices, in_range)
+		vy_log_delete_slice(slice->id);
+	vy_log_delete_range(range->id);
+	int64_t gc_lsn = checkpoint_last(NULL);
+	rlist_foreach_entry(run, &unused_runs, in_unused)
+		vy_log_drop_run(run->id, gc_lsn);
+	for (int i = 0; i < n_parts; i++) {
+		run = parts[i]->new_run;
+		if (!vy_run_is_empty(run))
+			vy_log_create_run(index->commit_lsn, run->id,
+					  run->dump_lsn);
+	}
+	for (int i = 0; i < n_parts; i++) {
+		struct vy_range *new_range = new_ranges[i];
+		vy_log_insert_range(index->commit_lsn, new_range->id,
+				    tuple_data_or_null(new_range->begin),
+				    tuple_data_or_null(new_range->end));
+		rlist_foreach_entry(slice, &new_range->slices, in_range)
+			vy_log_insert_slice(new_range->id, slice->run->id,
+					    slice->id,
+					    tuple_data_or_null(slice->begin),
+					    tuple_data_or_null(slice->end));
+	}
+	if (vy_log_tx_commit() < 0)
+		goto fail;
+
+	/*
+	 * Account new runs if they are not empty,
+	 * otherwise discard them.
+	 */
+	for (int i = 0; i < n_parts; i++) {
+		part = parts[i];
+		run = part->new_run;
+		if (!vy_run_is_empty(run)) {
+			vy_index_add_run(index, run);
+			vy_stmt_counter_add_disk(&index->stat.disk.compact.out,
+						 &run->count);
+			/* Drop the reference held by the task. */
+			vy_run_unref(run);
+		} else
+			vy_run_discard(run);
+		part->new_run = NULL;
+	}
+
+	/*
+	 * Replace the compacted range with the new ones.
+	 */
+	for (slice = first_slice; ; slice = rlist_next_entry(slice, in_range)) {
+		vy_stmt_counter_add_disk(&index->stat.disk.compact.in,
+					 &slice->count);
+		if (slice == last_slice)
+			break;
+	}
+	vy_index_unacct_range(index, range);
+	assert(range->heap_node.pos == UINT32_MAX);
+	vy_range_heap_insert(&index->range_heap, &range->heap_node);
+	vy_index_remove_range(index, range);
+	for (int i = 0; i < n_parts; i++) {
+		vy_index_add_range(index, new_ranges[i]);
+		vy_index_acct_range(index, new_ranges[i]);
+	}
+	index->range_tree_version++;
+	index->stat.disk.compact.count++;
+
+	/*
+	 * Unaccount unused runs and delete the compacted range.
+	 */
+	rlist_foreach_entry(run, &unused_runs, in_unused)
+		vy_index_remove_run(index, run);
+
+	say_info("%s: completed compacting range %s in %d parts",
+		 vy_index_name(index), vy_range_str(range), n_parts);
+
+	rlist_foreach_entry(slice, &range->slices, in_range)
+		vy_slice_wait_pinned(slice);
+	vy_range_delete(range);
+	task->range = NULL;
+
+	vy_scheduler_update_index(scheduler, index);
+	return 0;
+fail:
+	for (int i = 0; i < n_parts; i++) {
+		if (new_ranges[i] != NULL)
+			vy_range_delete(new_ranges[i]);
+	}
+	return -1;
 }
 
 static int
 vy_task_compact_complete(struct vy_scheduler *scheduler, struct vy_task *task)
 {
+	if (!stailq_empty(&task->parts))
+		return vy_task_compact_complete_parts(scheduler, task);
+
 	struct vy_index *index = task->index;
 	struct vy_range *range = task->range;
 	struct vy_run *new_run = task->new_run;
@@ -1023,19 +1459,8 @@ vy_task_compact_complete(struct vy_scheduler *scheduler, struct vy_task *task)
 	 * as a result of compaction.
 	 */
 	RLIST_HEAD(unused_runs);
-	for (slice = first_slice; ; slice = rlist_next_entry(slice, in_range)) {
-		slice->run->compacted_slice_count++;
-		if (slice == last_slice)
-			break;
-	}
-	for (slice = first_slice; ; slice = rlist_next_entry(slice, in_range)) {
-		run = slice->run;
-		if (run->compacted_slice_count == run->refs)
-			rlist_add_entry(&unused_runs, run, in_unused);
-		slice->run->compacted_slice_count = 0;
-		if (slice == last_slice)
-			break;
-	}
+	vy_task_compact_find_unused_runs(first_slice, last_slice,
+					 &unused_runs);
 
 	/*
 	 * Log change in metadata.
@@ -1132,9 +1557,6 @@ vy_task_compact_abort(struct vy_scheduler *scheduler, struct vy_task *task,
 	struct vy_index *index = task->index;
 	struct vy_range *range = task->range;
 
-	/* The iterator has been cleaned up in worker. */
-	task->wi->iface->close(task->wi);
-
 	/*
 	 * It's no use alerting the user if the server is
 	 * shutting down or the index was dropped.
@@ -1145,17 +1567,162 @@ vy_task_compact_abort(struct vy_scheduler *scheduler, struct vy_task *task,
 			  diag_last_error(&task->diag)->errmsg);
 	}
 
-	/* The metadata log is unavailable on shutdown. */
-	if (!in_shutdown)
-		vy_run_discard(task->new_run);
-	else
-		vy_run_unref(task->new_run);
+	/* The iterator has been cleaned up in worker. */
+	vy_task_compact_cleanup(task, in_shutdown);
+	struct vy_task *part;
+	stailq_foreach_entry(part, &task->parts, in_parts)
+		vy_task_compact_cleanup(part, in_shutdown);
 
 	assert(range->heap_node.pos == UINT32_MAX);
 	vy_range_heap_insert(&index->range_heap, &range->heap_node);
 	vy_scheduler_update_index(scheduler, index);
 }
 
+/**
+ * Choose keys to split compaction of slices [@first_slice,
+ * @last_slice] of a range in parts that can be executed in
+ * parallel. A range is split only if there is enough data to
+ * compact to fill at least two ranges of the configured size.
+ * The keys are taken from page boundaries of the largest
+ * compacted slice so that the parts are of approximately the
+ * same size.
+ *
+ * On success, returns the number of parts (at most @max_parts)
+ * and stores the keys delimiting them in @split_keys. The caller
+ * is responsible for unreferencing the keys. On failure, returns
+ * -1 and sets diag.
+ */
+static int
+vy_task_compact_split(struct vy_index *index, struct vy_slice *first_slice,
+		      struct vy_slice *last_slice,
+		      int max_parts, struct tuple **split_keys)
+{
+	struct tuple_format *key_format = index->env->key_format;
+	struct vy_slice *slice, *largest = NULL;
+	uint64_t size = 0;
+
+	for (slice = first_slice; ; slice = rlist_next_entry(slice, in_range)) {
+		size += slice->count.bytes_compressed;
+		if (largest == NULL || slice->count.bytes_compressed >
+				       largest->count.bytes_compressed)
+			largest = slice;
+		if (slice == last_slice)
+			break;
+	}
+
+	int n_parts = MIN(size / index->opts.range_size, (uint64_t)max_parts);
+	n_parts = MIN(n_parts, (int)largest->count.pages);
+	if (n_parts < 2)
+		return 1;
+
+	/*
+	 * The split keys must be strictly increasing and lie
+	 * within the slice, while the min key of the first page
+	 * spanned by the slice may be less than its beginning.
+	 */
+	const char *prev_key = largest->begin != NULL ?
+			       tuple_data(largest->begin) : NULL;
+	int n_keys = 0;
+	for (int i = 1; i < n_parts; i++) {
+		uint32_t page_no = largest->first_page_no +
+			(uint64_t)largest->count.pages * i / n_parts;
+		struct vy_page_info *page = vy_run_page_info(largest->run,
+							     page_no);
+		if (prev_key != NULL && key_compare(page->min_key, prev_key,
+						    index->cmp_def) <= 0)
+			continue;
+		split_keys[n_keys] = vy_key_from_msgpack(key_format,
+							 page->min_key);
+		if (split_keys[n_keys] == NULL)
+			goto fail;
+		prev_key = page->min_key;
+		n_keys++;
+	}
+	return n_keys + 1;
+fail:
+	for (int i = 0; i < n_keys; i++)
+		tuple_unref(split_keys[i]);
+	return -1;
+}
+
+/**
+ * Create a task merging statements of slices [@first_slice,
+ * @last_slice] of a range that fall in the key interval
+ * [@begin, @end). NULL boundaries mean that the interval is
+ * bounded by the range.
+ */
+static struct vy_task *
+vy_task_compact_new_part(struct vy_scheduler *scheduler,
+			 struct vy_index *index, struct vy_range *range,
+			 struct vy_slice *first_slice,
+			 struct vy_slice *last_slice,
+			 struct tuple *begin, struct tuple *end,
+			 const struct vy_task_ops *ops)
+{
+	struct tx_manager *xm = scheduler->env->xm;
+	struct vy_task *task = vy_task_new(&scheduler->task_pool,
+					   index, ops);
+	if (task == NULL)
+		return NULL;
+
+	task->range = range;
+	task->first_slice = first_slice;
+	task->last_slice = last_slice;
+	task->bloom_fpr = index->opts.bloom_fpr;
+	task->bloom_prefix = index->opts.bloom_prefix;
+	task->page_size = index->opts.page_size;
+	if (begin != NULL)
+		tuple_ref(begin);
+	task->begin = begin;
+	if (end != NULL)
+		tuple_ref(end);
+	task->end = end;
+
+	task->new_run = vy_run_prepare(index);
+	if (task->new_run == NULL)
+		goto err;
+
+	bool is_last_level = (range->compact_priority == range->slice_count);
+	task->wi = vy_write_iterator_new(index->cmp_def, index->disk_format,
+					 index->upsert_format, index->id == 0,
+					 is_last_level, &xm->read_views);
+	if (task->wi == NULL)
+		goto err;
+
+	struct vy_slice *slice;
+	for (slice = first_slice; ; slice = rlist_next_entry(slice, in_range)) {
+		struct vy_slice *part_slice = slice;
+		if (begin != NULL || end != NULL) {
+			if (vy_slice_cut(slice, vy_log_next_id(), begin, end,
+					 index->cmp_def, &part_slice) != 0)
+				goto err;
+			if (part_slice != NULL)
+				rlist_add_tail_entry(&task->part_slices,
+						     part_slice, in_range);
+		}
+		if (part_slice != NULL) {
+			if (vy_write_iterator_new_slice(task->wi, part_slice,
+					&scheduler->env->run_env) != 0)
+				goto err;
+			task->max_output_count += part_slice->count.rows;
+		}
+		task->new_run->dump_lsn = MAX(task->new_run->dump_lsn,
+					      slice->run->dump_lsn);
+		/* Slices are sorted by age, the newest first. */
+		if (task->dict_run_id < 0 && slice->run->zddict != NULL &&
+		    scheduler->env->dict_size > 0)
+			task->dict_run_id = slice->run->id;
+		if (slice == last_slice)
+			break;
+	}
+	assert(task->new_run->dump_lsn >= 0);
+	return task;
+err:
+	vy_task_compact_cleanup(task, false);
+	vy_task_delete(&scheduler->task_pool, task);
+	return NULL;
+}
+
 static int
 vy_task_compact_new(struct vy_scheduler *scheduler, struct vy_index *index,
 		    struct vy_task **p_task)
@@ -1166,7 +1733,6 @@ vy_task_compact_new(struct vy_scheduler *scheduler, struct vy_index *index,
 		.abort = vy_task_compact_abort,
 	};
 
-	struct tx_manager *xm = scheduler->env->xm;
 	struct heap_node *range_node;
 	struct vy_range *range;
 
@@ -1183,50 +1749,52 @@ vy_task_compact_new(struct vy_scheduler *scheduler, struct vy_index *index,
 		return 0;
 	}
 
-	struct vy_task *task = vy_task_new(&scheduler->task_pool,
-					   index, &compact_ops);
-	if (task == NULL)
-		goto err_task;
-
-	struct vy_run *new_run = vy_run_prepare(index);
-	if (new_run == NULL)
-		goto err_run;
-
-	struct vy_stmt_stream *wi;
-	bool is_last_level = (range->compact_priority == range->slice_count);
-	wi = vy_write_iterator_new(index->cmp_def, index->disk_format,
-				   index->upsert_format, index->id == 0,
-				   is_last_level, &xm->read_views);
-	if (wi == NULL)
-		goto err_wi;
-
-	struct vy_slice *slice;
+	/* Find the slices we are going to compact. */
+	struct vy_slice *slice, *first_slice = NULL, *last_slice = NULL;
 	int n = range->compact_priority;
 	rlist_foreach_entry(slice, &range->slices, in_range) {
-		if (vy_write_iterator_new_slice(wi, slice,
-						&scheduler->env->run_env) != 0)
-			goto err_wi_sub;
-
-		task->max_output_count += slice->count.rows;
-		new_run->dump_lsn = MAX(new_run->dump_lsn,
-					slice->run->dump_lsn);
-
-		/* Remember the slices we are compacting. */
-		if (task->first_slice == NULL)
-			task->first_slice = slice;
-		task->last_slice = slice;
-
+		if (first_slice == NULL)
+			first_slice = slice;
+		last_slice = slice;
 		if (--n == 0)
 			break;
 	}
 	assert(n == 0);
-	assert(new_run->dump_lsn >= 0);
 
-	task->range = range;
-	task->new_run = new_run;
-	task->wi = wi;
-	task->bloom_fpr = index->opts.bloom_fpr;
-	task->page_size = index->opts.page_size;
+	/*
+	 * Split compaction of a large range in parts to be
+	 * executed by idle worker threads in parallel. Note,
+	 * one worker thread is always reserved for dumps,
+	 * see vy_schedule().
+	 */
+	struct vy_task *task = NULL;
+	struct tuple *split_keys[VY_COMPACT_MAX_PARTS - 1];
+	int max_parts = MIN(scheduler->workers_available - 1,
+			    VY_COMPACT_MAX_PARTS);
+	int n_parts = vy_task_compact_split(index, first_slice, last_slice,
+					    max_parts, split_keys);
+	if (n_parts < 0)
+		goto err;
+
+	for (int i = 0; i < n_parts; i++) {
+		struct tuple *begin = i > 0 ? split_keys[i - 1] : NULL;
+		struct tuple *end = i < n_parts - 1 ? split_keys[i] : NULL;
+		struct vy_task *part;
+		part = vy_task_compact_new_part(scheduler, index, range,
+						first_slice, last_slice,
+						begin, end, &compact_ops);
+		if (part == NULL)
+			goto err_part;
+		if (task == NULL) {
+			task = part;
+			continue;
+		}
+		part->leader = task;
+		stailq_add_tail_entry(&task->parts, part, in_parts);
+		task->pending_part_count++;
+	}
+	for (int i = 0; i < n_parts - 1; i++)
+		tuple_unref(split_keys[i]);
 
 	/*
 	 * Remove the range we are going to compact from the heap
@@ -1236,19 +1804,30 @@ vy_task_compact_new(struct vy_scheduler *scheduler, struct vy_index *index,
 	range_node->pos = UINT32_MAX;
 	vy_scheduler_update_index(scheduler, index);
 
-	say_info("%s: started compacting range %s, runs %d/%d",
-		 vy_index_name(index), vy_range_str(range),
-                 range->compact_priority, range->slice_count);
+	if (n_parts > 1) {
+		say_info("%s: started compacting range %s, runs %d/%d, "
+			 "parts %d", vy_index_name(index), vy_range_str(range),
+			 range->compact_priority, range->slice_count,
+			 n_parts);
+	} else {
+		say_info("%s: started compacting range %s, runs %d/%d",
+			 vy_index_name(index), vy_range_str(range),
+			 range->compact_priority, range->slice_count);
+	}
 	*p_task = task;
 	return 0;
 
-err_wi_sub:
-	task->wi->iface->close(wi);
-err_wi:
-	vy_run_discard(new_run);
-err_run:
-	vy_task_delete(&scheduler->task_pool, task);
-err_task:
+err_part:
+	if (task != NULL) {
+		struct vy_task *part;
+		vy_task_compact_cleanup(task, false);
+		stailq_foreach_entry(part, &task->parts, in_parts)
+			vy_task_compact_cleanup(part, false);
+		vy_task_delete(&scheduler->task_pool, task);
+	}
+	for (int i = 0; i < n_parts - 1; i++)
+		tuple_unref(split_keys[i]);
+err:
 	say_error("%s: could not start compacting range %s: %s",
 		  vy_index_name(index), vy_range_str(range),
 		  diag_last_error(diag_get())->errmsg);
@@ -1575,6 +2154,26 @@ fail:
 
 }
 
+/**
+ * Account a task processed by a worker thread. If the task is
+ * a part of another task, the error it failed with, if any,
+ * is propagated to the leader. Returns the task to complete
+ * if all parts of the leader have been processed, NULL otherwise.
+ */
+static struct vy_task *
+vy_task_part_done(struct vy_task *task)
+{
+	struct vy_task *leader = task->leader != NULL ? task->leader : task;
+	if (task != leader && task->status != 0 && leader->status == 0) {
+		leader->status = task->status;
+		diag_move(&task->diag, &leader->diag);
+	}
+	assert(leader->pending_part_count > 0);
+	if (--leader->pending_part_count > 0)
+		return NULL;
+	return leader;
+}
+
 static int
 vy_scheduler_complete_task(struct vy_scheduler *scheduler,
 			   struct vy_task *task)
@@ -1658,14 +2257,21 @@ vy_scheduler_f(va_list va)
 
 		/* Complete and delete all processed tasks. */
 		stailq_foreach_entry_safe(task, next, &output_queue, link) {
-			if (vy_scheduler_complete_task(scheduler, task) != 0)
-				tasks_failed++;
-			else
-				tasks_done++;
-			vy_task_delete(&scheduler->task_pool, task);
 			scheduler->workers_available++;
 			assert(scheduler->workers_available <=
 			       scheduler->worker_pool_size);
+			/*
+			 * A task split in parts can only be completed
+			 * after all its parts have been processed.
+			 */
+			struct vy_task *leader = vy_task_part_done(task);
+			if (leader == NULL)
+				continue;
+			if (vy_scheduler_complete_task(scheduler, leader) != 0)
+				tasks_failed++;
+			else
+				tasks_done++;
+			vy_task_delete(&scheduler->task_pool, leader);
 		}
 		/*
 		 * Reset the timeout if we managed to successfully
@@ -1700,11 +2306,18 @@ vy_scheduler_f(va_list va)
 		tt_pthread_mutex_lock(&scheduler->mutex);
 		was_empty = stailq_empty(&scheduler->input_queue);
 		stailq_add_tail_entry(&scheduler->input_queue, task, link);
-		if (was_empty)
+		struct vy_task *part;
+		stailq_foreach_entry(part, &task->parts, in_parts)
+			stailq_add_tail_entry(&scheduler->input_queue,
+					      part, link);
+		if (was_empty && stailq_empty(&task->parts))
 			tt_pthread_cond_signal(&scheduler->worker_cond);
+		else if (was_empty)
+			tt_pthread_cond_broadcast(&scheduler->worker_cond);
 		tt_pthread_mutex_unlock(&scheduler->mutex);
 
-		scheduler->workers_available--;
+		scheduler->workers_available -= task->pending_part_count;
+		assert(scheduler->workers_available >= 0);
 		fiber_reschedule();
 		continue;
 error:
@@ -1826,13 +2439,19 @@ vy_scheduler_stop_workers(struct vy_scheduler *scheduler)
 	scheduler->worker_pool = NULL;
 	scheduler->worker_pool_size = 0;
 
-	/* Abort all pending tasks. */
+	/*
+	 * Abort all pending tasks. Parts of a task are aborted
+	 * and deleted along with the task they belong to.
+	 */
 	struct vy_task *task, *next;
 	stailq_concat(&task_queue, &scheduler->output_queue);
 	stailq_foreach_entry_safe(task, next, &task_queue, link) {
-		if (task->ops->abort != NULL)
-			task->ops->abort(scheduler, task, true);
-		vy_task_delete(&scheduler->task_pool, task);
+		struct vy_task *leader = vy_task_part_done(task);
+		if (leader == NULL)
+			continue;
+		if (leader->ops->abort != NULL)
+			leader->ops->abort(scheduler, leader, true);
+		vy_task_delete(&scheduler->task_pool, leader);
 	}
 }
 
@@ -2052,6 +2671,12 @@ vy_info_append_performance(struct vy_env *env, struct info_handler *h)
 	info_append_int(h, "used", ce->mem_used);
 	info_table_end(h);
 
+	struct vy_page_cache *pc = &env->run_env.page_cache;
+	info_table_begin(h, "page_cache");
+	info_append_int(h, "count", pc->page_count);
+	info_append_int(h, "used", pc->mem_used);
+	info_table_end(h);
+
 	info_table_end(h);
 }
 
@@ -2153,6 +2778,10 @@ vy_index_info(struct vy_index *index, struct info_handler *h)
 	info_append_int(h, "hit", stat->disk.iterator.bloom_hit);
 	info_append_int(h, "miss", stat->disk.iterator.bloom_miss);
 	info_table_end(h);
+	info_table_begin(h, "page_cache");
+	info_append_int(h, "hit", stat->disk.iterator.page_cache_hit);
+	info_append_int(h, "miss", stat->disk.iterator.page_cache_miss);
+	info_table_end(h);
 	info_table_end(h);
 	vy_info_append_compact_stat(h, "dump", &stat->disk.dump);
 	vy_info_append_compact_stat(h, "compact", &stat->disk.compact);
@@ -3978,6 +4607,18 @@ vy_set_timeout(struct vy_env *env, double timeout)
 	env->timeout = timeout;
 }
 
+void
+vy_set_page_cache(struct vy_env *env, size_t quota)
+{
+	vy_run_env_set_page_cache_quota(&env->run_env, quota);
+}
+
+void
+vy_set_dict_size(struct vy_env *env, size_t size)
+{
+	env->dict_size = size;
+}
+
 /** }}} Environment */
 
 /* {{{ Checkpoint */
@@ -4566,6 +5207,9 @@ vy_backup_cb(const struct vy_log_record *record, void *cb_arg)
 		vy_run_snprint_path(path, sizeof(path), arg->env->path,
 				    arg->space_id, arg->index_id,
 				    record->run_id, type);
+		/* Runs compressed without a dictionary have none. */
+		if (type == VY_FILE_DICT && access(path, F_OK) != 0)
+			continue;
 		if (arg->cb(path, arg->cb_arg) != 0)
 			return -1;
 	}
@@ -403,6 +403,19 @@ vy_set_max_tuple_size(struct vy_env *env, size_t max_size);
 void
 vy_set_timeout(struct vy_env *env, double timeout);
 
+/**
+ * Update the size of the cache of decompressed run pages.
+ */
+void
+vy_set_page_cache(struct vy_env *env, size_t quota);
+
+/**
+ * Update the max size of compression dictionaries trained
+ * for new run files. 0 disables dictionaries.
+ */
+void
+vy_set_dict_size(struct vy_env *env, size_t size);
+
 #ifdef __cplusplus
 }
 #endif
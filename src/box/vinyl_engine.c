@@ -241,6 +241,11 @@ vinyl_engine_check_space_def(struct space_def *def)
 			 def->name, "engine does not support temporary flag");
 		return -1;
 	}
+	if (def->opts.compress_threshold != 0) {
+		diag_set(ClientError, ER_ALTER_SPACE, def->name,
+			 "engine does not support compress_threshold");
+		return -1;
+	}
 	return 0;
 }
 
@@ -301,3 +306,15 @@ vinyl_engine_set_timeout(struct vinyl_engine *vinyl, double timeout)
 {
 	vy_set_timeout(vinyl->env, timeout);
 }
+
+void
+vinyl_engine_set_page_cache(struct vinyl_engine *vinyl, size_t quota)
+{
+	vy_set_page_cache(vinyl->env, quota);
+}
+
+void
+vinyl_engine_set_dict_size(struct vinyl_engine *vinyl, size_t size)
+{
+	vy_set_dict_size(vinyl->env, size);
+}
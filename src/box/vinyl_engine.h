@@ -58,6 +58,17 @@ vinyl_engine_set_max_tuple_size(struct vinyl_engine *vinyl, size_t max_size);
 void
 vinyl_engine_set_timeout(struct vinyl_engine *vinyl, double timeout);
 
+void
+vinyl_engine_set_page_cache(struct vinyl_engine *vinyl, size_t quota);
+
+enum {
+	/** Max size of a run file compression dictionary. */
+	VINYL_DICT_SIZE_MAX = 1024 * 1024,
+};
+
+void
+vinyl_engine_set_dict_size(struct vinyl_engine *vinyl, size_t size);
+
 #if defined(__cplusplus)
 } /* extern "C" */
 
@@ -43,6 +43,40 @@
 #include "xlog.h"
 #include "xrow.h"
 
+struct vy_page_cache_key {
+	int64_t run_id;
+	uint32_t page_no;
+};
+
+static inline uint32_t
+vy_page_cache_hash(int64_t run_id, uint32_t page_no)
+{
+	uint64_t h = (uint64_t)run_id * 0x9E3779B97F4A7C15ULL ^ page_no;
+	return (uint32_t)(h ^ (h >> 32));
+}
+
+#define mh_name _vy_page_cache
+#define mh_key_t const struct vy_page_cache_key *
+#define mh_node_t struct vy_page *
+#define mh_arg_t void *
+#define mh_hash(a, arg) (vy_page_cache_hash((*(a))->run_id, (*(a))->page_no))
+#define mh_hash_key(a, arg) (vy_page_cache_hash((a)->run_id, (a)->page_no))
+#define mh_cmp(a, b, arg) ((*(a))->run_id != (*(b))->run_id || \
+			   (*(a))->page_no != (*(b))->page_no)
+#define mh_cmp_key(a, b, arg) ((a)->run_id != (*(b))->run_id || \
+			       (a)->page_no != (*(b))->page_no)
+#define MH_SOURCE 1
+#include "salad/mhash.h"
+
+static void
+vy_page_cache_create(struct vy_page_cache *cache);
+
+static void
+vy_page_cache_destroy(struct vy_page_cache *cache);
+
+static void
+vy_page_cache_evict(struct vy_page_cache *cache);
+
 static const uint64_t vy_page_info_key_map = (1 << VY_PAGE_INFO_OFFSET) |
 					     (1 << VY_PAGE_INFO_SIZE) |
 					     (1 << VY_PAGE_INFO_UNPACKED_SIZE) |
@@ -67,6 +101,7 @@ enum { VY_BLOOM_VERSION = 0 };
 const char *vy_file_suffix[] = {
 	"index",	/* VY_FILE_INDEX */
 	"run",		/* VY_FILE_RUN */
+	"dict",		/* VY_FILE_DICT */
 };
 
 /**
@@ -171,6 +206,7 @@ vy_run_env_create(struct vy_run_env *env)
 	tt_pthread_key_create(&env->zdctx_key, vy_free_zdctx);
 	mempool_create(&env->read_task_pool, cord_slab_cache(),
 		       sizeof(struct vy_page_read_task));
+	vy_page_cache_create(&env->page_cache);
 }
 
 /**
@@ -181,10 +217,18 @@ vy_run_env_destroy(struct vy_run_env *env)
 {
 	if (env->reader_pool != NULL)
 		vy_run_env_stop_readers(env);
+	vy_page_cache_destroy(&env->page_cache);
 	mempool_destroy(&env->read_task_pool);
 	tt_pthread_key_delete(env->zdctx_key);
 }
 
+void
+vy_run_env_set_page_cache_quota(struct vy_run_env *env, size_t quota)
+{
+	env->page_cache.quota = quota;
+	vy_page_cache_evict(&env->page_cache);
+}
+
 /**
  * Enable coio reads for a vinyl run environment.
  */
@@ -256,10 +300,18 @@ vy_run_clear(struct vy_run *run)
 	if (run->info.has_bloom)
 		bloom_destroy(&run->info.bloom, runtime.quota);
 	run->info.has_bloom = false;
+	for (uint32_t i = 0; i < run->info.prefix_bloom_count; i++)
+		bloom_destroy(&run->info.prefix_bloom[i], runtime.quota);
+	free(run->info.prefix_bloom);
+	run->info.prefix_bloom = NULL;
+	run->info.prefix_bloom_count = 0;
 	free(run->info.min_key);
 	run->info.min_key = NULL;
 	free(run->info.max_key);
 	run->info.max_key = NULL;
+	if (run->zddict != NULL)
+		ZSTD_freeDDict(run->zddict);
+	run->zddict = NULL;
 }
 
 void
@@ -579,6 +631,43 @@ vy_run_bloom_decode(struct bloom *bloom, const char **buffer,
 	return 0;
 }
 
+/**
+ * Read key prefix bloom filters from given buffer.
+ * @param run_info - run info to store bloom filters in.
+ * @param buffer[in/out] - a buffer to read from.
+ *  The pointer is incremented on the number of bytes read.
+ * @param filename Filename for error reporting.
+ * @return - 0 on success or -1 on format/memory error
+ */
+static int
+vy_run_prefix_bloom_decode(struct vy_run_info *run_info, const char **buffer,
+			   const char *filename)
+{
+	uint32_t count = mp_decode_array(buffer);
+	if (count == 0)
+		return 0;
+	run_info->prefix_bloom = calloc(count, sizeof(struct bloom));
+	if (run_info->prefix_bloom == NULL) {
+		diag_set(OutOfMemory, count * sizeof(struct bloom),
+			 "malloc", "prefix bloom");
+		return -1;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		if (vy_run_bloom_decode(&run_info->prefix_bloom[i],
+					buffer, filename) != 0)
+			goto fail;
+		run_info->prefix_bloom_count++;
+	}
+	return 0;
+fail:
+	for (uint32_t i = 0; i < run_info->prefix_bloom_count; i++)
+		bloom_destroy(&run_info->prefix_bloom[i], runtime.quota);
+	free(run_info->prefix_bloom);
+	run_info->prefix_bloom = NULL;
+	run_info->prefix_bloom_count = 0;
+	return -1;
+}
+
 /**
  * Decode the run metadata from xrow.
  *
@@ -637,6 +726,11 @@ vy_run_info_decode(struct vy_run_info *run_info,
 			else
 				return -1;
 			break;
+		case VY_RUN_INFO_PREFIX_BLOOM:
+			if (vy_run_prefix_bloom_decode(run_info, &pos,
+						       filename) != 0)
+				return -1;
+			break;
 		default:
 			diag_set(ClientError, ER_INVALID_INDEX_FILE, filename,
 				"Can't decode run info: unknown key %u",
@@ -664,6 +758,9 @@ vy_page_new(const struct vy_page_info *page_info)
 			 "load_page", "page cache");
 		return NULL;
 	}
+	page->run_id = -1;
+	page->refs = 1;
+	rlist_create(&page->in_cache);
 	page->unpacked_size = page_info->unpacked_size;
 	page->row_count = page_info->row_count;
 	page->row_index = calloc(page_info->row_count, sizeof(uint32_t));
@@ -700,6 +797,132 @@ vy_page_delete(struct vy_page *page)
 	free(page);
 }
 
+static inline void
+vy_page_ref(struct vy_page *page)
+{
+	assert(page->refs > 0);
+	page->refs++;
+}
+
+static inline void
+vy_page_unref(struct vy_page *page)
+{
+	assert(page->refs > 0);
+	if (--page->refs == 0)
+		vy_page_delete(page);
+}
+
+/** Amount of memory accounted to a page stored in the cache. */
+static inline size_t
+vy_page_cache_page_size(struct vy_page *page)
+{
+	return sizeof(*page) + page->unpacked_size +
+	       page->row_count * sizeof(uint32_t);
+}
+
+static void
+vy_page_cache_create(struct vy_page_cache *cache)
+{
+	cache->hash = mh_vy_page_cache_new();
+	if (cache->hash == NULL)
+		panic("failed to allocate vinyl page cache");
+	rlist_create(&cache->lru);
+	cache->mem_used = 0;
+	cache->quota = 0;
+	cache->page_count = 0;
+}
+
+static void
+vy_page_cache_destroy(struct vy_page_cache *cache)
+{
+	struct vy_page *page, *tmp;
+	rlist_foreach_entry_safe(page, &cache->lru, in_cache, tmp)
+		vy_page_unref(page);
+	mh_vy_page_cache_delete(cache->hash);
+}
+
+/** Remove the given page from the cache. */
+static void
+vy_page_cache_remove(struct vy_page_cache *cache, struct vy_page *page)
+{
+	struct vy_page_cache_key key = {
+		.run_id = page->run_id,
+		.page_no = page->page_no,
+	};
+	mh_int_t k = mh_vy_page_cache_find(cache->hash, &key, NULL);
+	assert(k != mh_end(cache->hash));
+	mh_vy_page_cache_del(cache->hash, k, NULL);
+	rlist_del_entry(page, in_cache);
+	assert(cache->mem_used >= vy_page_cache_page_size(page));
+	cache->mem_used -= vy_page_cache_page_size(page);
+	cache->page_count--;
+	vy_page_unref(page);
+}
+
+/** Evict least recently used pages until the cache fits in quota. */
+static void
+vy_page_cache_evict(struct vy_page_cache *cache)
+{
+	while (cache->mem_used > cache->quota) {
+		assert(!rlist_empty(&cache->lru));
+		struct vy_page *page = rlist_last_entry(&cache->lru,
+						struct vy_page, in_cache);
+		vy_page_cache_remove(cache, page);
+	}
+}
+
+/**
+ * Look up a page in the cache.
+ * @retval page if found; the page is referenced and
+ *         moved to the head of the LRU list
+ * @retval NULL otherwise
+ */
+static struct vy_page *
+vy_page_cache_get(struct vy_page_cache *cache, int64_t run_id,
+		  uint32_t page_no)
+{
+	struct vy_page_cache_key key = {
+		.run_id = run_id,
+		.page_no = page_no,
+	};
+	mh_int_t k = mh_vy_page_cache_find(cache->hash, &key, NULL);
+	if (k == mh_end(cache->hash))
+		return NULL;
+	struct vy_page *page = *mh_vy_page_cache_node(cache->hash, k);
+	rlist_move_entry(&cache->lru, page, in_cache);
+	vy_page_ref(page);
+	return page;
+}
+
+/**
+ * Add a page to the cache unless the cache already has a page
+ * with the same id or the page doesn't fit in the quota. Never
+ * fails: if we run out of memory, the page is just not cached.
+ */
+static void
+vy_page_cache_put(struct vy_page_cache *cache, struct vy_page *page)
+{
+	assert(page->run_id >= 0);
+	size_t size = vy_page_cache_page_size(page);
+	if (size > cache->quota)
+		return;
+	struct vy_page_cache_key key = {
+		.run_id = page->run_id,
+		.page_no = page->page_no,
+	};
+	if (mh_vy_page_cache_find(cache->hash, &key,
+				  NULL) != mh_end(cache->hash))
+		return; /* loaded by another fiber */
+	if (mh_vy_page_cache_put(cache->hash, &page,
+				 NULL, NULL) == mh_end(cache->hash))
+		return;
+	vy_page_ref(page);
+	rlist_add_entry(&cache->lru, page, in_cache);
+	cache->mem_used += size;
+	cache->page_count++;
+	vy_page_cache_evict(cache);
+}
+
 static int
 vy_page_xrow(struct vy_page *page, uint32_t stmt_no,
 	     struct xrow_header *xrow)
@@ -782,7 +1005,7 @@ vy_run_iterator_cache_put(struct vy_run_iterator *itr, struct vy_page *page,
 			  uint32_t page_no)
 {
 	if (itr->prev_page != NULL)
-		vy_page_delete(itr->prev_page);
+		vy_page_unref(itr->prev_page);
 	itr->prev_page = itr->curr_page;
 	itr->curr_page = page;
 	page->page_no = page_no;
@@ -800,9 +1023,9 @@ vy_run_iterator_cache_clean(struct vy_run_iterator *itr)
 		itr->curr_stmt_pos.page_no = UINT32_MAX;
 	}
 	if (itr->curr_page != NULL) {
-		vy_page_delete(itr->curr_page);
+		vy_page_unref(itr->curr_page);
 		if (itr->prev_page != NULL)
-			vy_page_delete(itr->prev_page);
+			vy_page_unref(itr->prev_page);
 		itr->curr_page = itr->prev_page = NULL;
 	}
 }
@@ -847,8 +1070,8 @@ vy_row_index_decode(uint32_t *row_index, uint32_t row_count,
  * @retval -1 on error, check diag
  */
 static int
-vy_page_read(struct vy_page *page, const struct vy_page_info *page_info, int fd,
-	     ZSTD_DStream *zdctx)
+vy_page_read(struct vy_page *page, const struct vy_page_info *page_info,
+	     struct vy_run *run, ZSTD_DStream *zdctx)
 {
 	/* read xlog tx from xlog file */
 	size_t region_svp = region_used(&fiber()->gc);
@@ -857,7 +1080,7 @@ vy_page_read(struct vy_page *page, const struct vy_page_info *page_info, int fd,
 		diag_set(OutOfMemory, page_info->size, "region gc", "page");
 		return -1;
 	}
-	ssize_t readen = fio_pread(fd, data, page_info->size,
+	ssize_t readen = fio_pread(run->fd, data, page_info->size,
 				   page_info->offset);
 	ERROR_INJECT(ERRINJ_VYRUN_DATA_READ, {
 		readen = -1;
@@ -880,7 +1103,8 @@ vy_page_read(struct vy_page *page, const struct vy_page_info *page_info, int fd,
 	const char *data_end = data + readen;
 	char *rows = page->data;
 	char *rows_end = rows + page_info->unpacked_size;
-	if (xlog_tx_decode(data, data_end, rows, rows_end, zdctx) != 0)
+	if (xlog_tx_decode(data, data_end, rows, rows_end,
+			   zdctx, run->zddict) != 0)
 		goto error;
 
 	struct xrow_header xrow;
@@ -938,7 +1162,7 @@ vy_page_read_cb(struct cbus_call_msg *base)
 	if (zdctx == NULL)
 		return -1;
 	return vy_page_read(task->page, &task->page_info,
-			    task->slice->run->fd, zdctx);
+			    task->slice->run, zdctx);
 }
 
 /**
@@ -972,9 +1196,20 @@ vy_run_iterator_load_page(struct vy_run_iterator *itr, uint32_t page_no,
 	if (*result != NULL)
 		return 0;
 
+	/* Check the page cache shared by all iterators */
+	struct vy_page *page = vy_page_cache_get(&env->page_cache,
+						 slice->run->id, page_no);
+	if (page != NULL) {
+		itr->stat->page_cache_hit++;
+		vy_run_iterator_cache_put(itr, page, page_no);
+		*result = page;
+		return 0;
+	}
+	itr->stat->page_cache_miss++;
+
 	/* Allocate buffers */
 	struct vy_page_info *page_info = vy_run_page_info(slice->run, page_no);
-	struct vy_page *page = vy_page_new(page_info);
+	page = vy_page_new(page_info);
 	if (page == NULL)
 		return -1;
 
@@ -1033,7 +1268,7 @@ vy_run_iterator_load_page(struct vy_run_iterator *itr, uint32_t page_no,
 			vy_page_delete(page);
 			return -1;
 		}
-		if (vy_page_read(page, page_info, slice->run->fd, zdctx) != 0) {
+		if (vy_page_read(page, page_info, slice->run, zdctx) != 0) {
 			vy_page_delete(page);
 			return -1;
 		}
@@ -1044,6 +1279,8 @@ vy_run_iterator_load_page(struct vy_run_iterator *itr, uint32_t page_no,
 
 	/* Update cache */
 	vy_run_iterator_cache_put(itr, page, page_no);
+	page->run_id = slice->run->id;
+	vy_page_cache_put(&env->page_cache, page);
 
 	/* Update read statistics. */
 	itr->stat->read.rows += page_info->row_count;
@@ -1339,7 +1576,13 @@ vy_run_iterator_start_from(struct vy_run_iterator *itr,
 	*ret = NULL;
 
 	const struct key_def *key_def = itr->key_def;
-	bool is_full_key = (tuple_field_count(key) >= key_def->part_count);
+	uint32_t key_part_count = tuple_field_count(key);
+	bool is_full_key = (key_part_count >= key_def->part_count);
+	/*
+	 * Set if a bloom filter was checked, full key or prefix.
+	 * Used for accounting bloom filter misses.
+	 */
+	bool is_bloom_checked = false;
 	if (run->info.has_bloom && iterator_type == ITER_EQ && is_full_key) {
 		uint32_t hash;
 		if (vy_stmt_type(key) == IPROTO_SELECT) {
@@ -1354,6 +1597,23 @@ vy_run_iterator_start_from(struct vy_run_iterator *itr,
 			itr->stat->bloom_hit++;
 			return 0;
 		}
+		is_bloom_checked = true;
+	} else if (iterator_type == ITER_EQ && key_part_count > 0 &&
+		   key_part_count <= run->info.prefix_bloom_count) {
+		/* A partial key is always a SELECT statement. */
+		assert(vy_stmt_type(key) == IPROTO_SELECT);
+		const char *data = tuple_data(key);
+		mp_decode_array(&data);
+		uint32_t hash = key_hash_prefix(data, key_def,
+						key_part_count);
+		struct bloom *bloom;
+		bloom = &run->info.prefix_bloom[key_part_count - 1];
+		if (!bloom_possible_has(bloom, hash)) {
+			itr->search_ended = true;
+			itr->stat->bloom_hit++;
+			return 0;
+		}
+		is_bloom_checked = true;
 	}
 
 	itr->stat->lookup++;
@@ -1395,7 +1655,7 @@ vy_run_iterator_start_from(struct vy_run_iterator *itr,
 	if (iterator_type == ITER_EQ && !equal_found) {
 		vy_run_iterator_cache_clean(itr);
 		itr->search_ended = true;
-		if (run->info.has_bloom && is_full_key)
+		if (is_bloom_checked)
 			itr->stat->bloom_miss++;
 		return 0;
 	}
@@ -1900,6 +2160,9 @@ vy_run_recover(struct vy_run *run, const char *dir,
 		goto fail_close;
 	}
 	run->fd = cursor.fd;
+	/* Keep the dictionary pages are compressed with. */
+	run->zddict = cursor.zddict;
+	cursor.zddict = NULL;
 	xlog_cursor_close(&cursor, true);
 	return 0;
 
@@ -1993,6 +2256,138 @@ vy_run_alloc_page_info(struct vy_run *run, uint32_t *page_info_capacity)
 	return 0;
 }
 
+/**
+ * Bloom filters built while a run is written.
+ */
+struct vy_bloom_builder {
+	/** Spectrum for the bloom filter of full keys. */
+	struct bloom_spectrum full;
+	/** Number of key prefix spectra, see vy_run_info. */
+	uint32_t prefix_count;
+	/** Spectra for the bloom filters of key prefixes. */
+	struct bloom_spectrum *prefix;
+	/** Prefix hashes of the statement being added. */
+	uint32_t *hash;
+	/** Prefix hashes of the last added statement. */
+	uint32_t *last_hash;
+	/** Set if no statement has been added yet. */
+	bool is_empty;
+};
+
+static void
+vy_bloom_builder_destroy(struct vy_bloom_builder *builder)
+{
+	bloom_spectrum_destroy(&builder->full, runtime.quota);
+	for (uint32_t i = 0; i < builder->prefix_count; i++)
+		bloom_spectrum_destroy(&builder->prefix[i], runtime.quota);
+	free(builder->prefix);
+	free(builder->hash);
+}
+
+/**
+ * Create bloom filter builder. Prefix bloom filters are only
+ * built if @bloom_prefix is set and the key has more than one
+ * part.
+ */
+static int
+vy_bloom_builder_create(struct vy_bloom_builder *builder,
+			const struct key_def *key_def,
+			size_t max_output_count, double bloom_fpr,
+			bool bloom_prefix)
+{
+	memset(builder, 0, sizeof(*builder));
+	builder->is_empty = true;
+	if (bloom_spectrum_create(&builder->full, max_output_count,
+				  bloom_fpr, runtime.quota) != 0) {
+		diag_set(OutOfMemory, 0,
+			 "bloom_spectrum_create", "bloom_spectrum");
+		return -1;
+	}
+	if (!bloom_prefix || key_def->part_count <= 1)
+		return 0;
+	uint32_t count = key_def->part_count - 1;
+	builder->prefix = calloc(count, sizeof(*builder->prefix));
+	if (builder->prefix == NULL) {
+		diag_set(OutOfMemory, count * sizeof(*builder->prefix),
+			 "malloc", "prefix bloom_spectrum");
+		goto fail;
+	}
+	builder->hash = calloc(2 * count, sizeof(*builder->hash));
+	if (builder->hash == NULL) {
+		diag_set(OutOfMemory, 2 * count * sizeof(*builder->hash),
+			 "malloc", "prefix hash");
+		goto fail;
+	}
+	builder->last_hash = builder->hash + count;
+	for (uint32_t i = 0; i < count; i++) {
+		if (bloom_spectrum_create(&builder->prefix[i],
+					  max_output_count, bloom_fpr,
+					  runtime.quota) != 0) {
+			diag_set(OutOfMemory, 0,
+				 "bloom_spectrum_create", "bloom_spectrum");
+			goto fail;
+		}
+		builder->prefix_count++;
+	}
+	return 0;
+fail:
+	vy_bloom_builder_destroy(builder);
+	return -1;
+}
+
+static void
+vy_bloom_builder_add(struct vy_bloom_builder *builder,
+		     const struct tuple *stmt, const struct key_def *key_def)
+{
+	bloom_spectrum_add(&builder->full, tuple_hash(stmt, key_def));
+	if (builder->prefix_count == 0)
+		return;
+	tuple_hash_prefixes(stmt, key_def, builder->prefix_count,
+			    builder->hash);
+	for (uint32_t i = 0; i < builder->prefix_count; i++) {
+		/*
+		 * Statements are sorted by key so equal prefixes
+		 * go one after another. Add each prefix only once
+		 * so as not to overestimate the number of distinct
+		 * values and hence the filter size.
+		 */
+		if (builder->is_empty ||
+		    builder->hash[i] != builder->last_hash[i])
+			bloom_spectrum_add(&builder->prefix[i],
+					   builder->hash[i]);
+		builder->last_hash[i] = builder->hash[i];
+	}
+	builder->is_empty = false;
+}
+
+/**
+ * Move the built bloom filters to the run info.
+ * The builder must be destroyed after this function is called.
+ */
+static int
+vy_bloom_builder_choose(struct vy_bloom_builder *builder,
+			struct vy_run_info *run_info)
+{
+	assert(!run_info->has_bloom);
+	assert(run_info->prefix_bloom_count == 0);
+	if (builder->prefix_count > 0) {
+		uint32_t count = builder->prefix_count;
+		run_info->prefix_bloom = calloc(count, sizeof(struct bloom));
+		if (run_info->prefix_bloom == NULL) {
+			diag_set(OutOfMemory, count * sizeof(struct bloom),
+				 "malloc", "prefix bloom");
+			return -1;
+		}
+		for (uint32_t i = 0; i < count; i++)
+			bloom_spectrum_choose(&builder->prefix[i],
+					      &run_info->prefix_bloom[i]);
+		run_info->prefix_bloom_count = count;
+	}
+	bloom_spectrum_choose(&builder->full, &run_info->bloom);
+	run_info->has_bloom = true;
+	return 0;
+}
+
 /**
  * Write statements from the iterator to a new page in the run,
  * update page and run statistics.
@@ -2004,7 +2399,7 @@ vy_run_alloc_page_info(struct vy_run *run, uint32_t *page_info_capacity)
 static int
 vy_run_write_page(struct vy_run *run, struct xlog *data_xlog,
 		  struct vy_stmt_stream *wi, struct tuple **curr_stmt,
-		  uint64_t page_size, struct bloom_spectrum *bs,
+		  uint64_t page_size, struct vy_bloom_builder *bloom,
 		  const struct key_def *cmp_def,
 		  const struct key_def *key_def, bool is_primary,
 		  uint32_t *page_info_capacity)
@@ -2058,7 +2453,7 @@ vy_run_write_page(struct vy_run *run, struct xlog *data_xlog,
 				     cmp_def, is_primary) != 0)
 			goto error_rollback;
 
-		bloom_spectrum_add(bs, tuple_hash(*curr_stmt, key_def));
+		vy_bloom_builder_add(bloom, *curr_stmt, key_def);
 
 		int64_t lsn = vy_stmt_lsn(*curr_stmt);
 		run->info.min_lsn = MIN(run->info.min_lsn, lsn);
@@ -2152,9 +2547,11 @@ vy_run_write_data(struct vy_run *run, const char *dirpath,
 		  struct vy_stmt_stream *wi, uint64_t page_size,
 		  const struct key_def *cmp_def,
 		  const struct key_def *key_def,
-		  size_t max_output_count, double bloom_fpr)
+		  size_t max_output_count, double bloom_fpr,
+		  bool bloom_prefix, const void *dict, size_t dict_size)
 {
 	struct tuple *stmt;
+	ZSTD_CDict *zcdict = NULL;
 
 	/* Start iteration. */
 	if (wi->iface->start(wi) != 0)
@@ -2166,24 +2563,41 @@ vy_run_write_data(struct vy_run *run, const char *dirpath,
 	if (stmt == NULL)
 		goto done;
 
-	struct bloom_spectrum bs;
-	if (bloom_spectrum_create(&bs, max_output_count,
-				  bloom_fpr, runtime.quota) != 0) {
-		diag_set(OutOfMemory, 0,
-			 "bloom_spectrum_create", "bloom_spectrum");
+	struct vy_bloom_builder bloom;
+	if (vy_bloom_builder_create(&bloom, key_def, max_output_count,
+				    bloom_fpr, bloom_prefix) != 0)
 		goto err;
-	}
 
 	char path[PATH_MAX];
-	vy_run_snprint_path(path, sizeof(path), dirpath,
-			    space_id, iid, run->id, VY_FILE_RUN);
 	struct xlog data_xlog;
 	struct xlog_meta meta = {
 		.filetype = XLOG_META_TYPE_RUN,
 		.instance_uuid = INSTANCE_UUID,
 	};
+	if (dict != NULL) {
+		/*
+		 * Store the dictionary next to the run file
+		 * and reference it from the run file meta.
+		 */
+		vy_run_snprint_path(path, sizeof(path), dirpath,
+				    space_id, iid, run->id, VY_FILE_DICT);
+		if (xlog_dict_write(path, dict, dict_size) != 0)
+			goto err_free_bloom;
+		zcdict = xlog_cdict_new(dict, dict_size);
+		if (zcdict == NULL)
+			goto err_free_bloom;
+		assert(run->zddict == NULL);
+		run->zddict = xlog_ddict_new(dict, dict_size);
+		if (run->zddict == NULL)
+			goto err_free_bloom;
+		snprintf(meta.dict, sizeof(meta.dict), "%s",
+			 strrchr(path, '/') + 1);
+	}
+	vy_run_snprint_path(path, sizeof(path), dirpath,
+			    space_id, iid, run->id, VY_FILE_RUN);
 	if (xlog_create(&data_xlog, path, 0, &meta) < 0)
 		goto err_free_bloom;
+	data_xlog.zcdict = zcdict;
 
 	run->info.min_lsn = INT64_MAX;
 	run->info.max_lsn = -1;
@@ -2193,7 +2607,7 @@ vy_run_write_data(struct vy_run *run, const char *dirpath,
 	int rc;
 	do {
 		rc = vy_run_write_page(run, &data_xlog, wi, &stmt,
-				       page_size, &bs, cmp_def, key_def,
+				       page_size, &bloom, cmp_def, key_def,
 				       iid == 0, &page_info_capacity);
 		if (rc < 0)
 			goto err_close_xlog;
@@ -2209,9 +2623,11 @@ vy_run_write_data(struct vy_run *run, const char *dirpath,
 	xlog_close(&data_xlog, true);
 	fiber_gc();
 
-	bloom_spectrum_choose(&bs, &run->info.bloom);
-	run->info.has_bloom = true;
-	bloom_spectrum_destroy(&bs, runtime.quota);
+	if (vy_bloom_builder_choose(&bloom, &run->info) != 0)
+		goto err_free_bloom;
+	vy_bloom_builder_destroy(&bloom);
+	if (zcdict != NULL)
+		ZSTD_freeCDict(zcdict);
 	done:
 	wi->iface->stop(wi);
 	return 0;
@@ -2220,7 +2636,9 @@ vy_run_write_data(struct vy_run *run, const char *dirpath,
 	xlog_close(&data_xlog, false);
 	fiber_gc();
 	err_free_bloom:
-	bloom_spectrum_destroy(&bs, runtime.quota);
+	vy_bloom_builder_destroy(&bloom);
+	if (zcdict != NULL)
+		ZSTD_freeCDict(zcdict);
 	err:
 	wi->iface->stop(wi);
 	return -1;
@@ -2360,7 +2778,10 @@ vy_run_info_encode(const struct vy_run_info *run_info,
 	size_t max_key_size = tmp - run_info->max_key;
 
 	assert(run_info->has_bloom);
-	size_t size = mp_sizeof_map(6);
+	uint32_t key_count = 6;
+	if (run_info->prefix_bloom_count > 0)
+		key_count++;
+	size_t size = mp_sizeof_map(key_count);
 	size += mp_sizeof_uint(VY_RUN_INFO_MIN_KEY) + min_key_size;
 	size += mp_sizeof_uint(VY_RUN_INFO_MAX_KEY) + max_key_size;
 	size += mp_sizeof_uint(VY_RUN_INFO_MIN_LSN) +
@@ -2371,6 +2792,13 @@ vy_run_info_encode(const struct vy_run_info *run_info,
 		mp_sizeof_uint(run_info->page_count);
 	size += mp_sizeof_uint(VY_RUN_INFO_BLOOM) +
 		vy_run_bloom_encode_size(&run_info->bloom);
+	if (run_info->prefix_bloom_count > 0) {
+		size += mp_sizeof_uint(VY_RUN_INFO_PREFIX_BLOOM);
+		size += mp_sizeof_array(run_info->prefix_bloom_count);
+		for (uint32_t i = 0; i < run_info->prefix_bloom_count; i++)
+			size += vy_run_bloom_encode_size(
+					&run_info->prefix_bloom[i]);
+	}
 
 	char *pos = region_alloc(&fiber()->gc, size);
 	if (pos == NULL) {
@@ -2380,7 +2808,7 @@ vy_run_info_encode(const struct vy_run_info *run_info,
 	memset(xrow, 0, sizeof(*xrow));
 	xrow->body->iov_base = pos;
 	/* encode values */
-	pos = mp_encode_map(pos, 6);
+	pos = mp_encode_map(pos, key_count);
 	pos = mp_encode_uint(pos, VY_RUN_INFO_MIN_KEY);
 	memcpy(pos, run_info->min_key, min_key_size);
 	pos += min_key_size;
@@ -2395,6 +2823,13 @@ vy_run_info_encode(const struct vy_run_info *run_info,
 	pos = mp_encode_uint(pos, run_info->page_count);
 	pos = mp_encode_uint(pos, VY_RUN_INFO_BLOOM);
 	pos = vy_run_bloom_encode(&run_info->bloom, pos);
+	if (run_info->prefix_bloom_count > 0) {
+		pos = mp_encode_uint(pos, VY_RUN_INFO_PREFIX_BLOOM);
+		pos = mp_encode_array(pos, run_info->prefix_bloom_count);
+		for (uint32_t i = 0; i < run_info->prefix_bloom_count; i++)
+			pos = vy_run_bloom_encode(&run_info->prefix_bloom[i],
+						  pos);
+	}
 	xrow->body->iov_len = (void *)pos - xrow->body->iov_base;
 	xrow->bodycnt = 1;
 	xrow->type = VY_INDEX_RUN_INFO;
@@ -2466,7 +2901,8 @@ vy_run_write(struct vy_run *run, const char *dirpath,
 	     struct vy_stmt_stream *wi, uint64_t page_size,
 	     const struct key_def *cmp_def,
 	     const struct key_def *key_def,
-	     size_t max_output_count, double bloom_fpr)
+	     size_t max_output_count, double bloom_fpr,
+	     bool bloom_prefix, const void *dict, size_t dict_size)
 {
 	ERROR_INJECT(ERRINJ_VY_RUN_WRITE,
 		     {diag_set(ClientError, ER_INJECTION,
@@ -2478,7 +2914,8 @@ vy_run_write(struct vy_run *run, const char *dirpath,
 
 	if (vy_run_write_data(run, dirpath, space_id, iid,
 			      wi, page_size, cmp_def, key_def,
-			      max_output_count, bloom_fpr) != 0)
+			      max_output_count, bloom_fpr,
+			      bloom_prefix, dict, dict_size) != 0)
 		return -1;
 
 	if (vy_run_is_empty(run))
@@ -2588,6 +3025,33 @@ vy_run_rebuild_index(struct vy_run *run, const char *dir,
 			 "bloom_create", "bloom");
 		goto close_err;
 	}
+	run->info.has_bloom = true;
+	uint32_t prefix_count = 0;
+	uint32_t *prefix_hash = NULL;
+	if (opts->bloom_prefix && key_def->part_count > 1)
+		prefix_count = key_def->part_count - 1;
+	if (prefix_count > 0) {
+		run->info.prefix_bloom = calloc(prefix_count,
+						sizeof(struct bloom));
+		prefix_hash = region_alloc(region,
+					   prefix_count * sizeof(uint32_t));
+		if (run->info.prefix_bloom == NULL || prefix_hash == NULL) {
+			diag_set(OutOfMemory, prefix_count *
+				 sizeof(struct bloom), "malloc",
+				 "prefix bloom");
+			goto close_err;
+		}
+		for (uint32_t i = 0; i < prefix_count; i++) {
+			if (bloom_create(&run->info.prefix_bloom[i],
+					 run_row_count, opts->bloom_fpr,
+					 runtime.quota) != 0) {
+				diag_set(OutOfMemory, 0,
+					 "bloom_create", "bloom");
+				goto close_err;
+			}
+			run->info.prefix_bloom_count++;
+		}
+	}
 	struct xrow_header xrow;
 	while ((rc = xlog_cursor_next(&cursor, &xrow, false)) == 0) {
 		if (xrow.type == VY_RUN_ROW_INDEX)
@@ -2598,11 +3062,19 @@ vy_run_rebuild_index(struct vy_run *run, const char *dir,
 		if (tuple == NULL)
 			goto close_err;
 		bloom_add(&run->info.bloom, tuple_hash(tuple, key_def));
+		if (prefix_count > 0) {
+			tuple_hash_prefixes(tuple, key_def, prefix_count,
+					    prefix_hash);
+			for (uint32_t i = 0; i < prefix_count; i++)
+				bloom_add(&run->info.prefix_bloom[i],
+					  prefix_hash[i]);
+		}
 	}
-	run->info.has_bloom = true;
 
 	region_truncate(region, mem_used);
 	run->fd = cursor.fd;
+	run->zddict = cursor.zddict;
+	cursor.zddict = NULL;
 	xlog_cursor_close(&cursor, true);
 	/* New run index is ready for write, unlink old file if exists */
 	vy_run_snprint_path(path, sizeof(path), dir,
@@ -2643,7 +3115,7 @@ vy_slice_stream_read_page(struct vy_slice_stream *stream)
 		return -1;
 
 	if (vy_page_read(stream->page, page_info,
-			 stream->slice->run->fd, zdctx) != 0) {
+			 stream->slice->run, zdctx) != 0) {
 		vy_page_delete(stream->page);
 		stream->page = NULL;
 		return -1;
@@ -33,6 +33,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <zstd.h>
 
 #include "fiber_cond.h"
 #include "iterator_type.h"
@@ -42,6 +43,7 @@
 #include "index_def.h"
 
 #include "small/mempool.h"
+#include "small/rlist.h"
 #include "salad/bloom.h"
 
 #if defined(__cplusplus)
@@ -49,6 +51,30 @@ extern "C" {
 #endif /* defined(__cplusplus) */
 
 struct vy_run_reader;
+struct mh_vy_page_cache_t;
+
+/**
+ * Cache of decompressed run pages shared by all run iterators.
+ *
+ * Pages are looked up by (run id, page number) and evicted in
+ * LRU order as soon as the total size of cached pages exceeds
+ * the configured quota. Since run ids are never reused, pages
+ * of deleted runs are not purged explicitly - they simply age
+ * out of the cache. The cache is only accessed from the tx
+ * thread.
+ */
+struct vy_page_cache {
+	/** (run id, page no) -> struct vy_page. */
+	struct mh_vy_page_cache_t *hash;
+	/** List of cached pages, most recently used first. */
+	struct rlist lru;
+	/** Memory used by cached pages, in bytes. */
+	size_t mem_used;
+	/** Max memory that may be used by cached pages. */
+	size_t quota;
+	/** Number of pages stored in the cache. */
+	int64_t page_count;
+};
 
 /** Part of vinyl environment for run read/write */
 struct vy_run_env {
@@ -65,6 +91,8 @@ struct vy_run_env {
 	 * processing the next read request.
 	 */
 	int next_reader;
+	/** Cache of decompressed pages shared by run iterators. */
+	struct vy_page_cache page_cache;
 };
 
 /**
@@ -85,6 +113,18 @@ struct vy_run_info {
 	bool has_bloom;
 	/** Bloom filter of all tuples in run */
 	struct bloom bloom;
+	/**
+	 * Number of bloom filters on key prefixes. It is
+	 * the number of key parts minus one if the index
+	 * has bloom_prefix option set, 0 otherwise.
+	 */
+	uint32_t prefix_bloom_count;
+	/**
+	 * Bloom filters on key prefixes: prefix_bloom[i] is
+	 * a bloom filter of the first i + 1 key parts of all
+	 * tuples in the run.
+	 */
+	struct bloom *prefix_bloom;
 };
 
 /**
@@ -115,6 +155,11 @@ struct vy_run {
 	struct vy_page_info *page_info;
 	/** Run data file. */
 	int fd;
+	/**
+	 * Dictionary the run pages are compressed with or NULL,
+	 * see vy_run_write().
+	 */
+	ZSTD_DDict *zddict;
 	/** Unique ID of this run. */
 	int64_t id;
 	/** Number of statements in this run. */
@@ -264,8 +309,18 @@ struct vy_run_iterator {
  * Vinyl page stored in memory.
  */
 struct vy_page {
+	/** ID of the run this page was read from. */
+	int64_t run_id;
 	/** Page position in the run file. */
 	uint32_t page_no;
+	/**
+	 * Number of references to this page. A page is referenced
+	 * by the page cache and by each run iterator that has it
+	 * in its own two-page cache.
+	 */
+	int refs;
+	/** Link in vy_page_cache::lru. */
+	struct rlist in_cache;
 	/** Size of page data in memory, i.e. unpacked. */
 	uint32_t unpacked_size;
 	/** Number of statements in the page. */
@@ -288,6 +343,15 @@ vy_run_env_create(struct vy_run_env *env);
 void
 vy_run_env_destroy(struct vy_run_env *env);
 
+/**
+ * Set the max amount of memory that may be used for caching
+ * decompressed run pages. Pages are evicted from the cache
+ * immediately if it is over the new limit. Zero disables the
+ * page cache.
+ */
+void
+vy_run_env_set_page_cache_quota(struct vy_run_env *env, size_t quota);
+
 /**
  * Enable coio reads for a vinyl run environment.
  *
@@ -353,7 +417,7 @@ vy_run_recover(struct vy_run *run, const char *dir,
  * @param space_id - space id
  * @param iid - index id
  * @param key_def index key definition
- * @param bloom_fpr bloom filter param
+ * @param opts index options (bloom_fpr, bloom_prefix)
  * @return - 0 on sucess, -1 on fail
  */
 int
@@ -368,6 +432,7 @@ vy_run_rebuild_index(struct vy_run *run, const char *dir,
 enum vy_file_type {
 	VY_FILE_INDEX,
 	VY_FILE_RUN,
+	VY_FILE_DICT,
 	vy_file_MAX,
 };
 
@@ -394,13 +459,20 @@ vy_run_snprint_path(char *buf, int size, const char *dir,
 	return total;
 }
 
+/**
+ * Write statements from the stream to a new run file and
+ * create an index file for it. If @dict is not NULL, pages
+ * are compressed with the zstd dictionary, which is stored
+ * in a separate file referenced by the run file meta.
+ */
 int
 vy_run_write(struct vy_run *run, const char *dirpath,
 	     uint32_t space_id, uint32_t iid,
 	     struct vy_stmt_stream *wi, uint64_t page_size,
 	     const struct key_def *cmp_def,
 	     const struct key_def *key_def,
-	     size_t max_output_count, double bloom_fpr);
+	     size_t max_output_count, double bloom_fpr,
+	     bool bloom_prefix, const void *dict, size_t dict_size);
 
 /**
  * Allocate a new run slice.
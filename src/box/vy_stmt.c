@@ -126,6 +126,7 @@ vy_stmt_alloc(struct tuple_format *format, uint32_t bsize)
 		tuple_format_ref(format);
 	tuple->bsize = bsize;
 	tuple->data_offset = sizeof(struct vy_stmt) + meta_size;;
+	tuple->is_compressed = false;
 	vy_stmt_set_lsn(tuple, 0);
 	vy_stmt_set_type(tuple, 0);
 	return tuple;
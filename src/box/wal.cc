@@ -41,6 +41,12 @@
 #include "cbus.h"
 #include "coio_task.h"
 #include "replication.h"
+#include "xstream.h"
+#include "tt_pthread.h"
+#include "coio_file.h"
+#include "rmean.h"
+
+#include <pmatomic.h>
 
 
 const char *wal_mode_STRS[] = { "none", "write", "fsync", NULL };
@@ -61,6 +67,85 @@ struct wal_thread {
 	struct cpipe wal_pipe;
 	/** Return pipe from 'wal' to tx' */
 	struct cpipe tx_pipe;
+	/**
+	 * 'wal_sync' thread doing fsync of written batches
+	 * in wal_mode = 'fsync', so that the next batch can be
+	 * written while the previous one is being synced.
+	 */
+	struct cord sync_cord;
+	/** A pipe from 'wal' thread to 'wal_sync' */
+	struct cpipe sync_pipe;
+	/** Return pipe from 'wal_sync' to 'wal' */
+	struct cpipe sync_wal_pipe;
+	/** Set if the sync thread was started. */
+	bool has_sync_thread;
+};
+
+enum {
+	/** Number of spare WAL files kept ready for rotation. */
+	WAL_SPARE_COUNT = 2,
+	/** Size of a chunk of zeros written to a spare file at once. */
+	WAL_SPARE_CHUNK_SIZE = 1024 * 1024,
+};
+
+/**
+ * The adaptive commit delay never goes below the configured
+ * wal_commit_delay divided by this number.
+ */
+enum { WAL_COMMIT_DELAY_RANGE = 64 };
+
+/** Delay before retrying to create a spare WAL file. */
+static const double WAL_SPARE_RETRY_TIMEOUT = 1.0;
+
+/** Size of a block of the in-memory WAL tail. */
+enum { WAL_TAIL_BLOCK_SIZE = 1024 * 1024 };
+
+/**
+ * A block of rows recently written to WAL. Rows are stored
+ * one after another, each prefixed with its length.
+ */
+struct wal_tail_block {
+	/** Link in wal_tail::blocks. */
+	struct rlist in_tail;
+	/**
+	 * Number of relays reading the block plus one
+	 * if the block is in the tail.
+	 */
+	int refs;
+	/** WAL vclock preceding the first row stored in the block. */
+	struct vclock vclock;
+	/** Size of data written to the block. */
+	size_t used;
+	/** Size of the block data. */
+	size_t size;
+	/** Encoded rows. */
+	char data[0];
+};
+
+/**
+ * In-memory tail of the WAL. Rows are appended to it by the
+ * WAL thread as soon as they have been written to disk. Relay
+ * threads stream rows from it directly instead of reading and
+ * decoding the same xlog files over and over again, and only
+ * fall back on reading files if a replica is lagging behind
+ * the oldest row stored in memory.
+ */
+struct wal_tail {
+	/**
+	 * Protects the list of blocks, block reference
+	 * counters and the size of data written to blocks.
+	 * Block data itself is written without the lock,
+	 * because it is never read past block->used.
+	 */
+	pthread_mutex_t mutex;
+	/** List of blocks, from the oldest to the newest. */
+	struct rlist blocks;
+	/** Total size of blocks in the tail. */
+	size_t size;
+	/** Max size of the tail, 0 if disabled. */
+	size_t max_size;
+	/** Vclock of the last row committed to WAL. */
+	struct vclock vclock;
 };
 
 /*
@@ -82,6 +167,18 @@ struct wal_writer
 	 * the wal-tx bus and are rolled back "on arrival".
 	 */
 	struct stailq rollback;
+	/**
+	 * Number of fibers waiting for their requests to be
+	 * written. Updated by tx, read by the sync thread.
+	 */
+	int n_waiting;
+	/**
+	 * A setting from instance configuration -
+	 * wal_commit_delay, in microseconds.
+	 */
+	int64_t commit_delay;
+	/** Another one - wal_commit_siblings */
+	int commit_siblings;
 	/* ----------------- wal ------------------- */
 	/** A setting from instance configuration - rows_per_wal */
 	int64_t wal_max_rows;
@@ -117,6 +214,36 @@ struct wal_writer
 	 * Used for replication relays.
 	 */
 	struct rlist watchers;
+	/** Rows recently written to WAL, for replication relays. */
+	struct wal_tail tail;
+	/**
+	 * Set for spare file slots holding a file ready
+	 * to be used for the next WAL, see wal_spare_f().
+	 */
+	bool spare_ready[WAL_SPARE_COUNT];
+	/** Fiber creating spare files, NULL if not started. */
+	struct fiber *spare_fiber;
+	/** Set on shutdown to stop the spare fiber. */
+	bool spare_stop;
+	/**
+	 * Number of batches written to WAL so far. Updated
+	 * by the WAL thread, read by the sync thread.
+	 */
+	int64_t write_seq;
+	/**
+	 * Descriptor of the current WAL file, or -1 if there
+	 * is none. Updated by the WAL thread, read by the sync
+	 * thread.
+	 */
+	int sync_fd;
+	/* ----------------- wal_sync ------------------- */
+	/** Number of batches known to be synced to disk. */
+	int64_t sync_seq;
+	/**
+	 * Current time to wait for more batches before
+	 * syncing, in microseconds, see wal_sync_delay().
+	 */
+	int64_t sync_delay;
 };
 
 struct wal_msg: public cmsg {
@@ -127,6 +254,14 @@ struct wal_msg: public cmsg {
 	 * be rolled back.
 	 */
 	struct stailq rollback;
+	/**
+	 * Value of wal_writer::write_seq after the batch was
+	 * written. Used by the sync thread to skip batches that
+	 * have already been synced along with subsequent ones.
+	 */
+	int64_t write_seq;
+	/** Set if fdatasync() was called for this batch. */
+	bool is_synced;
 };
 
 /**
@@ -141,6 +276,23 @@ static struct vy_log_writer vy_log_writer;
 static struct wal_thread wal_thread;
 static struct wal_writer wal_writer_singleton;
 
+enum {
+	/** Requests committed to WAL. */
+	WAL_STAT_TXN,
+	/** Batches of requests written to WAL. */
+	WAL_STAT_BATCH,
+	/** Calls to fdatasync() on WAL files. */
+	WAL_STAT_FSYNC,
+	WAL_STAT_LAST,
+};
+
+static const char *rmean_wal_strings[WAL_STAT_LAST] = {
+	"TXN", "BATCH", "FSYNC"
+};
+
+/** WAL statistics, collected in tx. */
+struct rmean *rmean_wal;
+
 enum wal_mode
 wal_mode()
 {
@@ -153,23 +305,48 @@ wal_write_to_disk(struct cmsg *msg);
 static void
 tx_schedule_commit(struct cmsg *msg);
 
+static void
+wal_sync_batch(struct cmsg *msg);
+
+static void
+wal_sync_complete(struct cmsg *msg);
+
 static struct cmsg_hop wal_request_route[] = {
 	{wal_write_to_disk, &wal_thread.tx_pipe},
 	{tx_schedule_commit, NULL},
 };
 
+/**
+ * In wal_mode = 'fsync' a batch is written by the WAL thread,
+ * then synced by the sync thread, then handed over to relays
+ * by the WAL thread, and only then returned to tx. Since
+ * batches are passed along the pipeline in order, commits
+ * are still acknowledged in the order they were written.
+ */
+static struct cmsg_hop wal_sync_request_route[] = {
+	{wal_write_to_disk, &wal_thread.sync_pipe},
+	{wal_sync_batch, &wal_thread.sync_wal_pipe},
+	{wal_sync_complete, &wal_thread.tx_pipe},
+	{tx_schedule_commit, NULL},
+};
+
 static void
 wal_msg_create(struct wal_msg *batch)
 {
-	cmsg_init(batch, wal_request_route);
+	cmsg_init(batch, wal_thread.has_sync_thread ?
+		  wal_sync_request_route : wal_request_route);
 	stailq_create(&batch->commit);
 	stailq_create(&batch->rollback);
+	batch->write_seq = 0;
+	batch->is_synced = false;
 }
 
 static struct wal_msg *
 wal_msg(struct cmsg *msg)
 {
-	return msg->route == wal_request_route ? (struct wal_msg *) msg : NULL;
+	return msg->route == wal_request_route ||
+	       msg->route == wal_sync_request_route ?
+	       (struct wal_msg *) msg : NULL;
 }
 
 /** Write a request to a log in a single transaction. */
@@ -194,6 +371,210 @@ xlog_write_entry(struct xlog *l, struct journal_entry *entry)
 	return xlog_tx_commit(l);
 }
 
+static void
+wal_tail_create(struct wal_tail *tail, const struct vclock *vclock,
+		size_t max_size)
+{
+	tt_pthread_mutex_init(&tail->mutex, NULL);
+	rlist_create(&tail->blocks);
+	tail->size = 0;
+	tail->max_size = max_size;
+	vclock_copy(&tail->vclock, vclock);
+}
+
+/** Drop a reference to a block. Called with the tail locked. */
+static void
+wal_tail_block_unref(struct wal_tail_block *block)
+{
+	assert(block->refs > 0);
+	if (--block->refs == 0) {
+		assert(rlist_empty(&block->in_tail));
+		TRASH(block);
+		free(block);
+	}
+}
+
+/**
+ * Remove the oldest block from the tail. The block is freed
+ * as soon as the last relay reading it is done with it.
+ * Called with the tail locked.
+ */
+static void
+wal_tail_evict(struct wal_tail *tail)
+{
+	assert(!rlist_empty(&tail->blocks));
+	struct wal_tail_block *block = rlist_first_entry(&tail->blocks,
+					struct wal_tail_block, in_tail);
+	rlist_del_entry(block, in_tail);
+	tail->size -= block->size;
+	wal_tail_block_unref(block);
+}
+
+static void
+wal_tail_destroy(struct wal_tail *tail)
+{
+	while (!rlist_empty(&tail->blocks))
+		wal_tail_evict(tail);
+	tt_pthread_mutex_destroy(&tail->mutex);
+}
+
+/**
+ * Append a row to the tail. Called with the tail locked.
+ * Returns 0 on success, -1 on memory allocation error.
+ */
+static int
+wal_tail_append_row(struct wal_tail *tail, struct xrow_header *row)
+{
+	struct iovec iov[XROW_IOVMAX];
+	int iovcnt = xrow_header_encode(row, 0, iov, 0);
+	if (iovcnt < 0)
+		return -1;
+	uint32_t len = 0;
+	for (int i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+
+	struct wal_tail_block *block = NULL;
+	if (!rlist_empty(&tail->blocks))
+		block = rlist_last_entry(&tail->blocks,
+					 struct wal_tail_block, in_tail);
+	if (block == NULL || block->used + sizeof(len) + len > block->size) {
+		size_t size = MAX((size_t)WAL_TAIL_BLOCK_SIZE,
+				  sizeof(len) + len);
+		block = (struct wal_tail_block *)malloc(sizeof(*block) + size);
+		if (block == NULL) {
+			diag_set(OutOfMemory, sizeof(*block) + size,
+				 "malloc", "struct wal_tail_block");
+			return -1;
+		}
+		block->refs = 1;
+		block->used = 0;
+		block->size = size;
+		vclock_copy(&block->vclock, &tail->vclock);
+		rlist_add_tail_entry(&tail->blocks, block, in_tail);
+		tail->size += size;
+		/* Never evict the block we are writing to. */
+		while (tail->size > tail->max_size &&
+		       rlist_first_entry(&tail->blocks, struct wal_tail_block,
+					 in_tail) != block)
+			wal_tail_evict(tail);
+	}
+	char *data = block->data + block->used;
+	memcpy(data, &len, sizeof(len));
+	data += sizeof(len);
+	for (int i = 0; i < iovcnt; i++) {
+		memcpy(data, iov[i].iov_base, iov[i].iov_len);
+		data += iov[i].iov_len;
+	}
+	block->used += sizeof(len) + len;
+	return 0;
+}
+
+/**
+ * Append rows of requests committed to WAL to the tail.
+ * If a row can't be stored, the tail is discarded so that
+ * relays don't miss it, falling back on reading xlogs.
+ */
+static void
+wal_tail_append(struct wal_tail *tail, struct stailq *commit,
+		struct journal_entry *last)
+{
+	if (tail->max_size == 0)
+		return;
+	bool is_ok = true;
+	tt_pthread_mutex_lock(&tail->mutex);
+	struct journal_entry *entry;
+	stailq_foreach_entry(entry, commit, fifo) {
+		struct xrow_header **row = entry->rows;
+		for (; row < entry->rows + entry->n_rows; row++) {
+			if (is_ok && wal_tail_append_row(tail, *row) != 0) {
+				diag_log();
+				diag_clear(diag_get());
+				while (!rlist_empty(&tail->blocks))
+					wal_tail_evict(tail);
+				is_ok = false;
+			}
+			vclock_follow(&tail->vclock, (*row)->replica_id,
+				      (*row)->lsn);
+		}
+		if (entry == last)
+			break;
+	}
+	tt_pthread_mutex_unlock(&tail->mutex);
+}
+
+int
+wal_relay_tail(struct vclock *vclock, struct xstream *stream)
+{
+	struct wal_tail *tail = &wal_writer_singleton.tail;
+	struct wal_tail_block *block = NULL, *it;
+
+	tt_pthread_mutex_lock(&tail->mutex);
+	/*
+	 * Find the newest block starting before the
+	 * given vclock. If there's no such block, the
+	 * relay has to read rows from xlog files.
+	 */
+	rlist_foreach_entry(it, &tail->blocks, in_tail) {
+		int cmp = vclock_compare(&it->vclock, vclock);
+		if (cmp != 0 && cmp != -1)
+			break;
+		block = it;
+	}
+	if (block == NULL) {
+		tt_pthread_mutex_unlock(&tail->mutex);
+		return 1;
+	}
+	int rc = 0;
+	while (true) {
+		block->refs++;
+		size_t used = block->used;
+		tt_pthread_mutex_unlock(&tail->mutex);
+
+		const char *pos = block->data;
+		const char *end = block->data + used;
+		while (pos < end) {
+			uint32_t len;
+			memcpy(&len, pos, sizeof(len));
+			pos += sizeof(len);
+			struct xrow_header row;
+			if (xrow_header_decode(&row, &pos, pos + len) != 0) {
+				rc = -1;
+				break;
+			}
+			/* Skip rows that have already been sent. */
+			if (row.lsn <= vclock_get(vclock, row.replica_id))
+				continue;
+			vclock_follow(vclock, row.replica_id, row.lsn);
+			if (xstream_write(stream, &row) != 0) {
+				rc = -1;
+				break;
+			}
+		}
+
+		tt_pthread_mutex_lock(&tail->mutex);
+		struct wal_tail_block *next = NULL;
+		if (rc == 0 && rlist_empty(&block->in_tail)) {
+			/*
+			 * The block was evicted while we were
+			 * reading it. The relay is falling behind,
+			 * let it continue from xlog files.
+			 */
+			rc = 1;
+		} else if (rc == 0 && used == block->used &&
+			   block != rlist_last_entry(&tail->blocks,
+						     struct wal_tail_block,
+						     in_tail)) {
+			next = rlist_next_entry(block, in_tail);
+		}
+		wal_tail_block_unref(block);
+		if (next == NULL)
+			break;
+		block = next;
+	}
+	tt_pthread_mutex_unlock(&tail->mutex);
+	return rc;
+}
+
 /**
  * Invoke fibers waiting for their journal_entry's to be
  * completed. The fibers are invoked in strict fifo order:
@@ -233,6 +614,16 @@ tx_schedule_commit(struct cmsg *msg)
 		/* Closes the input valve. */
 		stailq_concat(&writer->rollback, &batch->rollback);
 	}
+	if (! stailq_empty(&batch->commit)) {
+		int64_t n_txn = 0;
+		struct journal_entry *req;
+		stailq_foreach_entry(req, &batch->commit, fifo)
+			n_txn++;
+		rmean_collect(rmean_wal, WAL_STAT_TXN, n_txn);
+		rmean_collect(rmean_wal, WAL_STAT_BATCH, 1);
+	}
+	if (batch->is_synced)
+		rmean_collect(rmean_wal, WAL_STAT_FSYNC, 1);
 	tx_schedule_queue(&batch->commit);
 }
 
@@ -263,7 +654,8 @@ static void
 wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 		  const char *wal_dirname, const struct tt_uuid *instance_uuid,
 		  struct vclock *vclock, int64_t wal_max_rows,
-		  int64_t wal_max_size)
+		  int64_t wal_max_size, int64_t wal_tail_size,
+		  bool wal_prealloc)
 {
 	writer->wal_mode = wal_mode;
 	writer->wal_max_rows = wal_max_rows;
@@ -273,8 +665,25 @@ wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 
 	xdir_create(&writer->wal_dir, wal_dirname, XLOG, instance_uuid);
 	xlog_clear(&writer->current_wal);
-	if (wal_mode == WAL_FSYNC)
-		writer->wal_dir.open_wflags |= O_SYNC;
+	/*
+	 * Note, we don't open WAL files with O_SYNC in 'fsync'
+	 * mode: written batches are synced by the sync thread
+	 * while the WAL thread proceeds to the next batch.
+	 */
+	writer->write_seq = 0;
+	writer->sync_fd = -1;
+	writer->sync_seq = 0;
+	writer->sync_delay = 0;
+	writer->n_waiting = 0;
+	/*
+	 * Preallocate WAL files to the size they are
+	 * rotated at, so that appends don't extend them.
+	 */
+	if (wal_prealloc && wal_mode != WAL_NONE)
+		writer->wal_dir.prealloc_size = wal_max_size;
+	memset(writer->spare_ready, 0, sizeof(writer->spare_ready));
+	writer->spare_fiber = NULL;
+	writer->spare_stop = false;
 
 	stailq_create(&writer->rollback);
 	cmsg_init(&writer->in_rollback, NULL);
@@ -284,19 +693,66 @@ wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 	vclock_copy(&writer->vclock, vclock);
 
 	rlist_create(&writer->watchers);
+
+	wal_tail_create(&writer->tail, vclock,
+			wal_mode == WAL_NONE ? 0 : wal_tail_size);
 }
 
 /** Destroy a WAL writer structure. */
 static void
 wal_writer_destroy(struct wal_writer *writer)
 {
+	rmean_delete(rmean_wal);
+	rmean_wal = NULL;
+	wal_tail_destroy(&writer->tail);
 	xdir_destroy(&writer->wal_dir);
 }
 
+/**
+ * Close the current WAL file. The sync thread only syncs the
+ * current file, so in 'fsync' mode batches written to this
+ * file may still be waiting for a sync. Sync the file before
+ * closing it: xlog_close() syncs it too, but asynchronously,
+ * so the batches could be acknowledged before they reach the
+ * disk.
+ */
+static void
+wal_writer_close_xlog(struct wal_writer *writer)
+{
+	if (wal_thread.has_sync_thread) {
+		if (fdatasync(writer->current_wal.fd) != 0) {
+			/* See wal_sync_batch(). */
+			panic_syserror("WAL writer: fdatasync failed");
+		}
+		pm_atomic_store(&writer->sync_fd, -1);
+	}
+	xlog_close(&writer->current_wal, false);
+}
+
 /** WAL thread routine. */
 static int
 wal_thread_f(va_list ap);
 
+/** WAL sync thread routine. */
+static int
+wal_sync_thread_f(va_list ap);
+
+/**
+ * Start the WAL sync thread. Executed by the WAL thread,
+ * which owns the pipe to the sync thread.
+ */
+static int
+wal_sync_thread_start_f(struct cbus_call_msg *msg)
+{
+	(void) msg;
+	if (cord_costart(&wal_thread.sync_cord, "wal_sync",
+			 wal_sync_thread_f, NULL) != 0)
+		return -1;
+	cpipe_create(&wal_thread.sync_pipe, "wal_sync");
+	wal_thread.has_sync_thread = true;
+	return 0;
+}
+
 /** Start WAL thread and setup pipes to and from TX. */
 void
 wal_thread_start()
@@ -319,17 +775,37 @@ wal_thread_start()
 void
 wal_init(enum wal_mode wal_mode, const char *wal_dirname,
 	 const struct tt_uuid *instance_uuid, struct vclock *vclock,
-	 int64_t wal_max_rows, int64_t wal_max_size)
+	 int64_t wal_max_rows, int64_t wal_max_size, int64_t wal_tail_size,
+	 bool wal_prealloc)
 {
 	assert(wal_max_rows > 1);
 
 	struct wal_writer *writer = &wal_writer_singleton;
 
 	wal_writer_create(writer, wal_mode, wal_dirname, instance_uuid,
-			  vclock, wal_max_rows, wal_max_size);
+			  vclock, wal_max_rows, wal_max_size, wal_tail_size,
+			  wal_prealloc);
+
+	rmean_wal = rmean_new(rmean_wal_strings, WAL_STAT_LAST);
+	if (rmean_wal == NULL) {
+		tnt_raise(OutOfMemory, sizeof(struct rmean),
+			  "rmean", "struct rmean");
+	}
 
 	xdir_scan_xc(&writer->wal_dir);
 
+	/*
+	 * Batches are synced by a separate thread only in
+	 * 'fsync' mode, don't start it otherwise.
+	 */
+	if (wal_mode == WAL_FSYNC) {
+		struct cbus_call_msg msg;
+		if (cbus_call(&wal_thread.wal_pipe, &wal_thread.tx_pipe,
+			      &msg, wal_sync_thread_start_f, NULL,
+			      TIMEOUT_INFINITY) != 0)
+			diag_raise();
+	}
+
 	journal_set(&writer->base);
 }
 
@@ -376,7 +852,7 @@ wal_checkpoint_f(struct cmsg *data)
 	    vclock_sum(&writer->current_wal.meta.vclock) !=
 	    vclock_sum(&writer->vclock)) {
 
-		xlog_close(&writer->current_wal, false);
+		wal_writer_close_xlog(writer);
 		/*
 		 * Avoid creating an empty xlog if this is the
 		 * last snapshot before shutdown.
@@ -461,6 +937,182 @@ wal_collect_garbage(int64_t lsn)
 static void
 wal_notify_watchers(struct wal_writer *writer, unsigned events);
 
+/** Format the name of a spare WAL file. */
+static void
+wal_spare_filename(struct wal_writer *writer, int slot, bool inprogress,
+		   char *buf, size_t size)
+{
+	snprintf(buf, size, "%s/spare%d%s.spare%s",
+		 writer->wal_dir.dirname, slot,
+		 writer->wal_dir.filename_ext,
+		 inprogress ? ".inprogress" : "");
+}
+
+/**
+ * Create a spare WAL file filled with zeros in the given slot.
+ * The file is written under a temporary name, synced, and then
+ * renamed, so that a file with the final name is always
+ * complete. Yields while the file is being written. Runs in
+ * the WAL thread, so the I/O is done by the eio thread pool,
+ * not io_uring, which serves only tx.
+ */
+static int
+wal_spare_create(struct wal_writer *writer, int slot)
+{
+	static const char zeros[WAL_SPARE_CHUNK_SIZE] = {0};
+	char path[PATH_MAX], tmp_path[PATH_MAX];
+	wal_spare_filename(writer, slot, false, path, sizeof(path));
+	wal_spare_filename(writer, slot, true, tmp_path, sizeof(tmp_path));
+
+	int fd = coio_file_open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC,
+				0644);
+	if (fd < 0) {
+		say_syserror("failed to create %s", tmp_path);
+		return -1;
+	}
+	off_t size = writer->wal_dir.prealloc_size;
+	off_t offset = 0;
+	while (offset < size) {
+		if (writer->spare_stop)
+			goto err;
+		size_t len = MIN((off_t)sizeof(zeros), size - offset);
+		ssize_t written = coio_pwrite(fd, zeros, len, offset);
+		if (written < 0) {
+			say_syserror("failed to write %s", tmp_path);
+			goto err;
+		}
+		offset += written;
+	}
+	if (coio_fdatasync(fd) != 0) {
+		say_syserror("failed to sync %s", tmp_path);
+		goto err;
+	}
+	coio_file_close(fd);
+	if (coio_rename(tmp_path, path) != 0) {
+		say_syserror("failed to rename %s", tmp_path);
+		coio_unlink(tmp_path);
+		return -1;
+	}
+	return 0;
+err:
+	coio_file_close(fd);
+	coio_unlink(tmp_path);
+	return -1;
+}
+
+/**
+ * Fiber keeping spare WAL files ready. Writing zeros to a file
+ * in advance makes the file system allocate and initialize its
+ * blocks, so that writes to the WAL renamed from the spare file
+ * don't need to update metadata, which makes fdatasync() cheap.
+ */
+static int
+wal_spare_f(va_list ap)
+{
+	struct wal_writer *writer = va_arg(ap, struct wal_writer *);
+	while (!writer->spare_stop) {
+		int slot;
+		for (slot = 0; slot < WAL_SPARE_COUNT; slot++) {
+			if (!writer->spare_ready[slot])
+				break;
+		}
+		if (slot == WAL_SPARE_COUNT) {
+			/* Woken up by wal_spare_take() or on shutdown. */
+			fiber_yield();
+			continue;
+		}
+		if (wal_spare_create(writer, slot) != 0) {
+			fiber_sleep(WAL_SPARE_RETRY_TIMEOUT);
+			continue;
+		}
+		writer->spare_ready[slot] = true;
+	}
+	return 0;
+}
+
+/**
+ * Start the fiber creating spare WAL files. Spare files
+ * left from the previous run are reused.
+ */
+static void
+wal_spare_start(struct wal_writer *writer)
+{
+	assert(writer->spare_fiber == NULL);
+	for (int slot = 0; slot < WAL_SPARE_COUNT; slot++) {
+		char path[PATH_MAX];
+		wal_spare_filename(writer, slot, false, path, sizeof(path));
+		writer->spare_ready[slot] = access(path, F_OK) == 0;
+	}
+	struct fiber *f = fiber_new("wal_spare", wal_spare_f);
+	if (f == NULL) {
+		diag_log();
+		return;
+	}
+	fiber_set_joinable(f, true);
+	writer->spare_fiber = f;
+	fiber_start(f, writer);
+}
+
+/** Stop the fiber creating spare WAL files and wait for it. */
+static void
+wal_spare_stop(struct wal_writer *writer)
+{
+	if (writer->spare_fiber == NULL)
+		return;
+	writer->spare_stop = true;
+	fiber_wakeup(writer->spare_fiber);
+	fiber_join(writer->spare_fiber);
+	writer->spare_fiber = NULL;
+}
+
+/**
+ * Take a spare WAL file. Returns the slot of the file,
+ * or -1 if there are no spare files ready.
+ */
+static int
+wal_spare_take(struct wal_writer *writer)
+{
+	if (writer->spare_fiber == NULL)
+		return -1;
+	for (int slot = 0; slot < WAL_SPARE_COUNT; slot++) {
+		if (writer->spare_ready[slot]) {
+			writer->spare_ready[slot] = false;
+			/* Refill the slot. */
+			fiber_wakeup(writer->spare_fiber);
+			return slot;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Create a new WAL file, reusing a spare file if
+ * preallocation is enabled and there is one ready.
+ */
+static int
+wal_create_xlog(struct wal_writer *writer)
+{
+	if (writer->wal_dir.prealloc_size == 0)
+		return xdir_create_xlog(&writer->wal_dir,
+					&writer->current_wal,
+					&writer->vclock);
+	if (writer->spare_fiber == NULL && !writer->spare_stop)
+		wal_spare_start(writer);
+	int slot = wal_spare_take(writer);
+	if (slot >= 0) {
+		char path[PATH_MAX];
+		wal_spare_filename(writer, slot, false, path, sizeof(path));
+		if (xdir_create_xlog_from_spare(&writer->wal_dir,
+						&writer->current_wal,
+						&writer->vclock, path) == 0)
+			return 0;
+		/* Fall back on creating a new file. */
+		diag_log();
+	}
+	return xdir_create_xlog(&writer->wal_dir, &writer->current_wal,
+				&writer->vclock);
+}
+
 /**
  * If there is no current WAL, try to open it, and close the
  * previous WAL. We close the previous WAL only after opening
@@ -490,7 +1142,7 @@ wal_opt_rotate(struct wal_writer *writer)
 		 * failure in any reasonable way.
 		 * A warning is written to the error log.
 		 */
-		xlog_close(&writer->current_wal, false);
+		wal_writer_close_xlog(writer);
 	}
 
 	if (xlog_is_open(&writer->current_wal))
@@ -505,13 +1157,13 @@ wal_opt_rotate(struct wal_writer *writer)
 	}
 	vclock_copy(vclock, &writer->vclock);
 
-	if (xdir_create_xlog(&writer->wal_dir, &writer->current_wal,
-			     &writer->vclock) != 0) {
+	if (wal_create_xlog(writer) != 0) {
 		diag_log();
 		free(vclock);
 		return -1;
 	}
 	xdir_add_vclock(&writer->wal_dir, vclock);
+	pm_atomic_store(&writer->sync_fd, writer->current_wal.fd);
 
 	wal_notify_watchers(writer, WAL_EVENT_ROTATE);
 	return 0;
@@ -557,12 +1209,34 @@ wal_writer_begin_rollback(struct wal_writer *writer)
 		{ wal_writer_end_rollback, NULL }
 	};
 
+	/*
+	 * In 'fsync' mode written batches travel to tx through
+	 * the sync thread and back through the WAL thread, so
+	 * the bus must be cleared along all the legs of the
+	 * wal -> wal_sync -> wal -> tx route.
+	 */
+	static struct cmsg_hop sync_rollback_route[8] = {
+		{ wal_writer_clear_bus, &wal_thread.sync_wal_pipe },
+		{ wal_writer_clear_bus, &wal_thread.tx_pipe },
+		{ wal_writer_clear_bus, &wal_thread.wal_pipe },
+		{ wal_writer_clear_bus, &wal_thread.sync_pipe },
+		{ wal_writer_clear_bus, &wal_thread.sync_wal_pipe },
+		{ wal_writer_clear_bus, &wal_thread.tx_pipe },
+		{ tx_schedule_rollback, &wal_thread.wal_pipe },
+		{ wal_writer_end_rollback, NULL }
+	};
+
 	/*
 	 * Make sure the WAL writer rolls back
 	 * all input until rollback mode is off.
 	 */
-	cmsg_init(&writer->in_rollback, rollback_route);
-	cpipe_push(&wal_thread.tx_pipe, &writer->in_rollback);
+	if (wal_thread.has_sync_thread) {
+		cmsg_init(&writer->in_rollback, sync_rollback_route);
+		cpipe_push(&wal_thread.sync_pipe, &writer->in_rollback);
+	} else {
+		cmsg_init(&writer->in_rollback, rollback_route);
+		cpipe_push(&wal_thread.tx_pipe, &writer->in_rollback);
+	}
 }
 
 static void
@@ -653,6 +1327,19 @@ done:
 		error_log(error);
 		diag_clear(diag_get());
 	}
+	/*
+	 * Make committed rows available to relays. In 'fsync'
+	 * mode it's done only once the rows have been synced,
+	 * see wal_sync_complete().
+	 */
+	if (last_commit_entry != NULL) {
+		if (!wal_thread.has_sync_thread)
+			wal_tail_append(&writer->tail, &wal_msg->commit,
+					last_commit_entry);
+		/* Let the sync thread know there's data to sync. */
+		pm_atomic_store(&writer->write_seq, writer->write_seq + 1);
+	}
+	wal_msg->write_seq = writer->write_seq;
 	/*
 	 * We need to start rollback from the first request
 	 * following the last committed request. If
@@ -677,9 +1364,127 @@ done:
 		wal_writer_begin_rollback(writer);
 	}
 	fiber_gc();
+	if (!wal_thread.has_sync_thread)
+		wal_notify_watchers(writer, WAL_EVENT_WRITE);
+}
+
+void
+wal_set_commit_delay(double delay)
+{
+	pm_atomic_store(&wal_writer_singleton.commit_delay,
+			(int64_t)(delay * 1000000));
+}
+
+void
+wal_set_commit_siblings(int siblings)
+{
+	pm_atomic_store(&wal_writer_singleton.commit_siblings, siblings);
+}
+
+/**
+ * Group commit: if there are many fibers waiting for WAL,
+ * wait for more batches to be written before syncing, so
+ * that a single fdatasync() covers more transactions.
+ *
+ * The wait time adapts to the load: it's doubled if more
+ * batches were written while waiting and halved otherwise,
+ * but never exceeds wal_commit_delay.
+ */
+static void
+wal_sync_delay(struct wal_writer *writer)
+{
+	int64_t max_delay = pm_atomic_load(&writer->commit_delay);
+	if (max_delay <= 0 || pm_atomic_load(&writer->n_waiting) <
+			      pm_atomic_load(&writer->commit_siblings))
+		return;
+	int64_t min_delay = MAX(max_delay / WAL_COMMIT_DELAY_RANGE, 1);
+	int64_t delay = MIN(MAX(writer->sync_delay, min_delay), max_delay);
+	int64_t seq = pm_atomic_load(&writer->write_seq);
+	fiber_sleep(delay / 1e6);
+	if (pm_atomic_load(&writer->write_seq) > seq)
+		writer->sync_delay = MIN(delay * 2, max_delay);
+	else
+		writer->sync_delay = MAX(delay / 2, min_delay);
+}
+
+/**
+ * Sync a batch written by the WAL thread to disk. Executed
+ * by the sync thread while the WAL thread is writing next
+ * batches. Since fdatasync() flushes everything written to
+ * the file so far, a single call covers all batches written
+ * by the time it's issued, so batches queued behind it are
+ * passed on without syncing.
+ */
+static void
+wal_sync_batch(struct cmsg *msg)
+{
+	struct wal_writer *writer = &wal_writer_singleton;
+	struct wal_msg *wal_msg = (struct wal_msg *) msg;
+
+	if (wal_msg->write_seq <= writer->sync_seq)
+		return;
+	wal_sync_delay(writer);
+	/*
+	 * Load the sequence number before the file descriptor:
+	 * if the WAL was rotated after the batches were written,
+	 * the WAL thread synced the old file before closing it.
+	 */
+	int64_t seq = pm_atomic_load(&writer->write_seq);
+	int fd = pm_atomic_load(&writer->sync_fd);
+	if (fd >= 0) {
+		int rc = fdatasync(fd);
+		ERROR_INJECT(ERRINJ_WAL_SYNC, { rc = -1; errno = EIO; });
+		if (rc != 0 && errno != EBADF) {
+			/*
+			 * The data may be lost on failed fsync, and
+			 * relays may have read it from the file, so
+			 * it can't be rolled back either. There's
+			 * nothing we can do about it.
+			 */
+			panic_syserror("WAL writer: fdatasync failed");
+		}
+	}
+	pm_atomic_store(&writer->sync_seq, seq);
+	wal_msg->is_synced = true;
+}
+
+/**
+ * Make rows of a synced batch available to relays. Executed
+ * by the WAL thread, which owns the tail and the watchers, in
+ * 'fsync' mode, so that replicas don't get rows that haven't
+ * reached the disk yet.
+ */
+static void
+wal_sync_complete(struct cmsg *msg)
+{
+	struct wal_writer *writer = &wal_writer_singleton;
+	struct wal_msg *wal_msg = (struct wal_msg *) msg;
+
+	if (stailq_empty(&wal_msg->commit))
+		return;
+	wal_tail_append(&writer->tail, &wal_msg->commit,
+			stailq_last_entry(&wal_msg->commit,
+					  struct journal_entry, fifo));
 	wal_notify_watchers(writer, WAL_EVENT_WRITE);
 }
 
+/** WAL sync thread main loop. */
+static int
+wal_sync_thread_f(va_list ap)
+{
+	(void) ap;
+
+	struct cbus_endpoint endpoint;
+	cbus_endpoint_create(&endpoint, "wal_sync", fiber_schedule_cb,
+			     fiber());
+	cpipe_create(&wal_thread.sync_wal_pipe, "wal");
+
+	cbus_loop(&endpoint);
+
+	cpipe_destroy(&wal_thread.sync_wal_pipe);
+	return 0;
+}
+
 /** WAL thread main loop.  */
 static int
 wal_thread_f(va_list ap)
@@ -703,11 +1508,21 @@ wal_thread_f(va_list ap)
 	struct wal_writer *writer = &wal_writer_singleton;
 
 	if (xlog_is_open(&writer->current_wal))
-		xlog_close(&writer->current_wal, false);
+		wal_writer_close_xlog(writer);
 
 	if (xlog_is_open(&vy_log_writer.xlog))
 		xlog_close(&vy_log_writer.xlog, false);
 
+	wal_spare_stop(writer);
+
+	if (wal_thread.has_sync_thread) {
+		cbus_stop_loop(&wal_thread.sync_pipe);
+		if (cord_join(&wal_thread.sync_cord)) {
+			/* We can't recover from this in any reasonable way. */
+			panic_syserror("WAL writer: sync thread join failed");
+		}
+	}
+
 	cpipe_destroy(&wal_thread.tx_pipe);
 	return 0;
 }
@@ -758,6 +1573,7 @@ wal_write(struct journal *journal, struct journal_entry *entry)
 	}
 	wal_thread.wal_pipe.n_input += entry->n_rows * XROW_IOVMAX;
 	cpipe_flush_input(&wal_thread.wal_pipe);
+	pm_atomic_store(&writer->n_waiting, writer->n_waiting + 1);
 	/**
 	 * It's not safe to spuriously wakeup this fiber
 	 * since in that case it will ignore a possible
@@ -767,6 +1583,7 @@ wal_write(struct journal *journal, struct journal_entry *entry)
 	bool cancellable = fiber_set_cancellable(false);
 	fiber_yield(); /* Request was inserted. */
 	fiber_set_cancellable(cancellable);
+	pm_atomic_store(&writer->n_waiting, writer->n_waiting - 1);
 	if (entry->res > 0) {
 		struct xrow_header **last = entry->rows + entry->n_rows - 1;
 		while (last >= entry->rows) {
@@ -39,6 +39,7 @@
 struct fiber;
 struct vclock;
 struct wal_writer;
+struct xstream;
 
 enum wal_mode { WAL_NONE = 0, WAL_WRITE, WAL_FSYNC, WAL_MODE_MAX };
 
@@ -55,11 +56,26 @@ wal_thread_start();
 void
 wal_init(enum wal_mode wal_mode, const char *wal_dirname,
 	 const struct tt_uuid *instance_uuid, struct vclock *vclock,
-	 int64_t wal_max_rows, int64_t wal_max_size);
+	 int64_t wal_max_rows, int64_t wal_max_size, int64_t wal_tail_size,
+	 bool wal_prealloc);
 
 enum wal_mode
 wal_mode();
 
+/**
+ * Set the max time the WAL waits for more transactions
+ * to be written before syncing in wal_mode = 'fsync'.
+ */
+void
+wal_set_commit_delay(double delay);
+
+/**
+ * Set the min number of fibers waiting for WAL for the
+ * commit delay to be applied.
+ */
+void
+wal_set_commit_siblings(int siblings);
+
 void
 wal_thread_stop();
 
@@ -138,6 +154,20 @@ void
 wal_clear_watcher(struct wal_watcher *watcher,
 		  void (*process_cb)(struct cbus_endpoint *));
 
+/**
+ * Send rows written to WAL after @vclock to @stream reading
+ * them from the in-memory WAL tail and advance @vclock
+ * accordingly. Used by replication relays so as not to
+ * re-read recently written xlog files.
+ *
+ * @retval  0 all rows available in memory have been sent.
+ * @retval  1 the WAL tail doesn't have rows following
+ *            @vclock, they must be read from xlog files.
+ * @retval -1 error, diag is set.
+ */
+int
+wal_relay_tail(struct vclock *vclock, struct xstream *stream);
+
 void
 wal_atfork();
 
@@ -47,6 +47,8 @@
 #include "iproto_constants.h"
 #include "errinj.h"
 
+#include "zdict.h"
+
 /*
  * marker is MsgPack fixext2
  * +--------+--------+--------+--------+
@@ -87,13 +89,16 @@ enum {
 	 *
 	 * @sa xlog_meta_parse()
 	 */
-	XLOG_META_LEN_MAX = 1024 + VCLOCK_STR_LEN_MAX
+	XLOG_META_LEN_MAX = 1024 + 2 * VCLOCK_STR_LEN_MAX
 };
 
 #define INSTANCE_UUID_KEY "Instance"
 #define INSTANCE_UUID_KEY_V12 "Server"
 #define VCLOCK_KEY "VClock"
+#define PREV_VCLOCK_KEY "PrevVClock"
 #define VERSION_KEY "Version"
+#define DICT_KEY "Dictionary"
+#define PREALLOCATED_KEY "Preallocated"
 
 static const char v13[] = "0.13";
 static const char v12[] = "0.12";
@@ -116,16 +121,35 @@ xlog_meta_format(const struct xlog_meta *meta, char *buf, int size)
 	char *vstr = vclock_to_string(&meta->vclock);
 	if (vstr == NULL)
 		return -1;
+	char *prev_vstr = NULL;
+	if (meta->has_prev_vclock) {
+		prev_vstr = vclock_to_string(&meta->prev_vclock);
+		if (prev_vstr == NULL) {
+			free(vstr);
+			return -1;
+		}
+	}
 	char *instance_uuid = tt_uuid_str(&meta->instance_uuid);
 	int total = snprintf(buf, size,
 		"%s\n"
 		"%s\n"
 		VERSION_KEY ": %s\n"
 		INSTANCE_UUID_KEY ": %s\n"
-		VCLOCK_KEY ": %s\n\n",
-		meta->filetype, v13, PACKAGE_VERSION, instance_uuid, vstr);
+		VCLOCK_KEY ": %s\n"
+		"%s%s%s"
+		"%s%s%s"
+		"%s\n",
+		meta->filetype, v13, PACKAGE_VERSION, instance_uuid, vstr,
+		prev_vstr != NULL ? PREV_VCLOCK_KEY ": " : "",
+		prev_vstr != NULL ? prev_vstr : "",
+		prev_vstr != NULL ? "\n" : "",
+		*meta->dict != '\0' ? DICT_KEY ": " : "",
+		meta->dict,
+		*meta->dict != '\0' ? "\n" : "",
+		meta->is_preallocated ? PREALLOCATED_KEY ": true\n" : "");
 	assert(total > 0);
 	free(vstr);
+	free(prev_vstr);
 	return total;
 }
 
@@ -239,6 +263,42 @@ xlog_meta_parse(struct xlog_meta *meta, const char **data,
 					  "offset %zd", off);
 				return -1;
 			}
+		} else if (memcmp(key, PREV_VCLOCK_KEY, key_end - key) == 0) {
+			/*
+			 * PrevVClock: <vclock>
+			 */
+			if (val_end - val > VCLOCK_STR_LEN_MAX) {
+				diag_set(XlogError, "can't parse prev vclock");
+				return -1;
+			}
+			char vclock[VCLOCK_STR_LEN_MAX + 1];
+			memcpy(vclock, val, val_end - val);
+			vclock[val_end - val] = '\0';
+			size_t off = vclock_from_string(&meta->prev_vclock,
+							vclock);
+			if (off != 0) {
+				diag_set(XlogError, "invalid prev vclock at "
+					  "offset %zd", off);
+				return -1;
+			}
+			meta->has_prev_vclock = true;
+		} else if (memcmp(key, DICT_KEY, key_end - key) == 0) {
+			/*
+			 * Dictionary: <file name>
+			 */
+			if (val_end - val >= (ptrdiff_t)sizeof(meta->dict) ||
+			    memchr(val, '/', val_end - val) != NULL) {
+				diag_set(XlogError, "can't parse dictionary");
+				return -1;
+			}
+			memcpy(meta->dict, val, val_end - val);
+			meta->dict[val_end - val] = '\0';
+		} else if (memcmp(key, PREALLOCATED_KEY, key_end - key) == 0) {
+			/*
+			 * Preallocated: true
+			 */
+			meta->is_preallocated = val_end - val == 4 &&
+						memcmp(val, "true", 4) == 0;
 		} else if (memcmp(key, VERSION_KEY, key_end - key) == 0) {
 			/* Ignore Version: for now */
 		} else {
@@ -255,6 +315,152 @@ xlog_meta_parse(struct xlog_meta *meta, const char **data,
 
 /* struct xlog }}} */
 
+/* {{{ Compression dictionaries */
+
+void *
+xlog_dict_train(size_t dict_size, const void *samples,
+		const size_t *sample_sizes, unsigned count, size_t *size)
+{
+	void *dict = malloc(dict_size);
+	if (dict == NULL) {
+		diag_set(OutOfMemory, dict_size, "malloc", "dictionary");
+		return NULL;
+	}
+	size_t rc = ZDICT_trainFromBuffer(dict, dict_size, samples,
+					  sample_sizes, count);
+	if (ZDICT_isError(rc)) {
+		diag_set(ClientError, ER_COMPRESSION,
+			 ZDICT_getErrorName(rc));
+		free(dict);
+		return NULL;
+	}
+	*size = rc;
+	return dict;
+}
+
+int
+xlog_dict_write(const char *path, const void *dict, size_t size)
+{
+	char tmp_path[PATH_MAX];
+	snprintf(tmp_path, sizeof(tmp_path), "%s%s", path, inprogress_suffix);
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		diag_set(SystemError, "failed to create file '%s'", tmp_path);
+		return -1;
+	}
+	if (fio_writen(fd, dict, size) != 0) {
+		diag_set(SystemError, "failed to write to '%s' file",
+			 tmp_path);
+		goto error;
+	}
+	if (fsync(fd) != 0) {
+		diag_set(SystemError, "failed to sync file '%s'", tmp_path);
+		goto error;
+	}
+	close(fd);
+	if (rename(tmp_path, path) != 0) {
+		diag_set(SystemError, "failed to rename '%s' file", tmp_path);
+		unlink(tmp_path);
+		return -1;
+	}
+	return 0;
+error:
+	close(fd);
+	unlink(tmp_path);
+	return -1;
+}
+
+void *
+xlog_dict_read(const char *path, size_t *size)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		diag_set(SystemError, "failed to open '%s' file", path);
+		return NULL;
+	}
+	void *dict = NULL;
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		diag_set(SystemError, "failed to stat file '%s'", path);
+		goto out;
+	}
+	dict = malloc(st.st_size);
+	if (dict == NULL) {
+		diag_set(OutOfMemory, st.st_size, "malloc", "dictionary");
+		goto out;
+	}
+	if (fio_pread(fd, dict, st.st_size, 0) != st.st_size) {
+		diag_set(SystemError, "failed to read file '%s'", path);
+		free(dict);
+		dict = NULL;
+		goto out;
+	}
+	*size = st.st_size;
+out:
+	close(fd);
+	return dict;
+}
+
+ZSTD_CDict *
+xlog_cdict_new(const void *dict, size_t size)
+{
+	/* 3 is compression level, see xlog_tx_encode_zstd(). */
+	ZSTD_CDict *zcdict = ZSTD_createCDict(dict, size, 3);
+	if (zcdict == NULL)
+		diag_set(OutOfMemory, size, "ZSTD_createCDict",
+			 "compression dictionary");
+	return zcdict;
+}
+
+ZSTD_DDict *
+xlog_ddict_new(const void *dict, size_t size)
+{
+	ZSTD_DDict *zddict = ZSTD_createDDict(dict, size);
+	if (zddict == NULL)
+		diag_set(OutOfMemory, size, "ZSTD_createDDict",
+			 "decompression dictionary");
+	return zddict;
+}
+
+/**
+ * Load the dictionary referenced by the meta of the file
+ * a cursor is open for. The dictionary file is looked up
+ * in the directory of the file.
+ */
+static ZSTD_DDict *
+xlog_cursor_load_dict(struct xlog_cursor *i)
+{
+	char path[PATH_MAX];
+	const char *sep = strrchr(i->name, '/');
+	if (sep != NULL) {
+		snprintf(path, sizeof(path), "%.*s/%s",
+			 (int)(sep - i->name), i->name, i->meta.dict);
+	} else {
+		snprintf(path, sizeof(path), "%s", i->meta.dict);
+	}
+	size_t size;
+	void *dict = xlog_dict_read(path, &size);
+	if (dict == NULL)
+		return NULL;
+	ZSTD_DDict *zddict = xlog_ddict_new(dict, size);
+	free(dict);
+	return zddict;
+}
+
+/**
+ * Prepare a decompression stream for a new tx block.
+ */
+static inline void
+xlog_zdctx_init(ZSTD_DStream *zdctx, const ZSTD_DDict *zddict)
+{
+	if (zddict != NULL)
+		ZSTD_initDStream_usingDDict(zdctx, zddict);
+	else
+		ZSTD_initDStream(zdctx);
+}
+
+/* }}} */
+
 /* {{{ struct xdir */
 
 /* sync snapshot every 16MB */
@@ -688,9 +894,13 @@ xlog_destroy(struct xlog *xlog)
 	xlog->fd = -1;
 }
 
-int
-xlog_create(struct xlog *xlog, const char *name, int flags,
-	    const struct xlog_meta *meta)
+/**
+ * Create a new xlog file. If @spare is not NULL, the spare
+ * file is renamed into place instead of creating a new one.
+ */
+static int
+xlog_create_impl(struct xlog *xlog, const char *name, int flags,
+		 const struct xlog_meta *meta, const char *spare)
 {
 	char meta_buf[XLOG_META_LEN_MAX];
 	int meta_len;
@@ -711,7 +921,22 @@ xlog_create(struct xlog *xlog, const char *name, int flags,
 	xlog->is_inprogress = true;
 	snprintf(xlog->filename, PATH_MAX, "%s%s", name, inprogress_suffix);
 
-	flags |= O_RDWR | O_CREAT | O_EXCL;
+	if (spare != NULL) {
+		/*
+		 * Move the spare file into place, the header
+		 * is written over its beginning.
+		 */
+		if (rename(spare, xlog->filename) != 0) {
+			say_syserror("can't rename %s to %s", spare,
+				     xlog->filename);
+			diag_set(SystemError, "failed to rename '%s' file",
+				 spare);
+			goto err_open;
+		}
+		flags |= O_RDWR;
+	} else {
+		flags |= O_RDWR | O_CREAT | O_EXCL;
+	}
 
 	/*
 	 * Open the <lsn>.<suffix>.inprogress file.
@@ -729,6 +954,15 @@ xlog_create(struct xlog *xlog, const char *name, int flags,
 		diag_set(SystemError, "failed to create file '%s'", name);
 		goto err_open;
 	}
+	if (spare != NULL) {
+		struct stat st;
+		if (fstat(xlog->fd, &st) != 0) {
+			diag_set(SystemError, "failed to stat file '%s'",
+				 name);
+			goto err_write;
+		}
+		xlog->allocated_size = st.st_size;
+	}
 
 	/* Format metadata */
 	meta_len = xlog_meta_format(&xlog->meta, meta_buf, sizeof(meta_buf));
@@ -754,6 +988,38 @@ err:
 	return -1;
 }
 
+int
+xlog_create(struct xlog *xlog, const char *name, int flags,
+	    const struct xlog_meta *meta)
+{
+	return xlog_create_impl(xlog, name, flags, meta, NULL);
+}
+
+/**
+ * Preallocate disk space for an xlog file. The file is
+ * usable without preallocation, so a failure is only logged.
+ */
+static void
+xlog_prealloc(struct xlog *xlog, off_t size)
+{
+#ifdef HAVE_POSIX_FALLOCATE
+	if (size <= xlog->offset)
+		return;
+	int rc = posix_fallocate(xlog->fd, xlog->offset,
+				 size - xlog->offset);
+	if (rc != 0) {
+		errno = rc;
+		say_syserror("%s: failed to preallocate disk space",
+			     xlog->filename);
+		return;
+	}
+	xlog->allocated_size = size;
+#else
+	(void) xlog;
+	(void) size;
+#endif /* HAVE_POSIX_FALLOCATE */
+}
+
 int
 xlog_open(struct xlog *xlog, const char *name)
 {
@@ -845,9 +1111,10 @@ xdir_touch_xlog(struct xdir *dir, const struct vclock *vclock)
  * In case of error, writes a message to the error log
  * and sets errno.
  */
-int
-xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
-		 const struct vclock *vclock)
+static int
+xdir_create_xlog_impl(struct xdir *dir, struct xlog *xlog,
+		      const struct vclock *vclock,
+		      const struct vclock *prev_vclock, const char *spare)
 {
 	char *filename;
 	int64_t signature = vclock_sum(vclock);
@@ -865,10 +1132,19 @@ xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
 	snprintf(meta.filetype, sizeof(meta.filetype), "%s", dir->filetype);
 	meta.instance_uuid = *dir->instance_uuid;
 	vclock_copy(&meta.vclock, vclock);
-
-	if (xlog_create(xlog, filename, dir->open_wflags, &meta) != 0)
+	meta.has_prev_vclock = prev_vclock != NULL;
+	if (prev_vclock != NULL)
+		vclock_copy(&meta.prev_vclock, prev_vclock);
+	*meta.dict = '\0';
+	meta.is_preallocated = spare != NULL || dir->prealloc_size > 0;
+
+	if (xlog_create_impl(xlog, filename, dir->open_wflags,
+			     &meta, spare) != 0)
 		return -1;
 
+	if (spare == NULL && dir->prealloc_size > 0)
+		xlog_prealloc(xlog, dir->prealloc_size);
+
 	/* set sync interval from xdir settings */
 	xlog->sync_interval = dir->sync_interval;
 	/* free file cache if dir should be synced */
@@ -886,32 +1162,53 @@ xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
 	return 0;
 }
 
+int
+xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
+		 const struct vclock *vclock)
+{
+	return xdir_create_xlog_impl(dir, xlog, vclock, NULL, NULL);
+}
+
+int
+xdir_create_xlog_from_spare(struct xdir *dir, struct xlog *xlog,
+			    const struct vclock *vclock, const char *spare)
+{
+	return xdir_create_xlog_impl(dir, xlog, vclock, NULL, spare);
+}
+
+int
+xdir_create_xlog_after(struct xdir *dir, struct xlog *xlog,
+		       const struct vclock *vclock,
+		       const struct vclock *prev_vclock)
+{
+	return xdir_create_xlog_impl(dir, xlog, vclock, prev_vclock, NULL);
+}
+
 /**
- * Write a sequence of uncompressed xrow objects.
- *
- * @retval -1 error
- * @retval >= 0 the number of bytes written
+ * Fill the fixheader of an uncompressed tx block accumulated
+ * in @obuf. The space for the fixheader is reserved when the
+ * first row is added to the block.
  */
-static off_t
-xlog_tx_write_plain(struct xlog *log)
+static void
+xlog_tx_encode_plain(struct obuf *obuf)
 {
 	/**
 	 * We created an obuf savepoint at start of xlog_tx,
 	 * now populate it with data.
 	 */
-	char *fixheader = (char *)log->obuf.iov[0].iov_base;
+	char *fixheader = (char *)obuf->iov[0].iov_base;
 	*(log_magic_t *)fixheader = row_marker;
 	char *data = fixheader + sizeof(log_magic_t);
 
 	data = mp_encode_uint(data,
-			      obuf_size(&log->obuf) - XLOG_FIXHEADER_SIZE);
+			      obuf_size(obuf) - XLOG_FIXHEADER_SIZE);
 	/* Encode crc32 for previous row */
 	data = mp_encode_uint(data, 0);
 	/* Encode crc32 for current row */
 	uint32_t crc32c = 0;
 	struct iovec *iov;
 	size_t offset = XLOG_FIXHEADER_SIZE;
-	for (iov = log->obuf.iov; iov->iov_len; ++iov) {
+	for (iov = obuf->iov; iov->iov_len; ++iov) {
 		crc32c = crc32_calc(crc32c,
 				    (char *)iov->iov_base + offset,
 				    iov->iov_len - offset);
@@ -930,42 +1227,39 @@ xlog_tx_write_plain(struct xlog *log)
 			data += padding - 1;
 		}
 	}
-
-	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
-		diag_set(ClientError, ER_INJECTION, "xlog write injection");
-		return -1;
-	});
-
-	ssize_t written = fio_writevn(log->fd, log->obuf.iov, log->obuf.pos + 1);
-	if (written < 0) {
-		diag_set(SystemError, "failed to write to '%s' file",
-			 log->filename);
-		return -1;
-	}
-	return obuf_size(&log->obuf);
 }
 
 /**
- * Write a compressed block of xrow objects.
- * @retval -1  error
- * @retval >= 0 the number of bytes written
+ * Compress a tx block accumulated in @obuf and append it,
+ * fixheader included, to @zbuf. If @zcdict is not NULL,
+ * the block is compressed with the dictionary.
  */
-static off_t
-xlog_tx_write_zstd(struct xlog *log)
+static int
+xlog_tx_encode_zstd(ZSTD_CCtx *zctx, const ZSTD_CDict *zcdict,
+		    struct obuf *obuf, struct obuf *zbuf)
 {
-	char *fixheader = (char *)obuf_alloc(&log->zbuf,
-					     XLOG_FIXHEADER_SIZE);
+	struct obuf_svp svp = obuf_create_svp(zbuf);
+	char *fixheader = (char *)obuf_alloc(zbuf, XLOG_FIXHEADER_SIZE);
+	if (fixheader == NULL) {
+		diag_set(OutOfMemory, XLOG_FIXHEADER_SIZE, "runtime arena",
+			 "compression buffer");
+		return -1;
+	}
 
 	uint32_t crc32c = 0;
 	struct iovec *iov;
-	/* 3 is compression level. */
-	ZSTD_compressBegin(log->zctx, 3);
+	if (zcdict != NULL) {
+		ZSTD_compressBegin_usingCDict(zctx, zcdict);
+	} else {
+		/* 3 is compression level. */
+		ZSTD_compressBegin(zctx, 3);
+	}
 	size_t offset = XLOG_FIXHEADER_SIZE;
-	for (iov = log->obuf.iov; iov->iov_len; ++iov) {
+	for (iov = obuf->iov; iov->iov_len; ++iov) {
 		/* Estimate max output buffer size. */
 		size_t zmax_size = ZSTD_compressBound(iov->iov_len - offset);
 		/* Allocate a destination buffer. */
-		void *zdst = obuf_reserve(&log->zbuf, zmax_size);
+		void *zdst = obuf_reserve(zbuf, zmax_size);
 		if (!zdst) {
 			diag_set(OutOfMemory, zmax_size, "runtime arena",
 				  "compression buffer");
@@ -977,13 +1271,13 @@ xlog_tx_write_zstd(struct xlog *log)
 		 * If it's the last iov or the last
 		 * log has 0 bytes, end the stream.
 		 */
-		if (iov == log->obuf.iov + log->obuf.pos ||
+		if (iov == obuf->iov + obuf->pos ||
 		    !(iov + 1)->iov_len) {
 			fcompress = ZSTD_compressEnd;
 		} else {
 			fcompress = ZSTD_compressContinue;
 		}
-		size_t zsize = fcompress(log->zctx, zdst, zmax_size,
+		size_t zsize = fcompress(zctx, zdst, zmax_size,
 					 (char *)iov->iov_base + offset,
 					 iov->iov_len - offset);
 		if (ZSTD_isError(zsize)) {
@@ -992,7 +1286,7 @@ xlog_tx_write_zstd(struct xlog *log)
 			goto error;
 		}
 		/* Advance output buffer to the end of compressed data. */
-		obuf_alloc(&log->zbuf, zsize);
+		obuf_alloc(zbuf, zsize);
 		/* Update crc32c */
 		crc32c = crc32_calc(crc32c, (char *)zdst, zsize);
 		/* Discount fixheader size for all iovs after first. */
@@ -1002,8 +1296,8 @@ xlog_tx_write_zstd(struct xlog *log)
 	*(log_magic_t *)fixheader = zrow_marker;
 	char *data;
 	data = fixheader + sizeof(log_magic_t);
-	data = mp_encode_uint(data,
-			      obuf_size(&log->zbuf) - XLOG_FIXHEADER_SIZE);
+	data = mp_encode_uint(data, obuf_size(zbuf) - svp.used -
+			      XLOG_FIXHEADER_SIZE);
 	/* Encode crc32 for previous row */
 	data = mp_encode_uint(data, 0);
 	/* Encode crc32 for current row */
@@ -1018,6 +1312,48 @@ xlog_tx_write_zstd(struct xlog *log)
 			data += padding - 1;
 		}
 	}
+	return 0;
+error:
+	obuf_rollback_to_svp(zbuf, &svp);
+	return -1;
+}
+
+/**
+ * Write a sequence of uncompressed xrow objects.
+ *
+ * @retval -1 error
+ * @retval >= 0 the number of bytes written
+ */
+static off_t
+xlog_tx_write_plain(struct xlog *log)
+{
+	xlog_tx_encode_plain(&log->obuf);
+
+	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
+		diag_set(ClientError, ER_INJECTION, "xlog write injection");
+		return -1;
+	});
+
+	ssize_t written = fio_writevn(log->fd, log->obuf.iov, log->obuf.pos + 1);
+	if (written < 0) {
+		diag_set(SystemError, "failed to write to '%s' file",
+			 log->filename);
+		return -1;
+	}
+	return obuf_size(&log->obuf);
+}
+
+/**
+ * Write a compressed block of xrow objects.
+ * @retval -1  error
+ * @retval >= 0 the number of bytes written
+ */
+static off_t
+xlog_tx_write_zstd(struct xlog *log)
+{
+	if (xlog_tx_encode_zstd(log->zctx, log->zcdict,
+				&log->obuf, &log->zbuf) != 0)
+		goto error;
 
 	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
 		diag_set(ClientError, ER_INJECTION, "xlog write injection");
@@ -1045,6 +1381,9 @@ error:
 #define SYNC_ROUND_DOWN(size)	((size) & ~(4096 - 1))
 #define SYNC_ROUND_UP(size)	(SYNC_ROUND_DOWN(size + SYNC_MASK))
 
+static void
+xlog_sync_written(struct xlog *log);
+
 /**
  * Writes xlog batch to file
  */
@@ -1075,11 +1414,24 @@ xlog_tx_write(struct xlog *log)
 		if (lseek(log->fd, log->offset, SEEK_SET) < 0 ||
 		    ftruncate(log->fd, log->offset) != 0)
 			panic_syserror("failed to truncate xlog after write error");
+		log->allocated_size = 0;
 		return -1;
 	}
 	log->offset += written;
 	log->rows += log->tx_rows;
 	log->tx_rows = 0;
+	xlog_sync_written(log);
+	return written;
+}
+
+/**
+ * Throttle the writer according to the rate limit and sync
+ * the data written since the last sync, once there's enough
+ * of it.
+ */
+static void
+xlog_sync_written(struct xlog *log)
+{
 	if ((log->sync_interval && log->offset >=
 	    (off_t)(log->synced_size + log->sync_interval)) ||
 	    (log->rate_limit && log->offset >=
@@ -1118,63 +1470,77 @@ xlog_tx_write(struct xlog *log)
 		}
 		log->synced_size = log->offset;
 	}
-	return written;
 }
 
-/*
- * Add a row to a log and possibly flush the log.
+/**
+ * Encode a row and append it to a tx block accumulated
+ * in @obuf.
  *
  * @retval  -1 error, check diag.
- * @retval >=0 the number of bytes written to buffer.
+ * @retval >=0 the number of bytes added to the buffer.
  */
-ssize_t
-xlog_write_row(struct xlog *log, const struct xrow_header *packet)
+static ssize_t
+xlog_obuf_add_row(struct obuf *obuf, const struct xrow_header *packet)
 {
 	/*
 	 * Automatically reserve space for a fixheader when adding
 	 * the first row in * a log. The fixheader is populated
 	 * at write. @sa xlog_tx_write().
 	 */
-	if (obuf_size(&log->obuf) == 0) {
-		if (!obuf_alloc(&log->obuf, XLOG_FIXHEADER_SIZE)) {
+	if (obuf_size(obuf) == 0) {
+		if (!obuf_alloc(obuf, XLOG_FIXHEADER_SIZE)) {
 			diag_set(OutOfMemory, XLOG_FIXHEADER_SIZE,
 				  "runtime arena", "xlog tx output buffer");
 			return -1;
 		}
 	}
 
-	struct obuf_svp svp = obuf_create_svp(&log->obuf);
-	size_t page_offset = obuf_size(&log->obuf);
+	struct obuf_svp svp = obuf_create_svp(obuf);
+	size_t page_offset = obuf_size(obuf);
 	/** encode row into iovec */
 	struct iovec iov[XROW_IOVMAX];
 	/** don't write sync to the disk */
 	int iovcnt = xrow_header_encode(packet, 0, iov, 0);
 	if (iovcnt < 0) {
-		obuf_rollback_to_svp(&log->obuf, &svp);
+		obuf_rollback_to_svp(obuf, &svp);
 		return -1;
 	}
 	for (int i = 0; i < iovcnt; ++i) {
 		struct errinj *inj = errinj(ERRINJ_WAL_WRITE_PARTIAL,
 					    ERRINJ_INT);
 		if (inj != NULL && inj->iparam >= 0 &&
-		    obuf_size(&log->obuf) > (size_t)inj->iparam) {
+		    obuf_size(obuf) > (size_t)inj->iparam) {
 			diag_set(ClientError, ER_INJECTION,
 				 "xlog write injection");
-			obuf_rollback_to_svp(&log->obuf, &svp);
+			obuf_rollback_to_svp(obuf, &svp);
 			return -1;
 		};
-		if (obuf_dup(&log->obuf, iov[i].iov_base, iov[i].iov_len) <
+		if (obuf_dup(obuf, iov[i].iov_base, iov[i].iov_len) <
 		    iov[i].iov_len) {
 			diag_set(OutOfMemory, XLOG_FIXHEADER_SIZE,
 				  "runtime arena", "xlog tx output buffer");
-			obuf_rollback_to_svp(&log->obuf, &svp);
+			obuf_rollback_to_svp(obuf, &svp);
 			return -1;
 		}
 	}
 	assert(iovcnt <= XROW_IOVMAX);
+	return obuf_size(obuf) - page_offset;
+}
+
+/*
+ * Add a row to a log and possibly flush the log.
+ *
+ * @retval  -1 error, check diag.
+ * @retval >=0 the number of bytes written to buffer.
+ */
+ssize_t
+xlog_write_row(struct xlog *log, const struct xrow_header *packet)
+{
+	ssize_t row_size = xlog_obuf_add_row(&log->obuf, packet);
+	if (row_size < 0)
+		return -1;
 	log->tx_rows++;
 
-	size_t row_size = obuf_size(&log->obuf) - page_offset;
 	if (log->is_autocommit &&
 	    obuf_size(&log->obuf) >= XLOG_TX_AUTOCOMMIT_THRESHOLD &&
 	    xlog_tx_write(log) < 0)
@@ -1236,6 +1602,104 @@ xlog_flush(struct xlog *log)
 	return xlog_tx_write(log);
 }
 
+int
+xlog_tx_buf_create(struct xlog_tx_buf *buf)
+{
+	memset(buf, 0, sizeof(*buf));
+	buf->zctx = ZSTD_createCCtx();
+	if (buf->zctx == NULL) {
+		diag_set(ClientError, ER_COMPRESSION,
+			 "failed to create context");
+		return -1;
+	}
+	obuf_create(&buf->obuf, &cord()->slabc, XLOG_TX_AUTOCOMMIT_THRESHOLD);
+	obuf_create(&buf->zbuf, &cord()->slabc, XLOG_TX_AUTOCOMMIT_THRESHOLD);
+	return 0;
+}
+
+void
+xlog_tx_buf_destroy(struct xlog_tx_buf *buf)
+{
+	obuf_destroy(&buf->obuf);
+	obuf_destroy(&buf->zbuf);
+	ZSTD_freeCCtx(buf->zctx);
+	TRASH(buf);
+}
+
+int
+xlog_tx_buf_add_row(struct xlog_tx_buf *buf,
+		    const struct xrow_header *packet)
+{
+	if (xlog_obuf_add_row(&buf->obuf, packet) < 0)
+		return -1;
+	buf->tx_rows++;
+	if (obuf_size(&buf->obuf) >= XLOG_TX_AUTOCOMMIT_THRESHOLD)
+		return xlog_tx_buf_flush(buf);
+	return 0;
+}
+
+int
+xlog_tx_buf_flush(struct xlog_tx_buf *buf)
+{
+	if (obuf_size(&buf->obuf) <= XLOG_FIXHEADER_SIZE)
+		return 0;
+	if (obuf_size(&buf->obuf) >= XLOG_TX_COMPRESS_THRESHOLD) {
+		if (xlog_tx_encode_zstd(buf->zctx, NULL, &buf->obuf,
+					&buf->zbuf) != 0)
+			return -1;
+	} else {
+		xlog_tx_encode_plain(&buf->obuf);
+		struct obuf_svp svp = obuf_create_svp(&buf->zbuf);
+		for (int i = 0; i <= buf->obuf.pos; i++) {
+			struct iovec *iov = &buf->obuf.iov[i];
+			if (obuf_dup(&buf->zbuf, iov->iov_base,
+				     iov->iov_len) < iov->iov_len) {
+				diag_set(OutOfMemory, iov->iov_len,
+					 "runtime arena", "xlog tx buffer");
+				obuf_rollback_to_svp(&buf->zbuf, &svp);
+				return -1;
+			}
+		}
+	}
+	obuf_reset(&buf->obuf);
+	buf->rows += buf->tx_rows;
+	buf->tx_rows = 0;
+	return 0;
+}
+
+ssize_t
+xlog_write_tx_buf(struct xlog *log, struct xlog_tx_buf *buf)
+{
+	/* Blocks must not be mixed with buffered rows. */
+	assert(obuf_size(&log->obuf) == 0);
+	if (obuf_size(&buf->zbuf) == 0)
+		return 0;
+
+	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
+		diag_set(ClientError, ER_INJECTION, "xlog write injection");
+		obuf_reset(&buf->zbuf);
+		return -1;
+	});
+
+	ssize_t written = fio_writevn(log->fd, buf->zbuf.iov,
+				      buf->zbuf.pos + 1);
+	obuf_reset(&buf->zbuf);
+	if (written < 0) {
+		diag_set(SystemError, "failed to write to '%s' file",
+			 log->filename);
+		if (lseek(log->fd, log->offset, SEEK_SET) < 0 ||
+		    ftruncate(log->fd, log->offset) != 0)
+			panic_syserror("failed to truncate xlog after write error");
+		log->allocated_size = 0;
+		return -1;
+	}
+	log->offset += written;
+	log->rows += buf->rows;
+	buf->rows = 0;
+	xlog_sync_written(log);
+	return written;
+}
+
 static int
 sync_cb(eio_req *req)
 {
@@ -1284,6 +1748,14 @@ xlog_write_eof(struct xlog *l)
 int
 xlog_close(struct xlog *l, bool reuse_fd)
 {
+	/*
+	 * Cut off the unused preallocated tail, so that
+	 * the file ends with the EOF marker.
+	 */
+	if (l->allocated_size > l->offset &&
+	    ftruncate(l->fd, l->offset) != 0)
+		say_syserror("%s: failed to truncate", l->filename);
+
 	int rc = xlog_write_eof(l);
 	if (rc < 0)
 		say_error("%s: failed to write EOF marker: %s", l->filename,
@@ -1496,7 +1968,8 @@ xlog_fixheader_decode(struct xlog_fixheader *fixheader,
 
 int
 xlog_tx_decode(const char *data, const char *data_end,
-	       char *rows, char *rows_end, ZSTD_DStream *zdctx)
+	       char *rows, char *rows_end, ZSTD_DStream *zdctx,
+	       const ZSTD_DDict *zddict)
 {
 	/* Decode fixheader */
 	struct xlog_fixheader fixheader;
@@ -1535,7 +2008,7 @@ xlog_tx_decode(const char *data, const char *data_end,
 
 	/* Decompress zstd rows */
 	assert(fixheader.magic == zrow_marker);
-	ZSTD_initDStream(zdctx);
+	xlog_zdctx_init(zdctx, zddict);
 	int rc = xlog_cursor_decompress(&rows, rows_end, &data, data_end,
 					zdctx);
 	if (rc < 0) {
@@ -1559,7 +2032,7 @@ xlog_tx_decode(const char *data, const char *data_end,
 ssize_t
 xlog_tx_cursor_create(struct xlog_tx_cursor *tx_cursor,
 		      const char **data, const char *data_end,
-		      ZSTD_DStream *zdctx)
+		      ZSTD_DStream *zdctx, const ZSTD_DDict *zddict)
 {
 	const char *rpos = *data;
 	struct xlog_fixheader fixheader;
@@ -1601,7 +2074,7 @@ xlog_tx_cursor_create(struct xlog_tx_cursor *tx_cursor,
 	};
 
 	assert(fixheader.magic == zrow_marker);
-	ZSTD_initDStream(zdctx);
+	xlog_zdctx_init(zdctx, zddict);
 	int rc;
 	do {
 		if (ibuf_reserve(&tx_cursor->rows,
@@ -1676,6 +2149,35 @@ xlog_cursor_find_tx_magic(struct xlog_cursor *i)
 	return 0;
 }
 
+/**
+ * Discard data read ahead of the current position, so that
+ * it's re-read from the file next time.
+ */
+static void
+xlog_cursor_unread(struct xlog_cursor *i)
+{
+	i->read_offset -= ibuf_used(&i->rbuf);
+	i->rbuf.wpos = i->rbuf.rpos;
+}
+
+/**
+ * Check if a tx that failed to decode is followed by zeros,
+ * i.e. it's the last tx in a preallocated file and it hasn't
+ * been completely written yet.
+ */
+static bool
+xlog_cursor_tx_is_unwritten(struct xlog_cursor *i)
+{
+	struct xlog_fixheader fixheader;
+	const char *pos = i->rbuf.rpos;
+	size_t size = XLOG_FIXHEADER_SIZE;
+	if (xlog_fixheader_decode(&fixheader, &pos, i->rbuf.wpos) == 0)
+		size += fixheader.len;
+	if (xlog_cursor_ensure(i, size + sizeof(log_magic_t)) != 0)
+		return false;
+	return load_u32(i->rbuf.rpos + size) == 0;
+}
+
 int
 xlog_cursor_next_tx(struct xlog_cursor *i)
 {
@@ -1692,11 +2194,20 @@ xlog_cursor_next_tx(struct xlog_cursor *i)
 		/* eof marker found */
 		goto eof_found;
 	}
+	if (i->meta.is_preallocated && load_u32(i->rbuf.rpos) == 0) {
+		/*
+		 * Unused tail of a preallocated file: no more
+		 * data has been written yet.
+		 */
+		xlog_cursor_unread(i);
+		return 1;
+	}
 
 	ssize_t to_load;
 	while ((to_load = xlog_tx_cursor_create(&i->tx_cursor,
 						(const char **)&i->rbuf.rpos,
-						i->rbuf.wpos, i->zdctx)) > 0) {
+						i->rbuf.wpos, i->zdctx,
+						i->zddict)) > 0) {
 		/* not enough data in read buffer */
 		int rc = xlog_cursor_ensure(i, ibuf_used(&i->rbuf) + to_load);
 		if (rc < 0)
@@ -1704,8 +2215,14 @@ xlog_cursor_next_tx(struct xlog_cursor *i)
 		if (rc > 0)
 			return 1;
 	}
-	if (to_load < 0)
-		return -1;
+	if (to_load < 0) {
+		if (!i->meta.is_preallocated ||
+		    !xlog_cursor_tx_is_unwritten(i))
+			return -1;
+		/* The tx is still being written, retry later. */
+		xlog_cursor_unread(i);
+		return 1;
+	}
 
 	i->state = XLOG_CURSOR_TX;
 	return 0;
@@ -1806,6 +2323,13 @@ xlog_cursor_openfd(struct xlog_cursor *i, int fd, const char *name)
 			 "failed to create context");
 		goto error;
 	}
+	if (*i->meta.dict != '\0') {
+		i->zddict = xlog_cursor_load_dict(i);
+		if (i->zddict == NULL) {
+			ZSTD_freeDStream(i->zdctx);
+			goto error;
+		}
+	}
 	i->state = XLOG_CURSOR_ACTIVE;
 	return 0;
 error:
@@ -1906,6 +2430,8 @@ xlog_cursor_close(struct xlog_cursor *i, bool reuse_fd)
 	if (i->state == XLOG_CURSOR_TX)
 		xlog_tx_cursor_destroy(&i->tx_cursor);
 	ZSTD_freeDStream(i->zdctx);
+	if (i->zddict != NULL)
+		ZSTD_freeDDict(i->zddict);
 	TRASH(i);
 	i->state = eof ? XLOG_CURSOR_EOF_CLOSED : XLOG_CURSOR_CLOSED;
 }
@@ -135,6 +135,15 @@ struct xdir {
 	 * corresponding file cache will be marked as free
 	 */
 	uint64_t sync_interval;
+	/**
+	 * If not 0, new xlog files are preallocated to this
+	 * size, so that appending to them doesn't need to
+	 * update file system metadata. The unused tail of
+	 * a preallocated file reads as zeros, which the
+	 * cursor treats as end of log. Such files are marked
+	 * as preallocated in the meta.
+	 */
+	int64_t prealloc_size;
 };
 
 /**
@@ -229,10 +238,82 @@ struct xlog_meta {
 	 * is vector clock *at the time the snapshot is taken*.
 	 */
 	struct vclock vclock;
+	/**
+	 * Text file header: vector clock of the previous file
+	 * this file is based on. Only set for delta snapshots,
+	 * which can't be used without the previous snapshot.
+	 */
+	struct vclock prev_vclock;
+	/** True if @prev_vclock is set. */
+	bool has_prev_vclock;
+	/**
+	 * Text file header: name of the file storing the zstd
+	 * dictionary tx blocks are compressed with, relative to
+	 * the directory of this file. Empty if no dictionary
+	 * is used.
+	 */
+	char dict[NAME_MAX + 1];
+	/**
+	 * Text file header: set if the file was preallocated,
+	 * so that its unused tail reads as zeros. Only in such
+	 * a file a zero word at a tx boundary is treated as the
+	 * end of written data rather than as corruption.
+	 */
+	bool is_preallocated;
 };
 
 /* }}} */
 
+/* {{{ Compression dictionaries */
+
+/**
+ * Train a zstd dictionary of at most @a dict_size bytes on
+ * @a count samples stored back to back in @a samples.
+ *
+ * @param[out] size actual size of the dictionary.
+ * @retval a malloc'ed dictionary on success
+ * @retval NULL on error, check diag
+ */
+void *
+xlog_dict_train(size_t dict_size, const void *samples,
+		const size_t *sample_sizes, unsigned count, size_t *size);
+
+/**
+ * Write a dictionary to a file. The file is created with
+ * .inprogress suffix, synced and then renamed.
+ *
+ * @retval 0 success
+ * @retval -1 error, check diag
+ */
+int
+xlog_dict_write(const char *path, const void *dict, size_t size);
+
+/**
+ * Read a dictionary from a file.
+ *
+ * @param[out] size size of the dictionary.
+ * @retval a malloc'ed dictionary on success
+ * @retval NULL on error, check diag
+ */
+void *
+xlog_dict_read(const char *path, size_t *size);
+
+/**
+ * Digest a dictionary for compression of tx blocks, see
+ * xlog::zcdict. Returns NULL and sets diag on error.
+ */
+ZSTD_CDict *
+xlog_cdict_new(const void *dict, size_t size);
+
+/**
+ * Digest a dictionary for decompression of tx blocks.
+ * Returns NULL and sets diag on error.
+ */
+ZSTD_DDict *
+xlog_ddict_new(const void *dict, size_t size);
+
+/* }}} */
+
 /**
  * A single log file - a snapshot, a vylog or a write ahead log.
  */
@@ -284,6 +365,11 @@ struct xlog {
 	struct obuf obuf;
 	/** The context of zstd compression */
 	ZSTD_CCtx *zctx;
+	/**
+	 * Dictionary to compress tx blocks with or NULL.
+	 * Not owned by the xlog, must match meta.dict.
+	 */
+	const ZSTD_CDict *zcdict;
 	/**
 	 * Compressed output buffer
 	 */
@@ -298,6 +384,12 @@ struct xlog {
 	 * Synced file size
 	 */
 	uint64_t synced_size;
+	/**
+	 * Size the file was preallocated to, or 0 if it
+	 * wasn't. The file is truncated to the written size
+	 * on close.
+	 */
+	off_t allocated_size;
 	/**
 	 * If xlog file was synced corresponding cache will be freed if true.
 	 * This can be significant for memtx snapshots (that wouldn't
@@ -344,6 +436,36 @@ int
 xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
 		 const struct vclock *vclock);
 
+/**
+ * Same as xdir_create_xlog(), but instead of creating a new
+ * file, rename a spare file into place and write the header
+ * over it. The spare file must be filled with zeros, so that
+ * its unused tail is treated as end of log. Appending to such
+ * a file doesn't need to allocate disk space.
+ *
+ * @param spare   path to the spare file
+ *
+ * @retval 0 if OK
+ * @retval -1 if error
+ */
+int
+xdir_create_xlog_from_spare(struct xdir *dir, struct xlog *xlog,
+			    const struct vclock *vclock, const char *spare);
+
+/**
+ * Same as xdir_create_xlog(), but also store the vector clock
+ * of the previous file in the header, see xlog_meta::prev_vclock.
+ *
+ * @param prev_vclock   vclock of the file this one is based on
+ *
+ * @retval 0 if OK
+ * @retval -1 if error
+ */
+int
+xdir_create_xlog_after(struct xdir *dir, struct xlog *xlog,
+		       const struct vclock *vclock,
+		       const struct vclock *prev_vclock);
+
 /**
  * Create new xlog writer based on fd.
  * @param fd            file descriptor
@@ -435,6 +557,74 @@ xlog_tx_rollback(struct xlog *log);
 ssize_t
 xlog_flush(struct xlog *log);
 
+/**
+ * Rows encoded into xlog tx blocks in memory, apart from the
+ * xlog they are written to. Every block is self-contained, so
+ * several threads can fill their own buffers and append them
+ * to the same xlog, see xlog_write_tx_buf().
+ */
+struct xlog_tx_buf {
+	/** Rows of the tx block being accumulated. */
+	struct obuf obuf;
+	/** Complete tx blocks, ready to be written. */
+	struct obuf zbuf;
+	/** The context of zstd compression. */
+	ZSTD_CCtx *zctx;
+	/** The number of rows in @obuf. */
+	int64_t tx_rows;
+	/** The number of rows in @zbuf. */
+	int64_t rows;
+};
+
+/**
+ * Create a tx block buffer. Its memory is allocated from
+ * the calling thread's slab cache.
+ */
+int
+xlog_tx_buf_create(struct xlog_tx_buf *buf);
+
+void
+xlog_tx_buf_destroy(struct xlog_tx_buf *buf);
+
+/**
+ * Add a row to a tx block buffer, completing the current
+ * block if it's big enough.
+ *
+ * @retval 0 success
+ * @retval -1 error
+ */
+int
+xlog_tx_buf_add_row(struct xlog_tx_buf *buf,
+		    const struct xrow_header *packet);
+
+/**
+ * Complete the current tx block, compressing it if it's
+ * big enough.
+ *
+ * @retval 0 success
+ * @retval -1 error
+ */
+int
+xlog_tx_buf_flush(struct xlog_tx_buf *buf);
+
+/** Size of complete tx blocks ready to be written. */
+static inline size_t
+xlog_tx_buf_size(struct xlog_tx_buf *buf)
+{
+	return obuf_size(&buf->zbuf);
+}
+
+/**
+ * Append complete tx blocks of a buffer to an xlog, which
+ * must have no rows of its own buffered. The caller has to
+ * serialize calls writing to the same xlog.
+ *
+ * @retval -1 error
+ * @retval >= 0 the number of bytes written
+ */
+ssize_t
+xlog_write_tx_buf(struct xlog *log, struct xlog_tx_buf *buf);
+
 
 /**
  * Sync a log file. The exact action is defined
@@ -486,7 +676,7 @@ struct xlog_tx_cursor
 ssize_t
 xlog_tx_cursor_create(struct xlog_tx_cursor *cursor,
 		      const char **data, const char *data_end,
-		      ZSTD_DStream *zdctx);
+		      ZSTD_DStream *zdctx, const ZSTD_DDict *zddict);
 
 /**
  * Destroy xlog tx cursor and free all associated memory
@@ -524,13 +714,15 @@ xlog_tx_cursor_pos(struct xlog_tx_cursor *tx_cursor)
  * @param data_end the end of @a data buffer
  * @param[out] rows a buffer to store decoded rows
  * @param[out] rows_end the end of @a rows buffer
+ * @param zdctx decompression context
+ * @param zddict decompression dictionary or NULL
  * @retval  0 success
  * @retval -1 error, check diag
  */
 int
 xlog_tx_decode(const char *data, const char *data_end,
 	       char *rows, char *rows_end,
-	       ZSTD_DStream *zdctx);
+	       ZSTD_DStream *zdctx, const ZSTD_DDict *zddict);
 
 /* }}} */
 
@@ -569,6 +761,11 @@ struct xlog_cursor
 	struct xlog_tx_cursor tx_cursor;
 	/** ZSTD context for decompression */
 	ZSTD_DStream *zdctx;
+	/**
+	 * Decompression dictionary referenced by the meta
+	 * or NULL, loaded on open.
+	 */
+	ZSTD_DDict *zddict;
 };
 
 /**
@@ -376,13 +376,15 @@ iproto_reply_map_key(struct obuf *buf, uint32_t size, uint8_t key)
 	return iproto_reply_key(buf, 0xdf, size, key);
 }
 
-void
-iproto_reply_select(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
-		    uint32_t schema_version, uint32_t count)
+/** Write a header of a reply with data to a preallocated buffer. */
+static void
+iproto_reply_data(struct obuf *buf, struct obuf_svp *svp, uint32_t type,
+		  uint64_t sync, uint32_t schema_version, uint32_t count,
+		  size_t ext_size)
 {
 	char *pos = (char *) obuf_svp_to_ptr(buf, svp);
-	iproto_header_encode(pos, IPROTO_OK, sync, schema_version,
-			        obuf_size(buf) - svp->used -
+	iproto_header_encode(pos, type, sync, schema_version,
+			        obuf_size(buf) - svp->used + ext_size -
 				IPROTO_HEADER_LEN);
 
 	struct iproto_body_bin body = iproto_body_bin;
@@ -391,6 +393,30 @@ iproto_reply_select(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 	memcpy(pos + IPROTO_HEADER_LEN, &body, sizeof(body));
 }
 
+void
+iproto_reply_select(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
+		    uint32_t schema_version, uint32_t count)
+{
+	iproto_reply_data(buf, svp, IPROTO_OK, sync, schema_version, count, 0);
+}
+
+void
+iproto_reply_select_ext(struct obuf *buf, struct obuf_svp *svp,
+			uint64_t sync, uint32_t schema_version,
+			uint32_t count, size_t ext_size)
+{
+	iproto_reply_data(buf, svp, IPROTO_OK, sync, schema_version, count,
+			  ext_size);
+}
+
+void
+iproto_reply_chunk(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
+		   uint32_t schema_version, uint32_t count)
+{
+	iproto_reply_data(buf, svp, IPROTO_CHUNK, sync, schema_version,
+			  count, 0);
+}
+
 void
 iproto_reply_sql(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 		 uint32_t schema_version, int keys)
@@ -477,6 +503,9 @@ error:
 			request->ops = value;
 			request->ops_end = data;
 			break;
+		case IPROTO_CHUNK_SIZE:
+			request->chunk_size = mp_decode_uint(&value);
+			break;
 		default:
 			break;
 		}
@@ -641,6 +670,11 @@ error:
 			request->args = value;
 			request->args_end = data;
 			break;
+		case IPROTO_CHUNK_SIZE:
+			if (mp_typeof(*value) != MP_UINT)
+				goto error;
+			request->chunk_size = mp_decode_uint(&value);
+			break;
 		default:
 			continue; /* unknown key */
 		}
@@ -139,6 +139,8 @@ struct request {
 	const char *ops_end;
 	/** Base field offset for UPDATE/UPSERT, e.g. 0 for C and 1 for Lua. */
 	int index_base;
+	/** SELECT reply chunk size, 0 if not streamed. */
+	uint32_t chunk_size;
 };
 
 /**
@@ -187,6 +189,8 @@ struct call_request {
 	/** CALL/EVAL parameters. MessagePack Array. */
 	const char *args;
 	const char *args_end;
+	/** CALL reply chunk size, 0 if not streamed. */
+	uint32_t chunk_size;
 };
 
 /**
@@ -348,6 +352,26 @@ void
 iproto_reply_select(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 		    uint32_t schema_version, uint32_t count);
 
+/**
+ * Write a header of a streamed reply chunk, see IPROTO_CHUNK,
+ * with @a count values in its data to a preallocated buffer.
+ * This function doesn't throw.
+ */
+void
+iproto_reply_chunk(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
+		   uint32_t schema_version, uint32_t count);
+
+/**
+ * Write select header to a preallocated buffer for a reply
+ * whose body also contains @a ext_size bytes sent from outside
+ * of the buffer, e.g. tuple data referenced rather than copied.
+ * This function doesn't throw.
+ */
+void
+iproto_reply_select_ext(struct obuf *buf, struct obuf_svp *svp,
+			uint64_t sync, uint32_t schema_version,
+			uint32_t count, size_t ext_size);
+
 /**
  * Write header of the key to a preallocated buffer by svp.
  * @param buf Buffer to write to.
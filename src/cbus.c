@@ -31,9 +31,16 @@
 #include "cbus.h"
 
 #include <limits.h>
+#include <pmatomic.h>
 #include "fiber.h"
 #include "trigger.h"
 
+enum {
+	/** Bounds of cbus_endpoint::spin_count. */
+	CBUS_SPIN_MIN = 16,
+	CBUS_SPIN_MAX = 1024,
+};
+
 /**
  * Cord interconnect.
  */
@@ -83,6 +90,108 @@ cbus_find_endpoint(struct cbus *bus, const char *name)
 	return endpoint;
 }
 
+/** Tell the CPU that we are in a spin-wait loop. */
+static inline void
+cbus_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield" ::: "memory");
+#endif
+}
+
+/**
+ * Push a batch of messages to the endpoint queue and reset
+ * the batch.
+ * @retval true if the queue was empty, so that the consumer
+ *         may need a wakeup.
+ */
+static bool
+cbus_endpoint_push(struct cbus_endpoint *endpoint, struct stailq *batch)
+{
+	assert(!stailq_empty(batch));
+	/* The queue keeps the newest message first. */
+	struct stailq_entry *oldest = stailq_first(batch);
+	stailq_reverse(batch);
+	struct stailq_entry *newest = stailq_first(batch);
+	struct stailq_entry *head = pm_atomic_load(&endpoint->queue);
+	do {
+		oldest->next = head;
+	} while (!pm_atomic_compare_exchange_weak(&endpoint->queue,
+						  &head, newest));
+	stailq_create(batch);
+	return head == NULL;
+}
+
+/**
+ * Wake up the consumer after a push to the empty queue unless
+ * it is polling the queue anyway.
+ */
+static void
+cbus_endpoint_wakeup(struct cbus_endpoint *endpoint)
+{
+	/*
+	 * The queue was updated before the flag is checked, and
+	 * the consumer clears the flag before it checks the
+	 * queue for the last time, so either we see the flag
+	 * cleared or the consumer sees the message.
+	 */
+	if (pm_atomic_load(&endpoint->is_spinning))
+		return;
+	/* Count statistics */
+	rmean_collect(cbus.stats, CBUS_STAT_EVENTS, 1);
+	ev_async_send(endpoint->consumer, &endpoint->async);
+}
+
+void
+cbus_endpoint_fetch(struct cbus_endpoint *endpoint, struct stailq *output)
+{
+	struct stailq batch;
+	stailq_create(&batch);
+	struct stailq_entry *item = pm_atomic_exchange(&endpoint->queue, NULL);
+	/* Restore the order in which the messages were pushed. */
+	while (item != NULL) {
+		struct stailq_entry *next = stailq_next(item);
+		stailq_add(&batch, item);
+		item = next;
+	}
+	stailq_concat(output, &batch);
+}
+
+/**
+ * Poll the endpoint queue for a while before the consumer goes
+ * to sleep so that a busy producer doesn't have to wake it up.
+ * The number of polls adapts to the load: it grows while
+ * messages arrive during polling and shrinks otherwise.
+ * @retval true if the queue isn't empty.
+ */
+static bool
+cbus_endpoint_spin(struct cbus_endpoint *endpoint)
+{
+	bool found = false;
+	pm_atomic_store(&endpoint->is_spinning, true);
+	for (int i = 0; i < endpoint->spin_count; i++) {
+		if (pm_atomic_load_explicit(&endpoint->queue,
+					    pm_memory_order_relaxed) != NULL) {
+			found = true;
+			break;
+		}
+		cbus_cpu_relax();
+	}
+	pm_atomic_store(&endpoint->is_spinning, false);
+	/* A producer might have skipped the wakeup. */
+	if (!found)
+		found = pm_atomic_load(&endpoint->queue) != NULL;
+	if (found)
+		endpoint->spin_count = MIN(endpoint->spin_count * 2,
+					   CBUS_SPIN_MAX);
+	else
+		endpoint->spin_count = MAX(endpoint->spin_count / 2,
+					   CBUS_SPIN_MIN);
+	return found;
+}
+
 static void
 cpipe_flush_cb(ev_loop * /* loop */, struct ev_async *watcher,
 	       int /* events */);
@@ -149,18 +258,18 @@ cpipe_destroy(struct cpipe *pipe)
 	 * delivered.
 	 */
 	tt_pthread_mutex_lock(&endpoint->mutex);
-	/* Flush input */
-	stailq_concat(&endpoint->output, &pipe->input);
+	/* Flush input with the pipe shutdown message as the last one. */
+	stailq_add_tail_entry(&pipe->input, poison, msg.fifo);
 	pipe->n_input = 0;
-	/* Add the pipe shutdown message as the last one. */
-	stailq_add_tail_entry(&endpoint->output, poison, msg.fifo);
+	cbus_endpoint_push(endpoint, &pipe->input);
 	/* Count statistics */
 	rmean_collect(cbus.stats, CBUS_STAT_EVENTS, 1);
 	/*
 	 * Keep the lock for the duration of ev_async_send():
 	 * this will avoid a race condition between
 	 * ev_async_send() and execution of the poison
-	 * message, after which the endpoint may disappear.
+	 * message, after which the endpoint may disappear
+	 * (see cbus_endpoint_destroy()).
 	 */
 	ev_async_send(endpoint->consumer, &endpoint->async);
 	tt_pthread_mutex_unlock(&endpoint->mutex);
@@ -218,7 +327,9 @@ cbus_endpoint_create(struct cbus_endpoint *endpoint, const char *name,
 	endpoint->n_pipes = 0;
 	fiber_cond_create(&endpoint->cond);
 	tt_pthread_mutex_init(&endpoint->mutex, NULL);
-	stailq_create(&endpoint->output);
+	endpoint->queue = NULL;
+	endpoint->is_spinning = false;
+	endpoint->spin_count = CBUS_SPIN_MIN;
 	ev_async_init(&endpoint->async,
 		      (void (*)(ev_loop *, struct ev_async *, int)) fetch_cb);
 	endpoint->async.data = fetch_data;
@@ -252,14 +363,15 @@ cbus_endpoint_destroy(struct cbus_endpoint *endpoint,
 	while (true) {
 		if (process_cb)
 			process_cb(endpoint);
-		if (endpoint->n_pipes == 0 && stailq_empty(&endpoint->output))
+		if (endpoint->n_pipes == 0 &&
+		    pm_atomic_load(&endpoint->queue) == NULL)
 			break;
 		 fiber_cond_wait(&endpoint->cond);
 	}
 
 	/*
-	 * Pipe flush func can still lock mutex, so just lock and unlock
-	 * it.
+	 * cpipe_destroy() can still hold the mutex, so just lock
+	 * and unlock it.
 	 */
 	tt_pthread_mutex_lock(&endpoint->mutex);
 	tt_pthread_mutex_unlock(&endpoint->mutex);
@@ -281,22 +393,10 @@ cpipe_flush_cb(ev_loop *loop, struct ev_async *watcher, int events)
 		return;
 
 	trigger_run(&pipe->on_flush, pipe);
-	/* Trigger task processing when the queue becomes non-empty. */
-	bool output_was_empty;
-
-	tt_pthread_mutex_lock(&endpoint->mutex);
-	output_was_empty = stailq_empty(&endpoint->output);
-	/** Flush input */
-	stailq_concat(&endpoint->output, &pipe->input);
-	tt_pthread_mutex_unlock(&endpoint->mutex);
-
 	pipe->n_input = 0;
-	if (output_was_empty) {
-		/* Count statistics */
-		rmean_collect(cbus.stats, CBUS_STAT_EVENTS, 1);
-
-		ev_async_send(endpoint->consumer, &endpoint->async);
-	}
+	/* Trigger task processing when the queue becomes non-empty. */
+	if (cbus_endpoint_push(endpoint, &pipe->input))
+		cbus_endpoint_wakeup(endpoint);
 }
 
 void
@@ -642,7 +742,16 @@ cbus_loop(struct cbus_endpoint *endpoint)
 		cbus_process(endpoint);
 		if (fiber_is_cancelled())
 			break;
-		fiber_yield();
+		if (cbus_endpoint_spin(endpoint)) {
+			/*
+			 * Let other fibers and events run, then
+			 * get back to the messages without waiting
+			 * for a wakeup.
+			 */
+			fiber_reschedule();
+		} else {
+			fiber_yield();
+		}
 	}
 }
 
@@ -118,7 +118,8 @@ struct cpipe {
 	/**
 	 * When pushing messages, keep the staged input size under
 	 * this limit (speeds up message delivery and reduces
-	 * latency, while still keeping the bus mutex cold enough).
+	 * latency, while still keeping the endpoint queue cold
+	 * enough).
 	 */
 	int max_input;
 	/**
@@ -166,7 +167,7 @@ cpipe_destroy(struct cpipe *pipe);
  * Otherwise, the messages flushed once per event loop iteration.
  *
  * @todo: collect bus stats per second and adjust max_input once
- * a second to keep the mutex cold regardless of the message load,
+ * a second to keep the queue cold regardless of the message load,
  * while still keeping the latency low if there are few
  * long-to-process messages.
  */
@@ -251,10 +252,27 @@ struct cbus_endpoint {
 	char name[FIBER_NAME_MAX];
 	/** Member of cbus->endpoints */
 	struct rlist in_cbus;
-	/** The lock around the pipe. */
+	/**
+	 * Incoming messages, the newest first. This is a
+	 * lock-free multi-producer single-consumer queue:
+	 * producers push batches of messages with a
+	 * compare-and-swap, the consumer takes all messages at
+	 * once with an atomic exchange and reverses them.
+	 */
+	struct stailq_entry *queue;
+	/**
+	 * Set while the consumer polls the queue before going to
+	 * sleep, see cbus_loop(). Producers don't wake up the
+	 * consumer while it is set.
+	 */
+	bool is_spinning;
+	/** Number of queue polls before the consumer sleeps. */
+	int spin_count;
+	/**
+	 * Serializes the last access of a pipe to the endpoint in
+	 * cpipe_destroy() with the endpoint destruction.
+	 */
 	pthread_mutex_t mutex;
-	/** A queue with incoming messages. */
-	struct stailq output;
 	/** Consumer cord loop */
 	ev_loop *consumer;
 	/** Async to notify the consumer */
@@ -268,13 +286,8 @@ struct cbus_endpoint {
 /**
  * Fetch incomming messages to output
  */
-static inline void
-cbus_endpoint_fetch(struct cbus_endpoint *endpoint, struct stailq *output)
-{
-	tt_pthread_mutex_lock(&endpoint->mutex);
-	stailq_concat(output, &endpoint->output);
-	tt_pthread_mutex_unlock(&endpoint->mutex);
-}
+void
+cbus_endpoint_fetch(struct cbus_endpoint *endpoint, struct stailq *output);
 
 /** Initialize the global singleton bus. */
 void
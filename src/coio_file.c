@@ -30,6 +30,7 @@
  */
 #include "coio_file.h"
 #include "coio_task.h"
+#include "uring.h"
 #include "fiber.h"
 #include "say.h"
 #include <stdio.h>
@@ -152,6 +153,8 @@ coio_file_close(int fd)
 ssize_t
 coio_pwrite(int fd, const void *buf, size_t count, off_t offset)
 {
+	if (uring_is_enabled())
+		return uring_pwrite(fd, buf, count, offset);
 	INIT_COEIO_FILE(eio);
 	eio_req *req = eio_write(fd, (void *) buf, count, offset,
 				 0, coio_complete, &eio);
@@ -161,6 +164,8 @@ coio_pwrite(int fd, const void *buf, size_t count, off_t offset)
 ssize_t
 coio_pread(int fd, void *buf, size_t count, off_t offset)
 {
+	if (uring_is_enabled())
+		return uring_pread(fd, buf, count, offset);
 	INIT_COEIO_FILE(eio);
 	eio_req *req = eio_read(fd, buf, count,
 				offset, 0, coio_complete, &eio);
@@ -478,6 +483,8 @@ coio_sync()
 int
 coio_fsync(int fd)
 {
+	if (uring_is_enabled())
+		return uring_fsync(fd, false);
 	INIT_COEIO_FILE(eio);
 	eio_req *req = eio_fsync(fd, 0, coio_complete, &eio);
 	return coio_wait_done(req, &eio);
@@ -486,6 +493,8 @@ coio_fsync(int fd)
 int
 coio_fdatasync(int fd)
 {
+	if (uring_is_enabled())
+		return uring_fsync(fd, true);
 	INIT_COEIO_FILE(eio);
 	eio_req *req = eio_fdatasync(fd, 0, coio_complete, &eio);
 	return coio_wait_done(req, &eio);
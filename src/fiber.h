@@ -105,7 +105,9 @@ enum fiber_key {
 	/** User global privilege and authentication token */
 	FIBER_KEY_USER = 3,
 	FIBER_KEY_MSG = 4,
-	FIBER_KEY_MAX = 5
+	/** Where to account time spent waiting for WAL, ev_tstamp * */
+	FIBER_KEY_WAL_WAIT = 5,
+	FIBER_KEY_MAX = 6
 };
 
 /** \cond public */
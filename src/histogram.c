@@ -122,8 +122,21 @@ histogram_discard(struct histogram *hist, int64_t val)
 	hist->total--;
 }
 
+void
+histogram_merge(struct histogram *hist, const struct histogram *other)
+{
+	assert(hist->n_buckets == other->n_buckets);
+	hist->total += other->total;
+	for (size_t i = 0; i < hist->n_buckets; i++) {
+		assert(hist->buckets[i].max == other->buckets[i].max);
+		hist->buckets[i].count += other->buckets[i].count;
+	}
+	if (hist->max < other->max)
+		hist->max = other->max;
+}
+
 int64_t
-histogram_percentile(struct histogram *hist, int pct)
+histogram_percentile(struct histogram *hist, double pct)
 {
 	size_t count = 0;
 
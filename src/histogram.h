@@ -76,12 +76,19 @@ histogram_collect(struct histogram *hist, int64_t val);
 void
 histogram_discard(struct histogram *hist, int64_t val);
 
+/**
+ * Add all observations collected by a histogram to another
+ * histogram. Both histograms must have the same buckets.
+ */
+void
+histogram_merge(struct histogram *hist, const struct histogram *other);
+
 /**
  * Calculate a percentile, i.e. the value below which a given
  * percentage of observations fall.
  */
 int64_t
-histogram_percentile(struct histogram *hist, int pct);
+histogram_percentile(struct histogram *hist, double pct);
 
 /**
  * Print string representation of a histogram.
@@ -34,6 +34,7 @@
  */
 #include <string.h> /* memmove, memset */
 #include <stdint.h>
+#include <sys/types.h> /* ssize_t */
 #include <assert.h>
 #include <stdio.h> /* printf */
 #include "small/matras.h"
@@ -163,6 +164,12 @@
  * bool bps_tree_iterator_prev(tree, itr);
  * void bps_tree_iterator_freeze(tree, itr);
  * void bps_tree_iterator_destroy(tree, itr);
+ * // order statistics (BPS_INNER_CARD only):
+ * struct bps_tree_iterator bps_tree_lower_bound_get_offset(tree, key, exact,
+ *                                                          offset);
+ * struct bps_tree_iterator bps_tree_upper_bound_get_offset(tree, key, exact,
+ *                                                          offset);
+ * struct bps_tree_iterator bps_tree_iterator_at(tree, offset);
  */
 /* }}} */
 
@@ -274,6 +281,18 @@
 #error "BPS_TREE_COMPARE_KEY must be defined"
 #endif
 
+/**
+ * Function to check if two elements are identical, i.e. are
+ * the same element, not just equal in terms of BPS_TREE_COMPARE.
+ * Used by debug self-checks. Must be defined if the element type
+ * can't be compared with ==, e.g. it is a struct.
+ * Example:
+ * #define BPS_TREE_IDENTICAL(a, b) ((a).ptr == (b).ptr)
+ */
+#ifndef BPS_TREE_IDENTICAL
+#define BPS_TREE_IDENTICAL(a, b) ((a) == (b))
+#endif
+
 /**
  * A switch to define the type of search in an array elements.
  * By default, bps_tree uses binary search to find a particular
@@ -283,6 +302,16 @@
  * #define BPS_BLOCK_LINEAR_SEARCH
  */
 
+/**
+ * A switch that makes every inner block store the number of
+ * elements in its subtree. It costs a few more block touches on
+ * insertion and deletion and a bit of space in inner blocks, but
+ * allows to get the position (offset) of an element in the tree
+ * and to find an element by its position in logarithmic time.
+ * To turn it on,
+ * #define BPS_INNER_CARD
+ */
+
 /**
  * A switch that enables collection of executions of different
  * branches of code. Used only for debug purposes, I hope you
@@ -365,6 +394,9 @@ typedef uint32_t bps_tree_block_id_t;
 #define bps_tree_lower_bound_elem _api_name(lower_bound_elem)
 #define bps_tree_upper_bound_elem _api_name(upper_bound_elem)
 #define bps_tree_approximate_count _api_name(approximate_count)
+#define bps_tree_lower_bound_get_offset _api_name(lower_bound_get_offset)
+#define bps_tree_upper_bound_get_offset _api_name(upper_bound_get_offset)
+#define bps_tree_iterator_at _api_name(iterator_at)
 #define bps_tree_iterator_get_elem _api_name(iterator_get_elem)
 #define bps_tree_iterator_next _api_name(iterator_next)
 #define bps_tree_iterator_prev _api_name(iterator_prev)
@@ -444,6 +476,10 @@ typedef uint32_t bps_tree_block_id_t;
 #define bps_tree_print_block _bps_tree(print_block)
 #define bps_tree_print_leaf _bps_tree(print_leaf)
 #define bps_tree_print_inner _bps_tree(print_inner)
+#define bps_tree_block_card _bps_tree(block_card)
+#define bps_tree_children_card _bps_tree(children_card)
+#define bps_tree_inner_offset _bps_tree(inner_offset)
+#define bps_tree_path_add_card _bps_tree(path_add_card)
 #define bps_tree_debug_set_elem _bps_tree(debug_set_elem)
 #define bps_tree_debug_get_elem _bps_tree(debug_get_elem)
 #define bps_tree_debug_set_elem_inner _bps_tree(debug_set_elem_inner)
@@ -780,6 +816,55 @@ bps_tree_upper_bound_elem(const struct bps_tree *tree, bps_tree_elem_t key,
 static inline size_t
 bps_tree_approximate_count(const struct bps_tree *tree, bps_tree_key_t key);
 
+#ifdef BPS_INNER_CARD
+
+/**
+ * @brief Same as bps_tree_lower_bound, but also calculates the
+ *  offset of the found position, i.e. the number of elements
+ *  that are less than the key.
+ * @param tree - pointer to a tree
+ * @param key - key that will be compared with elements
+ * @param exact - pointer to a bool value, that will be set to true if
+ *  and element pointed by the iterator is equal to the key, false otherwise
+ *  Pass NULL if you don't need that info.
+ * @param[out] offset - offset of the found position.
+ * @return - Lower-bound iterator. Invalid if all elements are less than key.
+ */
+static inline struct bps_tree_iterator
+bps_tree_lower_bound_get_offset(const struct bps_tree *tree,
+				bps_tree_key_t key, bool *exact,
+				size_t *offset);
+
+/**
+ * @brief Same as bps_tree_upper_bound, but also calculates the
+ *  offset of the found position, i.e. the number of elements
+ *  that are less than or equal to the key.
+ * @param tree - pointer to a tree
+ * @param key - key that will be compared with elements
+ * @param exact - pointer to a bool value, that will be set to true if
+ *  and element pointed by the (!)previous iterator is equal to the key,
+ *  false otherwise. Pass NULL if you don't need that info.
+ * @param[out] offset - offset of the found position.
+ * @return - Upper-bound iterator. Invalid if all elements are less or equal
+ *  than the key.
+ */
+static inline struct bps_tree_iterator
+bps_tree_upper_bound_get_offset(const struct bps_tree *tree,
+				bps_tree_key_t key, bool *exact,
+				size_t *offset);
+
+/**
+ * @brief Get an iterator to the element at the given offset,
+ *  i.e. the element that has exactly @a offset elements before it.
+ * @param tree - pointer to a tree
+ * @param offset - offset of the element
+ * @return - The iterator. Invalid if offset >= tree size.
+ */
+static inline struct bps_tree_iterator
+bps_tree_iterator_at(const struct bps_tree *tree, size_t offset);
+
+#endif /* BPS_INNER_CARD */
+
 /**
  * @brief Get a pointer to the element pointed by iterator.
  *  If iterator is detected as broken, it is invalidated and NULL returned.
@@ -912,9 +997,16 @@ enum bps_tree_max_sizes {
 		(BPS_TREE_BLOCK_SIZE - sizeof(struct bps_block)
 		 - 2 * sizeof(bps_tree_block_id_t) )
 		/ sizeof(bps_tree_elem_t),
+#ifdef BPS_INNER_CARD
+	/* The header is padded to the alignment of the card member. */
+	BPS_TREE_MAX_COUNT_IN_INNER =
+		(BPS_TREE_BLOCK_SIZE - 2 * sizeof(size_t))
+		/ (sizeof(bps_tree_elem_t) + sizeof(bps_tree_block_id_t)),
+#else
 	BPS_TREE_MAX_COUNT_IN_INNER =
 		(BPS_TREE_BLOCK_SIZE - sizeof(struct bps_block))
 		/ (sizeof(bps_tree_elem_t) + sizeof(bps_tree_block_id_t)),
+#endif
 	BPS_TREE_MAX_DEPTH = 16
 };
 
@@ -956,6 +1048,10 @@ CT_ASSERT_G(sizeof(struct bps_leaf) <= BPS_TREE_BLOCK_SIZE);
 struct bps_inner {
 	/* Block header */
 	struct bps_block header;
+#ifdef BPS_INNER_CARD
+	/* Number of elements in all leaves of the subtree */
+	size_t card;
+#endif
 	/* Ordered array of elements. Note -1 in size. See struct descr. */
 	bps_tree_elem_t elems[BPS_TREE_MAX_COUNT_IN_INNER - 1];
 	/* Corresponding child IDs */
@@ -1166,6 +1262,9 @@ bps_tree_build(struct bps_tree *tree, bps_tree_elem_t *sorted_array,
 				}
 				parents[i]->header.type = BPS_TREE_BT_INNER;
 				parents[i]->header.size = 0;
+#ifdef BPS_INNER_CARD
+				parents[i]->card = 0;
+#endif
 				inner_count++;
 			}
 			parents[i]->child_ids[parents[i]->header.size] =
@@ -1178,6 +1277,11 @@ bps_tree_build(struct bps_tree *tree, bps_tree_elem_t *sorted_array,
 				insert_id = new_id;
 			}
 		}
+#ifdef BPS_INNER_CARD
+		/* All the current parents are ancestors of the new leaf */
+		for (bps_tree_block_id_t i = 0; i < depth - 1; i++)
+			parents[i]->card += leaf->header.size;
+#endif
 
 		bps_tree_elem_t insert_value = current[leaf->header.size - 1];
 		for (bps_tree_block_id_t i = 0; i < depth - 1; i++) {
@@ -1295,6 +1399,54 @@ bps_tree_touch_block(struct bps_tree *tree, bps_tree_block_id_t id)
 	return (struct bps_block *)matras_touch(&tree->matras, id);
 }
 
+#ifdef BPS_INNER_CARD
+
+/**
+ * @brief Get the number of elements in a subtree by its root ID.
+ */
+static inline size_t
+bps_tree_block_card(const struct bps_tree *tree, bps_tree_block_id_t id)
+{
+	struct bps_block *block = bps_tree_restore_block(tree, id);
+	if (block->type == BPS_TREE_BT_LEAF)
+		return block->size;
+	assert(block->type == BPS_TREE_BT_INNER);
+	return ((struct bps_inner *)block)->card;
+}
+
+/**
+ * @brief Get the number of elements in a range of children of
+ *  an inner block.
+ */
+static inline size_t
+bps_tree_children_card(const struct bps_tree *tree,
+		       const struct bps_inner *inner,
+		       bps_tree_pos_t from, bps_tree_pos_t count)
+{
+	size_t card = 0;
+	for (bps_tree_pos_t i = from; i < from + count; i++)
+		card += bps_tree_block_card(tree, inner->child_ids[i]);
+	return card;
+}
+
+/**
+ * @brief Get the number of elements in children of an inner block
+ *  that precede the given position. Cards are summed from the
+ *  nearest edge of the block.
+ */
+static inline size_t
+bps_tree_inner_offset(const struct bps_tree *tree,
+		      const struct bps_inner *inner, bps_tree_pos_t pos)
+{
+	if (pos <= inner->header.size / 2)
+		return bps_tree_children_card(tree, inner, 0, pos);
+	return inner->card -
+		bps_tree_children_card(tree, inner, pos,
+				       inner->header.size - pos);
+}
+
+#endif /* BPS_INNER_CARD */
+
 /**
  * @brief Get a random element in a tree.
  * @param tree - pointer to a tree
@@ -1948,6 +2100,186 @@ bps_tree_approximate_count(const struct bps_tree *tree, bps_tree_key_t key)
 	return result;
 }
 
+#ifdef BPS_INNER_CARD
+
+/**
+ * @brief Get an iterator to the first element that is greater or
+ *  equal than key and the number of elements that are less than key.
+ * @param tree - pointer to a tree
+ * @param key - key that will be compared with elements
+ * @param exact - pointer to a bool value, that will be set to true if
+ *  and element pointed by the iterator is equal to the key, false otherwise
+ *  Pass NULL if you don't need that info.
+ * @param[out] offset - offset of the found position.
+ * @return - Lower-bound iterator. Invalid if all elements are less than key.
+ */
+static inline struct bps_tree_iterator
+bps_tree_lower_bound_get_offset(const struct bps_tree *tree,
+				bps_tree_key_t key, bool *exact,
+				size_t *offset)
+{
+	struct bps_tree_iterator res;
+	matras_head_read_view(&res.view);
+	bool local_result;
+	if (!exact)
+		exact = &local_result;
+	*exact = false;
+	*offset = 0;
+	if (tree->root_id == (bps_tree_block_id_t)(-1)) {
+		res.block_id = (bps_tree_block_id_t)(-1);
+		res.pos = 0;
+		return res;
+	}
+	struct bps_block *block = bps_tree_root(tree);
+	bps_tree_block_id_t block_id = tree->root_id;
+	for (bps_tree_block_id_t i = 0; i < tree->depth - 1; i++) {
+		struct bps_inner *inner = (struct bps_inner *)block;
+		bps_tree_pos_t pos;
+		pos = bps_tree_find_ins_point_key(tree, inner->elems,
+						  inner->header.size - 1,
+						  key, exact);
+		*offset += bps_tree_inner_offset(tree, inner, pos);
+		block_id = inner->child_ids[pos];
+		block = bps_tree_restore_block(tree, block_id);
+	}
+
+	struct bps_leaf *leaf = (struct bps_leaf *)block;
+	bps_tree_pos_t pos;
+	pos = bps_tree_find_ins_point_key(tree, leaf->elems, leaf->header.size,
+					  key, exact);
+	*offset += pos;
+	if (pos >= leaf->header.size) {
+		res.block_id = leaf->next_id;
+		res.pos = 0;
+	} else {
+		res.block_id = block_id;
+		res.pos = pos;
+	}
+	return res;
+}
+
+/**
+ * @brief Get an iterator to the first element that is greater than
+ *  key and the number of elements that are less or equal than key.
+ * @param tree - pointer to a tree
+ * @param key - key that will be compared with elements
+ * @param exact - pointer to a bool value, that will be set to true if
+ *  and element pointed by the (!)previous iterator is equal to the key,
+ *  false otherwise. Pass NULL if you don't need that info.
+ * @param[out] offset - offset of the found position.
+ * @return - Upper-bound iterator. Invalid if all elements are less or equal
+ *  than the key.
+ */
+static inline struct bps_tree_iterator
+bps_tree_upper_bound_get_offset(const struct bps_tree *tree,
+				bps_tree_key_t key, bool *exact,
+				size_t *offset)
+{
+	struct bps_tree_iterator res;
+	matras_head_read_view(&res.view);
+	bool local_result;
+	if (!exact)
+		exact = &local_result;
+	*exact = false;
+	*offset = 0;
+	bool exact_test;
+	if (tree->root_id == (bps_tree_block_id_t)(-1)) {
+		res.block_id = (bps_tree_block_id_t)(-1);
+		res.pos = 0;
+		return res;
+	}
+	struct bps_block *block = bps_tree_root(tree);
+	bps_tree_block_id_t block_id = tree->root_id;
+	for (bps_tree_block_id_t i = 0; i < tree->depth - 1; i++) {
+		struct bps_inner *inner = (struct bps_inner *)block;
+		bps_tree_pos_t pos;
+		pos = bps_tree_find_after_ins_point_key(tree, inner->elems,
+							inner->header.size - 1,
+							key, &exact_test);
+		if (exact_test)
+			*exact = true;
+		*offset += bps_tree_inner_offset(tree, inner, pos);
+		block_id = inner->child_ids[pos];
+		block = bps_tree_restore_block(tree, block_id);
+	}
+
+	struct bps_leaf *leaf = (struct bps_leaf *)block;
+	bps_tree_pos_t pos;
+	pos = bps_tree_find_after_ins_point_key(tree, leaf->elems,
+						leaf->header.size,
+						key, &exact_test);
+	if (exact_test)
+		*exact = true;
+	*offset += pos;
+	if (pos >= leaf->header.size) {
+		res.block_id = leaf->next_id;
+		res.pos = 0;
+	} else {
+		res.block_id = block_id;
+		res.pos = pos;
+	}
+	return res;
+}
+
+/**
+ * @brief Get an iterator to the element at the given offset,
+ *  i.e. the element that has exactly @a offset elements before it.
+ * @param tree - pointer to a tree
+ * @param offset - offset of the element
+ * @return - The iterator. Invalid if offset >= tree size.
+ */
+static inline struct bps_tree_iterator
+bps_tree_iterator_at(const struct bps_tree *tree, size_t offset)
+{
+	struct bps_tree_iterator res;
+	matras_head_read_view(&res.view);
+	if (offset >= tree->size) {
+		res.block_id = (bps_tree_block_id_t)(-1);
+		res.pos = 0;
+		return res;
+	}
+	struct bps_block *block = bps_tree_root(tree);
+	bps_tree_block_id_t block_id = tree->root_id;
+	for (bps_tree_block_id_t i = 0; i < tree->depth - 1; i++) {
+		struct bps_inner *inner = (struct bps_inner *)block;
+		bps_tree_pos_t pos;
+		if (offset < inner->card / 2) {
+			/* Look for the child from the left side */
+			pos = 0;
+			for (;;) {
+				size_t card = bps_tree_block_card(tree,
+							inner->child_ids[pos]);
+				if (offset < card)
+					break;
+				offset -= card;
+				pos++;
+			}
+		} else {
+			/* Look for the child from the right side */
+			size_t right = inner->card - offset;
+			pos = inner->header.size - 1;
+			for (;;) {
+				size_t card = bps_tree_block_card(tree,
+							inner->child_ids[pos]);
+				if (right <= card) {
+					offset = card - right;
+					break;
+				}
+				right -= card;
+				pos--;
+			}
+		}
+		block_id = inner->child_ids[pos];
+		block = bps_tree_restore_block(tree, block_id);
+	}
+	assert(offset < (size_t)block->size);
+	res.block_id = block_id;
+	res.pos = offset;
+	return res;
+}
+
+#endif /* BPS_INNER_CARD */
+
 /**
  * @brief Get a pointer to the element pointed by iterator.
  *  If iterator is detected as broken, it is invalidated and NULL returned.
@@ -2156,6 +2488,9 @@ bps_tree_create_inner(struct bps_tree *tree, bps_tree_block_id_t *id)
 	if (!res)
 		res = (struct bps_inner *)matras_alloc(&tree->matras, id);
 	res->header.type = BPS_TREE_BT_INNER;
+#ifdef BPS_INNER_CARD
+	res->card = 0;
+#endif
 	tree->inner_count++;
 	return res;
 }
@@ -2325,6 +2660,24 @@ bps_tree_touch_path(struct bps_tree *tree,
 	}
 }
 
+#ifdef BPS_INNER_CARD
+/**
+ * @brief Add a value to the card of every inner block of the path
+ */
+static inline void
+bps_tree_path_add_card(struct bps_tree *tree,
+		       struct bps_leaf_path_elem *leaf_path_elem,
+		       ssize_t delta)
+{
+	for (struct bps_inner_path_elem *path = leaf_path_elem->parent;
+	     path; path = path->parent) {
+		path->block = (struct bps_inner *)
+			bps_tree_touch_block(tree, path->block_id);
+		path->block->card += delta;
+	}
+}
+#endif
+
 /**
  * @brief Replace element by it's path and fill the *replaced argument
  */
@@ -2658,6 +3011,13 @@ bps_tree_move_elems_to_right_inner(struct bps_tree *tree,
 
 	a->header.size -= num;
 	b->header.size += num;
+#ifdef BPS_INNER_CARD
+	if (tree->root_id != (bps_tree_block_id_t) -1) {
+		size_t card = bps_tree_children_card(tree, b, 0, num);
+		a->card -= card;
+		b->card += card;
+	}
+#endif
 }
 
 /**
@@ -2737,6 +3097,14 @@ bps_tree_move_elems_to_left_inner(struct bps_tree *tree,
 
 	a->header.size += num;
 	b->header.size -= num;
+#ifdef BPS_INNER_CARD
+	if (tree->root_id != (bps_tree_block_id_t) -1) {
+		size_t card = bps_tree_children_card(tree, a,
+					a->header.size - num, num);
+		a->card += card;
+		b->card -= card;
+	}
+#endif
 }
 
 /**
@@ -2941,6 +3309,14 @@ bps_tree_insert_and_move_elems_to_right_inner(struct bps_tree *tree,
 
 	a->header.size -= (num - 1);
 	b->header.size += num;
+#ifdef BPS_INNER_CARD
+	/* The inserted child is already accounted in 'a' */
+	if (tree->root_id != (bps_tree_block_id_t) -1) {
+		size_t card = bps_tree_children_card(tree, b, 0, num);
+		a->card -= card;
+		b->card += card;
+	}
+#endif
 }
 
 /**
@@ -3139,6 +3515,15 @@ bps_tree_insert_and_move_elems_to_left_inner(struct bps_tree *tree,
 
 	a->header.size += num;
 	b->header.size -= (num - 1);
+#ifdef BPS_INNER_CARD
+	/* The inserted child is already accounted in 'b' */
+	if (tree->root_id != (bps_tree_block_id_t) -1) {
+		size_t card = bps_tree_children_card(tree, a,
+					a->header.size - num, num);
+		a->card += card;
+		b->card -= card;
+	}
+#endif
 }
 
 /**
@@ -3705,6 +4090,9 @@ bps_tree_process_insert_leaf(struct bps_tree *tree,
 		new_root->child_ids[0] = tree->root_id;
 		new_root->child_ids[1] = new_block_id;
 		new_root->elems[0] = tree->max_elem;
+#ifdef BPS_INNER_CARD
+		new_root->card = tree->size;
+#endif
 		tree->root_id = new_root_id;
 		tree->max_elem = new_max_elem;
 		tree->depth++;
@@ -4025,6 +4413,9 @@ bps_tree_process_insert_inner(struct bps_tree *tree,
 		new_root->child_ids[0] = tree->root_id;
 		new_root->child_ids[1] = new_block_id;
 		new_root->elems[0] = tree->max_elem;
+#ifdef BPS_INNER_CARD
+		new_root->card = tree->size;
+#endif
 		tree->root_id = new_root_id;
 		tree->max_elem = new_max_elem;
 		tree->depth++;
@@ -4441,9 +4832,20 @@ bps_tree_insert(struct bps_tree *tree, bps_tree_elem_t new_elem,
 	} else {
 		bps_tree_block_id_t unused1;
 		bps_tree_pos_t unused2;
+#ifdef BPS_INNER_CARD
+		bps_tree_path_add_card(tree, &leaf_path_elem, 1);
+		if (bps_tree_process_insert_leaf(tree, &leaf_path_elem,
+						 new_elem, &unused1,
+						 &unused2) != 0) {
+			bps_tree_path_add_card(tree, &leaf_path_elem, -1);
+			return -1;
+		}
+		return 0;
+#else
 		return bps_tree_process_insert_leaf(tree, &leaf_path_elem,
 						    new_elem, &unused1,
 						    &unused2);
+#endif
 	}
 }
 
@@ -4476,10 +4878,17 @@ bps_tree_insert_get_iterator(struct bps_tree *tree, bps_tree_elem_t new_elem,
 					 replaced);
 		return 0;
 	} else {
+#ifdef BPS_INNER_CARD
+		bps_tree_path_add_card(tree, &leaf_path_elem, 1);
+#endif
 		int rc = bps_tree_process_insert_leaf(tree, &leaf_path_elem,
 						      new_elem,
 						      &inserted_iterator->block_id,
 						      &inserted_iterator->pos);
+#ifdef BPS_INNER_CARD
+		if (rc != 0)
+			bps_tree_path_add_card(tree, &leaf_path_elem, -1);
+#endif
 		matras_head_read_view(&inserted_iterator->view);
 		return rc;
 	}
@@ -4504,6 +4913,9 @@ bps_tree_delete(struct bps_tree *tree, bps_tree_elem_t elem)
 	if (!exact)
 		return -1;
 
+#ifdef BPS_INNER_CARD
+	bps_tree_path_add_card(tree, &leaf_path_elem, -1);
+#endif
 	bps_tree_process_delete_leaf(tree, &leaf_path_elem);
 	return 0;
 }
@@ -4592,7 +5004,7 @@ bps_tree_debug_check_block(const struct bps_tree *tree, struct bps_block *block,
 						       inner->child_ids[i]);
 			bps_tree_elem_t calc_max_elem =
 				bps_tree_debug_find_max_elem(tree, tmp_block);
-			if (inner->elems[i] != calc_max_elem)
+			if (!BPS_TREE_IDENTICAL(inner->elems[i], calc_max_elem))
 				result |= 0x4000;
 		}
 		if (block->size > 1) {
@@ -4619,6 +5031,9 @@ bps_tree_debug_check_block(const struct bps_tree *tree, struct bps_block *block,
 				result |= 0x4000000;
 		}
 
+#ifdef BPS_INNER_CARD
+		size_t count_before = *calc_count;
+#endif
 		for (bps_tree_pos_t i = 0; i < block->size; i++)
 			result |= bps_tree_debug_check_block(tree,
 				bps_tree_restore_block(tree,
@@ -4626,6 +5041,10 @@ bps_tree_debug_check_block(const struct bps_tree *tree, struct bps_block *block,
 				inner->child_ids[i], level - 1, calc_count,
 				expected_prev_id, expected_this_id,
 				check_fullness_next);
+#ifdef BPS_INNER_CARD
+		if (inner->card != *calc_count - count_before)
+			result |= 0x8000000;
+#endif
 		return result;
 	}
 }
@@ -4651,7 +5070,8 @@ bps_tree_debug_check(const struct bps_tree *tree)
 		return result;
 	}
 	struct bps_block *root = bps_tree_root(tree);
-	if (tree->max_elem != bps_tree_debug_find_max_elem(tree, root))
+	if (!BPS_TREE_IDENTICAL(tree->max_elem,
+				bps_tree_debug_find_max_elem(tree, root)))
 		result |= 0x8;
 	size_t calc_count = 0;
 	bps_tree_block_id_t expected_prev_id = (bps_tree_block_id_t)(-1);
@@ -5017,12 +5437,14 @@ bps_tree_debug_check_move_to_right_leaf(struct bps_tree *tree, bool assertme)
 				}
 
 				if (a.header.size)
-					if (ma != a.elems[a.header.size - 1]) {
+					if (!BPS_TREE_IDENTICAL(ma,
+							a.elems[a.header.size - 1])) {
 						result |= (1 << 5);
 						assert(!assertme);
 					}
 				if (b.header.size)
-					if (mb != b.elems[b.header.size - 1]) {
+					if (!BPS_TREE_IDENTICAL(mb,
+							b.elems[b.header.size - 1])) {
 						result |= (1 << 5);
 						assert(!assertme);
 					}
@@ -5114,12 +5536,14 @@ bps_tree_debug_check_move_to_left_leaf(struct bps_tree *tree, bool assertme)
 				}
 
 				if (a.header.size)
-					if (ma != a.elems[a.header.size - 1]) {
+					if (!BPS_TREE_IDENTICAL(ma,
+							a.elems[a.header.size - 1])) {
 						result |= (1 << 7);
 						assert(!assertme);
 					}
 				if (b.header.size)
-					if (mb != b.elems[b.header.size - 1]) {
+					if (!BPS_TREE_IDENTICAL(mb,
+							b.elems[b.header.size - 1])) {
 						result |= (1 << 7);
 						assert(!assertme);
 					}
@@ -5225,16 +5649,14 @@ bps_tree_debug_check_insert_and_move_to_right_leaf(struct bps_tree *tree,
 					}
 
 					if (i - u + 1)
-						if (ma
-							!= a.elems[a.header.size
-								- 1]) {
+						if (!BPS_TREE_IDENTICAL(ma,
+							a.elems[a.header.size - 1])) {
 							result |= (1 << 9);
 							assert(!assertme);
 						}
 					if (j + u)
-						if (mb
-							!= b.elems[b.header.size
-								- 1]) {
+						if (!BPS_TREE_IDENTICAL(mb,
+							b.elems[b.header.size - 1])) {
 							result |= (1 << 9);
 							assert(!assertme);
 						}
@@ -5341,16 +5763,14 @@ bps_tree_debug_check_insert_and_move_to_left_leaf(struct bps_tree *tree,
 					}
 
 					if (i + u)
-						if (ma
-							!= a.elems[a.header.size
-								- 1]) {
+						if (!BPS_TREE_IDENTICAL(ma,
+							a.elems[a.header.size - 1])) {
 							result |= (1 << 11);
 							assert(!assertme);
 						}
 					if (j - u + 1)
-						if (mb
-							!= b.elems[b.header.size
-								- 1]) {
+						if (!BPS_TREE_IDENTICAL(mb,
+							b.elems[b.header.size - 1])) {
 							result |= (1 << 11);
 							assert(!assertme);
 						}
@@ -6038,6 +6458,9 @@ bps_tree_debug_check_internal_functions(bool assertme)
 #undef bps_tree_lower_bound_elem
 #undef bps_tree_upper_bound_elem
 #undef bps_tree_approximate_count
+#undef bps_tree_lower_bound_get_offset
+#undef bps_tree_upper_bound_get_offset
+#undef bps_tree_iterator_at
 #undef bps_tree_iterator_get_elem
 #undef bps_tree_iterator_next
 #undef bps_tree_iterator_prev
@@ -6126,4 +6549,9 @@ bps_tree_debug_check_internal_functions(bool assertme)
 #undef bps_tree_debug_check_move_to_left_inner
 #undef bps_tree_debug_check_insert_and_move_to_right_inner
 #undef bps_tree_debug_check_insert_and_move_to_left_inner
+#undef bps_tree_block_card
+#undef bps_tree_children_card
+#undef bps_tree_inner_offset
+#undef bps_tree_path_add_card
+#undef BPS_TREE_IDENTICAL
 /* }}} */
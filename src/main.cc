@@ -53,6 +53,7 @@
 #include "fiber.h"
 #include "cbus.h"
 #include "coio_task.h"
+#include "uring.h"
 #include <crc32.h>
 #include "memory.h"
 #include <say.h>
@@ -301,6 +302,15 @@ daemonize()
 	 */
 	ev_loop_fork(cord()->loop);
 
+	/*
+	 * The io_uring instance belongs to the parent process,
+	 * which is about to exit, so create a new one. This is
+	 * done by the first box.cfg(), before the instance
+	 * starts doing any file I/O.
+	 */
+	uring_free();
+	uring_enable();
+
 	/*
 	 * reinit signals after fork, because fork() implicitly calls
 	 * signal_reset() via pthread_atfork() hook installed by signal_init().
@@ -431,6 +441,9 @@ load_cfg()
 	if (background)
 		daemonize();
 
+	/* Threads don't survive fork(), start it after daemonize(). */
+	say_logger_start_writer();
+
 	/*
 	 * after (optional) daemonising to avoid confusing messages with
 	 * different pids
@@ -469,6 +482,7 @@ tarantool_free(void)
 
 	/* Shutdown worker pool. Waits until threads terminate. */
 	coio_shutdown();
+	uring_free();
 
 	box_free();
 
@@ -656,6 +670,7 @@ main(int argc, char **argv)
 	iobuf_init();
 	coio_init();
 	coio_enable();
+	uring_enable();
 	signal_init();
 	cbus_init();
 	tarantool_lua_init(tarantool_bin, main_argc, main_argv);
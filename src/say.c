@@ -30,6 +30,7 @@
  */
 #include "say.h"
 #include "fiber.h"
+#include "tt_pthread.h"
 
 #include <errno.h>
 #include <stdarg.h>
@@ -42,6 +43,7 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <arpa/inet.h>
+#include <pmatomic.h>
 
 pid_t log_pid = 0;
 int log_level = S_INFO;
@@ -434,6 +436,7 @@ say_logger_init(const char *init_str, int level, int nonblock, const char *forma
 void
 say_logger_free()
 {
+	say_logger_stop_writer();
 	if (logger_type == SAY_LOGGER_SYSLOG && log_fd != -1)
 		close(log_fd);
 	free(syslog_ident);
@@ -650,7 +653,7 @@ say_format_syslog(char *buf, int len, int level, const char *filename,
 
 /** Formatters }}} */
 
-/** {{{ Loggers */
+/** {{{ Writer thread */
 
 /*
  * From pipe(7):
@@ -665,6 +668,373 @@ say_format_syslog(char *buf, int len, int level, const char *filename,
 enum { SAY_BUF_LEN_MAX = 16 * 1024 };
 static __thread char buf[SAY_BUF_LEN_MAX];
 
+enum {
+	/** Size of a log ring, must be a power of two. */
+	SAY_RING_SIZE = 128 * 1024,
+	/** Size of a buffer the writer batches messages in. */
+	SAY_BATCH_SIZE = 64 * 1024,
+};
+
+/**
+ * A ring buffer a thread queues formatted log messages in.
+ * Each message is stored as its length followed by its text.
+ * A ring has a single producer, the thread that owns it, and
+ * a single consumer, the one holding writer.mutex, so it is
+ * synchronized with a pair of monotonic positions.
+ */
+struct say_ring {
+	/** Next ring in the list of all rings. */
+	struct say_ring *next;
+	/** Set while the ring is owned by a thread. */
+	int is_used;
+	/** Position of the first byte not consumed yet. */
+	uint64_t head;
+	/** Position past the last produced byte. */
+	uint64_t tail;
+	char data[SAY_RING_SIZE];
+};
+
+/**
+ * Log writer. While the writer thread is running, loggers
+ * do not write to the log themselves: they format messages
+ * into the ring of the calling thread, and the writer thread
+ * drains all rings, so a slow log never blocks the caller.
+ */
+static struct {
+	/** List of all rings. A ring is never freed. */
+	struct say_ring *rings;
+	/** Key to release the ring of an exiting thread. */
+	pthread_key_t ring_key;
+	/** Set while the writer thread is running. */
+	int is_running;
+	/** Set while the writer thread may block on the pipe. */
+	int is_sleeping;
+	/** Pipe to wake up the writer thread. */
+	int pipe[2];
+	pthread_t thread;
+	/** Serializes consumers: the writer and flushes. */
+	pthread_mutex_t mutex;
+	/** Messages dropped because a ring was full. */
+	uint64_t dropped;
+	/** Value of dropped the writer last reported. */
+	uint64_t dropped_reported;
+	/** Messages batched for a single write to the log. */
+	char batch[SAY_BATCH_SIZE];
+	int batch_len;
+} writer = {
+	.pipe = { -1, -1 },
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/** The ring of the current thread. */
+static __thread struct say_ring *say_ring;
+
+/**
+ * Write a formatted message to the log.
+ */
+static void
+say_write(const char *buf, int len)
+{
+	if (logger_type != SAY_LOGGER_SYSLOG) {
+		(void) write(log_fd, buf, len);
+		return;
+	}
+	if (log_fd < 0 || write(log_fd, buf, len) <= 0) {
+		/*
+		 * Try to reconnect, if write to syslog has
+		 * failed. Syslog write can fail, if, for example,
+		 * syslogd is restarted. In such a case write to
+		 * UNIX socket starts return -1 even for UDP.
+		 */
+		if (log_fd >= 0)
+			close(log_fd);
+		log_fd = say_syslog_connect();
+		if (log_fd >= 0) {
+			/*
+			 * In a case or error the log message is
+			 * lost. We can not wait for connection -
+			 * it would block thread. Try to reconnect
+			 * on next vsay().
+			 */
+			(void) write(log_fd, buf, len);
+		}
+	}
+}
+
+/** Write out the messages batched by the consumer. */
+static void
+say_batch_flush(void)
+{
+	if (writer.batch_len > 0)
+		say_write(writer.batch, writer.batch_len);
+	writer.batch_len = 0;
+}
+
+static void
+say_ring_copy_in(struct say_ring *ring, uint64_t pos, const void *src,
+		 size_t len)
+{
+	size_t offset = pos & (SAY_RING_SIZE - 1);
+	size_t n = MIN(len, SAY_RING_SIZE - offset);
+	memcpy(ring->data + offset, src, n);
+	memcpy(ring->data, (const char *)src + n, len - n);
+}
+
+static void
+say_ring_copy_out(struct say_ring *ring, uint64_t pos, void *dst, size_t len)
+{
+	size_t offset = pos & (SAY_RING_SIZE - 1);
+	size_t n = MIN(len, SAY_RING_SIZE - offset);
+	memcpy(dst, ring->data + offset, n);
+	memcpy((char *)dst + n, ring->data, len - n);
+}
+
+/** Release the ring of an exiting thread for reuse. */
+static void
+say_ring_release(void *arg)
+{
+	struct say_ring *ring = (struct say_ring *)arg;
+	pm_atomic_store(&ring->is_used, 0);
+}
+
+/**
+ * Return the ring of the current thread. A thread takes over
+ * a ring released by an exited thread, if any, or allocates
+ * a new one.
+ */
+static struct say_ring *
+say_ring_get(void)
+{
+	if (say_ring != NULL)
+		return say_ring;
+	struct say_ring *ring;
+	for (ring = pm_atomic_load(&writer.rings); ring != NULL;
+	     ring = ring->next) {
+		int is_used = 0;
+		if (pm_atomic_compare_exchange_strong(&ring->is_used,
+						      &is_used, 1))
+			goto done;
+	}
+	ring = (struct say_ring *)malloc(sizeof(*ring));
+	if (ring == NULL)
+		return NULL;
+	ring->is_used = 1;
+	ring->head = ring->tail = 0;
+	ring->next = pm_atomic_load(&writer.rings);
+	while (!pm_atomic_compare_exchange_strong(&writer.rings,
+						  &ring->next, ring))
+		;
+done:
+	if (pthread_setspecific(writer.ring_key, ring) != 0) {
+		say_ring_release(ring);
+		return NULL;
+	}
+	say_ring = ring;
+	return ring;
+}
+
+/**
+ * Queue a message in the ring of the current thread.
+ * @retval  0 the message is queued or dropped.
+ * @retval -1 the message must be written synchronously.
+ */
+static int
+say_ring_push(const char *buf, int len)
+{
+	struct say_ring *ring = say_ring_get();
+	if (ring == NULL)
+		return -1;
+	uint32_t size = len;
+	uint64_t tail = ring->tail;
+	uint64_t head = pm_atomic_load_explicit(&ring->head,
+						pm_memory_order_acquire);
+	if (tail + sizeof(size) + len - head > SAY_RING_SIZE) {
+		pm_atomic_fetch_add(&writer.dropped, 1);
+		return 0;
+	}
+	say_ring_copy_in(ring, tail, &size, sizeof(size));
+	say_ring_copy_in(ring, tail + sizeof(size), buf, len);
+	pm_atomic_store(&ring->tail, tail + sizeof(size) + len);
+	if (pm_atomic_load(&writer.is_sleeping) &&
+	    pm_atomic_exchange(&writer.is_sleeping, 0) != 0) {
+		char c = 0;
+		(void) write(writer.pipe[1], &c, 1);
+	}
+	return 0;
+}
+
+/**
+ * Write out all messages queued in rings.
+ * @return the number of messages written.
+ */
+static int
+say_rings_drain(void)
+{
+	int count = 0;
+	tt_pthread_mutex_lock(&writer.mutex);
+	for (struct say_ring *ring = pm_atomic_load(&writer.rings);
+	     ring != NULL; ring = ring->next) {
+		uint64_t head = ring->head;
+		uint64_t tail = pm_atomic_load(&ring->tail);
+		while (head != tail) {
+			uint32_t size;
+			say_ring_copy_out(ring, head, &size, sizeof(size));
+			assert(size <= SAY_BUF_LEN_MAX);
+			if (writer.batch_len + size > SAY_BATCH_SIZE)
+				say_batch_flush();
+			say_ring_copy_out(ring, head + sizeof(size),
+					  writer.batch + writer.batch_len, size);
+			writer.batch_len += size;
+			/* Syslog needs a datagram per message. */
+			if (logger_type == SAY_LOGGER_SYSLOG)
+				say_batch_flush();
+			head += sizeof(size) + size;
+			count++;
+		}
+		say_batch_flush();
+		pm_atomic_store_explicit(&ring->head, head,
+					 pm_memory_order_release);
+	}
+	tt_pthread_mutex_unlock(&writer.mutex);
+	return count;
+}
+
+static void *
+say_writer_f(void *arg)
+{
+	(void) arg;
+	char buf[64];
+	while (true) {
+		/*
+		 * Announce that the thread is about to sleep
+		 * before checking the rings: a message queued
+		 * after the check will wake the thread up.
+		 */
+		pm_atomic_store(&writer.is_sleeping, 1);
+		if (say_rings_drain() == 0) {
+			if (!pm_atomic_load(&writer.is_running))
+				break;
+			(void) read(writer.pipe[0], buf, sizeof(buf));
+		}
+		uint64_t dropped = pm_atomic_load(&writer.dropped);
+		if (dropped != writer.dropped_reported) {
+			say_warn("%llu log messages were dropped, "
+				 "the log can not keep up with them",
+				 (unsigned long long)(dropped -
+						      writer.dropped_reported));
+			writer.dropped_reported = dropped;
+		}
+	}
+	pm_atomic_store(&writer.is_sleeping, 0);
+	return NULL;
+}
+
+/**
+ * The writer thread does not exist in a child process.
+ * Messages queued by the parent are written by the parent.
+ */
+static void
+say_writer_atfork(void)
+{
+	writer.is_running = 0;
+	writer.is_sleeping = 0;
+	for (struct say_ring *ring = writer.rings; ring != NULL;
+	     ring = ring->next)
+		ring->head = ring->tail;
+	if (writer.pipe[0] >= 0) {
+		close(writer.pipe[0]);
+		close(writer.pipe[1]);
+		writer.pipe[0] = writer.pipe[1] = -1;
+	}
+	tt_pthread_mutex_init(&writer.mutex, NULL);
+}
+
+static void
+say_writer_atexit(void)
+{
+	say_logger_stop_writer();
+}
+
+void
+say_logger_start_writer(void)
+{
+	if (writer.is_running)
+		return;
+	static bool is_initialized = false;
+	if (!is_initialized) {
+		tt_pthread_key_create(&writer.ring_key, say_ring_release);
+		tt_pthread_atfork(NULL, NULL, say_writer_atfork);
+		atexit(say_writer_atexit);
+		is_initialized = true;
+	}
+	if (pipe(writer.pipe) != 0) {
+		say_syserror("can't start log writer");
+		writer.pipe[0] = writer.pipe[1] = -1;
+		return;
+	}
+	int flags = fcntl(writer.pipe[1], F_GETFL, 0);
+	if (flags < 0 || fcntl(writer.pipe[1], F_SETFL, flags | O_NONBLOCK) < 0)
+		say_syserror("fcntl, fd=%i", writer.pipe[1]);
+	writer.is_running = 1;
+	tt_pthread_create(&writer.thread, NULL, say_writer_f, NULL);
+}
+
+void
+say_logger_stop_writer(void)
+{
+	if (!pm_atomic_load(&writer.is_running))
+		return;
+	pm_atomic_store(&writer.is_running, 0);
+	char c = 0;
+	(void) write(writer.pipe[1], &c, 1);
+	/* exit() may be called by the writer itself. */
+	if (!pthread_equal(writer.thread, pthread_self()))
+		tt_pthread_join(writer.thread, NULL);
+	close(writer.pipe[0]);
+	close(writer.pipe[1]);
+	writer.pipe[0] = writer.pipe[1] = -1;
+	say_rings_drain();
+}
+
+void
+say_logger_flush(void)
+{
+	if (pm_atomic_load(&writer.is_running))
+		say_rings_drain();
+}
+
+/**
+ * Send a formatted message to the log. If the writer thread
+ * is running, the message is queued, otherwise it is written
+ * right away. A fatal error is written synchronously, after
+ * everything queued before it, since the process is going to
+ * exit.
+ */
+static void
+say_output(int level, const char *buf, int len)
+{
+	if (level == S_FATAL || !pm_atomic_load(&writer.is_running)) {
+		say_logger_flush();
+		say_write(buf, len);
+		return;
+	}
+	if (say_ring_push(buf, len) != 0) {
+		say_write(buf, len);
+		return;
+	}
+	/*
+	 * The writer might have stopped before the message
+	 * was queued, don't leave it in the ring.
+	 */
+	if (!pm_atomic_load(&writer.is_running))
+		say_rings_drain();
+}
+
+/** Writer thread }}} */
+
+/** {{{ Loggers */
+
+
 /**
  * Boot-time logger.
  *
@@ -722,7 +1092,7 @@ say_logger_file(int level, const char *filename, int line, const char *error,
 			unreachable();
 	}
 	assert(total >= 0);
-	(void) write(log_fd, buf, total);
+	say_output(level, buf, total);
 	/* Log fatal errors to STDERR */
 	if (level == S_FATAL && log_fd != STDERR_FILENO)
 		(void) write(STDERR_FILENO, buf, total);
@@ -754,26 +1124,7 @@ say_logger_syslog(int level, const char *filename, int line, const char *error,
 	if (level == S_FATAL && log_fd != STDERR_FILENO)
 		(void) write(STDERR_FILENO, buf, total);
 
-	if (log_fd < 0 || write(log_fd, buf, total) <= 0) {
-		/*
-		 * Try to reconnect, if write to syslog has
-		 * failed. Syslog write can fail, if, for example,
-		 * syslogd is restarted. In such a case write to
-		 * UNIX socket starts return -1 even for UDP.
-		 */
-		if (log_fd >= 0)
-			close(log_fd);
-		log_fd = say_syslog_connect();
-		if (log_fd >= 0) {
-			/*
-			 * In a case or error the log message is
-			 * lost. We can not wait for connection -
-			 * it would block thread. Try to reconnect
-			 * on next vsay().
-			 */
-			(void) write(log_fd, buf, total);
-		}
-	}
+	say_output(level, buf, total);
 
 	va_end(ap);
 	errno = errsv; /* Preserve the errno. */
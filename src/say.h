@@ -108,6 +108,29 @@ void say_logger_init(const char *init_str,
 void
 say_logger_free();
 
+/**
+ * Start a thread writing the log in background. Until the
+ * thread is stopped, messages are queued in a per-thread
+ * ring buffer instead of being written by the logging
+ * thread. If a ring is full, the message is dropped and
+ * counted, the count is reported to the log later.
+ * Must be called after the process is daemonized, since the
+ * thread doesn't survive fork(). Stopped at exit.
+ */
+void
+say_logger_start_writer(void);
+
+/**
+ * Stop the log writer thread and write out all queued
+ * messages. The log is written synchronously afterwards.
+ */
+void
+say_logger_stop_writer(void);
+
+/** Write out all messages queued for the writer thread. */
+void
+say_logger_flush(void);
+
 CFORMAT(printf, 5, 0) void
 vsay(int level, const char *filename, int line, const char *error,
      const char *format, va_list ap);
@@ -0,0 +1,440 @@
+/*
+ * Copyright 2010-2017, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "uring.h"
+
+#include "trivia/config.h"
+
+#include <errno.h>
+
+#if defined(HAVE_LINUX_IO_URING_H)
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include <pmatomic.h>
+
+#include "fiber.h"
+#include "fiber_cond.h"
+#include "say.h"
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup	425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter	426
+#endif
+#ifndef __NR_io_uring_register
+#define __NR_io_uring_register	427
+#endif
+
+enum {
+	/** Size of the submission ring. */
+	URING_ENTRIES = 256,
+};
+
+struct uring {
+	/** io_uring file descriptor. */
+	int fd;
+	/** Eventfd the kernel signals on request completion. */
+	int efd;
+	/** Watcher of @efd, reaps completed requests. */
+	struct ev_io completion;
+	/** Submits queued requests before the event loop blocks. */
+	struct ev_prepare submission;
+	/** Submission ring, shared with the kernel. */
+	void *sq_ring;
+	size_t sq_ring_size;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned sq_entries;
+	/** Submission queue entries, shared with the kernel. */
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	/** Completion ring, shared with the kernel. */
+	void *cq_ring;
+	size_t cq_ring_size;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+	/** Number of requests queued, but not submitted yet. */
+	unsigned queued;
+	/**
+	 * Number of requests queued or submitted, but not
+	 * completed. Never exceeds @sq_entries, so that neither
+	 * the submission nor the completion ring overflows.
+	 */
+	unsigned inflight;
+	/** Signalled when a request completes. */
+	struct fiber_cond inflight_cond;
+};
+
+/** A request waiting for completion. */
+struct uring_request {
+	/** The fiber that issued the request. */
+	struct fiber *fiber;
+	/** Result of the operation, -errno on error. */
+	int result;
+	/** Set when the request completes. */
+	bool done;
+};
+
+/** The ring of the main thread, NULL if not enabled. */
+static struct uring *uring;
+
+static int
+sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+		   unsigned flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+static int
+sys_io_uring_register(int fd, unsigned opcode, const void *arg,
+		      unsigned nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/** Pass results of completed requests to waiting fibers. */
+static void
+uring_reap(struct uring *ring)
+{
+	unsigned head = *ring->cq_head;
+	unsigned tail = pm_atomic_load_explicit(ring->cq_tail,
+						pm_memory_order_acquire);
+	if (head == tail)
+		return;
+	for (; head != tail; head++) {
+		struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+		struct uring_request *req =
+			(struct uring_request *)(uintptr_t)cqe->user_data;
+		req->result = cqe->res;
+		req->done = true;
+		fiber_wakeup(req->fiber);
+		assert(ring->inflight > 0);
+		ring->inflight--;
+	}
+	pm_atomic_store_explicit(ring->cq_head, head,
+				 pm_memory_order_release);
+	fiber_cond_broadcast(&ring->inflight_cond);
+}
+
+/** Submit all queued requests with one system call. */
+static void
+uring_submit(struct uring *ring)
+{
+	while (ring->queued > 0) {
+		int rc = sys_io_uring_enter(ring->fd, ring->queued, 0, 0);
+		if (rc >= 0) {
+			ring->queued -= rc;
+			continue;
+		}
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EBUSY) {
+			/*
+			 * The kernel is short of resources or
+			 * has completions to be reaped first.
+			 */
+			uring_reap(ring);
+			continue;
+		}
+		panic_syserror("io_uring_enter");
+	}
+}
+
+static void
+uring_completion_cb(ev_loop *loop, struct ev_io *watcher, int events)
+{
+	(void) loop;
+	(void) events;
+	struct uring *ring = (struct uring *)watcher->data;
+	uint64_t count;
+	while (read(ring->efd, &count, sizeof(count)) < 0 && errno == EINTR)
+		;
+	uring_reap(ring);
+}
+
+static void
+uring_submission_cb(ev_loop *loop, struct ev_prepare *watcher, int events)
+{
+	(void) loop;
+	(void) events;
+	uring_submit((struct uring *)watcher->data);
+}
+
+/**
+ * Queue a request and wait for its completion. The request
+ * is submitted along with other requests queued in the same
+ * event loop iteration.
+ */
+static int
+uring_execute(uint8_t opcode, int fd, const struct iovec *iov,
+	      off_t offset, uint32_t fsync_flags)
+{
+	struct uring *ring = uring;
+	assert(ring != NULL);
+	while (ring->inflight >= ring->sq_entries)
+		fiber_cond_wait(&ring->inflight_cond);
+
+	struct uring_request req;
+	req.fiber = fiber();
+	req.result = 0;
+	req.done = false;
+
+	unsigned tail = *ring->sq_tail;
+	unsigned index = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->off = offset;
+	sqe->addr = (uintptr_t)iov;
+	sqe->len = iov != NULL ? 1 : 0;
+	sqe->fsync_flags = fsync_flags;
+	sqe->user_data = (uintptr_t)&req;
+	ring->sq_array[index] = index;
+	pm_atomic_store_explicit(ring->sq_tail, tail + 1,
+				 pm_memory_order_release);
+	ring->queued++;
+	ring->inflight++;
+
+	/* The request refers to the stack, wait for it even if woken up. */
+	while (!req.done)
+		fiber_yield();
+	if (req.result < 0) {
+		errno = -req.result;
+		return -1;
+	}
+	return req.result;
+}
+
+static void
+uring_delete(struct uring *ring)
+{
+	if (ring->sqes != NULL)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ring != NULL)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	if (ring->sq_ring != NULL)
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	if (ring->efd >= 0)
+		close(ring->efd);
+	if (ring->fd >= 0)
+		close(ring->fd);
+	free(ring);
+}
+
+/** Map a ring region shared with the kernel. */
+static void *
+uring_mmap(int fd, size_t size, off_t offset)
+{
+	void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, fd, offset);
+	return ptr != MAP_FAILED ? ptr : NULL;
+}
+
+void
+uring_enable(void)
+{
+	assert(uring == NULL);
+	assert(cord_is_main());
+	struct uring *ring = calloc(1, sizeof(*ring));
+	if (ring == NULL) {
+		say_warn("failed to allocate io_uring");
+		return;
+	}
+	ring->fd = -1;
+	ring->efd = -1;
+
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	ring->fd = sys_io_uring_setup(URING_ENTRIES, &p);
+	if (ring->fd < 0)
+		goto fail;
+
+	ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->sq_ring = uring_mmap(ring->fd, ring->sq_ring_size,
+				   IORING_OFF_SQ_RING);
+	if (ring->sq_ring == NULL)
+		goto fail;
+	ring->cq_ring_size = p.cq_off.cqes +
+			     p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->cq_ring = uring_mmap(ring->fd, ring->cq_ring_size,
+				   IORING_OFF_CQ_RING);
+	if (ring->cq_ring == NULL)
+		goto fail;
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = uring_mmap(ring->fd, ring->sqes_size, IORING_OFF_SQES);
+	if (ring->sqes == NULL)
+		goto fail;
+
+	char *sq = (char *)ring->sq_ring;
+	ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+	ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+	ring->sq_entries = p.sq_entries;
+	char *cq = (char *)ring->cq_ring;
+	ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+	ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	ring->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (ring->efd < 0)
+		goto fail;
+	if (sys_io_uring_register(ring->fd, IORING_REGISTER_EVENTFD,
+				  &ring->efd, 1) != 0)
+		goto fail;
+
+	fiber_cond_create(&ring->inflight_cond);
+	ev_io_init(&ring->completion, uring_completion_cb, ring->efd, EV_READ);
+	ring->completion.data = ring;
+	ev_io_start(loop(), &ring->completion);
+	ev_prepare_init(&ring->submission, uring_submission_cb);
+	ring->submission.data = ring;
+	ev_prepare_start(loop(), &ring->submission);
+	uring = ring;
+	say_info("using io_uring for file I/O");
+	return;
+fail:
+	say_info("io_uring is not available, using thread pool "
+		 "for file I/O: %s", strerror(errno));
+	uring_delete(ring);
+}
+
+void
+uring_free(void)
+{
+	if (uring == NULL)
+		return;
+	ev_io_stop(loop(), &uring->completion);
+	ev_prepare_stop(loop(), &uring->submission);
+	fiber_cond_destroy(&uring->inflight_cond);
+	uring_delete(uring);
+	uring = NULL;
+}
+
+bool
+uring_is_enabled(void)
+{
+	return uring != NULL && cord_is_main();
+}
+
+ssize_t
+uring_pread(int fd, void *buf, size_t count, off_t offset)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = count };
+	return uring_execute(IORING_OP_READV, fd, &iov, offset, 0);
+}
+
+ssize_t
+uring_pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+	struct iovec iov = { .iov_base = (void *)buf, .iov_len = count };
+	return uring_execute(IORING_OP_WRITEV, fd, &iov, offset, 0);
+}
+
+int
+uring_fsync(int fd, bool datasync)
+{
+	return uring_execute(IORING_OP_FSYNC, fd, NULL, 0,
+			     datasync ? IORING_FSYNC_DATASYNC : 0);
+}
+
+#else /* !defined(HAVE_LINUX_IO_URING_H) */
+
+void
+uring_enable(void)
+{
+}
+
+void
+uring_free(void)
+{
+}
+
+bool
+uring_is_enabled(void)
+{
+	return false;
+}
+
+ssize_t
+uring_pread(int fd, void *buf, size_t count, off_t offset)
+{
+	(void) fd;
+	(void) buf;
+	(void) count;
+	(void) offset;
+	errno = ENOSYS;
+	return -1;
+}
+
+ssize_t
+uring_pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+	(void) fd;
+	(void) buf;
+	(void) count;
+	(void) offset;
+	errno = ENOSYS;
+	return -1;
+}
+
+int
+uring_fsync(int fd, bool datasync)
+{
+	(void) fd;
+	(void) datasync;
+	errno = ENOSYS;
+	return -1;
+}
+
+#endif /* defined(HAVE_LINUX_IO_URING_H) */
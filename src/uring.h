@@ -0,0 +1,91 @@
+#ifndef TARANTOOL_URING_H_INCLUDED
+#define TARANTOOL_URING_H_INCLUDED
+/*
+ * Copyright 2010-2017, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <sys/types.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * io_uring based file I/O for the main (tx) thread.
+ *
+ * Fibers queue requests to the submission ring and yield.
+ * Requests queued during an event loop iteration are submitted
+ * to the kernel with a single system call right before the
+ * loop blocks, and completions are delivered to the loop via
+ * an eventfd, so no worker thread is involved.
+ *
+ * If io_uring is not supported by the kernel or the build,
+ * uring_is_enabled() returns false and callers are supposed
+ * to fall back on the eio thread pool. The same goes for
+ * all threads other than tx, e.g. spare WAL files are
+ * written by the WAL thread through eio.
+ */
+
+/**
+ * Set up the ring for the main thread. Failure is not an
+ * error: it is logged and io_uring is not used.
+ */
+void
+uring_enable(void);
+
+void
+uring_free(void);
+
+/**
+ * Return true if file I/O of the current thread can be
+ * done with io_uring.
+ */
+bool
+uring_is_enabled(void);
+
+/**
+ * Cooperative counterparts of pread(), pwrite(), fsync()
+ * and fdatasync(). Like system calls, return -1 and set
+ * errno on error. May be called only if uring_is_enabled().
+ */
+ssize_t
+uring_pread(int fd, void *buf, size_t count, off_t offset);
+
+ssize_t
+uring_pwrite(int fd, const void *buf, size_t count, off_t offset);
+
+int
+uring_fsync(int fd, bool datasync);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_URING_H_INCLUDED */
@@ -4,7 +4,7 @@ local tap = require('tap')
 local test = tap.test('cfg')
 local socket = require('socket')
 local fio = require('fio')
-test:plan(70)
+test:plan(73)
 
 --------------------------------------------------------------------------------
 -- Invalid values
@@ -31,6 +31,8 @@ invalid('listen', '//!')
 invalid('log', ':')
 invalid('log', 'syslog:xxx=')
 invalid('log_level', 'unknown')
+invalid('iproto_threads', 0)
+invalid('iproto_threads', 1001)
 
 test:is(type(box.cfg), 'function', 'box is not started')
 
@@ -266,6 +268,22 @@ os.exit(0)
 ]]
 test:is(run_script(code), 0, "vinyl_read_threads = 1")
 
+--
+-- client connections are spread over several iproto threads
+--
+code = [[
+box.cfg{iproto_threads = 4, listen = 'unix/:./iproto_threads.sock'}
+local net_box = require('net.box')
+local ok = true
+for i = 1, 8 do
+    local c = net_box.connect('unix/:./iproto_threads.sock')
+    ok = ok and c:ping()
+    c:close()
+end
+os.exit(ok and 0 or 1)
+]]
+test:is(run_script(code), 0, "iproto_threads = 4")
+
 --
 -- gh-2150 one vinyl worker thread is reserved for dumps
 --
@@ -0,0 +1,62 @@
+test_run = require('test_run').new()
+fiber = require('fiber')
+net_box = require('net.box')
+
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+readahead = box.cfg.readahead
+box.cfg{readahead = 128 * 1024}
+
+--
+-- A connection may have 192 requests in progress and 768 more
+-- waiting for their turn. Requests beyond that are rejected
+-- with an overload error, and the other connections are still
+-- served meanwhile.
+--
+released = false
+function block() while not released do fiber.sleep(0.001) end return true end
+c = net_box.connect(box.cfg.listen)
+c2 = net_box.connect(box.cfg.listen)
+ok, rejected = 0, 0
+test_run:cmd("setopt delimiter ';'")
+for i = 1, 1100 do
+    fiber.create(function()
+        local status, err = pcall(c.call, c, 'block')
+        if status then
+            ok = ok + 1
+        elseif err.code == box.error.OVERLOAD then
+            rejected = rejected + 1
+        end
+    end)
+end;
+test_run:cmd("setopt delimiter ''");
+test_run:wait_cond(function() return rejected == 140 end)
+box.stat.net.REQUESTS.in_progress, box.stat.net.REQUESTS.queued
+queue = box.stat.net.QUEUE
+queue.connections, queue.p50, queue.p99, queue.max
+box.stat.net.REJECTED.total
+c2:call('tostring', {1})
+
+released = true
+test_run:wait_cond(function() return ok == 960 end)
+rejected
+box.stat.net.REQUESTS.in_progress, box.stat.net.REQUESTS.queued
+box.stat.net.QUEUE.connections
+
+--
+-- Requests waiting in the queue of a closed connection are
+-- dropped, the ones in progress complete.
+--
+released = false
+calls = 0
+function block() calls = calls + 1 while not released do fiber.sleep(0.001) end return true end
+for i = 1, 500 do fiber.create(pcall, c.call, c, 'block') end
+test_run:wait_cond(function() return box.stat.net.REQUESTS.queued == 308 end)
+c:close()
+test_run:wait_cond(function() return box.stat.net.REQUESTS.queued == 0 end)
+released = true
+test_run:wait_cond(function() return box.stat.net.REQUESTS.in_progress == 0 end)
+calls
+
+c2:close()
+box.cfg{readahead = readahead}
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
@@ -0,0 +1,62 @@
+test_run = require('test_run').new()
+fiber = require('fiber')
+net_box = require('net.box')
+
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+
+--
+-- Large tuples are sent from the tuple memory instead of being
+-- copied to the output buffer. Check that replies mixing copied
+-- and referenced tuples arrive intact.
+--
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+sizes = {1, 10, 1000, 1023, 1024, 1025, 5000, 100000, 3, 2000}
+for i, size in ipairs(sizes) do s:insert{i, string.rep('x', size)} end
+
+c = net_box.connect(box.cfg.listen)
+test_run:cmd("setopt delimiter ';'")
+function equal(a, b)
+    if #a ~= #b then return false end
+    for i = 1, #a do
+        if a[i][1] ~= b[i][1] or a[i][2] ~= b[i][2] then
+            return false
+        end
+    end
+    return true
+end;
+test_run:cmd("setopt delimiter ''");
+equal(c.space.test:select(), s:select())
+equal(c.space.test:select({8}), s:select({8}))
+equal(c.space.test:select({5}, {iterator = 'GE'}), s:select({5}, {iterator = 'GE'}))
+
+-- Many referenced tuples in a single reply.
+for i = 11, 1000 do s:insert{i, string.rep(tostring(i % 10), 1500 + i)} end
+equal(c.space.test:select(), s:select())
+
+-- Concurrent replies on the same connection.
+results, done = {}, 0
+test_run:cmd("setopt delimiter ';'")
+for i = 1, 10 do
+    fiber.create(function()
+        results[i] = equal(c.space.test:select({i * 50},
+                                               {iterator = 'GE'}),
+                           s:select({i * 50}, {iterator = 'GE'}))
+        done = done + 1
+    end)
+end;
+test_run:cmd("setopt delimiter ''");
+test_run:wait_cond(function() return done == 10 end)
+results
+
+-- Compressed tuples are copied decompressed.
+z = box.schema.space.create('z', {compress_threshold = 256})
+_ = z:create_index('pk')
+for i = 1, 20 do z:insert{i, string.rep('z', i * 200)} end
+c:reload_schema()
+equal(c.space.z:select(), z:select())
+
+c:close()
+s:drop()
+z:drop()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
@@ -0,0 +1,95 @@
+test_run = require('test_run').new()
+
+--
+-- Secondary keys are built after recovery, sorted in worker threads.
+-- Check their contents after a restart.
+--
+s1 = box.schema.space.create('test1')
+_ = s1:create_index('pk')
+_ = s1:create_index('sk1', {parts = {2, 'unsigned'}, unique = false})
+_ = s1:create_index('sk2', {parts = {3, 'string', 1, 'unsigned'}})
+_ = s1:create_index('sk3', {type = 'hash', parts = {4, 'unsigned'}})
+s2 = box.schema.space.create('test2')
+_ = s2:create_index('pk', {parts = {1, 'string'}})
+_ = s2:create_index('sk1', {parts = {2, 'integer'}, unique = false})
+_ = s2:create_index('sk2', {parts = {2, 'integer', 1, 'string'}})
+
+for i = 1, 10000 do s1:insert{i, i % 100, tostring(i % 7), 20000 - i} end
+for i = 1, 5000 do s2:insert{tostring(i), i * 7919 % 1000 - 500} end
+box.snapshot()
+-- These rows are recovered from WAL.
+for i = 10001, 10100 do s1:insert{i, i % 100, tostring(i % 7), 20000 - i} end
+for i = 1, 100 do s2:delete{tostring(i)} end
+
+test_run:cmd('restart server default')
+
+s1 = box.space.test1
+s2 = box.space.test2
+
+test_run:cmd("setopt delimiter ';'")
+function index_key(index, tuple)
+    local key = {}
+    for _, part in ipairs(index.parts) do
+        table.insert(key, tuple[part.fieldno])
+    end
+    return key
+end;
+function key_less(a, b)
+    for i = 1, #a do
+        if a[i] ~= b[i] then
+            return a[i] < b[i]
+        end
+    end
+    return false
+end;
+-- Check that every secondary key of a space has the same
+-- tuples as the primary key and, if it's a tree, is sorted.
+function check(space)
+    local pk = space.index[0]
+    local id = 1
+    while space.index[id] ~= nil do
+        local index = space.index[id]
+        if index:count() ~= pk:count() then
+            return false, index.name
+        end
+        local prev = nil
+        for _, tuple in index:pairs() do
+            local key = index_key(index, tuple)
+            if pk:get(index_key(pk, tuple)) ~= tuple then
+                return false, index.name
+            end
+            if index.type == 'TREE' and prev ~= nil and
+               key_less(key, prev) then
+                return false, index.name
+            end
+            prev = key
+        end
+        for _, tuple in pk:pairs() do
+            local found = false
+            for _, t in index:pairs(index_key(index, tuple)) do
+                if t == tuple then
+                    found = true
+                    break
+                end
+            end
+            if not found then
+                return false, index.name
+            end
+        end
+        id = id + 1
+    end
+    return true
+end;
+test_run:cmd("setopt delimiter ''");
+
+s1:count()
+s2:count()
+check(s1)
+check(s2)
+s1.index.sk1:count(42)
+s1.index.sk2:select({'3'}, {limit = 3})
+s1.index.sk3:get{9900}
+s2.index.sk1:select({-500}, {limit = 3})
+
+s1:drop()
+s2:drop()
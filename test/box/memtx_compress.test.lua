@@ -0,0 +1,99 @@
+test_run = require('test_run').new()
+
+-- Vinyl doesn't compress tuples in memory.
+box.schema.space.create('test', {engine = 'vinyl', compress_threshold = 256})
+
+s = box.schema.space.create('test', {compress_threshold = 256})
+box.space._space.index.name:get('test')[6]
+_ = s:create_index('pk')
+_ = s:create_index('sk', {parts = {2, 'string'}, unique = false})
+p = box.schema.space.create('plain')
+_ = p:create_index('pk')
+_ = p:create_index('sk', {parts = {2, 'string'}, unique = false})
+
+long = string.rep('abcdefgh', 512)
+function fill(space) for i = 1, 1000 do space:insert{i, 'k' .. i % 10, long .. i, i} end end
+used = box.slab.info().items_used
+fill(s)
+compressed = box.slab.info().items_used - used
+used = box.slab.info().items_used
+fill(p)
+plain = box.slab.info().items_used - used
+compressed * 10 < plain
+s:bsize() == p:bsize()
+
+test_run:cmd("setopt delimiter ';'")
+function check()
+    for i = 1, 1000 do
+        local a, b = s:get(i), p:get(i)
+        if a:bsize() ~= b:bsize() or #a ~= #b or a[2] ~= b[2] or
+           a[3] ~= b[3] or a[4] ~= b[4] or a:totable()[3] ~= b[3] then
+            return i
+        end
+    end
+    return true
+end;
+test_run:cmd("setopt delimiter ''");
+check()
+
+-- Indexed fields are read without decompression.
+#s.index.sk:select('k3')
+s.index.sk:select('k3', {limit = 1})[1][1]
+s:get(42)[4]
+s:get(42):bsize()
+
+-- Updates.
+s:update(5, {{'=', 3, 'short'}})
+p:update(5, {{'=', 3, 'short'}})
+s:update(6, {{'=', 2, 'k0'}})[3] == long .. 6
+p:update(6, {{'=', 2, 'k0'}})[3] == long .. 6
+s:update(7, {{'+', 4, 1}})[4]
+p:update(7, {{'+', 4, 1}})[4]
+#s.index.sk:select('k0')
+check()
+
+-- Fields stored compressed can't be indexed.
+s:create_index('tk', {parts = {3, 'string'}})
+s.index.tk
+_ = s:delete(8)
+_ = p:delete(8)
+check()
+
+-- Fields of a referenced tuple stay valid while other tuples
+-- are decompressed.
+t = s:get(1)
+gen, param, state = t:pairs()
+state, field = gen(param, state)
+field
+for j = 1, 2 do for _, u in s:pairs() do _ = u[3] end collectgarbage() end
+state, field = gen(param, state)
+field
+state, field = gen(param, state)
+field == long .. 1
+t, gen, param, state, field = nil
+
+box.snapshot()
+test_run:cmd("restart server default")
+s = box.space.test
+p = box.space.plain
+long = string.rep('abcdefgh', 512)
+test_run:cmd("setopt delimiter ';'")
+function check()
+    for i = 1, 1000 do
+        local a, b = s:get(i), p:get(i)
+        if (a == nil) ~= (b == nil) then
+            return i
+        end
+        if a ~= nil and (a:bsize() ~= b:bsize() or a[3] ~= b[3]) then
+            return i
+        end
+    end
+    return true
+end;
+test_run:cmd("setopt delimiter ''");
+check()
+s:count()
+s:get(9)[3] == long .. 9
+
+s:drop()
+p:drop()
@@ -0,0 +1,77 @@
+test_run = require('test_run').new()
+net_box = require('net.box')
+
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+
+--
+-- SELECT and CALL replies streamed in IPROTO_CHUNK packets.
+--
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+for i = 1, 1000 do s:insert{i, i * 2} end
+
+c = net_box.connect(box.cfg.listen)
+test_run:cmd("setopt delimiter ';'")
+function collect(it)
+    local res = {}
+    for _, v in it do table.insert(res, v) end
+    return res
+end;
+function equal(a, b)
+    if #a ~= #b then return false end
+    for i = 1, #a do
+        if a[i][1] ~= b[i][1] or a[i][2] ~= b[i][2] then
+            return false
+        end
+    end
+    return true
+end;
+test_run:cmd("setopt delimiter ''");
+equal(collect(c.space.test:pairs()), s:select())
+equal(collect(c.space.test:pairs(nil, {chunk_size = 7})), s:select())
+equal(collect(c.space.test.index.pk:pairs({500}, {iterator = 'GE', limit = 95, chunk_size = 10})), s:select({500}, {iterator = 'GE', limit = 95}))
+equal(collect(c.space.test:pairs({100}, {chunk_size = 1})), s:select({100}))
+#collect(c.space.test:pairs({2000}))
+
+-- Members of a single returned table are streamed.
+function big(n) local r = {} for i = 1, n do r[i] = i end return r end
+res = collect(c:call_stream('big', {10000}, {chunk_size = 100}))
+#res, res[1], res[5000], res[10000]
+collect(c:call_stream('big', {0}))
+
+-- Multiple return values are streamed one by one.
+function many() return 1, 2, 3 end
+collect(c:call_stream('many', {}, {chunk_size = 2}))
+
+-- A single map is sent as one item.
+function map() return {a = 1} end
+collect(c:call_stream('map'))
+
+-- A request with a stale schema version is retried.
+tmp = box.schema.space.create('tmp')
+#collect(c.space.test:pairs())
+tmp:drop()
+
+-- An abandoned iterator doesn't stall the connection.
+it = c:call_stream('big', {10000}, {chunk_size = 10})
+it()
+it = nil
+_ = collectgarbage('collect')
+
+-- Requests sent while iterating don't wait for the stream.
+n = 0
+for _, t in c.space.test:pairs(nil, {chunk_size = 10}) do n = n + #c.space.test:select(t[1]) end
+n
+
+-- Errors are raised by the iterator.
+function fail() box.error(box.error.PROC_LUA, 'boom') end
+ok, err = pcall(collect, c:call_stream('fail'))
+ok, err.message
+
+-- The connection is usable after streamed replies.
+c:call('many')
+#c.space.test:select()
+
+c:close()
+s:drop()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
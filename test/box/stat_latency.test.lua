@@ -0,0 +1,36 @@
+-- clear statistics
+env = require('test_run')
+test_run = env.new()
+test_run:cmd('restart server default')
+
+box.stat.latency.REPLACE.count -- zero
+box.stat.latency.REPLACE.total.p99 -- zero
+box.stat.latency.PING -- not accounted
+
+space = box.schema.space.create('tweedledum')
+box.schema.user.grant('guest','read,write,execute','universe')
+index = space:create_index('primary')
+remote = require 'net.box'
+
+LISTEN = require('uri').parse(box.cfg.listen)
+cn = remote.connect(LISTEN.host, LISTEN.service)
+
+for i = 1, 10 do cn.space.tweedledum:replace{i} end
+#cn.space.tweedledum:select()
+
+stat = box.stat.latency()
+stat.REPLACE.count
+stat.SELECT.count > 0
+stat.REPLACE.total.p50 > 0
+stat.REPLACE.total.p99 >= stat.REPLACE.total.p50
+stat.REPLACE.total.p999 >= stat.REPLACE.total.p99
+stat.REPLACE.wal.p50 > 0
+stat.REPLACE.net.p999 <= stat.REPLACE.total.p999
+stat.REPLACE.reply.p999 <= stat.REPLACE.total.p999
+-- selects don't write to WAL
+stat.SELECT.wal.p999
+box.stat.latency.SELECT.count >= stat.SELECT.count
+
+space:drop()
+cn:close()
+box.schema.user.revoke('guest','read,write,execute','universe')
@@ -0,0 +1,44 @@
+-- clear statistics
+env = require('test_run')
+test_run = env.new()
+test_run:cmd('restart server default')
+
+box.stat.wal.TXN -- zero
+box.stat.wal.BATCH -- zero
+
+space = box.schema.space.create('tweedledum')
+index = space:create_index('primary')
+for i = 1, 10 do space:replace{i} end
+
+box.stat.wal.TXN.total >= 12
+box.stat.wal.BATCH.total > 0
+box.stat.wal.BATCH.total <= box.stat.wal.TXN.total
+-- wal_mode is 'write', no fsync
+box.stat.wal.FSYNC.total
+
+-- group commit options
+box.cfg{wal_commit_delay = -1}
+box.cfg{wal_commit_siblings = -1}
+box.cfg{wal_commit_delay = 0.001, wal_commit_siblings = 2}
+box.cfg.wal_commit_delay
+box.cfg.wal_commit_siblings
+box.cfg{wal_commit_delay = 0, wal_commit_siblings = 5}
+
+space:drop()
+
+-- wal_mode is 'fsync': concurrent writers share fsyncs
+test_run:cmd("create server fsync with script='box/stat_wal_fsync.lua'")
+test_run:cmd("start server fsync")
+test_run:cmd("switch fsync")
+fiber = require('fiber')
+space = box.schema.space.create('test')
+index = space:create_index('primary')
+ch = fiber.channel(100)
+for i = 1, 100 do fiber.create(function() space:insert{i} ch:put(true) end) end
+for i = 1, 100 do ch:get() end
+space:len()
+box.stat.wal.FSYNC.total > 0
+box.stat.wal.BATCH.total >= box.stat.wal.FSYNC.total
+test_run:cmd("switch default")
+test_run:cmd("stop server fsync")
+test_run:cmd("cleanup server fsync")
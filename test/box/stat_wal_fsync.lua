@@ -0,0 +1,10 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen              = os.getenv("LISTEN"),
+    memtx_memory        = 107374182,
+    wal_mode            = 'fsync',
+}
+
+require('console').listen(os.getenv('ADMIN'))
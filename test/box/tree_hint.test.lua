@@ -0,0 +1,118 @@
+test_run = require('test_run').new()
+
+--
+-- Memtx tree index elements store a comparison hint of the
+-- first key part next to the tuple pointer. Check that hinted
+-- trees order and look up tuples exactly as vinyl does, which
+-- compares tuples without hints.
+--
+test_run:cmd("setopt delimiter ';'")
+function equal(a, b)
+    if #a ~= #b then
+        return false
+    end
+    for i = 1, #a do
+        if a[i][1] ~= b[i][1] or a[i][2] ~= b[i][2] then
+            return false
+        end
+    end
+    return true
+end;
+function check(name, keys)
+    local memtx = box.space['memtx_' .. name].index[name]
+    local vinyl = box.space['vinyl_' .. name].index[name]
+    if not equal(memtx:select(), vinyl:select()) then
+        return false
+    end
+    for _, key in ipairs(keys) do
+        for _, it in ipairs({'EQ', 'REQ', 'GE', 'GT', 'LE', 'LT'}) do
+            local opts = {iterator = it}
+            local res = vinyl:select(key, opts)
+            if not equal(memtx:select(key, opts), res) or
+               memtx:count(key, opts) ~= #res then
+                return false
+            end
+        end
+    end
+    return true
+end;
+function create(name, parts)
+    for _, engine in ipairs({'memtx', 'vinyl'}) do
+        local s = box.schema.space.create(engine .. '_' .. name,
+                                          {engine = engine})
+        s:create_index('pk', {parts = {1, 'unsigned'}})
+        s:create_index(name, {parts = parts, unique = false})
+    end
+end;
+function fill(name, values)
+    for i, v in ipairs(values) do
+        box.space['memtx_' .. name]:insert{i, v}
+        box.space['vinyl_' .. name]:insert{i, v}
+    end
+end;
+function drop(name)
+    box.space['memtx_' .. name]:drop()
+    box.space['vinyl_' .. name]:drop()
+end;
+test_run:cmd("setopt delimiter ''");
+
+-- Numbers of different types with equal or close hints.
+create('num', {2, 'number'})
+big = tonumber64('9007199254740993')
+num = {1, 1.5, -1, -1.5, 0, 0.1, -0.1, 2^53, big, big + 1, -2^53, -big, 1e300, -1e300, 1/0, -1/0, tonumber64('18446744073709551615'), tonumber64('-9223372036854775808')}
+fill('num', num)
+check('num', num)
+drop('num')
+
+-- Strings sharing a prefix longer than a hint.
+create('str', {2, 'string'})
+str = {'', 'a', 'ab', 'abcdefg', 'abcdefg\0', 'abcdefgh', 'abcdefgi', 'abcdefghij', 'abcdefgg', 'b', '\255', '\255\255\255\255\255\255\255\255', 'abcdefg\255'}
+fill('str', str)
+check('str', str)
+drop('str')
+
+-- Strings with a collation: hints are sort key prefixes.
+create('coll', {{2, 'string', collation = 'unicode_s1'}})
+coll = {'a', 'A', 'b', 'B', 'abcdefgh', 'ABCDEFGH', 'abcdefgi', 'ааа', 'ААА', 'еее', 'ёёё', 'жжж', 'ЯЯЯ', 'z', 'Z', ''}
+fill('coll', coll)
+check('coll', coll)
+drop('coll')
+
+-- Scalars: values of different types are ordered by type.
+create('scalar', {2, 'scalar'})
+scalar = {true, false, 1, -1, 1.5, 'a', 'abcdefgh', 'abcdefgi', '', 0, 1e300, -1e300}
+fill('scalar', scalar)
+check('scalar', scalar)
+drop('scalar')
+
+-- Nulls are less than any value.
+create('null', {{2, 'integer', is_nullable = true}})
+fill('null', {box.NULL, 1, -1, box.NULL, 0})
+check('null', {{box.NULL}, {0}, {-1}, {1}})
+drop('null')
+
+-- A hint is computed on index build too. Vinyl can't build an
+-- index on a non-empty space, so only the memtx one is rebuilt.
+create('build', {2, 'string'})
+fill('build', str)
+box.space.memtx_build.index.build:drop()
+_ = box.space.memtx_build:create_index('build', {parts = {2, 'string'}, unique = false})
+check('build', str)
+drop('build')
+
+-- A collation applies to string parts only, so changing the
+-- type of a part with a collation to or from 'string' must
+-- rebuild the index.
+s = box.schema.space.create('alter')
+_ = s:create_index('pk', {parts = {1, 'unsigned'}})
+_ = s:create_index('coll', {parts = {{2, 'string', collation = 'unicode_s1'}}, unique = false})
+for i, v in ipairs(coll) do s:insert{i, v} end
+s.index.coll:alter({parts = {{2, 'scalar', collation = 'unicode_s1'}}})
+_ = s:create_index('ref', {parts = {{2, 'scalar', collation = 'unicode_s1'}}, unique = false})
+equal(s.index.coll:select(), s.index.ref:select())
+#s.index.coll:select({'abcdefgh'})
+s.index.coll:alter({parts = {{2, 'string', collation = 'unicode_s1'}}})
+s.index.ref:alter({parts = {{2, 'string', collation = 'unicode_s1'}}})
+equal(s.index.coll:select(), s.index.ref:select())
+#s.index.coll:select({'abcdefgh'})
+s:drop()
@@ -297,3 +297,30 @@ s:drop()
 
 box.internal.collation.drop('test')
 box.internal.collation.drop('test-ci')
+
+-- count, rank and offset are calculated from subtree sizes
+s = box.schema.space.create('test')
+pk = s:create_index('pk')
+sk = s:create_index('sk', {parts = {2, 'unsigned'}, unique = false})
+for i = 1, 100 do s:replace{i, i % 10} end
+pk:count(50, {iterator = 'GE'})
+pk:count(50, {iterator = 'GT'})
+pk:count(50, {iterator = 'LT'})
+pk:count(50, {iterator = 'LE'})
+pk:count(50)
+pk:count(500)
+sk:count(3)
+sk:count(3, {iterator = 'REQ'})
+sk:count(3, {iterator = 'LT'})
+pk:rank(1)
+pk:rank(50)
+sk:rank(5)
+pk:select(90, {iterator = 'GE', offset = 5})
+pk:select(10, {iterator = 'LE', offset = 7, limit = 2})
+pk:select({}, {offset = 98})
+pk:select({}, {iterator = 'LT', offset = 98})
+pk:select({}, {offset = 100})
+sk:select(3, {offset = 8})
+sk:select(3, {iterator = 'REQ', offset = 8})
+sk:select(3, {offset = 10})
+s:drop()
@@ -0,0 +1,45 @@
+from lib.tarantool_server import TarantoolServer
+from time import sleep
+import yaml
+
+print '-------------------------------------------------------------'
+print 'wal_mode = fsync: replicas get rows only after they are synced'
+print '-------------------------------------------------------------'
+
+master = TarantoolServer(server.ini)
+master.script = 'replication-py/wal_fsync.lua'
+master.vardir = server.vardir
+master.name = 'wal_fsync'
+master.deploy()
+master.admin("box.schema.user.grant('guest', 'replication')")
+master.admin("_ = box.schema.space.create('test')")
+master.admin("_ = box.space.test:create_index('pk')")
+master.admin("box.space.test:insert{1}")
+master_id = master.get_param('id')
+
+replica = TarantoolServer(server.ini)
+replica.script = 'replication-py/replica.lua'
+replica.vardir = server.vardir
+replica.rpl_master = master
+replica.deploy()
+replica.wait_lsn(master_id, master.get_lsn(master_id))
+replica.admin("box.space.test:select{}")
+
+# A failed fdatasync() kills the master before the row
+# reaches the replica.
+master.crash_expected = True
+master.admin("fiber = require('fiber')", silent=True)
+master.admin("box.error.injection.set('ERRINJ_WAL_SYNC', true)")
+master.admin("_ = fiber.create(function() fiber.sleep(0.1) box.space.test:insert{2} end)")
+status = 'box.info.replication[%d].upstream.status' % master_id
+while yaml.load(replica.admin(status, silent=True))[0] == 'follow':
+    sleep(0.01)
+
+line = 'fdatasync failed'
+if master.logfile_pos.seek_once(line) >= 0:
+    print "'%s' exists in server log" % line
+replica.admin("box.space.test:select{}")
+
+replica.stop()
+replica.cleanup(True)
+master.cleanup(True)
@@ -0,0 +1,51 @@
+env = require('test_run')
+test_run = env.new()
+engine = test_run:get_cfg('engine')
+
+box.schema.user.grant('guest', 'replication')
+s = box.schema.space.create('test', {engine = engine})
+_ = s:create_index('pk')
+
+test_run:cmd("create server replica with rpl_master=default, script='replication/replica.lua'")
+test_run:cmd("start server replica")
+
+--
+-- A batch of rows read ahead from the master fails in the middle.
+-- The offending row is counted in the replica set vclock, the rows
+-- after it are not, so they are applied on resubscribe.
+--
+test_run:cmd("switch replica")
+fiber = require('fiber')
+_ = box.space.test:insert{5, 'replica'}
+-- Make the applier wait for WAL so that rows pile up in its buffer.
+box.error.injection.set("ERRINJ_WAL_DELAY", true)
+
+test_run:cmd("switch default")
+for i = 1, 10 do s:insert{i, 'master'} end
+lsn = box.info.vclock[1]
+
+test_run:cmd("switch replica")
+fiber.sleep(0.1)
+box.error.injection.set("ERRINJ_WAL_DELAY", false)
+while box.info.replication[1].upstream.status ~= 'stopped' do fiber.sleep(0.01) end
+box.info.replication[1].upstream.message
+box.space.test:select()
+
+test_run:cmd("switch default")
+test_run:cmd('eval replica "box.info.vclock[1]"')[1] == lsn - 5
+
+test_run:cmd("switch replica")
+replication = box.cfg.replication
+box.cfg{replication = {}}
+box.cfg{replication = replication}
+while box.space.test:count() < 10 do fiber.sleep(0.01) end
+box.info.replication[1].upstream.status
+box.space.test:select()
+
+test_run:cmd("switch default")
+test_run:cmd('eval replica "box.info.vclock[1]"')[1] == lsn
+
+test_run:cmd("stop server replica")
+test_run:cmd("cleanup server replica")
+s:drop()
+box.schema.user.revoke('guest', 'replication')
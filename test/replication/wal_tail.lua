@@ -0,0 +1,11 @@
+#!/usr/bin/env tarantool
+
+box.cfg({
+    listen              = os.getenv("LISTEN"),
+    memtx_memory        = 107374182,
+    -- Keep a single block of the in-memory WAL tail.
+    wal_tail_size       = 1024 * 1024,
+    rows_per_wal        = 1000,
+})
+
+require('console').listen(os.getenv('ADMIN'))
@@ -0,0 +1,92 @@
+env = require('test_run')
+test_run = env.new()
+engine = test_run:get_cfg('engine')
+
+test_run:cmd("create server master with script='replication/wal_tail.lua'")
+test_run:cmd("start server master")
+test_run:cmd("switch master")
+test_run = require('test_run').new()
+engine = test_run:get_cfg('engine')
+box.schema.user.grant('guest', 'replication')
+s = box.schema.space.create('test', {engine = engine})
+_ = s:create_index('pk')
+pad = string.rep('x', 1000)
+
+test_run:cmd("switch default")
+test_run:cmd("create server replica with rpl_master=master, script='replication/replica.lua'")
+test_run:cmd("start server replica")
+test_run:cmd("switch replica")
+fiber = require('fiber')
+test_run:cmd("setopt delimiter ';'")
+-- Wait for rows 1..n and check there are no gaps. A duplicate
+-- row would stop the applier with ER_TUPLE_FOUND.
+function check(n)
+    while box.space.test:count() < n do
+        if box.info.replication[1].upstream.status == 'stopped' then
+            return false
+        end
+        fiber.sleep(0.01)
+    end
+    for i = 1, n do
+        if box.space.test:get(i) == nil then
+            return false
+        end
+    end
+    return box.space.test:count() == n
+end;
+test_run:cmd("setopt delimiter ''");
+
+--
+-- The relay falls behind while the WAL tail evicts the rows
+-- it hasn't sent yet. It reads them from xlog files and then
+-- returns to the tail.
+--
+test_run:cmd("switch master")
+box.error.injection.set('ERRINJ_RELAY_TIMEOUT', 0.001)
+for i = 1, 3000 do s:insert{i, pad} end
+box.error.injection.set('ERRINJ_RELAY_TIMEOUT', 0)
+for i = 3001, 3100 do s:insert{i, pad} end
+test_run:cmd("switch replica")
+check(3100)
+box.info.replication[1].upstream.status
+
+--
+-- The replica is down while the tail is evicted. It catches up
+-- from xlog files.
+--
+test_run:cmd("switch default")
+test_run:cmd("stop server replica")
+test_run:cmd("switch master")
+for i = 3101, 6000 do s:insert{i, pad} end
+test_run:cmd("switch default")
+test_run:cmd("start server replica")
+test_run:cmd("switch master")
+for i = 6001, 6100 do s:insert{i, pad} end
+test_run:cmd("switch replica")
+fiber = require('fiber')
+test_run:cmd("setopt delimiter ';'")
+function check(n)
+    while box.space.test:count() < n do
+        if box.info.replication[1].upstream.status == 'stopped' then
+            return false
+        end
+        fiber.sleep(0.01)
+    end
+    for i = 1, n do
+        if box.space.test:get(i) == nil then
+            return false
+        end
+    end
+    return box.space.test:count() == n
+end;
+test_run:cmd("setopt delimiter ''");
+check(6100)
+box.info.replication[1].upstream.status
+
+test_run:cmd("switch default")
+test_run:cmd('eval master "box.info.vclock[1]"')[1] == test_run:cmd('eval replica "box.info.vclock[1]"')[1]
+
+test_run:cmd("stop server replica")
+test_run:cmd("cleanup server replica")
+test_run:cmd("stop server master")
+test_run:cmd("cleanup server master")
@@ -174,6 +174,29 @@ cn:execute('drop table test3')
 cn:reload_schema()
 cn:execute('drop table if exists test3')
 
+--
+-- Prepared statements.
+--
+stmt = cn:prepare('select ?, ?')
+type(stmt.stmt_id)
+stmt.metadata
+cn:execute(stmt, {1, 2})
+cn:execute(stmt, {3, 4})
+cn:prepare('select ?, ?').stmt_id == stmt.stmt_id
+cn:prepare('select * from not_existing_table')
+cn:execute('create table test4(id primary key)')
+cn:reload_schema()
+-- Statements that return no rows have no metadata.
+cn:prepare('insert into test4 values (?)').metadata
+stmt = cn:prepare('select * from test4')
+cn:execute(stmt)
+cn:execute('insert into test4 values (?)', {1})
+cn:execute(stmt)
+-- Cached statements are recompiled after schema change.
+cn:execute('drop table test4')
+cn:reload_schema()
+cn:execute(stmt)
+
 -- gh-2602 obuf_alloc breaks the tuple in different slabs
 _ = space:replace{1, 1, string.rep('a', 4 * 1024 * 1024)}
 res = cn:execute('select * from test')
@@ -70,6 +70,26 @@ compare(type_t a, type_t b);
 #define bps_tree_key_t uint32_t
 #define bps_tree_arg_t int
 #include "salad/bps_tree.h"
+#undef BPS_TREE_NAME
+#undef BPS_TREE_BLOCK_SIZE
+#undef BPS_TREE_EXTENT_SIZE
+#undef BPS_TREE_COMPARE
+#undef BPS_TREE_COMPARE_KEY
+#undef bps_tree_elem_t
+#undef bps_tree_key_t
+#undef bps_tree_arg_t
+
+/* tree for order statistics test */
+#define BPS_TREE_NAME card
+#define BPS_TREE_BLOCK_SIZE 128 /* value is to low specially for tests */
+#define BPS_TREE_EXTENT_SIZE 2048 /* value is to low specially for tests */
+#define BPS_TREE_COMPARE(a, b, arg) compare(a, b)
+#define BPS_TREE_COMPARE_KEY(a, b, arg) compare(a, b)
+#define bps_tree_elem_t type_t
+#define bps_tree_key_t type_t
+#define bps_tree_arg_t int
+#define BPS_INNER_CARD
+#include "salad/bps_tree.h"
 
 #define bps_insert_and_check(tree_name, tree, elem, replaced) \
 {\
@@ -792,6 +812,105 @@ insert_get_iterator()
 	footer();
 }
 
+static void
+card_check_offsets(card *tree, const bool *present, type_t range)
+{
+	size_t less = 0;
+	for (type_t key = 0; key <= range; key++) {
+		bool exact;
+		size_t offset;
+		card_iterator itr = card_lower_bound_get_offset(tree, key,
+							       &exact, &offset);
+		if (offset != less || exact != (key < range && present[key]))
+			fail("wrong lower bound offset", "true");
+		size_t less_or_equal = less;
+		if (key < range && present[key])
+			less_or_equal++;
+		card_upper_bound_get_offset(tree, key, &exact,
+					    &offset);
+		if (offset != less_or_equal)
+			fail("wrong upper bound offset", "true");
+		if (key < range && present[key]) {
+			card_iterator at = card_iterator_at(tree, less);
+			if (!card_iterator_are_equal(tree, &at, &itr))
+				fail("wrong iterator at offset", "true");
+			type_t *v = card_iterator_get_elem(tree, &at);
+			if (v == NULL || *v != key)
+				fail("wrong element at offset", "true");
+		}
+		less = less_or_equal;
+	}
+	if (less != card_size(tree))
+		fail("wrong tree size", "true");
+	card_iterator at = card_iterator_at(tree, less);
+	if (!card_iterator_is_invalid(&at))
+		fail("iterator beyond the tree is valid", "true");
+}
+
+static void
+inner_card()
+{
+	header();
+	srand(0);
+
+	int res = card_debug_check_internal_functions(false);
+	if (res)
+		printf("self test returned error %d\n", res);
+
+	const type_t range = 3000;
+	bool present[range];
+	type_t arr[range];
+	for (type_t i = 0; i < range; i++) {
+		present[i] = i % 3 != 0;
+		arr[i] = i;
+	}
+
+	card tree;
+	card_create(&tree, 0, extent_alloc, extent_free, &extents_count);
+	for (type_t i = 0; i < range; i++)
+		if (present[i] && card_insert(&tree, i, NULL) != 0)
+			fail("insert failed", "true");
+	card_check_offsets(&tree, present, range);
+
+	for (int i = 0; i < 20000; i++) {
+		type_t v = rand() % range;
+		if (present[v]) {
+			if (card_delete(&tree, v) != 0)
+				fail("delete failed", "true");
+		} else {
+			card_iterator itr;
+			if (card_insert_get_iterator(&tree, v, NULL,
+						     &itr) != 0)
+				fail("insert failed", "true");
+		}
+		present[v] = !present[v];
+		if (i % 1000 == 0) {
+			if (card_debug_check(&tree))
+				fail("debug check nonzero", "true");
+			card_check_offsets(&tree, present, range);
+		}
+	}
+	if (card_debug_check(&tree))
+		fail("debug check nonzero", "true");
+	card_check_offsets(&tree, present, range);
+	card_destroy(&tree);
+
+	for (type_t i = 0; i < range; i++)
+		present[i] = true;
+	for (type_t count = 0; count < range; count += 97) {
+		card_create(&tree, 0, extent_alloc, extent_free,
+			    &extents_count);
+		if (card_build(&tree, arr, count))
+			fail("building failed", "true");
+		if (card_debug_check(&tree))
+			fail("debug check nonzero", "true");
+		card_check_offsets(&tree, present, count);
+		card_destroy(&tree);
+	}
+
+	footer();
+}
+
 int
 main(void)
 {
@@ -806,4 +925,5 @@ main(void)
 	if (extents_count != 0)
 		fail("memory leak!", "true");
 	insert_get_iterator();
+	inner_card();
 }
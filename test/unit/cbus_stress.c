@@ -3,11 +3,13 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 #include "memory.h"
 #include "fiber.h"
 #include "cbus.h"
+#include "clock.h"
 #include "unit.h"
 
 /*
@@ -27,6 +29,22 @@ static const int connect_prob = 30;
 /* Chance of disconnecting from a random neighbor in a loop iteration. */
 static const int disconnect_prob = 20;
 
+/*
+ * If the test is run with --bench, the threads stream messages
+ * to the main thread instead, and the throughput and the hop
+ * latency of the bus are reported.
+ */
+static bool bench;
+
+/* Number of threads sending messages in the benchmark. */
+static const int bench_thread_count = 4;
+
+/* Number of messages sent by each thread in the benchmark. */
+static const int bench_msg_count = 1000000;
+
+/* Max number of messages in flight per thread in the benchmark. */
+static const int bench_window = 512;
+
 /* This structure represents a connection to a test thread. */
 struct conn {
 	bool active;
@@ -71,6 +89,12 @@ struct thread {
 	 * Sum 'send' must be equal to sum 'received' over all test threads.
 	 */
 	int sent, received;
+	/* Benchmark: pipes to and from the main thread. */
+	struct cpipe bench_to, bench_from;
+	/* Benchmark: route of a message, there and back. */
+	struct cmsg_hop bench_route[2];
+	/* Benchmark: signalled when a message gets back. */
+	struct fiber_cond bench_cond;
 };
 
 /* Array of test threads. */
@@ -134,11 +158,15 @@ thread_create(struct thread *t, int id)
 static int
 test_func(va_list ap);
 
+static int
+bench_func(va_list ap);
+
 static void
 thread_start_test_cb(struct cmsg *cmsg)
 {
 	struct thread *t = container_of(cmsg, struct thread, cmsg);
-	struct fiber *test_fiber = fiber_new("test", test_func);
+	struct fiber *test_fiber = fiber_new("test", bench ? bench_func :
+					     test_func);
 	assert(test_fiber != NULL);
 	fiber_start(test_fiber, t);
 }
@@ -307,6 +335,87 @@ test_func(va_list ap)
 	return 0;
 }
 
+struct bench_msg {
+	struct cmsg cmsg;
+	struct thread *thread;
+	/* Time when the message was pushed, in nanoseconds. */
+	uint64_t sent_at;
+};
+
+/* Benchmark results, collected by the main thread. */
+static int64_t bench_received;
+static uint64_t bench_latency_sum;
+static uint64_t bench_latency_max;
+
+static void
+bench_msg_received_cb(struct cmsg *cmsg)
+{
+	struct bench_msg *msg = container_of(cmsg, struct bench_msg, cmsg);
+	uint64_t latency = clock_monotonic64() - msg->sent_at;
+	bench_latency_sum += latency;
+	if (latency > bench_latency_max)
+		bench_latency_max = latency;
+	bench_received++;
+}
+
+static void
+bench_msg_returned_cb(struct cmsg *cmsg)
+{
+	struct bench_msg *msg = container_of(cmsg, struct bench_msg, cmsg);
+	struct thread *t = msg->thread;
+	t->received++;
+	free(msg);
+	fiber_cond_signal(&t->bench_cond);
+}
+
+static int
+bench_func(va_list ap)
+{
+	struct thread *t = va_arg(ap, struct thread *);
+	cbus_pair("main", t->name, &t->bench_to, &t->bench_from,
+		  NULL, NULL, NULL);
+	t->bench_route[0].f = bench_msg_received_cb;
+	t->bench_route[0].pipe = &t->bench_from;
+	t->bench_route[1].f = bench_msg_returned_cb;
+	t->bench_route[1].pipe = NULL;
+	fiber_cond_create(&t->bench_cond);
+	while (t->received < bench_msg_count) {
+		while (t->sent < bench_msg_count &&
+		       t->sent - t->received < bench_window) {
+			struct bench_msg *msg = malloc(sizeof(*msg));
+			assert(msg != NULL);
+			cmsg_init(&msg->cmsg, t->bench_route);
+			msg->thread = t;
+			msg->sent_at = clock_monotonic64();
+			cpipe_push_input(&t->bench_to, &msg->cmsg);
+			t->sent++;
+		}
+		cpipe_flush_input(&t->bench_to);
+		fiber_cond_wait(&t->bench_cond);
+	}
+	fiber_cond_destroy(&t->bench_cond);
+	cbus_unpair(&t->bench_to, &t->bench_from, NULL, NULL, NULL);
+	/* Notify the main thread that we are done. */
+	static struct cmsg_hop complete_route[] = {
+		{ test_complete_cb, NULL }
+	};
+	cmsg_init(&t->cmsg, complete_route);
+	cpipe_push(&t->main_pipe, &t->cmsg);
+	return 0;
+}
+
+static void
+bench_report(uint64_t elapsed)
+{
+	printf("# threads: %d, messages: %lld, window: %d\n",
+	       bench_thread_count, (long long)bench_received, bench_window);
+	printf("# throughput: %.0f messages/sec\n",
+	       bench_received * 1e9 / elapsed);
+	printf("# hop latency: avg %.1f us, max %.1f us\n",
+	       bench_latency_sum / 1e3 / bench_received,
+	       bench_latency_max / 1e3);
+}
+
 static int
 thread_func(va_list ap)
 {
@@ -336,16 +445,21 @@ main_func(va_list ap)
 	threads = calloc(thread_count, sizeof(*threads));
 	assert(threads != NULL);
 
-	for (int i = 0; i < thread_count; i++)
+	int count = bench ? bench_thread_count : thread_count;
+	for (int i = 0; i < count; i++)
 		thread_create(&threads[i], i);
 
-	for (int i = 0; i < thread_count; i++)
+	uint64_t start = clock_monotonic64();
+	for (int i = 0; i < count; i++)
 		thread_start_test(&threads[i]);
 
 	cbus_loop(&endpoint);
 
+	if (bench)
+		bench_report(clock_monotonic64() - start);
+
 	int sent = 0, received = 0;
-	for (int i = 0; i < thread_count; i++) {
+	for (int i = 0; i < count; i++) {
 		struct thread *t = &threads[i];
 		sent += t->sent;
 		received += t->received;
@@ -364,8 +478,9 @@ main_func(va_list ap)
 }
 
 int
-main()
+main(int argc, char **argv)
 {
+	bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
 	srand(time(NULL));
 
 	memory_init();
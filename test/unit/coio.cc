@@ -1,7 +1,12 @@
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "memory.h"
 #include "fiber.h"
 #include "coio.h"
 #include "coio_task.h"
+#include "coio_file.h"
+#include "uring.h"
 #include "fio.h"
 #include "unit.h"
 #include "unit.h"
@@ -68,6 +73,56 @@ test_call_f(va_list ap)
 	return res;
 }
 
+static int
+file_io_f(va_list ap)
+{
+	int fd = va_arg(ap, int);
+	int id = va_arg(ap, int);
+	char buf[64], out[64];
+	memset(buf, 'a' + id, sizeof(buf));
+	off_t offset = id * sizeof(buf);
+	fail_unless(coio_pwrite(fd, buf, sizeof(buf), offset) ==
+		    (ssize_t)sizeof(buf));
+	fail_unless(coio_fdatasync(fd) == 0);
+	fail_unless(coio_pread(fd, out, sizeof(out), offset) ==
+		    (ssize_t)sizeof(out));
+	fail_unless(memcmp(buf, out, sizeof(buf)) == 0);
+	return 0;
+}
+
+/**
+ * Concurrent file I/O from many fibers, served by io_uring
+ * if it is available, by the thread pool otherwise.
+ */
+static void
+file_io_test(void)
+{
+	header();
+
+	const char *filename = "2.out";
+	int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	fail_unless(fd >= 0);
+	enum { FIBER_COUNT = 10 };
+	struct fiber *fibers[FIBER_COUNT];
+	for (int i = 0; i < FIBER_COUNT; i++) {
+		fibers[i] = fiber_new_xc("file_io", file_io_f);
+		fiber_set_joinable(fibers[i], true);
+		fiber_start(fibers[i], fd, i);
+	}
+	for (int i = 0; i < FIBER_COUNT; i++)
+		fiber_join(fibers[i]);
+	struct stat st;
+	fail_unless(fstat(fd, &st) == 0);
+	note("file size: %lld", (long long)st.st_size);
+	char c;
+	note("read past eof: %zd", coio_pread(fd, &c, 1, st.st_size));
+	fail_unless(coio_fsync(fd) == 0);
+	close(fd);
+	(void) remove(filename);
+
+	footer();
+}
+
 static int
 main_f(va_list ap)
 {
@@ -86,6 +141,10 @@ main_f(va_list ap)
 	fiber_cancel(call_fiber);
 	fiber_join(call_fiber);
 
+	uring_enable();
+	file_io_test();
+	uring_free();
+
 	ev_break(loop(), EVBREAK_ALL);
 	return 0;
 }
@@ -1,4 +1,8 @@
 #include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "unit.h"
 #include "say.h"
 
@@ -44,11 +48,65 @@ parse_syslog_opts(const char *input)
 	return 0;
 }
 
+enum { WRITER_THREADS = 4, WRITER_MESSAGES = 100 };
+
+static void *
+writer_test_f(void *arg)
+{
+	int id = (intptr_t)arg;
+	for (int i = 0; i < WRITER_MESSAGES; i++)
+		say_info("thread %d message %d", id, i);
+	return NULL;
+}
+
+static void
+test_writer(void)
+{
+	char path[] = "/tmp/say.test.XXXXXX";
+	int fd = mkstemp(path);
+	fail_if(fd < 0);
+	close(fd);
+	say_logger_init(path, S_INFO, 0, "plain", 0);
+	say_logger_start_writer();
+	pthread_t threads[WRITER_THREADS];
+	for (int i = 0; i < WRITER_THREADS; i++) {
+		fail_if(pthread_create(&threads[i], NULL, writer_test_f,
+				       (void *)(intptr_t)i) != 0);
+	}
+	for (int i = 0; i < WRITER_THREADS; i++)
+		pthread_join(threads[i], NULL);
+	say_logger_stop_writer();
+
+	FILE *f = fopen(path, "r");
+	fail_if(f == NULL);
+	int count = 0;
+	bool in_order = true;
+	int next[WRITER_THREADS] = {0};
+	char line[256];
+	while (fgets(line, sizeof(line), f) != NULL) {
+		const char *msg = strstr(line, "I> thread ");
+		int id, i;
+		if (msg == NULL ||
+		    sscanf(msg, "I> thread %d message %d", &id, &i) != 2)
+			continue;
+		if (id < 0 || id >= WRITER_THREADS || next[id] != i)
+			in_order = false;
+		else
+			next[id]++;
+		count++;
+	}
+	fclose(f);
+	unlink(path);
+	ok(count == WRITER_THREADS * WRITER_MESSAGES,
+	   "writer: all messages are written");
+	ok(in_order, "writer: messages of a thread are in order");
+}
+
 int main()
 {
 	say_logger_init("/dev/null", S_INFO, 0, "plain", 0);
 
-	plan(20);
+	plan(22);
 
 #define PARSE_LOGGER_TYPE(input, rc) \
 	ok(parse_logger_type(input) == rc, "%s", input)
@@ -78,5 +136,7 @@ int main()
 	PARSE_SYSLOG_OPTS("facility=local1,facility=local2", -1);
 	PARSE_SYSLOG_OPTS("identity=foo,identity=bar", -1);
 
+	test_writer();
+
 	return check_plan();
 }
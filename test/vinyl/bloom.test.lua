@@ -48,3 +48,33 @@ new_reflects() > 980
 new_seeks() < 20
 
 s:drop()
+
+--
+-- Bloom filters on key prefixes.
+--
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk', {parts = {1, 'unsigned', 2, 'unsigned'}, bloom_prefix = true})
+_ = s:create_index('sk', {parts = {2, 'unsigned', 1, 'unsigned'}})
+for i = 1,1000 do s:replace{i, i} end
+box.snapshot()
+pk_hits = s.index.pk:info().disk.iterator.bloom.hit
+sk_hits = s.index.sk:info().disk.iterator.bloom.hit
+
+for i = 1,1000 do s.index.pk:select{i} end
+for i = 1,1000 do s.index.sk:select{i} end
+s.index.pk:info().disk.iterator.bloom.hit - pk_hits == 0
+s.index.sk:info().disk.iterator.bloom.hit - sk_hits == 0
+
+for i = 1001,2000 do s.index.pk:select{i} end
+for i = 1001,2000 do s.index.sk:select{i} end
+s.index.pk:info().disk.iterator.bloom.hit - pk_hits > 980
+s.index.sk:info().disk.iterator.bloom.hit - sk_hits == 0
+
+test_run:cmd('restart server default')
+
+s = box.space.test
+pk_hits = s.index.pk:info().disk.iterator.bloom.hit
+for i = 1001,2000 do s.index.pk:select{i} end
+s.index.pk:info().disk.iterator.bloom.hit - pk_hits > 980
+
+s:drop()
@@ -39,5 +39,25 @@ test_run:grep_log('default', 'UPSERT operation failed') ~= nil
 
 space:drop()
 
+--
+-- Compaction of a large range is split in parts merged
+-- by different worker threads.
+--
+digest = require('digest')
+space = box.schema.space.create('test', {engine = 'vinyl'})
+pk = space:create_index('pk', {page_size = 1024, range_size = 16 * 1024, run_count_per_level = 1})
+for i = 1, 1000 do space:replace{i, digest.urandom(100)} end
+box.snapshot()
+for i = 1, 1000 do space:replace{i, digest.urandom(150)} end
+box.snapshot()
+while pk:info().disk.compact.count == 0 do fiber.sleep(0.01) end
+pk:info().range_count
+pk:info().run_count
+space:count()
+bad = 0
+for i = 1, 1000 do if #space:get(i)[2] ~= 150 then bad = bad + 1 end end
+bad
+space:drop()
+
 fiber = nil
 test_run = nil
@@ -0,0 +1,75 @@
+test_run = require('test_run').new()
+fiber = require('fiber')
+fio = require('fio')
+xlog = require('xlog')
+
+box.cfg{vinyl_dict_size = -1}
+box.cfg{vinyl_dict_size = 2 * 1024 * 1024}
+box.cfg{vinyl_dict_size = 4096}
+
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk', {run_count_per_level = 2})
+
+test_run:cmd("setopt delimiter ';'")
+function fill(first, last)
+    for i = first, last do
+        s:replace{i, string.format('user%08d@example.com', i),
+                  'status: active', i % 7}
+    end
+end;
+function files(suffix)
+    local dir = fio.pathjoin(box.cfg.vinyl_dir, tostring(s.id),
+                             tostring(s.index.pk.id))
+    local list = fio.glob(fio.pathjoin(dir, '*.' .. suffix))
+    table.sort(list)
+    return list
+end;
+function has_dict(run)
+    return fio.stat((string.gsub(run, '%.run$', '.dict'))) ~= nil
+end;
+function count_rows(path)
+    local n = 0
+    for _, row in xlog.pairs(path) do
+        if row.BODY.tuple ~= nil then n = n + 1 end
+    end
+    return n
+end;
+test_run:cmd("setopt delimiter ''");
+
+--
+-- Dump trains a dictionary for the new run and stores it
+-- next to the run file.
+--
+fill(1, 2000)
+box.snapshot()
+#files('run')
+#files('dict')
+has_dict(files('run')[1])
+count_rows(files('run')[1])
+s:get(1)
+s:get(2000)
+s:count()
+
+--
+-- Compaction reuses the dictionary of a compacted run.
+--
+fill(2001, 3000)
+box.snapshot()
+fill(3001, 4000)
+box.snapshot()
+while s.index.pk:info().run_count > 1 do fiber.sleep(0.01) end
+has_dict(files('run')[#files('run')])
+count_rows(files('run')[#files('run')])
+s:count()
+
+--
+-- Runs are readable after restart, with dictionaries
+-- disabled as well.
+--
+test_run:cmd('restart server default')
+s = box.space.test
+box.cfg.vinyl_dict_size
+s:get(1)
+s:get(4000)
+s:count()
+s:drop()
@@ -0,0 +1,40 @@
+test_run = require('test_run').new()
+
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk')
+
+for i = 1, 100 do s:replace{i} end
+box.snapshot()
+
+function page_cache() local c = s.index.pk:info().disk.iterator.page_cache return {c.hit, c.miss} end
+function global_page_cache() local c = box.info.vinyl().performance.page_cache return {c.count, c.used} end
+
+--
+-- The first read loads the page from disk, subsequent reads
+-- of other keys stored in the same page are served from the
+-- page cache.
+--
+page_cache()
+s:get(1)
+page_cache()
+s:get(2)
+s:get(3)
+page_cache()
+global_page_cache()[1] > 0
+global_page_cache()[2] > 0
+
+--
+-- Shrinking the cache evicts pages.
+--
+box.cfg{vinyl_page_cache = 0}
+global_page_cache()
+s:get(4)
+page_cache()
+global_page_cache()
+
+box.cfg{vinyl_page_cache = 128 * 1024 * 1024}
+s:get(5)
+s:get(6)
+page_cache()
+
+s:drop()
@@ -0,0 +1,12 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen                  = os.getenv("LISTEN"),
+    memtx_memory            = 107374182,
+    pid_file                = "tarantool.pid",
+    checkpoint_count        = 2,
+    memtx_checkpoint_deltas = 2
+}
+
+require('console').listen(os.getenv('ADMIN'))
@@ -0,0 +1,140 @@
+--
+-- Check that memtx writes delta checkpoints if
+-- memtx_checkpoint_deltas is set.
+--
+test_run = require('test_run').new()
+box.cfg{memtx_checkpoint_deltas = -1}
+test_run:cmd("create server delta with script='xlog/checkpoint_delta.lua'")
+test_run:cmd("start server delta")
+test_run:cmd("switch delta")
+fio = require('fio')
+xlog = require('xlog')
+test_run:cmd("setopt delimiter ';'")
+function snap_files()
+    local files = fio.glob(fio.pathjoin(box.cfg.memtx_dir, '*.snap'))
+    table.sort(files)
+    return files
+end;
+function last_snap()
+    local files = snap_files()
+    return files[#files]
+end;
+function snap_is_delta(path)
+    local f = fio.open(path)
+    local header = f:read(1024)
+    f:close()
+    return string.find(header, 'PrevVClock') ~= nil
+end;
+function snap_rows(path)
+    local rows = {}
+    for _, row in xlog.pairs(path) do
+        if row.BODY.space_id == box.space.test.id then
+            local t = row.HEADER.type
+            rows[t] = (rows[t] or 0) + 1
+        end
+    end
+    return rows.INSERT, rows.REPLACE, rows.DELETE
+end;
+test_run:cmd("setopt delimiter ''");
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+for i = 1, 100 do s:replace{i} end
+-- DDL since the last checkpoint, full checkpoint.
+box.snapshot()
+snap_is_delta(last_snap())
+snap_rows(last_snap())
+-- Only changed tuples and deleted keys are written.
+_ = s:replace{1, 'a'}
+_ = s:delete{2}
+_ = s:insert{101}
+box.snapshot()
+snap_is_delta(last_snap())
+snap_rows(last_snap())
+_ = s:delete{3}
+box.snapshot()
+snap_is_delta(last_snap())
+snap_rows(last_snap())
+-- The full snapshot the deltas are based on is kept.
+#snap_files()
+-- Too many deltas, full checkpoint.
+_ = s:replace{4, 'b'}
+box.snapshot()
+snap_is_delta(last_snap())
+snap_rows(last_snap())
+#snap_files()
+-- The old chain is removed once it isn't needed.
+_ = s:replace{5, 'c'}
+box.snapshot()
+snap_is_delta(last_snap())
+snap_rows(last_snap())
+#snap_files()
+-- Recovery applies deltas and then the WAL.
+_ = s:insert{200}
+test_run:cmd("restart server delta")
+fio = require('fio')
+xlog = require('xlog')
+test_run:cmd("setopt delimiter ';'")
+function snap_files()
+    local files = fio.glob(fio.pathjoin(box.cfg.memtx_dir, '*.snap'))
+    table.sort(files)
+    return files
+end;
+function last_snap()
+    local files = snap_files()
+    return files[#files]
+end;
+function snap_is_delta(path)
+    local f = fio.open(path)
+    local header = f:read(1024)
+    f:close()
+    return string.find(header, 'PrevVClock') ~= nil
+end;
+function snap_rows(path)
+    local rows = {}
+    for _, row in xlog.pairs(path) do
+        if row.BODY.space_id == box.space.test.id then
+            local t = row.HEADER.type
+            rows[t] = (rows[t] or 0) + 1
+        end
+    end
+    return rows.INSERT, rows.REPLACE, rows.DELETE
+end;
+test_run:cmd("setopt delimiter ''");
+s = box.space.test
+s:count()
+s:get{1}
+s:get{2}
+s:get{3}
+s:get{4}
+s:get{5}
+s:get{200}
+-- Changes recovered from the WAL go to the next delta.
+_ = s:delete{6}
+_ = s:delete{200}
+box.snapshot()
+snap_is_delta(last_snap())
+snap_rows(last_snap())
+#snap_files()
+-- DDL forces a full checkpoint.
+box.schema.space.create('test2'):drop()
+_ = s:replace{7, 'd'}
+box.snapshot()
+snap_is_delta(last_snap())
+snap_rows(last_snap())
+#snap_files()
+-- Disabling deltas.
+box.cfg{memtx_checkpoint_deltas = 0}
+_ = s:replace{8, 'e'}
+box.snapshot()
+snap_is_delta(last_snap())
+snap_rows(last_snap())
+test_run:cmd("restart server delta")
+s = box.space.test
+s:count()
+s:get{6}
+s:get{7}
+s:get{8}
+s:drop()
+test_run:cmd("switch default")
+test_run:cmd("stop server delta")
+test_run:cmd("cleanup server delta")
@@ -0,0 +1,11 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen                   = os.getenv("LISTEN"),
+    memtx_memory             = 107374182,
+    pid_file                 = "tarantool.pid",
+    memtx_checkpoint_threads = 4
+}
+
+require('console').listen(os.getenv('ADMIN'))
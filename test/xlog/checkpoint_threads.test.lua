@@ -0,0 +1,83 @@
+--
+-- Check that user spaces are written to a snapshot by
+-- several threads if memtx_checkpoint_threads is set.
+--
+test_run = require('test_run').new()
+box.cfg{memtx_checkpoint_threads = 0}
+box.cfg{memtx_checkpoint_threads = 33}
+test_run:cmd("create server threads with script='xlog/checkpoint_threads.lua'")
+test_run:cmd("start server threads")
+test_run:cmd("switch threads")
+fio = require('fio')
+xlog = require('xlog')
+digest = require('digest')
+test_run:cmd("setopt delimiter ';'")
+function last_snap()
+    local files = fio.glob(fio.pathjoin(box.cfg.memtx_dir, '*.snap'))
+    table.sort(files)
+    return files[#files]
+end;
+function snap_rows(path)
+    local rows = {}
+    for _, row in xlog.pairs(path) do
+        local id = row.BODY.space_id
+        rows[id] = (rows[id] or 0) + 1
+    end
+    local result = {}
+    for i = 1, 8 do
+        table.insert(result, rows[box.space['test' .. i].id])
+    end
+    return result
+end;
+function check_spaces()
+    local result = {}
+    for i = 1, 8 do
+        local s = box.space['test' .. i]
+        local ok = s:count() == i * 100
+        for _, t in s:pairs() do
+            ok = ok and t[2] == digest.sha1_hex(tostring(t[1]))
+        end
+        table.insert(result, ok)
+    end
+    return result
+end;
+for i = 1, 8 do
+    local s = box.schema.space.create('test' .. i)
+    s:create_index('pk')
+    for j = 1, i * 100 do
+        s:insert{j, digest.sha1_hex(tostring(j))}
+    end
+end;
+test_run:cmd("setopt delimiter ''");
+box.snapshot()
+snap_rows(last_snap())
+test_run:cmd("restart server threads")
+fio = require('fio')
+xlog = require('xlog')
+digest = require('digest')
+test_run:cmd("setopt delimiter ';'")
+function check_spaces()
+    local result = {}
+    for i = 1, 8 do
+        local s = box.space['test' .. i]
+        local ok = s:count() == i * 100
+        for _, t in s:pairs() do
+            ok = ok and t[2] == digest.sha1_hex(tostring(t[1]))
+        end
+        table.insert(result, ok)
+    end
+    return result
+end;
+test_run:cmd("setopt delimiter ''");
+check_spaces()
+-- The number of threads can be changed on the fly.
+box.cfg{memtx_checkpoint_threads = 2}
+box.space.test1:replace{1, 'x'}
+box.snapshot()
+test_run:cmd("restart server threads")
+box.space.test1:get{1}
+box.space.test8:count()
+for i = 1, 8 do box.space['test' .. i]:drop() end
+test_run:cmd("switch default")
+test_run:cmd("stop server threads")
+test_run:cmd("cleanup server threads")
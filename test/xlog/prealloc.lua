@@ -0,0 +1,12 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen              = os.getenv("LISTEN"),
+    memtx_memory        = 107374182,
+    pid_file            = "tarantool.pid",
+    wal_max_size        = 1024 * 1024,
+    wal_prealloc        = true
+}
+
+require('console').listen(os.getenv('ADMIN'))
@@ -0,0 +1,56 @@
+--
+-- Check that WAL files are preallocated if wal_prealloc
+-- is set and the unused tail is treated as end of log.
+--
+test_run = require('test_run').new()
+test_run:cmd("create server prealloc with script='xlog/prealloc.lua'")
+test_run:cmd("start server prealloc")
+test_run:cmd("switch prealloc")
+fio = require('fio')
+xlog = require('xlog')
+fiber = require('fiber')
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+for i = 1, 100 do s:replace{i} end
+test_run:cmd("setopt delimiter ';'")
+function last_xlog()
+    local files = fio.glob(fio.pathjoin(box.cfg.wal_dir, '*.xlog'))
+    table.sort(files)
+    return files[#files]
+end;
+function count_rows(path)
+    local count = 0
+    for _, row in xlog.pairs(path) do
+        if row.BODY.space_id == s.id then
+            count = count + 1
+        end
+    end
+    return count
+end;
+test_run:cmd("setopt delimiter ''");
+-- The current WAL is preallocated.
+xlog_path = last_xlog()
+fio.stat(xlog_path).size >= box.cfg.wal_max_size
+-- The reader stops at the unused tail.
+count_rows(xlog_path)
+-- Spare files are created in the background.
+spare_pattern = fio.pathjoin(box.cfg.wal_dir, '*.spare')
+while #fio.glob(spare_pattern) < 2 do fiber.sleep(0.01) end
+#fio.glob(spare_pattern)
+-- The unused tail is cut off on close.
+box.snapshot()
+fio.stat(xlog_path).size < box.cfg.wal_max_size
+count_rows(xlog_path)
+-- The next WAL is created from a spare file.
+for i = 101, 200 do s:replace{i} end
+xlog_path = last_xlog()
+fio.stat(xlog_path).size >= box.cfg.wal_max_size
+count_rows(xlog_path)
+-- Recovery from preallocated WALs.
+test_run:cmd("restart server prealloc")
+s = box.space.test
+s:count()
+s:drop()
+test_run:cmd("switch default")
+test_run:cmd("stop server prealloc")
+test_run:cmd("cleanup server prealloc")